@@ -25,7 +25,11 @@
 
 #include <guacamole/client.h>
 #include <guacamole/protocol.h>
+#include <guacamole/socket.h>
 #include <guacamole/stream.h>
+#include <guacamole/timestamp.h>
+#include <limits.h>
+#include <pthread.h>
 #include <string.h>
 #include <stdlib.h>
 
@@ -33,70 +37,268 @@ guac_common_clipboard* guac_common_clipboard_alloc(int size) {
 
     guac_common_clipboard* clipboard = malloc(sizeof(guac_common_clipboard));
 
+    /* Buffer initially only large enough for typical clipboard contents */
+    int available = GUAC_COMMON_CLIPBOARD_INITIAL_SIZE;
+    if (available > size)
+        available = size;
+
     /* Init clipboard */
     clipboard->mimetype[0] = '\0';
-    clipboard->buffer = malloc(size);
+    clipboard->buffer = malloc(available);
     clipboard->length = 0;
-    clipboard->available = size;
+    clipboard->available = available;
+    clipboard->max_length = size;
+
+    /* No contents being sent */
+    clipboard->transfer = NULL;
+    clipboard->acknowledged = 0;
+    pthread_mutex_init(&(clipboard->lock), NULL);
 
     return clipboard;
 
 }
 
 void guac_common_clipboard_free(guac_common_clipboard* clipboard) {
+
+    /* Abandon any contents still being sent */
+    if (clipboard->transfer != NULL) {
+        free(clipboard->transfer->data);
+        free(clipboard->transfer);
+    }
+
+    pthread_mutex_destroy(&(clipboard->lock));
     free(clipboard->buffer);
     free(clipboard);
+
 }
 
-void guac_common_clipboard_send(guac_common_clipboard* clipboard, guac_client* client) {
+/**
+ * Ends the current transfer of clipboard contents, closing its stream. The
+ * clipboard lock must be held.
+ *
+ * @param clipboard The clipboard whose current transfer should be ended.
+ */
+static void __guac_common_clipboard_end_transfer(
+        guac_common_clipboard* clipboard) {
 
-    char* current = clipboard->buffer;
-    int remaining = clipboard->length;
+    guac_common_clipboard_transfer* transfer = clipboard->transfer;
 
-    /* Begin stream */
-    guac_stream* stream = guac_client_alloc_stream(client);
-    guac_protocol_send_clipboard(client->socket, stream, clipboard->mimetype);
+    /* End stream */
+    guac_protocol_send_end(transfer->client->socket, transfer->stream);
+    guac_client_free_stream(transfer->client, transfer->stream);
+
+    free(transfer->data);
+    free(transfer);
+    clipboard->transfer = NULL;
+
+}
+
+/**
+ * Sends blobs of the current transfer of clipboard contents until either all
+ * contents have been sent or the given number of blobs are awaiting
+ * acknowledgement, ending the transfer once all contents have been sent. The
+ * clipboard lock must be held.
+ *
+ * @param clipboard The clipboard whose current transfer should continue.
+ * @param window The maximum number of blobs which may await acknowledgement.
+ */
+static void __guac_common_clipboard_send_blocks(
+        guac_common_clipboard* clipboard, int window) {
+
+    guac_common_clipboard_transfer* transfer = clipboard->transfer;
 
     /* Split clipboard into chunks */
-    while (remaining > 0) {
+    while (transfer->offset < transfer->length
+            && transfer->unacknowledged < window) {
 
         /* Calculate size of next block */
         int block_size = GUAC_COMMON_CLIPBOARD_BLOCK_SIZE;
+        int remaining = transfer->length - transfer->offset;
         if (remaining < block_size)
-            block_size = remaining; 
+            block_size = remaining;
 
         /* Send block */
-        guac_protocol_send_blob(client->socket, stream, current, block_size);
+        guac_protocol_send_blob(transfer->client->socket, transfer->stream,
+                transfer->data + transfer->offset, block_size);
 
         /* Next block */
-        remaining -= block_size;
-        current += block_size;
+        transfer->offset += block_size;
+        transfer->unacknowledged++;
+        transfer->last_sent = guac_timestamp_current();
 
     }
 
-    /* End stream */
-    guac_protocol_send_end(client->socket, stream);
-    guac_client_free_stream(client, stream);
+    /* End stream once all contents are sent */
+    if (transfer->offset == transfer->length)
+        __guac_common_clipboard_end_transfer(clipboard);
+
+}
+
+/**
+ * Handler for acknowledgements of blobs of clipboard contents, sending
+ * further blobs as earlier blobs are acknowledged.
+ */
+static int __guac_common_clipboard_ack_handler(guac_client* client,
+        guac_stream* stream, char* message, guac_protocol_status status) {
+
+    guac_common_clipboard* clipboard = (guac_common_clipboard*) stream->data;
+    guac_common_clipboard_transfer* transfer;
+
+    pthread_mutex_lock(&(clipboard->lock));
+
+    /* Ignore acknowledgements for abandoned transfers */
+    transfer = clipboard->transfer;
+    if (transfer == NULL || transfer->stream != stream) {
+        pthread_mutex_unlock(&(clipboard->lock));
+        return 0;
+    }
+
+    /* If successful, send more data */
+    if (status == GUAC_PROTOCOL_STATUS_SUCCESS) {
+
+        clipboard->acknowledged = 1;
+        if (transfer->unacknowledged > 0)
+            transfer->unacknowledged--;
+
+        __guac_common_clipboard_send_blocks(clipboard,
+                GUAC_COMMON_CLIPBOARD_WINDOW_SIZE);
+        guac_socket_flush(client->socket);
+
+    }
+
+    /* Otherwise, return stream to client */
+    else {
+        guac_client_free_stream(client, stream);
+        free(transfer->data);
+        free(transfer);
+        clipboard->transfer = NULL;
+    }
+
+    pthread_mutex_unlock(&(clipboard->lock));
+    return 0;
+
+}
+
+void guac_common_clipboard_send(guac_common_clipboard* clipboard, guac_client* client) {
+
+    guac_common_clipboard_transfer* transfer;
+    guac_stream* stream;
+
+    pthread_mutex_lock(&(clipboard->lock));
+
+    /* Previous contents are superseded */
+    if (clipboard->transfer != NULL)
+        __guac_common_clipboard_end_transfer(clipboard);
+
+    /* Begin stream */
+    stream = guac_client_alloc_stream(client);
+    if (stream == NULL) {
+        guac_client_log_error(client,
+                "Unable to allocate stream for clipboard");
+        pthread_mutex_unlock(&(clipboard->lock));
+        return;
+    }
+
+    stream->data = clipboard;
+    stream->ack_handler = __guac_common_clipboard_ack_handler;
+    guac_protocol_send_clipboard(client->socket, stream, clipboard->mimetype);
+
+    /* Copy contents, such that the clipboard may change during transfer */
+    transfer = malloc(sizeof(guac_common_clipboard_transfer));
+    transfer->client = client;
+    transfer->stream = stream;
+    transfer->data = malloc(clipboard->length);
+    transfer->length = clipboard->length;
+    transfer->offset = 0;
+    transfer->unacknowledged = 0;
+    transfer->last_sent = guac_timestamp_current();
+    memcpy(transfer->data, clipboard->buffer, clipboard->length);
+    clipboard->transfer = transfer;
+
+    /* Send first blocks, remaining blocks are sent when acknowledged */
+    __guac_common_clipboard_send_blocks(clipboard,
+            GUAC_COMMON_CLIPBOARD_WINDOW_SIZE);
+
+    pthread_mutex_unlock(&(clipboard->lock));
+
+}
+
+void guac_common_clipboard_continue(guac_common_clipboard* clipboard) {
+
+    guac_common_clipboard_transfer* transfer;
+
+    pthread_mutex_lock(&(clipboard->lock));
+
+    /* Send everything if the client does not appear to acknowledge blobs */
+    transfer = clipboard->transfer;
+    if (transfer != NULL && !clipboard->acknowledged
+            && guac_timestamp_current() - transfer->last_sent
+                >= GUAC_COMMON_CLIPBOARD_ACK_TIMEOUT)
+        __guac_common_clipboard_send_blocks(clipboard, INT_MAX);
+
+    pthread_mutex_unlock(&(clipboard->lock));
 
 }
 
 void guac_common_clipboard_reset(guac_common_clipboard* clipboard, const char* mimetype) {
+
+    pthread_mutex_lock(&(clipboard->lock));
+
+    /* Release any space beyond that needed for typical contents */
+    if (clipboard->available > GUAC_COMMON_CLIPBOARD_INITIAL_SIZE) {
+        char* buffer = realloc(clipboard->buffer,
+                GUAC_COMMON_CLIPBOARD_INITIAL_SIZE);
+        if (buffer != NULL) {
+            clipboard->buffer = buffer;
+            clipboard->available = GUAC_COMMON_CLIPBOARD_INITIAL_SIZE;
+        }
+    }
+
     clipboard->length = 0;
     strncpy(clipboard->mimetype, mimetype, sizeof(clipboard->mimetype)-1);
+
+    pthread_mutex_unlock(&(clipboard->lock));
+
 }
 
 void guac_common_clipboard_append(guac_common_clipboard* clipboard, const char* data, int length) {
 
-    /* Truncate data to available length */
-    int remaining = clipboard->available - clipboard->length;
+    int remaining;
+
+    pthread_mutex_lock(&(clipboard->lock));
+
+    /* Truncate data to maximum length */
+    remaining = clipboard->max_length - clipboard->length;
     if (remaining < length)
         length = remaining;
 
+    /* Grow buffer if necessary, doubling its size */
+    if (clipboard->length + length > clipboard->available) {
+
+        char* buffer;
+        int available = clipboard->available;
+
+        while (available < clipboard->length + length)
+            available = available > clipboard->max_length / 2
+                      ? clipboard->max_length : available * 2;
+
+        /* Truncate data to available length if unable to grow */
+        buffer = realloc(clipboard->buffer, available);
+        if (buffer == NULL)
+            length = clipboard->available - clipboard->length;
+        else {
+            clipboard->buffer = buffer;
+            clipboard->available = available;
+        }
+
+    }
+
     /* Append to buffer */
     memcpy(clipboard->buffer + clipboard->length, data, length);
 
     /* Update length */
     clipboard->length += length;
 
-}
+    pthread_mutex_unlock(&(clipboard->lock));
 
+}
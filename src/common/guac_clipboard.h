@@ -26,6 +26,9 @@
 #include "config.h"
 
 #include <guacamole/client.h>
+#include <guacamole/stream.h>
+#include <guacamole/timestamp.h>
+#include <pthread.h>
 
 /**
  * The maximum number of bytes to send in an individual blob when
@@ -33,6 +36,69 @@
  */
 #define GUAC_COMMON_CLIPBOARD_BLOCK_SIZE 4096
 
+/**
+ * The maximum number of blobs which may be sent when transmitting the
+ * clipboard contents before the connected client must acknowledge receipt.
+ */
+#define GUAC_COMMON_CLIPBOARD_WINDOW_SIZE 16
+
+/**
+ * The number of milliseconds to wait for the connected client to acknowledge
+ * the first blobs of clipboard contents before assuming the client does not
+ * acknowledge clipboard blobs at all, and sending the remaining contents
+ * without waiting.
+ */
+#define GUAC_COMMON_CLIPBOARD_ACK_TIMEOUT 500
+
+/**
+ * The number of bytes initially allocated for the clipboard buffer. The
+ * buffer grows as necessary, up to the maximum size of the clipboard.
+ */
+#define GUAC_COMMON_CLIPBOARD_INITIAL_SIZE 4096
+
+/**
+ * The state of clipboard contents being sent to a connected client.
+ */
+typedef struct guac_common_clipboard_transfer {
+
+    /**
+     * The client receiving the clipboard contents.
+     */
+    guac_client* client;
+
+    /**
+     * The stream along which the clipboard contents are being sent.
+     */
+    guac_stream* stream;
+
+    /**
+     * A copy of the clipboard contents being sent, such that the clipboard
+     * can change while the transfer is in progress.
+     */
+    char* data;
+
+    /**
+     * The number of bytes within data.
+     */
+    int length;
+
+    /**
+     * The number of bytes of data sent thus far.
+     */
+    int offset;
+
+    /**
+     * The number of blobs sent which have not yet been acknowledged.
+     */
+    int unacknowledged;
+
+    /**
+     * The time at which the most recent blob was sent.
+     */
+    guac_timestamp last_sent;
+
+} guac_common_clipboard_transfer;
+
 /**
  * Generic clipboard structure.
  */
@@ -58,10 +124,37 @@ typedef struct guac_common_clipboard {
      */
     int available;
 
+    /**
+     * The maximum number of bytes to allow within the clipboard. The
+     * clipboard buffer grows as data is appended, up to this size.
+     */
+    int max_length;
+
+    /**
+     * The clipboard contents currently being sent, or NULL if no contents
+     * are being sent.
+     */
+    guac_common_clipboard_transfer* transfer;
+
+    /**
+     * Whether the connected client has acknowledged any blob of clipboard
+     * contents. Once a client is known to acknowledge blobs, clipboard
+     * contents are sent only as quickly as the client acknowledges them.
+     */
+    int acknowledged;
+
+    /**
+     * Lock which is acquired whenever the clipboard contents or the current
+     * transfer are modified. As the buffer may be reallocated as data is
+     * appended, this lock must also be held while reading the buffer or
+     * length from outside the clipboard functions.
+     */
+    pthread_mutex_t lock;
+
 } guac_common_clipboard;
 
 /**
- * Creates a new clipboard having the given initial size.
+ * Creates a new clipboard having the given maximum size.
  *
  * @param size The maximum number of bytes to allow within the clipboard.
  * @return A newly-allocated clipboard.
@@ -77,13 +170,29 @@ void guac_common_clipboard_free(guac_common_clipboard* clipboard);
 
 /**
  * Sends the contents of the clipboard along the given client, splitting
- * the contents as necessary.
+ * the contents as necessary. Only the first GUAC_COMMON_CLIPBOARD_WINDOW_SIZE
+ * blobs are sent immediately. Further blobs are sent as the client
+ * acknowledges those already received, or by
+ * guac_common_clipboard_continue() if the client does not acknowledge
+ * clipboard blobs. Any contents still being sent from a previous call are
+ * abandoned.
  *
  * @param clipboard The clipboard whose contents should be sent.
  * @param client The client to send the clipboard contents on.
  */
 void guac_common_clipboard_send(guac_common_clipboard* clipboard, guac_client* client);
 
+/**
+ * Sends all remaining clipboard contents being sent by
+ * guac_common_clipboard_send() if the client has not acknowledged any
+ * clipboard blob within GUAC_COMMON_CLIPBOARD_ACK_TIMEOUT milliseconds of
+ * the most recent blob. This function should be invoked periodically, such
+ * as once per frame, by the thread handling server messages.
+ *
+ * @param clipboard The clipboard whose contents are being sent.
+ */
+void guac_common_clipboard_continue(guac_common_clipboard* clipboard);
+
 /**
  * Clears the clipboard contents and assigns a new mimetype for future data.
  *
@@ -95,7 +204,9 @@ void guac_common_clipboard_reset(guac_common_clipboard* clipboard, const char* m
 /**
  * Appends the given data to the current clipboard contents. The data must
  * match the mimetype chosen for the clipboard data by
- * guac_common_clipboard_reset().
+ * guac_common_clipboard_reset(). The clipboard buffer grows as necessary to
+ * contain the data. Any data beyond the maximum size of the clipboard is
+ * discarded.
  *
  * @param clipboard The clipboard to append data to.
  * @param data The data to append.
@@ -25,6 +25,7 @@
 
 #include <guacamole/unicode.h>
 #include <stdint.h>
+#include <string.h>
 
 /**
  * Lookup table for Unicode code points, indexed by CP-1252 codepoint.
@@ -64,15 +65,218 @@ const static int __GUAC_RDP_CP1252_CODEPOINT[32] = {
     0x0178, /* 0x9F */
 };
 
+/**
+ * Returns the number of bytes used by each ASCII character within the
+ * encoding read by the given reader, or 0 if the reader is not one whose
+ * encoding is known.
+ *
+ * @param reader The reader to inspect.
+ * @return The number of bytes per ASCII character, or 0 if unknown.
+ */
+static int __guac_iconv_read_unit(guac_iconv_read* reader) {
+
+    if (reader == GUAC_READ_UTF8
+            || reader == GUAC_READ_CP1252
+            || reader == GUAC_READ_ISO8859_1)
+        return 1;
+
+    if (reader == GUAC_READ_UTF16)
+        return 2;
+
+    return 0;
+
+}
+
+/**
+ * Returns the number of bytes used by each ASCII character within the
+ * encoding written by the given writer, or 0 if the writer is not one whose
+ * encoding is known.
+ *
+ * @param writer The writer to inspect.
+ * @return The number of bytes per ASCII character, or 0 if unknown.
+ */
+static int __guac_iconv_write_unit(guac_iconv_write* writer) {
+
+    if (writer == GUAC_WRITE_UTF8
+            || writer == GUAC_WRITE_CP1252
+            || writer == GUAC_WRITE_ISO8859_1)
+        return 1;
+
+    if (writer == GUAC_WRITE_UTF16)
+        return 2;
+
+    return 0;
+
+}
+
+/**
+ * Returns the number of leading bytes within the given buffer which are
+ * non-null ASCII characters, testing eight bytes at a time where possible.
+ *
+ * @param input The buffer to scan.
+ * @param length The maximum number of bytes to scan.
+ * @return The number of leading bytes within the range 0x01 through 0x7F.
+ */
+static int __guac_iconv_ascii_length_8(const char* input, int length) {
+
+    int count = 0;
+
+    /* Test whole words for high or null bytes */
+    while (length - count >= (int) sizeof(uint64_t)) {
+
+        uint64_t word;
+        memcpy(&word, input + count, sizeof(word));
+
+        if ((word & 0x8080808080808080ULL)
+                || ((word - 0x0101010101010101ULL) & ~word
+                    & 0x8080808080808080ULL))
+            break;
+
+        count += sizeof(word);
+
+    }
+
+    /* Test any remaining bytes individually */
+    while (count < length) {
+        unsigned char value = input[count];
+        if (value == 0 || value >= 0x80)
+            break;
+        count++;
+    }
+
+    return count;
+
+}
+
+/**
+ * Returns the number of leading 16-bit units within the given buffer which
+ * are non-null ASCII characters, testing four units at a time where possible.
+ *
+ * @param input The buffer to scan.
+ * @param length The maximum number of 16-bit units to scan.
+ * @return The number of leading units within the range 0x0001 through 0x007F.
+ */
+static int __guac_iconv_ascii_length_16(const char* input, int length) {
+
+    int count = 0;
+
+    /* Test whole words for non-ASCII or null units */
+    while (length - count >= (int) (sizeof(uint64_t) / 2)) {
+
+        uint64_t word;
+        memcpy(&word, input + count*2, sizeof(word));
+
+        if ((word & 0xFF80FF80FF80FF80ULL)
+                || ((word - 0x0001000100010001ULL) & ~word
+                    & 0x8000800080008000ULL))
+            break;
+
+        count += sizeof(word) / 2;
+
+    }
+
+    /* Test any remaining units individually */
+    while (count < length) {
+        uint16_t value;
+        memcpy(&value, input + count*2, sizeof(value));
+        if (value == 0 || value >= 0x80)
+            break;
+        count++;
+    }
+
+    return count;
+
+}
+
+/**
+ * Copies the run of non-null ASCII characters at the start of the input
+ * buffer to the output buffer, converting between the given character sizes.
+ * ASCII characters are represented identically within all encodings
+ * supported by guac_iconv(), aside from the size of each character, thus no
+ * per-character conversion is needed. The input and output pointers and
+ * remaining byte counts are advanced past the characters copied.
+ *
+ * @param input Pointer to the input buffer.
+ * @param in_remaining Pointer to the number of bytes remaining in the input
+ *                     buffer.
+ * @param in_size The number of bytes per ASCII character in the input.
+ * @param output Pointer to the output buffer.
+ * @param out_remaining Pointer to the number of bytes remaining in the output
+ *                      buffer.
+ * @param out_size The number of bytes per ASCII character in the output.
+ */
+static void __guac_iconv_copy_ascii(
+        const char** input, int* in_remaining, int in_size,
+        char** output, int* out_remaining, int out_size) {
+
+    int i;
+    int count;
+
+    /* Copy no more than both buffers can hold */
+    int max_count = *in_remaining / in_size;
+    if (max_count > *out_remaining / out_size)
+        max_count = *out_remaining / out_size;
+
+    /* Find run of ASCII */
+    if (in_size == 1)
+        count = __guac_iconv_ascii_length_8(*input, max_count);
+    else
+        count = __guac_iconv_ascii_length_16(*input, max_count);
+
+    /* Identical sizes require only a copy */
+    if (in_size == out_size)
+        memcpy(*output, *input, count * in_size);
+
+    /* Widen bytes to 16-bit units */
+    else if (in_size == 1) {
+        const unsigned char* in = (const unsigned char*) *input;
+        for (i = 0; i < count; i++) {
+            uint16_t value = in[i];
+            memcpy(*output + i*2, &value, sizeof(value));
+        }
+    }
+
+    /* Narrow 16-bit units to bytes */
+    else {
+        for (i = 0; i < count; i++) {
+            uint16_t value;
+            memcpy(&value, *input + i*2, sizeof(value));
+            (*output)[i] = (char) value;
+        }
+    }
+
+    *input += count * in_size;
+    *in_remaining -= count * in_size;
+
+    *output += count * out_size;
+    *out_remaining -= count * out_size;
+
+}
+
 int guac_iconv(guac_iconv_read* reader, const char** input, int in_remaining,
                guac_iconv_write* writer, char** output, int out_remaining) {
 
+    /* ASCII can be copied in bulk only if both encodings are known */
+    int in_size = __guac_iconv_read_unit(reader);
+    int out_size = __guac_iconv_write_unit(writer);
+
     while (in_remaining > 0 && out_remaining > 0) {
 
         int value;
         const char* read_start;
         char* write_start;
 
+        /* Copy any run of ASCII directly */
+        if (in_size && out_size) {
+
+            __guac_iconv_copy_ascii(input, &in_remaining, in_size,
+                    output, &out_remaining, out_size);
+
+            if (in_remaining <= 0 || out_remaining <= 0)
+                break;
+
+        }
+
         /* Read character */
         read_start = *input;
         value = reader(input, in_remaining);
@@ -43,7 +43,9 @@ typedef void guac_iconv_write(char** output, int remaining, int value);
  * Converts characters within a given string from one encoding to another,
  * as defined by the reader/writer functions specified. The input and output
  * string pointers will be updated based on the number of bytes read or
- * written.
+ * written. When both the reader and writer are among those defined here,
+ * runs of ASCII characters are copied in bulk rather than one character at a
+ * time.
  *
  * @param reader The reader function to use when reading the input string.
  * @param input Pointer to the beginning of the input string.
@@ -22,6 +22,12 @@
 
 #include "config.h"
 
+#include "guac_pointer_cursor.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include <cairo/cairo.h>
 #include <guacamole/client.h>
 #include <guacamole/protocol.h>
@@ -90,3 +96,164 @@ void guac_common_set_pointer_cursor(guac_client* client) {
 
 }
 
+guac_common_cursor_cache* guac_common_cursor_cache_alloc(guac_client* client) {
+
+    int i;
+    guac_common_cursor_cache* cache = malloc(sizeof(guac_common_cursor_cache));
+
+    cache->client = client;
+    cache->clock = 0;
+
+    /* All entries initially unused */
+    for (i=0; i<GUAC_COMMON_CURSOR_CACHE_SIZE; i++) {
+        cache->entries[i].buffer = NULL;
+        cache->entries[i].data = NULL;
+    }
+
+    return cache;
+
+}
+
+void guac_common_cursor_cache_free(guac_common_cursor_cache* cache) {
+
+    int i;
+
+    /* Free all buffers and image copies */
+    for (i=0; i<GUAC_COMMON_CURSOR_CACHE_SIZE; i++) {
+        guac_common_cursor_cache_entry* entry = &(cache->entries[i]);
+        if (entry->buffer != NULL)
+            guac_client_free_buffer(cache->client, entry->buffer);
+        free(entry->data);
+    }
+
+    free(cache);
+
+}
+
+/**
+ * Returns the 32-bit FNV-1a hash of the given cursor image and hotspot.
+ */
+static uint32_t __guac_common_cursor_hash(int hotspot_x, int hotspot_y,
+        const unsigned char* data, int width, int height, int stride) {
+
+    int x, y;
+    uint32_t hash = 2166136261u;
+
+    /* Include dimensions and hotspot */
+    hash = (hash ^ (uint32_t) width)     * 16777619u;
+    hash = (hash ^ (uint32_t) height)    * 16777619u;
+    hash = (hash ^ (uint32_t) hotspot_x) * 16777619u;
+    hash = (hash ^ (uint32_t) hotspot_y) * 16777619u;
+
+    /* Hash image row by row, ignoring any padding */
+    for (y=0; y<height; y++) {
+        for (x=0; x<width*4; x++)
+            hash = (hash ^ data[x]) * 16777619u;
+        data += stride;
+    }
+
+    return hash;
+
+}
+
+/**
+ * Returns whether the given cache entry contains exactly the given cursor
+ * image and hotspot.
+ */
+static int __guac_common_cursor_matches(guac_common_cursor_cache_entry* entry,
+        uint32_t hash, int hotspot_x, int hotspot_y,
+        const unsigned char* data, int width, int height, int stride) {
+
+    int y;
+
+    if (entry->buffer == NULL
+            || entry->hash != hash
+            || entry->width != width
+            || entry->height != height
+            || entry->hotspot_x != hotspot_x
+            || entry->hotspot_y != hotspot_y)
+        return 0;
+
+    /* Verify image contents, guarding against hash collisions */
+    for (y=0; y<height; y++) {
+        if (memcmp(entry->data + y*width*4, data, width*4) != 0)
+            return 0;
+        data += stride;
+    }
+
+    return 1;
+
+}
+
+const guac_layer* guac_common_cursor_cache_set(guac_common_cursor_cache* cache,
+        int hotspot_x, int hotspot_y, const unsigned char* data,
+        int width, int height, int stride) {
+
+    guac_socket* socket = cache->client->socket;
+    guac_common_cursor_cache_entry* entry = NULL;
+    cairo_surface_t* surface;
+    int i, y;
+
+    uint32_t hash = __guac_common_cursor_hash(hotspot_x, hotspot_y,
+            data, width, height, stride);
+
+    /* Find identical cursor, or least-recently-used entry */
+    for (i=0; i<GUAC_COMMON_CURSOR_CACHE_SIZE; i++) {
+
+        guac_common_cursor_cache_entry* current = &(cache->entries[i]);
+
+        /* If already sent, only the cursor instruction is needed */
+        if (__guac_common_cursor_matches(current, hash, hotspot_x, hotspot_y,
+                    data, width, height, stride)) {
+
+            current->last_used = ++cache->clock;
+            guac_protocol_send_cursor(socket, hotspot_x, hotspot_y,
+                    current->buffer, 0, 0, width, height);
+
+            return current->buffer;
+
+        }
+
+        /* Prefer unused entries, then the least-recently-used */
+        if (entry == NULL
+                || (entry->buffer != NULL
+                    && (current->buffer == NULL
+                        || current->last_used < entry->last_used)))
+            entry = current;
+
+    }
+
+    /* Reuse buffer of evicted entry, if any */
+    if (entry->buffer == NULL)
+        entry->buffer = guac_client_alloc_buffer(cache->client);
+
+    /* Store copy of image for later comparison */
+    free(entry->data);
+    entry->data = malloc(width * height * 4);
+    for (y=0; y<height; y++)
+        memcpy(entry->data + y*width*4, data + y*stride, width*4);
+
+    entry->hash = hash;
+    entry->hotspot_x = hotspot_x;
+    entry->hotspot_y = hotspot_y;
+    entry->width = width;
+    entry->height = height;
+    entry->last_used = ++cache->clock;
+
+    /* Send image to buffer */
+    surface = cairo_image_surface_create_for_data(entry->data,
+            CAIRO_FORMAT_ARGB32, width, height, width*4);
+
+    guac_protocol_send_png(socket, GUAC_COMP_SRC, entry->buffer, 0, 0,
+            surface);
+
+    cairo_surface_destroy(surface);
+
+    /* Set cursor */
+    guac_protocol_send_cursor(socket, hotspot_x, hotspot_y,
+            entry->buffer, 0, 0, width, height);
+
+    return entry->buffer;
+
+}
+
@@ -26,8 +26,91 @@
 
 #include "config.h"
 
+#include <stdint.h>
+
 #include <cairo/cairo.h>
 #include <guacamole/client.h>
+#include <guacamole/layer.h>
+
+/**
+ * The maximum number of distinct cursor images retained by a cursor cache.
+ */
+#define GUAC_COMMON_CURSOR_CACHE_SIZE 16
+
+/**
+ * A single cursor image previously sent to the client, stored within a
+ * buffer layer.
+ */
+typedef struct guac_common_cursor_cache_entry {
+
+    /**
+     * The buffer containing the cursor image, or NULL if this entry is
+     * unused.
+     */
+    guac_layer* buffer;
+
+    /**
+     * Hash of the image data, dimensions and hotspot of the cursor.
+     */
+    uint32_t hash;
+
+    /**
+     * The X coordinate of the cursor hotspot.
+     */
+    int hotspot_x;
+
+    /**
+     * The Y coordinate of the cursor hotspot.
+     */
+    int hotspot_y;
+
+    /**
+     * The width of the cursor image, in pixels.
+     */
+    int width;
+
+    /**
+     * The height of the cursor image, in pixels.
+     */
+    int height;
+
+    /**
+     * Copy of the ARGB32 cursor image, with rows packed at four bytes per
+     * pixel.
+     */
+    unsigned char* data;
+
+    /**
+     * The value of the cache clock when this entry was last used.
+     */
+    int last_used;
+
+} guac_common_cursor_cache_entry;
+
+/**
+ * Cache of cursor images which have already been sent to the client, keyed
+ * by content, such that switching back to a previously-used cursor requires
+ * only a "cursor" instruction rather than a new PNG.
+ */
+typedef struct guac_common_cursor_cache {
+
+    /**
+     * The client to which cursor images are sent.
+     */
+    guac_client* client;
+
+    /**
+     * All cached cursor images.
+     */
+    guac_common_cursor_cache_entry entries[GUAC_COMMON_CURSOR_CACHE_SIZE];
+
+    /**
+     * Clock incremented each time a cursor is set, for the sake of evicting
+     * the least-recently-used entry.
+     */
+    int clock;
+
+} guac_common_cursor_cache;
 
 /**
  * Width of the embedded mouse cursor graphic.
@@ -61,4 +144,38 @@ extern unsigned char guac_common_pointer_cursor[];
  */
 void guac_common_set_pointer_cursor(guac_client* client);
 
+/**
+ * Allocates a new, empty cursor cache for the given client.
+ *
+ * @param client The guac_client to send cursor images to.
+ * @return A newly-allocated cursor cache.
+ */
+guac_common_cursor_cache* guac_common_cursor_cache_alloc(guac_client* client);
+
+/**
+ * Frees the given cursor cache, returning all of its buffers to the client.
+ *
+ * @param cache The cursor cache to free.
+ */
+void guac_common_cursor_cache_free(guac_common_cursor_cache* cache);
+
+/**
+ * Sets the cursor of the remote display to the given ARGB32 image. The image
+ * is sent only if an identical image with the same hotspot is not already
+ * cached; otherwise, the cached buffer is reused and only a "cursor"
+ * instruction is sent.
+ *
+ * @param cache The cursor cache to use.
+ * @param hotspot_x The X coordinate of the cursor hotspot.
+ * @param hotspot_y The Y coordinate of the cursor hotspot.
+ * @param data The ARGB32 image data of the cursor.
+ * @param width The width of the cursor image, in pixels.
+ * @param height The height of the cursor image, in pixels.
+ * @param stride The number of bytes in each row of the image data.
+ * @return The buffer layer containing the cursor image.
+ */
+const guac_layer* guac_common_cursor_cache_set(guac_common_cursor_cache* cache,
+        int hotspot_x, int hotspot_y, const unsigned char* data,
+        int width, int height, int stride);
+
 #endif
@@ -25,6 +25,7 @@
 #include "wav_encoder.h"
 
 #include <pthread.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -32,11 +33,16 @@
 #include <guacamole/client.h>
 #include <guacamole/protocol.h>
 #include <guacamole/stream.h>
+#include <guacamole/timestamp.h>
 
 #ifdef ENABLE_OGG
 #include "ogg_encoder.h"
 #endif
 
+#ifdef ENABLE_OPUS
+#include "opus_encoder.h"
+#endif
+
 guac_audio_stream* guac_audio_stream_alloc(guac_client* client, guac_audio_encoder* encoder) {
 
     guac_audio_stream* audio;
@@ -51,6 +57,14 @@ guac_audio_stream* guac_audio_stream_alloc(guac_client* client, guac_audio_encod
 
             const char* mimetype = client->info.audio_mimetypes[i];
 
+#ifdef ENABLE_OPUS
+            /* If Opus is supported, done. */
+            if (strcmp(mimetype, opus_encoder->mimetype) == 0) {
+                encoder = opus_encoder;
+                break;
+            }
+#endif
+
 #ifdef ENABLE_OGG
             /* If Ogg is supported, done. */
             if (strcmp(mimetype, ogg_encoder->mimetype) == 0) {
@@ -92,42 +106,537 @@ guac_audio_stream* guac_audio_stream_alloc(guac_client* client, guac_audio_encod
     audio->encoder = encoder;
     audio->stream = guac_client_alloc_stream(client);
 
+    /* No format until first packet */
+    audio->rate = 0;
+    audio->channels = 0;
+    audio->bps = 0;
+    audio->pcm_rate = 0;
+    audio->pcm_channels = 0;
+    audio->pcm_bps = 0;
+
+    /* Do not resample or downmix by default */
+    audio->target_rate = 0;
+    audio->target_channels = 0;
+    audio->convert = 0;
+
+    /* Init sample clock */
+    audio->clock_start = guac_timestamp_current();
+    audio->clock_samples = 0;
+    audio->jitter_target = GUAC_AUDIO_DEFAULT_JITTER_TARGET;
+    audio->lag = 0;
+
     return audio;
 }
 
+/**
+ * Returns the time at which the client will finish playing all PCM data
+ * accepted by the given audio stream thus far, according to its sample clock.
+ *
+ * @param audio The audio stream whose sample clock should be read.
+ * @return The time at which all accepted PCM data will have been played.
+ */
+static guac_timestamp __guac_audio_stream_clock(guac_audio_stream* audio) {
+
+    /* No samples can have been accepted without a rate */
+    if (audio->pcm_rate == 0)
+        return audio->clock_start;
+
+    return audio->clock_start + audio->clock_samples * 1000 / audio->pcm_rate;
+
+}
+
+/**
+ * Updates the estimated lag of the given audio stream, based on the amount of
+ * audio queued for playback according to the sample clock, and on the amount
+ * of time the client is behind in acknowledging frames.
+ *
+ * @param audio The audio stream whose lag should be updated.
+ */
+static void __guac_audio_stream_update_lag(guac_audio_stream* audio) {
+
+    guac_client* client = audio->client;
+
+    /* Audio already queued for playback */
+    int lag = __guac_audio_stream_clock(audio) - guac_timestamp_current();
+    if (lag < 0)
+        lag = 0;
+
+    /* Frames not yet acknowledged by the client */
+    if (client->last_sent_timestamp > client->last_received_timestamp)
+        lag += client->last_sent_timestamp - client->last_received_timestamp;
+
+    audio->lag = lag;
+
+}
+
+/**
+ * Returns whether the given PCM data, in the PCM format of the given audio
+ * stream, consists entirely of silence. Samples are tested in blocks, with
+ * each block reduced without branching such that the compiler may vectorize
+ * the inner loops.
+ *
+ * @param audio The audio stream whose PCM format should be used.
+ * @param data The PCM data to test.
+ * @param length The number of bytes of PCM data provided.
+ * @return Non-zero if the PCM data is silent, zero otherwise.
+ */
+static int __guac_audio_is_silent(guac_audio_stream* audio,
+        const unsigned char* data, int length) {
+
+    int offset;
+
+    /* 16-bit signed little-endian samples */
+    if (audio->pcm_bps == 16) {
+
+        length &= ~1;
+
+        for (offset = 0; offset < length;
+                offset += GUAC_AUDIO_SILENCE_BLOCK_SIZE) {
+
+            int i;
+            int loud = 0;
+
+            int block_length = length - offset;
+            if (block_length > GUAC_AUDIO_SILENCE_BLOCK_SIZE)
+                block_length = GUAC_AUDIO_SILENCE_BLOCK_SIZE;
+
+            /* Flag any sample outside the threshold */
+            for (i = offset; i < offset + block_length; i += 2) {
+                int sample = (int16_t) (data[i] | (data[i+1] << 8));
+                loud |= (unsigned int) (sample + GUAC_AUDIO_SILENCE_THRESHOLD)
+                            > 2 * GUAC_AUDIO_SILENCE_THRESHOLD;
+            }
+
+            if (loud)
+                return 0;
+
+        }
+
+    }
+
+    /* 8-bit unsigned samples */
+    else {
+
+        for (offset = 0; offset < length;
+                offset += GUAC_AUDIO_SILENCE_BLOCK_SIZE) {
+
+            int i;
+            int loud = 0;
+
+            int block_length = length - offset;
+            if (block_length > GUAC_AUDIO_SILENCE_BLOCK_SIZE)
+                block_length = GUAC_AUDIO_SILENCE_BLOCK_SIZE;
+
+            /* Flag any sample outside the threshold */
+            for (i = offset; i < offset + block_length; i++) {
+                int sample = (data[i] - 128) * 256;
+                loud |= (unsigned int) (sample + GUAC_AUDIO_SILENCE_THRESHOLD)
+                            > 2 * GUAC_AUDIO_SILENCE_THRESHOLD;
+            }
+
+            if (loud)
+                return 0;
+
+        }
+
+    }
+
+    return 1;
+
+}
+
+/**
+ * Appends the given PCM data, in the format in which it is to be encoded, to
+ * the PCM buffer of the given audio stream, flushing the buffer to the
+ * encoder as necessary.
+ *
+ * @param audio The audio stream whose PCM buffer should be appended to.
+ * @param data The PCM data to append.
+ * @param length The number of bytes of PCM data provided.
+ */
+static void __guac_audio_stream_buffer(guac_audio_stream* audio,
+        const unsigned char* data, int length) {
+
+    /* Resize audio buffer if necessary */
+    if (length > audio->length) {
+
+        /* Resize to double provided length */
+        audio->length = length*2;
+        audio->pcm_data = realloc(audio->pcm_data, audio->length);
+
+    }
+
+    /* Flush if necessary */
+    if (audio->used + length > audio->length)
+        guac_audio_stream_flush(audio);
+
+    /* Append to buffer */
+    memcpy(&(audio->pcm_data[audio->used]), data, length);
+    audio->used += length;
+
+}
+
+/**
+ * The left and right stereo coefficients of each channel of PCM data having
+ * the given number of channels, using the default WAVE speaker positions for
+ * that number of channels. Front channels map directly to their side, center
+ * channels are split equally at -3 dB, surround channels are attenuated by
+ * 3 dB and LFE is dropped.
+ */
+static const double __guac_audio_stereo_downmix[GUAC_AUDIO_MAX_PCM_CHANNELS]
+        [GUAC_AUDIO_MAX_PCM_CHANNELS][2] = {
+
+    /* Mono: C */
+    { { 0.707, 0.707 } },
+
+    /* Stereo: L, R */
+    { { 1.0, 0.0 }, { 0.0, 1.0 } },
+
+    /* 3.0: L, R, C */
+    { { 1.0, 0.0 }, { 0.0, 1.0 }, { 0.707, 0.707 } },
+
+    /* Quad: L, R, Ls, Rs */
+    { { 1.0, 0.0 }, { 0.0, 1.0 }, { 0.707, 0.0 }, { 0.0, 0.707 } },
+
+    /* 5.0: L, R, C, Ls, Rs */
+    { { 1.0, 0.0 }, { 0.0, 1.0 }, { 0.707, 0.707 },
+      { 0.707, 0.0 }, { 0.0, 0.707 } },
+
+    /* 5.1: L, R, C, LFE, Ls, Rs */
+    { { 1.0, 0.0 }, { 0.0, 1.0 }, { 0.707, 0.707 }, { 0.0, 0.0 },
+      { 0.707, 0.0 }, { 0.0, 0.707 } },
+
+    /* 6.1: L, R, C, LFE, Cs, Ls, Rs */
+    { { 1.0, 0.0 }, { 0.0, 1.0 }, { 0.707, 0.707 }, { 0.0, 0.0 },
+      { 0.5, 0.5 }, { 0.707, 0.0 }, { 0.0, 0.707 } },
+
+    /* 7.1: L, R, C, LFE, Lb, Rb, Ls, Rs */
+    { { 1.0, 0.0 }, { 0.0, 1.0 }, { 0.707, 0.707 }, { 0.0, 0.0 },
+      { 0.707, 0.0 }, { 0.0, 0.707 }, { 0.707, 0.0 }, { 0.0, 0.707 } }
+
+};
+
+/**
+ * Calculates the downmix coefficients of the given audio stream from its
+ * PCM and encoded channel counts. Channels are passed through unchanged if
+ * no downmixing is needed. Otherwise, each encoded channel is a weighted sum
+ * of the PCM channels, normalized such that the result cannot clip.
+ *
+ * @param audio The audio stream whose downmix coefficients should be
+ *              calculated.
+ * @param encoded_channels The number of channels which will be encoded.
+ */
+static void __guac_audio_stream_init_downmix(guac_audio_stream* audio,
+        int encoded_channels) {
+
+    int pcm_channels = audio->pcm_channels;
+    int output;
+    int channel;
+
+    memset(audio->downmix, 0, sizeof(audio->downmix));
+
+    /* Ignore any channels beyond those with known positions */
+    if (pcm_channels > GUAC_AUDIO_MAX_PCM_CHANNELS)
+        pcm_channels = GUAC_AUDIO_MAX_PCM_CHANNELS;
+
+    /* Pass channels through if not downmixing */
+    if (pcm_channels <= encoded_channels) {
+        for (channel = 0; channel < pcm_channels; channel++)
+            audio->downmix[channel][channel] = 1 << GUAC_AUDIO_DOWNMIX_BITS;
+        return;
+    }
+
+    for (output = 0; output < encoded_channels; output++) {
+
+        double weights[GUAC_AUDIO_MAX_PCM_CHANNELS];
+        double total = 0.0;
+
+        /* Mono is the average of the stereo downmix */
+        for (channel = 0; channel < pcm_channels; channel++) {
+
+            const double* stereo =
+                __guac_audio_stereo_downmix[pcm_channels - 1][channel];
+
+            if (encoded_channels == 1)
+                weights[channel] = (stereo[0] + stereo[1]) / 2;
+            else
+                weights[channel] = stereo[output];
+
+            total += weights[channel];
+
+        }
+
+        /* Normalize such that coefficients sum to one */
+        for (channel = 0; channel < pcm_channels; channel++)
+            audio->downmix[output][channel] = weights[channel] / total
+                * (1 << GUAC_AUDIO_DOWNMIX_BITS) + 0.5;
+
+    }
+
+}
+
+/**
+ * Converts the given PCM data from the PCM format of the given audio stream
+ * to the format expected by its encoder, downmixing and resampling as
+ * required, and appends the result to the PCM buffer of the stream. The
+ * sample clock of the stream is advanced accordingly.
+ *
+ * @param audio The audio stream to append PCM data to.
+ * @param data The PCM data to append.
+ * @param length The number of bytes of PCM data provided.
+ */
+static void __guac_audio_stream_append(guac_audio_stream* audio,
+        const unsigned char* data, int length) {
+
+    int bytes_per_sample = audio->pcm_bps / 8;
+    int frame_size = bytes_per_sample * audio->pcm_channels;
+
+    if (frame_size == 0)
+        return;
+
+    /* Advance sample clock */
+    audio->clock_samples += length / frame_size;
+
+    /* Buffer as-is if no conversion is needed */
+    if (!audio->convert) {
+        __guac_audio_stream_buffer(audio, data, length);
+        return;
+    }
+
+    /* For each sample frame */
+    for (; length >= frame_size; data += frame_size, length -= frame_size) {
+
+        int samples[GUAC_AUDIO_MAX_PCM_CHANNELS];
+        int mixed[GUAC_AUDIO_MAX_CHANNELS];
+        int pcm_channels = audio->pcm_channels;
+        int channel;
+        int source;
+
+        if (pcm_channels > GUAC_AUDIO_MAX_PCM_CHANNELS)
+            pcm_channels = GUAC_AUDIO_MAX_PCM_CHANNELS;
+
+        /* Read 16-bit signed or 8-bit unsigned samples */
+        for (source = 0; source < pcm_channels; source++) {
+
+            const unsigned char* sample = &(data[source * bytes_per_sample]);
+
+            if (bytes_per_sample == 2)
+                samples[source] = (int16_t) (sample[0] | (sample[1] << 8));
+            else
+                samples[source] = (sample[0] - 128) * 256;
+
+        }
+
+        /* Downmix as a weighted sum of all source channels */
+        for (channel = 0; channel < audio->channels; channel++) {
+
+            int sum = 0;
+            for (source = 0; source < pcm_channels; source++)
+                sum += samples[source] * audio->downmix[channel][source];
+
+            sum >>= GUAC_AUDIO_DOWNMIX_BITS;
+
+            /* Clamp rounding error to 16-bit range */
+            if (sum > INT16_MAX) sum = INT16_MAX;
+            else if (sum < INT16_MIN) sum = INT16_MIN;
+
+            mixed[channel] = sum;
+
+        }
+
+        /* Interpolate between previous and current samples */
+        while (audio->resample_phase < 1.0) {
+
+            unsigned char output[GUAC_AUDIO_MAX_CHANNELS * 2];
+
+            for (channel = 0; channel < audio->channels; channel++) {
+
+                int previous = audio->resample_previous[channel];
+                int sample = previous + (mixed[channel] - previous)
+                                      * audio->resample_phase;
+
+                /* Store as 16-bit signed little-endian */
+                output[channel*2]     = sample & 0xFF;
+                output[channel*2 + 1] = (sample >> 8) & 0xFF;
+
+            }
+
+            __guac_audio_stream_buffer(audio, output, audio->channels * 2);
+            audio->resample_phase += audio->resample_step;
+
+        }
+
+        audio->resample_phase -= 1.0;
+        memcpy(audio->resample_previous, mixed,
+                sizeof(int) * audio->channels);
+
+    }
+
+}
+
+/**
+ * Writes any silence which was held back from the current packet of the
+ * given audio stream as digital silence, such that the timing of audible
+ * data within the packet is preserved.
+ *
+ * @param audio The audio stream whose held silence should be written.
+ */
+static void __guac_audio_stream_write_held_silence(guac_audio_stream* audio) {
+
+    unsigned char silence[GUAC_AUDIO_SILENCE_BLOCK_SIZE];
+
+    /* Silence for 8-bit unsigned samples is centered at 128 */
+    memset(silence, audio->pcm_bps == 8 ? 0x80 : 0x00, sizeof(silence));
+
+    /* Write silence in blocks */
+    while (audio->silence_held > 0) {
+
+        int length = audio->silence_held;
+        if (length > GUAC_AUDIO_SILENCE_BLOCK_SIZE)
+            length = sizeof(silence);
+
+        __guac_audio_stream_append(audio, silence, length);
+        audio->silence_held -= length;
+
+    }
+
+}
+
 void guac_audio_stream_begin(guac_audio_stream* audio, int rate, int channels, int bps) {
 
-    /* Load PCM properties */
-    audio->rate = rate;
-    audio->channels = channels;
-    audio->bps = bps;
+    guac_timestamp now = guac_timestamp_current();
+    guac_timestamp timestamp = __guac_audio_stream_clock(audio);
 
-    /* Reset write counter */
+    int encoded_rate = rate;
+    int encoded_channels = channels;
+    int encoded_bps = bps;
+
+    /* Reset write counter and silence detection */
     audio->pcm_bytes_written = 0;
+    audio->silent = 1;
+    audio->silence_held = 0;
+
+    /* Restart sample clock if format changes */
+    if (audio->pcm_rate != rate) {
+        audio->clock_start = timestamp;
+        audio->clock_samples = 0;
+    }
+
+    /* Resynchronize sample clock if the client has run out of audio */
+    if (timestamp < now) {
+        audio->clock_start = timestamp = now;
+        audio->clock_samples = 0;
+    }
+
+    /* Resample if a different rate is requested */
+    if (audio->target_rate != 0)
+        encoded_rate = audio->target_rate;
+
+    /* Resample if the encoder does not accept the rate */
+    if (audio->encoder->rates != NULL) {
+
+        const int* supported = audio->encoder->rates;
+        while (*supported != 0 && *supported != encoded_rate)
+            supported++;
+
+        if (*supported == 0)
+            encoded_rate = audio->encoder->rates[0];
+
+    }
+
+    /* Downmix if fewer channels are requested, or too many are provided */
+    if (audio->target_channels != 0 && audio->target_channels < channels)
+        encoded_channels = audio->target_channels;
+    if (encoded_channels > GUAC_AUDIO_MAX_CHANNELS)
+        encoded_channels = GUAC_AUDIO_MAX_CHANNELS;
+
+    /* Converted data is always 16-bit */
+    audio->convert = (encoded_rate != rate || encoded_channels != channels);
+    if (audio->convert)
+        encoded_bps = 16;
+
+    /* Restart resampling if format changes */
+    if (audio->pcm_rate != rate || audio->pcm_channels != channels
+            || audio->pcm_bps != bps) {
+        audio->resample_phase = 0.0;
+        memset(audio->resample_previous, 0, sizeof(audio->resample_previous));
+    }
+
+    /* Load PCM properties */
+    audio->pcm_rate = rate;
+    audio->pcm_channels = channels;
+    audio->pcm_bps = bps;
+    audio->resample_step = (double) rate / encoded_rate;
+
+    /* Coefficients depend only on channel counts */
+    if (audio->convert)
+        __guac_audio_stream_init_downmix(audio, encoded_channels);
+
+    /* Load encoded properties */
+    audio->rate = encoded_rate;
+    audio->channels = encoded_channels;
+    audio->bps = encoded_bps;
 
     /* Call handler */
     audio->encoder->begin_handler(audio);
 
 }
 
+guac_timestamp guac_audio_stream_set_timestamp(guac_audio_stream* audio,
+        guac_timestamp timestamp) {
+
+    /* Play immediately if requested time has passed */
+    guac_timestamp now = guac_timestamp_current();
+    if (timestamp < now)
+        timestamp = now;
+
+    /* Resynchronize sample clock */
+    audio->clock_start = timestamp;
+    audio->clock_samples = 0;
+
+    return timestamp;
+
+}
+
 void guac_audio_stream_end(guac_audio_stream* audio) {
 
     double duration;
+    int offset;
+
+    /* Include trailing silence within audible packets */
+    if (!audio->silent)
+        __guac_audio_stream_write_held_silence(audio);
 
     /* Flush stream and finish encoding */
     guac_audio_stream_flush(audio);
     audio->encoder->end_handler(audio);
 
+    /* Send nothing if packet is silent or all PCM data was dropped */
+    if (audio->silent) {
+        audio->encoded_data_used = 0;
+        return;
+    }
+
     /* Calculate duration of PCM data */
     duration = ((double) (audio->pcm_bytes_written * 1000 * 8))
-                / audio->rate / audio->channels / audio->bps;
+                / audio->pcm_rate / audio->pcm_channels / audio->pcm_bps;
 
     /* Send audio */
     guac_protocol_send_audio(audio->client->socket, audio->stream,
             audio->stream->index, audio->encoder->mimetype, duration);
 
-    guac_protocol_send_blob(audio->client->socket, audio->stream,
-            audio->encoded_data, audio->encoded_data_used);
+    /* Send encoded data in blobs of bounded size */
+    for (offset = 0; offset < audio->encoded_data_used;
+            offset += GUAC_AUDIO_BLOB_SIZE) {
+
+        int length = audio->encoded_data_used - offset;
+        if (length > GUAC_AUDIO_BLOB_SIZE)
+            length = GUAC_AUDIO_BLOB_SIZE;
+
+        guac_protocol_send_blob(audio->client->socket, audio->stream,
+                &(audio->encoded_data[offset]), length);
+
+    }
 
     guac_protocol_send_end(audio->client->socket, audio->stream);
 
@@ -137,32 +646,41 @@ void guac_audio_stream_end(guac_audio_stream* audio) {
 }
 
 void guac_audio_stream_free(guac_audio_stream* audio) {
+
+    free(audio->encoded_data);
     free(audio->pcm_data);
     free(audio);
+
 }
 
 void guac_audio_stream_write_pcm(guac_audio_stream* audio, 
         const unsigned char* data, int length) {
 
-    /* Update counter */
-    audio->pcm_bytes_written += length;
+    int silent;
 
-    /* Resize audio buffer if necessary */
-    if (length > audio->length) {
+    /* Drop all audio if client is far behind */
+    __guac_audio_stream_update_lag(audio);
+    if (audio->lag > audio->jitter_target * GUAC_AUDIO_MAX_LAG_FACTOR)
+        return;
 
-        /* Resize to double provided length */
-        audio->length = length*2;
-        audio->pcm_data = realloc(audio->pcm_data, audio->length);
+    /* Drop silence if client is behind */
+    silent = __guac_audio_is_silent(audio, data, length);
+    if (silent && audio->lag > audio->jitter_target)
+        return;
 
-    }
+    /* Update counter */
+    audio->pcm_bytes_written += length;
 
-    /* Flush if necessary */
-    if (audio->used + length > audio->length)
-        guac_audio_stream_flush(audio);
+    /* Hold silence until it is known whether the packet is audible */
+    if (silent) {
+        audio->silence_held += length;
+        return;
+    }
 
-    /* Append to buffer */
-    memcpy(&(audio->pcm_data[audio->used]), data, length);
-    audio->used += length;
+    /* Write any preceding silence before audible data */
+    audio->silent = 0;
+    __guac_audio_stream_write_held_silence(audio);
+    __guac_audio_stream_append(audio, data, length);
 
 }
 
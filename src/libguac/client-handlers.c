@@ -24,6 +24,7 @@
 
 #include "client.h"
 #include "client-handlers.h"
+#include "instruction.h"
 #include "protocol.h"
 #include "stream.h"
 
@@ -79,14 +80,44 @@ int __guac_handle_sync(guac_client* client, guac_instruction* instruction) {
 }
 
 int __guac_handle_mouse(guac_client* client, guac_instruction* instruction) {
+
+    int x    = atoi(instruction->argv[0]);
+    int y    = atoi(instruction->argv[1]);
+    int mask = atoi(instruction->argv[2]);
+
+    if (client->mouse_handler == NULL)
+        return 0;
+
+    /* Defer pure motion if later input would supersede it anyway */
+    if (mask == client->__mouse_mask
+            && guac_instruction_waiting(client->socket, 0) > 0) {
+        client->__mouse_pending = 1;
+        client->__mouse_x = x;
+        client->__mouse_y = y;
+        return 0;
+    }
+
+    /* Button changes are always handled, replacing any deferred motion */
+    client->__mouse_pending = 0;
+    client->__mouse_mask = mask;
+
+    return client->mouse_handler(client, x, y, mask);
+
+}
+
+int __guac_client_flush_mouse(guac_client* client) {
+
+    if (!client->__mouse_pending)
+        return 0;
+
+    client->__mouse_pending = 0;
+
     if (client->mouse_handler)
-        return client->mouse_handler(
-            client,
-            atoi(instruction->argv[0]), /* x */
-            atoi(instruction->argv[1]), /* y */
-            atoi(instruction->argv[2])  /* mask */
-        );
+        return client->mouse_handler(client,
+                client->__mouse_x, client->__mouse_y, client->__mouse_mask);
+
     return 0;
+
 }
 
 int __guac_handle_key(guac_client* client, guac_instruction* instruction) {
@@ -69,10 +69,23 @@ int __guac_handle_sync(guac_client* client, guac_instruction* instruction);
 /**
  * Internal initial handler for the mouse instruction. When a mouse instruction
  * is received, this handler will be called. The client's mouse handler will
- * be invoked if defined.
+ * be invoked if defined. Mouse motion which does not change the button state
+ * is deferred while further input is already waiting, such that a burst of
+ * motion reaches the mouse handler only as its final position.
  */
 int __guac_handle_mouse(guac_client* client, guac_instruction* instruction);
 
+/**
+ * Passes any deferred mouse motion to the client's mouse handler. This is
+ * called before handling any instruction other than mouse, such that the
+ * order of mouse motion relative to other input is preserved.
+ *
+ * @param client The client whose deferred mouse motion should be handled.
+ * @return Zero if no motion was deferred or the mouse handler succeeded,
+ *         the return value of the mouse handler otherwise.
+ */
+int __guac_client_flush_mouse(guac_client* client);
+
 /**
  * Internal initial handler for the key instruction. When a key instruction
  * is received, this handler will be called. The client's key handler will
@@ -33,6 +33,7 @@
 #include "stream.h"
 #include "timestamp.h"
 
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -88,9 +89,13 @@ guac_stream* guac_client_alloc_stream(guac_client* client) {
     guac_stream* allocd_stream;
     int stream_index;
 
+    pthread_mutex_lock(&(client->__stream_lock));
+
     /* Refuse to allocate beyond maximum */
-    if (client->__stream_pool->active == GUAC_CLIENT_MAX_STREAMS)
+    if (client->__stream_pool->active == GUAC_CLIENT_MAX_STREAMS) {
+        pthread_mutex_unlock(&(client->__stream_lock));
         return NULL;
+    }
 
     /* Allocate stream */
     stream_index = guac_pool_next_int(client->__stream_pool);
@@ -100,18 +105,24 @@ guac_stream* guac_client_alloc_stream(guac_client* client) {
     allocd_stream->index = stream_index;
     allocd_stream->data = NULL;
 
+    pthread_mutex_unlock(&(client->__stream_lock));
+
     return allocd_stream;
 
 }
 
 void guac_client_free_stream(guac_client* client, guac_stream* stream) {
 
+    pthread_mutex_lock(&(client->__stream_lock));
+
     /* Release index to pool */
     guac_pool_free_int(client->__stream_pool, stream->index);
 
     /* Mark stream as closed */
     stream->index = GUAC_CLIENT_CLOSED_STREAM_INDEX;
 
+    pthread_mutex_unlock(&(client->__stream_lock));
+
 }
 
 guac_client* guac_client_alloc() {
@@ -140,6 +151,7 @@ guac_client* guac_client_alloc() {
 
     /* Allocate stream pool */
     client->__stream_pool = guac_pool_alloc(0);
+    pthread_mutex_init(&(client->__stream_lock), NULL);
 
     /* Initialze streams */
     client->__input_streams = malloc(sizeof(guac_stream) * GUAC_CLIENT_MAX_STREAMS);
@@ -173,6 +185,7 @@ void guac_client_free(guac_client* client) {
 
     /* Free stream pool */
     guac_pool_free(client->__stream_pool);
+    pthread_mutex_destroy(&(client->__stream_lock));
 
     free(client);
 }
@@ -181,6 +194,14 @@ int guac_client_handle_instruction(guac_client* client, guac_instruction* instru
 
     /* For each defined instruction */
     __guac_instruction_handler_mapping* current = __guac_instruction_handler_map;
+
+    /* Handle deferred mouse motion before any other instruction */
+    if (strcmp(instruction->opcode, "mouse") != 0) {
+        int result = __guac_client_flush_mouse(client);
+        if (result < 0)
+            return result;
+    }
+
     while (current->opcode != NULL) {
 
         /* If recognized, call handler */
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2014 Glyptodon LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __GUAC_AUDIO_CONSTANTS_H
+#define __GUAC_AUDIO_CONSTANTS_H
+
+/**
+ * Constants related to simple streaming audio.
+ *
+ * @file audio-constants.h
+ */
+
+/**
+ * The maximum number of bytes of encoded audio data sent within any single
+ * blob instruction.
+ */
+#define GUAC_AUDIO_BLOB_SIZE 4096
+
+/**
+ * The default amount of audio, in milliseconds, which may be queued for
+ * playback by the client before silence is dropped from the stream.
+ */
+#define GUAC_AUDIO_DEFAULT_JITTER_TARGET 250
+
+/**
+ * The multiple of the jitter target beyond which all audio, not only
+ * silence, is dropped from the stream until the client catches up.
+ */
+#define GUAC_AUDIO_MAX_LAG_FACTOR 4
+
+/**
+ * The largest absolute value of a 16-bit PCM sample which is still
+ * considered silence.
+ */
+#define GUAC_AUDIO_SILENCE_THRESHOLD 16
+
+/**
+ * The number of bytes of PCM data tested for silence at a time, and the size
+ * of the blocks in which held silence is written.
+ */
+#define GUAC_AUDIO_SILENCE_BLOCK_SIZE 1024
+
+/**
+ * The maximum number of channels passed to an audio encoder. PCM data with
+ * more channels is downmixed.
+ */
+#define GUAC_AUDIO_MAX_CHANNELS 2
+
+/**
+ * The maximum number of channels of PCM data which are downmixed. Any
+ * additional channels are ignored.
+ */
+#define GUAC_AUDIO_MAX_PCM_CHANNELS 8
+
+/**
+ * The number of fractional bits within each downmix coefficient.
+ */
+#define GUAC_AUDIO_DOWNMIX_BITS 12
+
+#endif
+
@@ -30,10 +30,12 @@
  * @file audio.h
  */
 
+#include "audio-constants.h"
 #include "audio-fntypes.h"
 #include "audio-types.h"
 #include "client-types.h"
 #include "stream-types.h"
+#include "timestamp-types.h"
 
 struct guac_audio_encoder {
 
@@ -58,6 +60,13 @@ struct guac_audio_encoder {
      */
     guac_audio_encoder_end_handler* end_handler;
 
+    /**
+     * Zero-terminated list of the sample rates accepted by this encoder, in
+     * Hz, or NULL if any rate is accepted. PCM data of any other rate is
+     * resampled to the first rate listed.
+     */
+    const int* rates;
+
 };
 
 struct guac_audio_stream {
@@ -109,27 +118,131 @@ struct guac_audio_stream {
     guac_stream* stream;
 
     /**
-     * The number of samples per second of PCM data sent to this stream.
+     * The number of samples per second of PCM data sent to the encoder.
      */
     int rate;
 
     /**
-     * The number of audio channels per sample of PCM data. Legal values are
-     * 1 or 2.
+     * The number of audio channels per sample of PCM data sent to the
+     * encoder. Legal values are 1 or 2.
      */
     int channels;
 
     /**
-     * The number of bits per sample per channel for PCM data. Legal values are
-     * 8 or 16.
+     * The number of bits per sample per channel for PCM data sent to the
+     * encoder. Legal values are 8 or 16.
      */
     int bps;
 
+    /**
+     * The number of samples per second of PCM data written to this stream.
+     */
+    int pcm_rate;
+
+    /**
+     * The number of audio channels per sample of PCM data written to this
+     * stream.
+     */
+    int pcm_channels;
+
+    /**
+     * The number of bits per sample per channel of PCM data written to this
+     * stream. Legal values are 8 or 16.
+     */
+    int pcm_bps;
+
+    /**
+     * The rate to which PCM data should be resampled before being encoded,
+     * or zero to encode PCM data at its original rate. Changes take effect
+     * when the next audio packet begins.
+     */
+    int target_rate;
+
+    /**
+     * The number of channels to which PCM data should be downmixed before
+     * being encoded, or zero to downmix only if more than
+     * GUAC_AUDIO_MAX_CHANNELS channels are provided. Changes take effect when
+     * the next audio packet begins.
+     */
+    int target_channels;
+
+    /**
+     * Non-zero if PCM data written to this stream must be resampled or
+     * downmixed before being encoded, zero otherwise.
+     */
+    int convert;
+
+    /**
+     * The contribution of each channel of PCM data to each encoded channel,
+     * as fixed-point coefficients having GUAC_AUDIO_DOWNMIX_BITS fractional
+     * bits. The coefficients of each encoded channel sum to one.
+     */
+    int downmix[GUAC_AUDIO_MAX_CHANNELS][GUAC_AUDIO_MAX_PCM_CHANNELS];
+
+    /**
+     * The ratio of the PCM rate to the encoded rate.
+     */
+    double resample_step;
+
+    /**
+     * The position of the next resampled sample relative to the previous
+     * input sample, as a fraction of the distance to the next input sample.
+     */
+    double resample_phase;
+
+    /**
+     * The previous downmixed input sample of each channel, used for
+     * interpolation while resampling.
+     */
+    int resample_previous[GUAC_AUDIO_MAX_CHANNELS];
+
+    /**
+     * Non-zero if all PCM data written within the current audio packet thus
+     * far is silent, zero otherwise. Silent packets are not sent.
+     */
+    int silent;
+
+    /**
+     * The number of bytes of silent PCM data which have been written but not
+     * yet passed to the encoder, as it is not yet known whether the current
+     * audio packet is silent.
+     */
+    int silence_held;
+
     /**
      * The number of PCM bytes written since the audio chunk began.
      */
     int pcm_bytes_written;
 
+    /**
+     * The time at which the first sample counted by clock_samples is to be
+     * played by the client. Together with clock_samples, this forms the
+     * sample clock of the stream.
+     */
+    guac_timestamp clock_start;
+
+    /**
+     * The number of samples per channel passed to the encoder since
+     * clock_start, in the rate of the PCM data written.
+     */
+    int64_t clock_samples;
+
+    /**
+     * The amount of audio, in milliseconds, which may be queued for playback
+     * by the client before silence is dropped from the stream. If the client
+     * falls further behind, all audio is dropped until it catches up. This
+     * defaults to GUAC_AUDIO_DEFAULT_JITTER_TARGET, and may be changed at any
+     * time.
+     */
+    int jitter_target;
+
+    /**
+     * The estimated time, in milliseconds, between PCM data being written to
+     * this stream and that data being played by the client, as of the last
+     * write.
+     */
+    int lag;
+
     /**
      * Encoder-specific state data.
      */
@@ -173,9 +286,29 @@ void guac_audio_stream_free(guac_audio_stream* stream);
  */
 void guac_audio_stream_begin(guac_audio_stream* stream, int rate, int channels, int bps);
 
+/**
+ * Sets the time at which the current audio packet is to be played by the
+ * client, overriding the timestamp derived from the PCM sample clock. The
+ * sample clock is resynchronized such that subsequent packets continue from
+ * the given timestamp. Timestamps which have already passed are replaced with
+ * the current time. This function must be called after
+ * guac_audio_stream_begin() and before any PCM data is written.
+ *
+ * @param stream The guac_audio_stream whose current audio packet should be
+ *               timestamped.
+ * @param timestamp The time at which the current audio packet is to be
+ *                  played, as returned by guac_timestamp_current().
+ * @return The time at which the current audio packet will actually be
+ *         played, which is the given timestamp or the current time,
+ *         whichever is later.
+ */
+guac_timestamp guac_audio_stream_set_timestamp(guac_audio_stream* stream,
+        guac_timestamp timestamp);
+
 /**
  * Ends the current audio packet, writing the finished packet as an audio
- * instruction.
+ * instruction followed by one or more blobs of at most GUAC_AUDIO_BLOB_SIZE
+ * bytes. If all PCM data within the packet was dropped, nothing is sent.
  *
  * @param stream The guac_audio_stream whose current audio packet should be
  *               completed and sent.
@@ -186,7 +319,11 @@ void guac_audio_stream_end(guac_audio_stream* stream);
  * Writes PCM data to the given audio stream. This PCM data will be
  * automatically encoded by the audio encoder associated with this stream. This
  * function must only be called after an audio packet has been started with
- * guac_audio_stream_begin().
+ * guac_audio_stream_begin(). If the client has fallen behind by more than the
+ * jitter target of the stream, silent PCM data is dropped, and if the client
+ * has fallen far behind, all PCM data is dropped until the client catches up.
+ * Audio packets which contain only silence are not sent. PCM data is
+ * downmixed and resampled as dictated by target_channels and target_rate.
  *
  * @param stream The guac_audio_stream to write PCM data through.
  * @param data The PCM data to write.
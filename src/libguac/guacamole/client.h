@@ -39,6 +39,7 @@
 #include "stream-types.h"
 #include "timestamp-types.h"
 
+#include <pthread.h>
 #include <stdarg.h>
 
 struct guac_client_info {
@@ -409,6 +410,12 @@ struct guac_client {
      */
     guac_pool* __stream_pool;
 
+    /**
+     * Lock which is acquired while output streams are allocated or freed,
+     * such that streams may be allocated and freed from multiple threads.
+     */
+    pthread_mutex_t __stream_lock;
+
     /**
      * All available output streams (data going to connected client).
      */
@@ -419,6 +426,28 @@ struct guac_client {
      */
     guac_stream* __input_streams;
 
+    /**
+     * Non-zero if mouse motion has been received but not yet passed to the
+     * mouse handler, as more input was already waiting. Such motion is
+     * superseded by any later mouse event.
+     */
+    int __mouse_pending;
+
+    /**
+     * The X coordinate of the pending mouse motion, if any.
+     */
+    int __mouse_x;
+
+    /**
+     * The Y coordinate of the pending mouse motion, if any.
+     */
+    int __mouse_y;
+
+    /**
+     * The button mask of the most recently received mouse event.
+     */
+    int __mouse_mask;
+
 };
 
 /**
@@ -0,0 +1,359 @@
+/*
+ * Copyright (C) 2014 Glyptodon LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "config.h"
+
+#include "opus_encoder.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <guacamole/audio.h>
+#include <guacamole/client.h>
+#include <guacamole/protocol.h>
+#include <ogg/ogg.h>
+#include <opus/opus.h>
+
+/**
+ * Writes the given value in little-endian byte order to the given buffer.
+ *
+ * @param buffer The buffer to write to.
+ * @param value The value to write.
+ * @param length The number of bytes of the value to write.
+ */
+static void opus_encoder_write_le(unsigned char* buffer, int value,
+        int length) {
+
+    int offset;
+
+    /* Write all bytes in the given value in little-endian byte order */
+    for (offset=0; offset<length; offset++) {
+        buffer[offset] = value & 0xFF;
+        value >>= 8;
+    }
+
+}
+
+/**
+ * Writes the current Ogg page of the given audio stream.
+ *
+ * @param audio The audio stream whose current Ogg page should be written.
+ */
+static void opus_encoder_write_page(guac_audio_stream* audio) {
+
+    /* Get state */
+    opus_encoder_state* state = (opus_encoder_state*) audio->data;
+
+    /* Write page header */
+    guac_audio_stream_write_encoded(audio,
+            state->ogg_page.header,
+            state->ogg_page.header_len);
+
+    /* Write page body */
+    guac_audio_stream_write_encoded(audio,
+            state->ogg_page.body,
+            state->ogg_page.body_len);
+
+}
+
+/**
+ * Submits the given header packet to the Ogg stream of the given audio
+ * stream, writing the page(s) containing that packet.
+ *
+ * @param audio The audio stream whose headers are being written.
+ * @param data The contents of the header packet.
+ * @param length The number of bytes within the header packet.
+ */
+static void opus_encoder_write_header(guac_audio_stream* audio,
+        unsigned char* data, int length) {
+
+    /* Get state */
+    opus_encoder_state* state = (opus_encoder_state*) audio->data;
+
+    ogg_packet packet = {
+        .packet     = data,
+        .bytes      = length,
+        .b_o_s      = (state->packet_number == 0),
+        .e_o_s      = 0,
+        .granulepos = 0,
+        .packetno   = state->packet_number++
+    };
+
+    ogg_stream_packetin(&(state->ogg_state), &packet);
+
+    /* Each header packet must be alone within its page(s) */
+    while (ogg_stream_flush(&(state->ogg_state), &(state->ogg_page)) != 0)
+        opus_encoder_write_page(audio);
+
+}
+
+/**
+ * Begins a new Ogg Opus stream for the current clip of the given audio
+ * stream, writing the stream headers. Each clip is decoded by the client on
+ * its own, and thus must be a complete stream.
+ *
+ * @param audio The audio stream whose current clip is beginning.
+ */
+static void opus_encoder_begin_clip(guac_audio_stream* audio) {
+
+    /* Get state */
+    opus_encoder_state* state = (opus_encoder_state*) audio->data;
+
+    /* OpusHead and OpusTags header packets */
+    unsigned char head[19] = "OpusHead";
+    unsigned char tags[8 + 4 + 7 + 4] = "OpusTags";
+
+    /* Init Ogg stream */
+    ogg_stream_init(&(state->ogg_state), rand());
+    state->packet_number = 0;
+    state->granule_position = 0;
+    state->samples = 0;
+
+    /* Build OpusHead (identification header) */
+    head[8] = 1;               /* Version */
+    head[9] = state->channels; /* Channel count */
+    opus_encoder_write_le(&(head[10]), state->pre_skip, 2);
+    opus_encoder_write_le(&(head[12]), state->rate, 4);
+    opus_encoder_write_le(&(head[16]), 0, 2); /* Output gain */
+    head[18] = 0;              /* Channel mapping family */
+
+    /* Build OpusTags (comment header) */
+    opus_encoder_write_le(&(tags[8]), 7, 4);
+    memcpy(&(tags[12]), "libguac", 7);
+    opus_encoder_write_le(&(tags[19]), 0, 4); /* No user comments */
+
+    opus_encoder_write_header(audio, head, sizeof(head));
+    opus_encoder_write_header(audio, tags, sizeof(tags));
+
+}
+
+/**
+ * Encodes the completed frame of the given audio stream as a single Opus
+ * packet, writing out any Ogg pages which are thus completed.
+ *
+ * @param audio The audio stream whose current frame should be encoded.
+ * @param last Non-zero if this frame is the last of the current clip, zero
+ *             otherwise.
+ */
+static void opus_encoder_encode_frame(guac_audio_stream* audio, int last) {
+
+    /* Get state */
+    opus_encoder_state* state = (opus_encoder_state*) audio->data;
+
+    ogg_packet packet;
+
+    /* Encode frame, dropping it on failure */
+    int length = opus_encode(state->encoder, state->frame, state->frame_size,
+            state->packet, sizeof(state->packet));
+
+    state->frame_used = 0;
+    if (length < 0)
+        return;
+
+    /* Granule positions are always at 48 kHz */
+    state->granule_position += state->frame_size
+                             * (OPUS_ENCODER_SAMPLE_RATE / state->rate);
+
+    /* Weld packet into bitstream */
+    packet.packet     = state->packet;
+    packet.bytes      = length;
+    packet.b_o_s      = 0;
+    packet.e_o_s      = last;
+    packet.granulepos = state->granule_position;
+    packet.packetno   = state->packet_number++;
+
+    /* Trim padding from the end of the last frame */
+    if (last)
+        packet.granulepos = state->pre_skip + state->samples
+                          * (OPUS_ENCODER_SAMPLE_RATE / state->rate);
+
+    ogg_stream_packetin(&(state->ogg_state), &packet);
+
+    /* Write out completed pages */
+    while (ogg_stream_pageout(&(state->ogg_state), &(state->ogg_page)) != 0)
+        opus_encoder_write_page(audio);
+
+}
+
+void opus_encoder_begin_handler(guac_audio_stream* audio) {
+
+    int error;
+    opus_int32 lookahead = 0;
+
+    /* Allocate stream state */
+    opus_encoder_state* state = (opus_encoder_state*)
+        malloc(sizeof(opus_encoder_state));
+
+    audio->data = state;
+
+    /* The audio stream resamples to a rate supported by Opus */
+    state->rate = audio->rate;
+    state->channels = audio->channels;
+
+    /* Init frame buffer */
+    state->frame_size = state->rate * OPUS_ENCODER_FRAME_DURATION / 1000;
+    state->frame_used = 0;
+    state->frame = malloc(sizeof(opus_int16)
+            * state->frame_size * state->channels);
+
+    /* Init encoder */
+    state->encoder = opus_encoder_create(state->rate, state->channels,
+            OPUS_APPLICATION_RESTRICTED_LOWDELAY, &error);
+
+    if (state->encoder == NULL)
+        guac_client_log_error(audio->client,
+                "Unable to create Opus encoder: %s", opus_strerror(error));
+
+    else {
+        opus_encoder_ctl(state->encoder, OPUS_SET_BITRATE(OPUS_ENCODER_BITRATE));
+        opus_encoder_ctl(state->encoder, OPUS_GET_LOOKAHEAD(&lookahead));
+    }
+
+    state->lookahead = lookahead;
+    state->pre_skip = lookahead * (OPUS_ENCODER_SAMPLE_RATE / state->rate);
+
+    /* Each clip is its own Ogg stream */
+    if (state->encoder != NULL)
+        opus_encoder_begin_clip(audio);
+
+}
+
+/**
+ * Finishes encoding the current clip of the given audio stream, writing all
+ * remaining Ogg pages and ending its Ogg stream.
+ *
+ * @param audio The audio stream whose current clip is ending.
+ */
+static void opus_encoder_end_clip(guac_audio_stream* audio) {
+
+    /* Get state */
+    opus_encoder_state* state = (opus_encoder_state*) audio->data;
+
+    int padding;
+
+    /* Pad with silence to complete the final frame and to push all written
+     * samples through the encoder lookahead */
+    padding = state->lookahead;
+    while (padding > 0 || state->frame_used != 0) {
+
+        memset(&(state->frame[state->frame_used * state->channels]), 0,
+                sizeof(opus_int16) * state->channels);
+
+        if (padding > 0)
+            padding--;
+
+        if (++state->frame_used == state->frame_size)
+            opus_encoder_encode_frame(audio, padding == 0);
+
+    }
+
+    /* End Ogg stream of clip */
+    while (ogg_stream_flush(&(state->ogg_state), &(state->ogg_page)) != 0)
+        opus_encoder_write_page(audio);
+
+    ogg_stream_clear(&(state->ogg_state));
+
+}
+
+void opus_encoder_end_handler(guac_audio_stream* audio) {
+
+    /* Get state */
+    opus_encoder_state* state = (opus_encoder_state*) audio->data;
+
+    /* Finish clip and clean up encoder */
+    if (state->encoder != NULL) {
+        opus_encoder_end_clip(audio);
+        opus_encoder_destroy(state->encoder);
+    }
+
+    /* Free stream state */
+    free(state->frame);
+    free(state);
+
+}
+
+void opus_encoder_write_handler(guac_audio_stream* audio,
+        const unsigned char* pcm_data, int length) {
+
+    /* Get state */
+    opus_encoder_state* state = (opus_encoder_state*) audio->data;
+
+    int bytes_per_sample = audio->bps / 8;
+    int bytes_per_frame = bytes_per_sample * audio->channels;
+
+    /* Drop audio if encoder could not be created */
+    if (state->encoder == NULL || bytes_per_frame == 0)
+        return;
+
+    /* For each sample frame */
+    while (length >= bytes_per_frame) {
+
+        int channel;
+        opus_int16* current =
+            &(state->frame[state->frame_used * state->channels]);
+
+        /* Read 16-bit signed or 8-bit unsigned samples */
+        for (channel = 0; channel < state->channels; channel++) {
+
+            const unsigned char* sample =
+                &(pcm_data[channel * bytes_per_sample]);
+
+            if (bytes_per_sample == 2)
+                current[channel] = (signed char) sample[1] * 256 + sample[0];
+            else
+                current[channel] = (sample[0] - 128) * 256;
+
+        }
+
+        state->samples++;
+
+        /* Encode frame once full */
+        if (++state->frame_used == state->frame_size)
+            opus_encoder_encode_frame(audio, 0);
+
+        pcm_data += bytes_per_frame;
+        length -= bytes_per_frame;
+
+    }
+
+}
+
+/**
+ * The sample rates supported by Opus, in Hz, most preferred first.
+ */
+static const int opus_encoder_rates[] = {
+    48000, 24000, 16000, 12000, 8000, 0
+};
+
+/* Encoder handlers */
+guac_audio_encoder _opus_encoder = {
+    .mimetype      = "audio/ogg; codecs=opus",
+    .begin_handler = opus_encoder_begin_handler,
+    .write_handler = opus_encoder_write_handler,
+    .end_handler   = opus_encoder_end_handler,
+    .rates         = opus_encoder_rates
+};
+
+/* Actual encoder */
+guac_audio_encoder* opus_encoder = &_opus_encoder;
+
@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2014 Glyptodon LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef __GUAC_OPUS_ENCODER_H
+#define __GUAC_OPUS_ENCODER_H
+
+#include "config.h"
+
+#include <guacamole/audio.h>
+#include <ogg/ogg.h>
+#include <opus/opus.h>
+
+/**
+ * The duration of each Opus frame, in milliseconds. Opus supports frames of
+ * 2.5, 5, 10, 20, 40 or 60 ms. Shorter frames reduce latency at the cost of
+ * compression efficiency.
+ */
+#define OPUS_ENCODER_FRAME_DURATION 20
+
+/**
+ * The sample rate used for all Ogg granule positions, in Hz.
+ */
+#define OPUS_ENCODER_SAMPLE_RATE 48000
+
+/**
+ * The target bitrate of the encoded audio, in bits per second.
+ */
+#define OPUS_ENCODER_BITRATE 64000
+
+/**
+ * The maximum size of a single encoded Opus packet, in bytes.
+ */
+#define OPUS_ENCODER_MAX_PACKET_SIZE 4000
+
+typedef struct opus_encoder_state {
+
+    /**
+     * The libopus encoder.
+     */
+    OpusEncoder* encoder;
+
+    /**
+     * Ogg state
+     */
+    ogg_stream_state ogg_state;
+    ogg_page ogg_page;
+
+    /**
+     * The number of the next Ogg packet within the stream.
+     */
+    ogg_int64_t packet_number;
+
+    /**
+     * The granule position of the end of the last packet written, in
+     * samples at OPUS_ENCODER_SAMPLE_RATE.
+     */
+    ogg_int64_t granule_position;
+
+    /**
+     * The number of samples per channel of PCM data written within the
+     * current clip, excluding any padding.
+     */
+    int samples;
+
+    /**
+     * The number of samples per channel of lookahead added by the encoder,
+     * at the encoder rate.
+     */
+    int lookahead;
+
+    /**
+     * The number of samples to discard from the start of each decoded clip,
+     * in samples at OPUS_ENCODER_SAMPLE_RATE.
+     */
+    int pre_skip;
+
+    /**
+     * The sample rate given to the encoder, in Hz.
+     */
+    int rate;
+
+    /**
+     * The number of channels given to the encoder.
+     */
+    int channels;
+
+    /**
+     * The number of samples per channel in each frame, at the encoder rate.
+     */
+    int frame_size;
+
+    /**
+     * Interleaved 16-bit samples of the frame currently being built.
+     */
+    opus_int16* frame;
+
+    /**
+     * The number of samples per channel currently stored within frame.
+     */
+    int frame_used;
+
+    /**
+     * Buffer receiving each encoded Opus packet.
+     */
+    unsigned char packet[OPUS_ENCODER_MAX_PACKET_SIZE];
+
+} opus_encoder_state;
+
+extern guac_audio_encoder* opus_encoder;
+
+#endif
+
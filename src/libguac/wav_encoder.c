@@ -149,6 +149,7 @@ void wav_encoder_end_handler(guac_audio_stream* audio) {
     guac_audio_stream_write_encoded(audio, state->data_buffer, state->used);
 
     /* Free stream state */
+    free(state->data_buffer);
     free(state);
 
 }
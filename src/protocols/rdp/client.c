@@ -101,6 +101,10 @@ const char* GUAC_CLIENT_ARGS[] = {
     "remote-app-dir",
     "remote-app-args",
     "static-channels",
+    "enable-remotefx",
+    "audio-rate",
+    "audio-channels",
+    "enable-write-behind",
     NULL
 };
 
@@ -129,6 +133,10 @@ enum RDP_ARGS_IDX {
     IDX_REMOTE_APP_DIR,
     IDX_REMOTE_APP_ARGS,
     IDX_STATIC_CHANNELS,
+    IDX_ENABLE_REMOTEFX,
+    IDX_AUDIO_RATE,
+    IDX_AUDIO_CHANNELS,
+    IDX_ENABLE_WRITE_BEHIND,
     RDP_ARGS_COUNT
 };
 
@@ -168,6 +176,12 @@ BOOL rdp_freerdp_pre_connect(freerdp* instance) {
         /* If an encoding is available, load the sound plugin */
         if (guac_client_data->audio != NULL) {
 
+            /* Convert audio to the requested format, if any */
+            guac_client_data->audio->target_rate =
+                guac_client_data->settings.audio_rate;
+            guac_client_data->audio->target_channels =
+                guac_client_data->settings.audio_channels;
+
             /* Load sound plugin */
             if (freerdp_channels_load_plugin(channels, instance->settings,
                         "guacsnd", guac_client_data->audio))
@@ -184,7 +198,8 @@ BOOL rdp_freerdp_pre_connect(freerdp* instance) {
     /* Load filesystem if drive enabled */
     if (guac_client_data->settings.drive_enabled) {
         guac_client_data->filesystem =
-            guac_rdp_fs_alloc(guac_client_data->settings.drive_path);
+            guac_rdp_fs_alloc(guac_client_data->settings.drive_path,
+                    guac_client_data->settings.write_behind_enabled);
     }
 
     /* If RDPDR required, load it */
@@ -262,6 +277,23 @@ BOOL rdp_freerdp_pre_connect(freerdp* instance) {
     clrconv->palette = calloc(1, sizeof(rdpPalette));
     ((rdp_freerdp_context*) context)->clrconv = clrconv;
 
+    /* Init surface bits decoders if RemoteFX enabled */
+    ((rdp_freerdp_context*) context)->rfx = NULL;
+#ifdef HAVE_FREERDP_NSCODEC
+    ((rdp_freerdp_context*) context)->nsc = NULL;
+#endif
+    if (guac_client_data->settings.remotefx_enabled) {
+
+        RFX_CONTEXT* rfx = rfx_context_new();
+        rfx_context_set_pixel_format(rfx, RDP_PIXEL_FORMAT_B8G8R8A8);
+        ((rdp_freerdp_context*) context)->rfx = rfx;
+
+#ifdef HAVE_FREERDP_NSCODEC
+        ((rdp_freerdp_context*) context)->nsc = nsc_context_new();
+#endif
+
+    }
+
     /* Init FreeRDP cache */
     instance->context->cache = cache_new(instance->settings);
 
@@ -276,6 +308,14 @@ BOOL rdp_freerdp_pre_connect(freerdp* instance) {
     graphics_register_bitmap(context->graphics, bitmap);
     free(bitmap);
 
+    /* Decode bitmap updates in parallel */
+    guac_client_data->decoder = guac_rdp_decoder_alloc(clrconv,
+            guac_client_data->settings.color_depth);
+    guac_client_data->update_bitmap = Bitmap_Alloc(context);
+
+    /* Bitmap_Alloc() leaves Guacamole-specific state uninitialized */
+    guac_rdp_bitmap_new(context, guac_client_data->update_bitmap);
+
     /* Set up glyph handling */
     glyph = calloc(1, sizeof(rdpGlyph));
     glyph->size = sizeof(guac_rdp_glyph);
@@ -306,6 +346,7 @@ BOOL rdp_freerdp_pre_connect(freerdp* instance) {
     instance->update->EndPaint = guac_rdp_gdi_end_paint;
     instance->update->Palette = guac_rdp_gdi_palette_update;
     instance->update->SetBounds = guac_rdp_gdi_set_bounds;
+    instance->update->SurfaceBits = guac_rdp_gdi_surface_bits;
 
     primary = instance->update->primary;
     primary->DstBlt = guac_rdp_gdi_dstblt;
@@ -321,6 +362,9 @@ BOOL rdp_freerdp_pre_connect(freerdp* instance) {
     offscreen_cache_register_callbacks(instance->update);
     palette_cache_register_callbacks(instance->update);
 
+    /* Replace default handling of bitmap updates */
+    instance->update->BitmapUpdate = guac_rdp_bitmap_update;
+
     /* Init channels (pre-connect) */
     if (freerdp_channels_pre_connect(channels, instance)) {
         guac_client_abort(client, GUAC_PROTOCOL_STATUS_SERVER_ERROR, "Error initializing RDP client channel manager");
@@ -632,10 +676,45 @@ int guac_client_init(guac_client* client, int argc, char** argv) {
                 argv[IDX_WIDTH], settings->color_depth);
     }
 
+    /* RemoteFX enable/disable */
+    settings->remotefx_enabled =
+        (strcmp(argv[IDX_ENABLE_REMOTEFX], "true") == 0);
+
+    /* RemoteFX requires 32-bit color */
+    if (settings->remotefx_enabled && settings->color_depth != 32) {
+        guac_client_log_info(client,
+                "RemoteFX enabled. Using color-depth of 32.");
+        settings->color_depth = 32;
+    }
+
     /* Audio enable/disable */
     guac_client_data->settings.audio_enabled =
         (strcmp(argv[IDX_DISABLE_AUDIO], "true") != 0);
 
+    /* Audio sample rate, if resampling is requested */
+    settings->audio_rate = 0;
+    if (argv[IDX_AUDIO_RATE][0] != '\0')
+        settings->audio_rate = atoi(argv[IDX_AUDIO_RATE]);
+
+    if (settings->audio_rate < 0) {
+        settings->audio_rate = 0;
+        guac_client_log_error(client,
+                "Invalid audio-rate: \"%s\". Audio will not be resampled.",
+                argv[IDX_AUDIO_RATE]);
+    }
+
+    /* Audio channel count, if downmixing is requested */
+    settings->audio_channels = 0;
+    if (argv[IDX_AUDIO_CHANNELS][0] != '\0')
+        settings->audio_channels = atoi(argv[IDX_AUDIO_CHANNELS]);
+
+    if (settings->audio_channels < 0) {
+        settings->audio_channels = 0;
+        guac_client_log_error(client,
+                "Invalid audio-channels: \"%s\". Audio will not be "
+                "downmixed.", argv[IDX_AUDIO_CHANNELS]);
+    }
+
     /* Printing enable/disable */
     guac_client_data->settings.printing_enabled =
         (strcmp(argv[IDX_ENABLE_PRINTING], "true") == 0);
@@ -646,16 +725,43 @@ int guac_client_init(guac_client* client, int argc, char** argv) {
 
     guac_client_data->settings.drive_path = strdup(argv[IDX_DRIVE_PATH]);
 
+    /* Write-behind buffering of drive writes */
+    guac_client_data->settings.write_behind_enabled =
+        (strcmp(argv[IDX_ENABLE_WRITE_BEHIND], "true") == 0);
+
     /* Store client data */
     guac_client_data->rdp_inst = rdp_inst;
     guac_client_data->bounded = FALSE;
     guac_client_data->mouse_button_mask = 0;
     guac_client_data->current_surface = GUAC_DEFAULT_LAYER;
+    guac_client_data->current_shadow = NULL;
     guac_client_data->clipboard = guac_common_clipboard_alloc(GUAC_RDP_CLIPBOARD_MAX_LENGTH);
     guac_client_data->requested_clipboard_format = CB_FORMAT_TEXT;
+    guac_client_data->cursor_cache = guac_common_cursor_cache_alloc(client);
+    guac_client_data->paint = guac_rdp_paint_alloc(client);
+    guac_client_data->cache_policy = guac_rdp_cache_policy_alloc(client,
+            GUAC_RDP_CACHE_POLICY_BUDGET);
+    guac_client_data->offscreen = guac_rdp_offscreen_alloc(client,
+            GUAC_RDP_OFFSCREEN_BUDGET);
+    guac_client_data->glyph_buffer = guac_client_alloc_buffer(client);
+    guac_client_data->glyph_drawing = 0;
+    guac_client_data->glyph_positions = NULL;
+    guac_client_data->glyph_count = 0;
+    guac_client_data->glyph_positions_size = 0;
+    guac_client_data->shadow = NULL;
+    guac_client_data->decoder = NULL;
+    guac_client_data->update_bitmap = NULL;
     guac_client_data->audio = NULL;
     guac_client_data->filesystem = NULL;
     guac_client_data->available_svc = guac_common_list_alloc();
+    guac_client_data->input_queue = guac_rdp_input_queue_alloc(client);
+
+    /* Input cannot be sent without a queue */
+    if (guac_client_data->input_queue == NULL) {
+        guac_client_abort(client, GUAC_PROTOCOL_STATUS_SERVER_ERROR,
+                "Unable to allocate input queue.");
+        return 1;
+    }
 
     /* Main socket needs to be threadsafe */
     guac_socket_require_threadsafe(client->socket);
@@ -704,6 +810,17 @@ int guac_client_init(guac_client* client, int argc, char** argv) {
     /* Pull actual settings back from FreeRDP */
     guac_rdp_pull_settings(rdp_inst, settings);
 
+    /* Maintain server-side copy of default layer for raster operations */
+    guac_client_data->shadow = guac_rdp_shadow_alloc(settings->width,
+            settings->height);
+
+    if (guac_client_data->shadow == NULL)
+        guac_client_log_info(client, "Unable to allocate shadow surface. "
+                "Raster operations will be evaluated client-side.");
+
+    guac_client_data->paint->shadow = guac_client_data->shadow;
+    guac_client_data->current_shadow = guac_client_data->shadow;
+
     /* Send connection name */
     guac_protocol_send_name(client->socket, settings->hostname);
 
@@ -711,13 +828,6 @@ int guac_client_init(guac_client* client, int argc, char** argv) {
     guac_protocol_send_size(client->socket, GUAC_DEFAULT_LAYER,
             settings->width, settings->height);
 
-    /* Create glyph surfaces */
-    guac_client_data->opaque_glyph_surface = cairo_image_surface_create(
-            CAIRO_FORMAT_RGB24, settings->width, settings->height);
-
-    guac_client_data->trans_glyph_surface = cairo_image_surface_create(
-            CAIRO_FORMAT_ARGB32, settings->width, settings->height);
-
     /* Set default pointer */
     guac_common_set_pointer_cursor(client);
 
@@ -28,15 +28,28 @@
 
 #include "guac_clipboard.h"
 #include "guac_list.h"
+#include "guac_pointer_cursor.h"
+#include "rdp_cache_policy.h"
+#include "rdp_decoder.h"
 #include "rdp_fs.h"
+#include "rdp_glyph.h"
+#include "rdp_input.h"
 #include "rdp_keymap.h"
+#include "rdp_offscreen.h"
+#include "rdp_paint.h"
 #include "rdp_settings.h"
+#include "rdp_shadow.h"
 
 #include <pthread.h>
 
 #include <cairo/cairo.h>
 #include <freerdp/freerdp.h>
 #include <freerdp/codec/color.h>
+#include <freerdp/codec/rfx.h>
+
+#ifdef HAVE_FREERDP_NSCODEC
+#include <freerdp/codec/nsc.h>
+#endif
 #include <guacamole/audio.h>
 #include <guacamole/client.h>
 
@@ -74,7 +87,7 @@
 /**
  * The maximum number of bytes to allow within the clipboard.
  */
-#define GUAC_RDP_CLIPBOARD_MAX_LENGTH 262144
+#define GUAC_RDP_CLIPBOARD_MAX_LENGTH 16777216
 
 /**
  * Client data that will remain accessible through the guac_client.
@@ -98,33 +111,115 @@ typedef struct rdp_guac_client_data {
     int mouse_button_mask;
 
     /**
-     * Cairo surface which will receive all TRANSPARENT glyphs.
+     * Drawing operations deferred until the end of the current paint.
+     */
+    guac_rdp_paint* paint;
+
+    /**
+     * Server-side copy of the contents of the default layer, or NULL if no
+     * such copy is maintained.
+     */
+    guac_rdp_shadow* shadow;
+
+    /**
+     * The policy deciding which bitmaps are cached within client-side
+     * buffers.
+     */
+    guac_rdp_cache_policy* cache_policy;
+
+    /**
+     * All offscreen surfaces whose contents are composed server-side.
+     */
+    guac_rdp_offscreen* offscreen;
+
+    /**
+     * Pool of threads which decode the rectangles of bitmap updates.
+     */
+    guac_rdp_decoder* decoder;
+
+    /**
+     * The bitmap reused for each rectangle of each bitmap update.
+     */
+    rdpBitmap* update_bitmap;
+
+    /**
+     * Buffer into which the glyphs of the current text run are copied from
+     * their cached buffers and colored before being drawn to the current
+     * surface.
+     */
+    guac_layer* glyph_buffer;
+
+    /**
+     * Whether a text run is currently being drawn, as marked by calls to
+     * the glyph BeginDraw and EndDraw handlers.
+     */
+    int glyph_drawing;
+
+    /**
+     * The foreground color of the current text run, as 24-bit RGB.
+     */
+    int glyph_color;
+
+    /**
+     * The X coordinate of the upper-left corner of the rectangle containing
+     * all glyphs drawn so far in the current text run.
+     */
+    int glyph_left;
+
+    /**
+     * The Y coordinate of the upper-left corner of the rectangle containing
+     * all glyphs drawn so far in the current text run.
+     */
+    int glyph_top;
+
+    /**
+     * The X coordinate just past the right edge of the rectangle containing
+     * all glyphs drawn so far in the current text run. If no glyphs have yet
+     * been drawn, this will be no greater than glyph_left.
+     */
+    int glyph_right;
+
+    /**
+     * The Y coordinate just past the bottom edge of the rectangle containing
+     * all glyphs drawn so far in the current text run. If no glyphs have yet
+     * been drawn, this will be no greater than glyph_top.
      */
-    cairo_surface_t* trans_glyph_surface;
+    int glyph_bottom;
 
     /**
-     * Cairo surface which will receive all OPAQUE glyphs.
+     * The position of each glyph drawn so far in the current text run, if
+     * that text run is being drawn to the default layer, such that the text
+     * can be mirrored within the shadow surface once its clipping rectangle
+     * is known.
      */
-    cairo_surface_t* opaque_glyph_surface;
+    guac_rdp_glyph_position* glyph_positions;
 
     /**
-     * The current Cairo surface which will receive all drawn glyphs,
-     * depending on whether we are currently drawing transparent or
-     * opaque glyphs.
+     * The number of glyphs within glyph_positions.
      */
-    cairo_surface_t* glyph_surface;
+    int glyph_count;
 
     /**
-     * Cairo instance for drawing to the current glyph surface.
+     * The number of glyphs which may be stored within glyph_positions before
+     * it must be resized.
      */
-    cairo_t* glyph_cairo;
+    int glyph_positions_size;
 
     /**
      * The Guacamole layer that GDI operations should draw to. RDP messages
      * exist which change this surface to allow drawing to occur off-screen.
+     * If the current surface is an offscreen surface composed server-side,
+     * this will be NULL.
      */
     const guac_layer* current_surface;
 
+    /**
+     * The shadow surface containing the server-side contents of the current
+     * surface, or NULL if the contents of the current surface are not known
+     * server-side.
+     */
+    guac_rdp_shadow* current_shadow;
+
     /**
      * Whether graphical operations are restricted to a specific bounding
      * rectangle.
@@ -184,6 +279,11 @@ typedef struct rdp_guac_client_data {
      */
     int requested_clipboard_format;
 
+    /**
+     * Cache of all cursor images sent to the client.
+     */
+    guac_common_cursor_cache* cursor_cache;
+
     /**
      * Audio output, if any.
      */
@@ -200,7 +300,15 @@ typedef struct rdp_guac_client_data {
     guac_common_list* available_svc;
 
     /**
-     * Lock which is locked and unlocked for each RDP message.
+     * Input events received from the Guacamole client which have not yet
+     * been sent. Only the RDP thread sends input, such that input handlers
+     * never wait on message handling.
+     */
+    guac_rdp_input_queue* input_queue;
+
+    /**
+     * Lock which is locked and unlocked for each RDP message, and is held
+     * only by the RDP thread.
      */
     pthread_mutex_t rdp_lock;
 
@@ -233,6 +341,18 @@ typedef struct rdp_freerdp_context {
      */
     CLRCONV* clrconv;
 
+    /**
+     * RemoteFX decoder for surface bits, or NULL if RemoteFX is not enabled.
+     */
+    RFX_CONTEXT* rfx;
+
+#ifdef HAVE_FREERDP_NSCODEC
+    /**
+     * NSCodec decoder for surface bits, or NULL if RemoteFX is not enabled.
+     */
+    NSC_CONTEXT* nsc;
+#endif
+
 } rdp_freerdp_context;
 
 /**
@@ -26,6 +26,7 @@
 #include "guac_handlers.h"
 #include "guac_list.h"
 #include "rdp_cliprdr.h"
+#include "rdp_input.h"
 #include "rdp_keymap.h"
 #include "rdp_rail.h"
 #include "rdp_stream.h"
@@ -80,6 +81,23 @@ int rdp_guac_client_free_handler(guac_client* client) {
 	freerdp_channels_free(channels);
 	freerdp_disconnect(rdp_inst);
     freerdp_clrconv_free(((rdp_freerdp_context*) rdp_inst->context)->clrconv);
+
+    /* Free surface bits decoders, if any */
+    if (((rdp_freerdp_context*) rdp_inst->context)->rfx != NULL)
+        rfx_context_free(((rdp_freerdp_context*) rdp_inst->context)->rfx);
+
+#ifdef HAVE_FREERDP_NSCODEC
+    if (((rdp_freerdp_context*) rdp_inst->context)->nsc != NULL)
+        nsc_context_free(((rdp_freerdp_context*) rdp_inst->context)->nsc);
+#endif
+
+    /* Stop decoding bitmap updates */
+    if (guac_client_data->decoder != NULL)
+        guac_rdp_decoder_free(guac_client_data->decoder);
+
+    if (guac_client_data->update_bitmap != NULL)
+        Bitmap_Free(rdp_inst->context, guac_client_data->update_bitmap);
+
     cache_free(rdp_inst->context->cache);
     freerdp_free(rdp_inst);
 
@@ -92,8 +110,14 @@ int rdp_guac_client_free_handler(guac_client* client) {
 
     /* Free client data */
     guac_common_clipboard_free(guac_client_data->clipboard);
-    cairo_surface_destroy(guac_client_data->opaque_glyph_surface);
-    cairo_surface_destroy(guac_client_data->trans_glyph_surface);
+    guac_common_cursor_cache_free(guac_client_data->cursor_cache);
+    guac_client_free_buffer(client, guac_client_data->glyph_buffer);
+    guac_rdp_paint_free(guac_client_data->paint);
+    guac_rdp_shadow_free(guac_client_data->shadow);
+    free(guac_client_data->glyph_positions);
+    guac_rdp_cache_policy_free(guac_client_data->cache_policy);
+    guac_rdp_offscreen_free(guac_client_data->offscreen);
+    guac_rdp_input_queue_free(guac_client_data->input_queue);
     free(guac_client_data);
 
     return 0;
@@ -158,6 +182,12 @@ static int rdp_guac_client_wait_for_messages(guac_client* client, int timeout_us
         return -1;
     }
 
+    /* Wake when input is queued */
+    fd = guac_rdp_input_queue_fd(guac_client_data->input_queue);
+    if (fd > max_fd)
+        max_fd = fd;
+    FD_SET(fd, &rfds);
+
     /* Wait for all RDP file descriptors */
     result = select(max_fd + 1, &rfds, &wfds, NULL, &timeout);
     if (result < 0) {
@@ -190,6 +220,10 @@ int rdp_guac_client_handle_messages(guac_client* client) {
     /* Wait for messages */
     int wait_result = rdp_guac_client_wait_for_messages(client, 250000);
     guac_timestamp frame_start = guac_timestamp_current();
+
+    /* Send any clipboard contents the client has not acknowledged in time */
+    guac_common_clipboard_continue(guac_client_data->clipboard);
+
     while (wait_result > 0) {
 
         guac_timestamp frame_end;
@@ -197,6 +231,10 @@ int rdp_guac_client_handle_messages(guac_client* client) {
 
         pthread_mutex_lock(&(guac_client_data->rdp_lock));
 
+        /* Send any input received while waiting */
+        guac_rdp_input_queue_flush(guac_client_data->input_queue,
+                rdp_inst->input);
+
         /* Check the libfreerdp fds */
         if (!freerdp_check_fds(rdp_inst)) {
             guac_error = GUAC_STATUS_BAD_STATE;
@@ -205,6 +243,9 @@ int rdp_guac_client_handle_messages(guac_client* client) {
             return 1;
         }
 
+        /* Send any drawing not yet ended by EndPaint */
+        guac_rdp_paint_flush(guac_client_data->paint);
+
         /* Check channel fds */
         if (!freerdp_channels_check_fds(channels, rdp_inst)) {
             guac_error = GUAC_STATUS_BAD_STATE;
@@ -269,13 +310,11 @@ int rdp_guac_client_handle_messages(guac_client* client) {
 int rdp_guac_client_mouse_handler(guac_client* client, int x, int y, int mask) {
 
     rdp_guac_client_data* guac_client_data = (rdp_guac_client_data*) client->data;
-    freerdp* rdp_inst = guac_client_data->rdp_inst;
-
-    pthread_mutex_lock(&(guac_client_data->rdp_lock));
+    guac_rdp_input_queue* input_queue = guac_client_data->input_queue;
 
     /* If button mask unchanged, just send move event */
     if (mask == guac_client_data->mouse_button_mask)
-        rdp_inst->input->MouseEvent(rdp_inst->input, PTR_FLAGS_MOVE, x, y);
+        guac_rdp_input_queue_mouse(input_queue, PTR_FLAGS_MOVE, x, y);
 
     /* Otherwise, send events describing button change */
     else {
@@ -295,7 +334,7 @@ int rdp_guac_client_mouse_handler(guac_client* client, int x, int y, int mask) {
             if (released_mask & 0x02) flags |= PTR_FLAGS_BUTTON3;
             if (released_mask & 0x04) flags |= PTR_FLAGS_BUTTON2;
 
-            rdp_inst->input->MouseEvent(rdp_inst->input, flags, x, y);
+            guac_rdp_input_queue_mouse(input_queue, flags, x, y);
 
         }
 
@@ -311,7 +350,7 @@ int rdp_guac_client_mouse_handler(guac_client* client, int x, int y, int mask) {
             if (pressed_mask & 0x10) flags |= PTR_FLAGS_WHEEL | PTR_FLAGS_WHEEL_NEGATIVE | 0x88;
 
             /* Send event */
-            rdp_inst->input->MouseEvent(rdp_inst->input, flags, x, y);
+            guac_rdp_input_queue_mouse(input_queue, flags, x, y);
 
         }
 
@@ -320,15 +359,13 @@ int rdp_guac_client_mouse_handler(guac_client* client, int x, int y, int mask) {
 
             /* Down */
             if (pressed_mask & 0x08)
-                rdp_inst->input->MouseEvent(
-                        rdp_inst->input,
+                guac_rdp_input_queue_mouse(input_queue,
                         PTR_FLAGS_WHEEL | 0x78,
                         x, y);
 
             /* Up */
             if (pressed_mask & 0x10)
-                rdp_inst->input->MouseEvent(
-                        rdp_inst->input,
+                guac_rdp_input_queue_mouse(input_queue,
                         PTR_FLAGS_WHEEL | PTR_FLAGS_WHEEL_NEGATIVE | 0x88,
                         x, y);
 
@@ -337,15 +374,13 @@ int rdp_guac_client_mouse_handler(guac_client* client, int x, int y, int mask) {
         guac_client_data->mouse_button_mask = mask;
     }
 
-    pthread_mutex_unlock(&(guac_client_data->rdp_lock));
-
     return 0;
 }
 
 int __guac_rdp_send_keysym(guac_client* client, int keysym, int pressed) {
 
     rdp_guac_client_data* guac_client_data = (rdp_guac_client_data*) client->data;
-    freerdp* rdp_inst = guac_client_data->rdp_inst;
+    guac_rdp_input_queue* input_queue = guac_client_data->input_queue;
 
     /* If keysym can be in lookup table */
     if (GUAC_RDP_KEYSYM_STORABLE(keysym)) {
@@ -359,8 +394,6 @@ int __guac_rdp_send_keysym(guac_client* client, int keysym, int pressed) {
         /* If defined, send event */
         if (keysym_desc->scancode != 0) {
 
-            pthread_mutex_lock(&(guac_client_data->rdp_lock));
-
             /* If defined, send any prerequesite keys that must be set */
             if (keysym_desc->set_keysyms != NULL)
                 __guac_rdp_update_keysyms(client, keysym_desc->set_keysyms, 0, 1);
@@ -376,8 +409,8 @@ int __guac_rdp_send_keysym(guac_client* client, int keysym, int pressed) {
                 pressed_flags = KBD_FLAGS_RELEASE;
 
             /* Send actual key */
-            rdp_inst->input->KeyboardEvent(rdp_inst->input, keysym_desc->flags | pressed_flags,
-                    keysym_desc->scancode);
+            guac_rdp_input_queue_keyboard(input_queue,
+                    keysym_desc->flags | pressed_flags, keysym_desc->scancode);
 
             /* If defined, release any keys that were originally released */
             if (keysym_desc->set_keysyms != NULL)
@@ -387,8 +420,6 @@ int __guac_rdp_send_keysym(guac_client* client, int keysym, int pressed) {
             if (keysym_desc->clear_keysyms != NULL)
                 __guac_rdp_update_keysyms(client, keysym_desc->clear_keysyms, 1, 1);
 
-            pthread_mutex_unlock(&(guac_client_data->rdp_lock));
-
             return 0;
 
         }
@@ -413,14 +444,8 @@ int __guac_rdp_send_keysym(guac_client* client, int keysym, int pressed) {
             return 0;
         }
 
-        pthread_mutex_lock(&(guac_client_data->rdp_lock));
-
         /* Send Unicode event */
-        rdp_inst->input->UnicodeKeyboardEvent(
-                rdp_inst->input,
-                0, codepoint);
-
-        pthread_mutex_unlock(&(guac_client_data->rdp_lock));
+        guac_rdp_input_queue_unicode(input_queue, 0, codepoint);
 
     }
     
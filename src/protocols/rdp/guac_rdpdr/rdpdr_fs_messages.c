@@ -213,6 +213,8 @@ void guac_rdpdr_fs_process_close(guac_rdpdr_device* device,
 
     wStream* output_stream;
     guac_rdp_fs_file* file;
+    int result = 0;
+    int close_result;
 
     GUAC_RDP_DEBUG(2, "[file_id=%i]", file_id);
 
@@ -221,18 +223,54 @@ void guac_rdpdr_fs_process_close(guac_rdpdr_device* device,
     if (file == NULL)
         return;
 
-    /* If file was written to, and it's in the \Download folder, start stream */
+    /* If file was written to, and it's in the \Download folder, start stream
+     * once all data has been written */
     if (file->bytes_written > 0 &&
             strncmp(file->absolute_path, "\\Download\\", 10) == 0) {
-        guac_rdpdr_start_download(device, file->absolute_path);
-        guac_rdp_fs_delete((guac_rdp_fs*) device->data, file_id);
+
+        result = guac_rdp_fs_flush((guac_rdp_fs*) device->data, file_id);
+        if (result == 0) {
+            guac_rdpdr_start_download(device, file->absolute_path);
+            guac_rdp_fs_delete((guac_rdp_fs*) device->data, file_id);
+        }
+
     }
 
-    /* Close file */
-    guac_rdp_fs_close((guac_rdp_fs*) device->data, file_id);
+    /* Close file, reporting any failure to write buffered data */
+    close_result = guac_rdp_fs_close((guac_rdp_fs*) device->data, file_id);
+    if (result == 0)
+        result = close_result;
+
+    if (result < 0)
+        output_stream = guac_rdpdr_new_io_completion(device, completion_id,
+                guac_rdp_fs_get_status(result), 4);
+    else
+        output_stream = guac_rdpdr_new_io_completion(device, completion_id,
+                STATUS_SUCCESS, 4);
+
+    Stream_Write(output_stream, "\0\0\0\0", 4); /* Padding */
+
+    svc_plugin_send((rdpSvcPlugin*) device->rdpdr, output_stream);
+
+}
+
+void guac_rdpdr_fs_process_flush_buffers(guac_rdpdr_device* device,
+        wStream* input_stream, int file_id, int completion_id) {
+
+    wStream* output_stream;
+
+    /* Write any buffered data */
+    int result = guac_rdp_fs_flush((guac_rdp_fs*) device->data, file_id);
+
+    GUAC_RDP_DEBUG(2, "[file_id=%i] result=%i", file_id, result);
+
+    if (result < 0)
+        output_stream = guac_rdpdr_new_io_completion(device, completion_id,
+                guac_rdp_fs_get_status(result), 4);
+    else
+        output_stream = guac_rdpdr_new_io_completion(device, completion_id,
+                STATUS_SUCCESS, 4);
 
-    output_stream = guac_rdpdr_new_io_completion(device, completion_id,
-            STATUS_SUCCESS, 4);
     Stream_Write(output_stream, "\0\0\0\0", 4); /* Padding */
 
     svc_plugin_send((rdpSvcPlugin*) device->rdpdr, output_stream);
@@ -402,7 +440,7 @@ void guac_rdpdr_fs_process_query_directory(guac_rdpdr_device* device, wStream* i
     int fs_information_class, initial_query;
     int path_length;
 
-    const char* entry_name;
+    const guac_rdp_fs_dir_entry* entry;
 
     /* Get file */
     file = guac_rdp_fs_get_file((guac_rdp_fs*) device->data, file_id);
@@ -423,65 +461,58 @@ void guac_rdpdr_fs_process_query_directory(guac_rdpdr_device* device, wStream* i
         guac_rdp_utf16_to_utf8(Stream_Pointer(input_stream), path_length/2 - 1,
                 file->dir_pattern, sizeof(file->dir_pattern));
 
+        /* Start from first entry of current directory contents */
+        guac_rdp_fs_rewind_dir((guac_rdp_fs*) device->data, file_id);
+
     }
 
     GUAC_RDP_DEBUG(2, "[file_id=%i] initial_query=%i, dir_pattern=\"%s\"",
              file_id, initial_query, file->dir_pattern);
 
     /* Find first matching entry in directory */
-    while ((entry_name = guac_rdp_fs_read_dir((guac_rdp_fs*) device->data,
+    while ((entry = guac_rdp_fs_read_dir((guac_rdp_fs*) device->data,
                     file_id)) != NULL) {
 
         /* Convert to absolute path */
         char entry_path[GUAC_RDP_FS_MAX_PATH];
         if (guac_rdp_fs_convert_path(file->absolute_path,
-                    entry_name, entry_path) == 0) {
-
-            int entry_file_id;
+                    entry->name, entry_path) == 0) {
 
             /* Pattern defined and match fails, continue with next file */
             if (guac_rdp_fs_matches(entry_path, file->dir_pattern))
                 continue;
 
-            /* Open directory entry */
-            entry_file_id = guac_rdp_fs_open((guac_rdp_fs*) device->data,
-                    entry_path, ACCESS_FILE_READ_DATA, 0, DISP_FILE_OPEN, 0);
-
-            if (entry_file_id >= 0) {
-
-                /* Dispatch to appropriate class-specific handler */
-                switch (fs_information_class) {
+            /* Dispatch to appropriate class-specific handler */
+            switch (fs_information_class) {
 
-                    case FileDirectoryInformation:
-                        guac_rdpdr_fs_process_query_directory_info(device,
-                                entry_name, entry_file_id, completion_id);
-                        break;
+                case FileDirectoryInformation:
+                    guac_rdpdr_fs_process_query_directory_info(device,
+                            entry, completion_id);
+                    break;
 
-                    case FileFullDirectoryInformation:
-                        guac_rdpdr_fs_process_query_full_directory_info(device,
-                                entry_name, entry_file_id, completion_id);
-                        break;
+                case FileFullDirectoryInformation:
+                    guac_rdpdr_fs_process_query_full_directory_info(device,
+                            entry, completion_id);
+                    break;
 
-                    case FileBothDirectoryInformation:
-                        guac_rdpdr_fs_process_query_both_directory_info(device,
-                                entry_name, entry_file_id, completion_id);
-                        break;
+                case FileBothDirectoryInformation:
+                    guac_rdpdr_fs_process_query_both_directory_info(device,
+                            entry, completion_id);
+                    break;
 
-                    case FileNamesInformation:
-                        guac_rdpdr_fs_process_query_names_info(device,
-                                entry_name, entry_file_id, completion_id);
-                        break;
+                case FileNamesInformation:
+                    guac_rdpdr_fs_process_query_names_info(device,
+                            entry, completion_id);
+                    break;
 
-                    default:
-                        guac_client_log_info(device->rdpdr->client,
-                                "Unknown dir information class: 0x%x",
-                                fs_information_class);
-                }
+                default:
+                    guac_client_log_info(device->rdpdr->client,
+                            "Unknown dir information class: 0x%x",
+                            fs_information_class);
+            }
 
-                guac_rdp_fs_close((guac_rdp_fs*) device->data, entry_file_id);
-                return;
+            return;
 
-            } /* end if file exists */
         } /* end if path valid */
     } /* end if entry exists */
 
@@ -57,6 +57,13 @@ void guac_rdpdr_fs_process_create(guac_rdpdr_device* device,
 void guac_rdpdr_fs_process_close(guac_rdpdr_device* device,
         wStream* input_stream, int file_id, int completion_id);
 
+/**
+ * Handles a Server Flush Buffers Request. This request writes any data
+ * buffered for an open file to the underlying file.
+ */
+void guac_rdpdr_fs_process_flush_buffers(guac_rdpdr_device* device,
+        wStream* input_stream, int file_id, int completion_id);
+
 /**
  * Handles a Server Drive Read Request. This request reads from a file.
  */
@@ -38,9 +38,9 @@
 #endif
 
 void guac_rdpdr_fs_process_query_directory_info(guac_rdpdr_device* device,
-        const char* entry_name, int file_id, int completion_id) {
+        const guac_rdp_fs_dir_entry* entry, int completion_id) {
 
-    guac_rdp_fs_file* file;
+    const char* entry_name = entry->name;
 
     wStream* output_stream;
     int length = guac_utf8_strlen(entry_name);
@@ -50,12 +50,7 @@ void guac_rdpdr_fs_process_query_directory_info(guac_rdpdr_device* device,
     guac_rdp_utf8_to_utf16((const unsigned char*) entry_name, length,
             (char*) utf16_entry_name, sizeof(utf16_entry_name));
 
-    /* Get file */
-    file = guac_rdp_fs_get_file((guac_rdp_fs*) device->data, file_id);
-    if (file == NULL)
-        return;
-
-    GUAC_RDP_DEBUG(2, "[file_id=%i (entry_name=\"%s\")]", file_id, entry_name);
+    GUAC_RDP_DEBUG(2, "[entry_name=\"%s\"]", entry_name);
 
     output_stream = guac_rdpdr_new_io_completion(device, completion_id,
             STATUS_SUCCESS, 4 + 64 + utf16_length + 2);
@@ -65,13 +60,13 @@ void guac_rdpdr_fs_process_query_directory_info(guac_rdpdr_device* device,
 
     Stream_Write_UINT32(output_stream, 0); /* NextEntryOffset */
     Stream_Write_UINT32(output_stream, 0); /* FileIndex */
-    Stream_Write_UINT64(output_stream, file->ctime); /* CreationTime */
-    Stream_Write_UINT64(output_stream, file->atime); /* LastAccessTime */
-    Stream_Write_UINT64(output_stream, file->mtime); /* LastWriteTime */
-    Stream_Write_UINT64(output_stream, file->mtime); /* ChangeTime */
-    Stream_Write_UINT64(output_stream, file->size);  /* EndOfFile */
-    Stream_Write_UINT64(output_stream, file->size);  /* AllocationSize */
-    Stream_Write_UINT32(output_stream, file->attributes);   /* FileAttributes */
+    Stream_Write_UINT64(output_stream, entry->ctime); /* CreationTime */
+    Stream_Write_UINT64(output_stream, entry->atime); /* LastAccessTime */
+    Stream_Write_UINT64(output_stream, entry->mtime); /* LastWriteTime */
+    Stream_Write_UINT64(output_stream, entry->mtime); /* ChangeTime */
+    Stream_Write_UINT64(output_stream, entry->size);  /* EndOfFile */
+    Stream_Write_UINT64(output_stream, entry->size);  /* AllocationSize */
+    Stream_Write_UINT32(output_stream, entry->attributes);  /* FileAttributes */
     Stream_Write_UINT32(output_stream, utf16_length+2); /* FileNameLength*/
 
     Stream_Write(output_stream, utf16_entry_name, utf16_length); /* FileName */
@@ -82,9 +77,9 @@ void guac_rdpdr_fs_process_query_directory_info(guac_rdpdr_device* device,
 }
 
 void guac_rdpdr_fs_process_query_full_directory_info(guac_rdpdr_device* device,
-        const char* entry_name, int file_id, int completion_id) {
+        const guac_rdp_fs_dir_entry* entry, int completion_id) {
 
-    guac_rdp_fs_file* file;
+    const char* entry_name = entry->name;
 
     wStream* output_stream;
     int length = guac_utf8_strlen(entry_name);
@@ -94,12 +89,7 @@ void guac_rdpdr_fs_process_query_full_directory_info(guac_rdpdr_device* device,
     guac_rdp_utf8_to_utf16((const unsigned char*) entry_name, length,
             (char*) utf16_entry_name, sizeof(utf16_entry_name));
 
-    /* Get file */
-    file = guac_rdp_fs_get_file((guac_rdp_fs*) device->data, file_id);
-    if (file == NULL)
-        return;
-
-    GUAC_RDP_DEBUG(2, "[file_id=%i (entry_name=\"%s\")]", file_id, entry_name);
+    GUAC_RDP_DEBUG(2, "[entry_name=\"%s\"]", entry_name);
 
     output_stream = guac_rdpdr_new_io_completion(device, completion_id,
             STATUS_SUCCESS, 4 + 68 + utf16_length + 2);
@@ -109,13 +99,13 @@ void guac_rdpdr_fs_process_query_full_directory_info(guac_rdpdr_device* device,
 
     Stream_Write_UINT32(output_stream, 0); /* NextEntryOffset */
     Stream_Write_UINT32(output_stream, 0); /* FileIndex */
-    Stream_Write_UINT64(output_stream, file->ctime); /* CreationTime */
-    Stream_Write_UINT64(output_stream, file->atime); /* LastAccessTime */
-    Stream_Write_UINT64(output_stream, file->mtime); /* LastWriteTime */
-    Stream_Write_UINT64(output_stream, file->mtime); /* ChangeTime */
-    Stream_Write_UINT64(output_stream, file->size);  /* EndOfFile */
-    Stream_Write_UINT64(output_stream, file->size);  /* AllocationSize */
-    Stream_Write_UINT32(output_stream, file->attributes);   /* FileAttributes */
+    Stream_Write_UINT64(output_stream, entry->ctime); /* CreationTime */
+    Stream_Write_UINT64(output_stream, entry->atime); /* LastAccessTime */
+    Stream_Write_UINT64(output_stream, entry->mtime); /* LastWriteTime */
+    Stream_Write_UINT64(output_stream, entry->mtime); /* ChangeTime */
+    Stream_Write_UINT64(output_stream, entry->size);  /* EndOfFile */
+    Stream_Write_UINT64(output_stream, entry->size);  /* AllocationSize */
+    Stream_Write_UINT32(output_stream, entry->attributes);  /* FileAttributes */
     Stream_Write_UINT32(output_stream, utf16_length+2); /* FileNameLength*/
     Stream_Write_UINT32(output_stream, 0); /* EaSize */
 
@@ -127,9 +117,9 @@ void guac_rdpdr_fs_process_query_full_directory_info(guac_rdpdr_device* device,
 }
 
 void guac_rdpdr_fs_process_query_both_directory_info(guac_rdpdr_device* device,
-        const char* entry_name, int file_id, int completion_id) {
+        const guac_rdp_fs_dir_entry* entry, int completion_id) {
 
-    guac_rdp_fs_file* file;
+    const char* entry_name = entry->name;
 
     wStream* output_stream;
     int length = guac_utf8_strlen(entry_name);
@@ -139,12 +129,7 @@ void guac_rdpdr_fs_process_query_both_directory_info(guac_rdpdr_device* device,
     guac_rdp_utf8_to_utf16((const unsigned char*) entry_name, length,
             (char*) utf16_entry_name, sizeof(utf16_entry_name));
 
-    /* Get file */
-    file = guac_rdp_fs_get_file((guac_rdp_fs*) device->data, file_id);
-    if (file == NULL)
-        return;
-
-    GUAC_RDP_DEBUG(2, "[file_id=%i (entry_name=\"%s\")]", file_id, entry_name);
+    GUAC_RDP_DEBUG(2, "[entry_name=\"%s\"]", entry_name);
 
     output_stream = guac_rdpdr_new_io_completion(device, completion_id,
             STATUS_SUCCESS, 4 + 69 + 24 + utf16_length + 2);
@@ -154,13 +139,13 @@ void guac_rdpdr_fs_process_query_both_directory_info(guac_rdpdr_device* device,
 
     Stream_Write_UINT32(output_stream, 0); /* NextEntryOffset */
     Stream_Write_UINT32(output_stream, 0); /* FileIndex */
-    Stream_Write_UINT64(output_stream, file->ctime); /* CreationTime */
-    Stream_Write_UINT64(output_stream, file->atime); /* LastAccessTime */
-    Stream_Write_UINT64(output_stream, file->mtime); /* LastWriteTime */
-    Stream_Write_UINT64(output_stream, file->mtime); /* ChangeTime */
-    Stream_Write_UINT64(output_stream, file->size);  /* EndOfFile */
-    Stream_Write_UINT64(output_stream, file->size);  /* AllocationSize */
-    Stream_Write_UINT32(output_stream, file->attributes);   /* FileAttributes */
+    Stream_Write_UINT64(output_stream, entry->ctime); /* CreationTime */
+    Stream_Write_UINT64(output_stream, entry->atime); /* LastAccessTime */
+    Stream_Write_UINT64(output_stream, entry->mtime); /* LastWriteTime */
+    Stream_Write_UINT64(output_stream, entry->mtime); /* ChangeTime */
+    Stream_Write_UINT64(output_stream, entry->size);  /* EndOfFile */
+    Stream_Write_UINT64(output_stream, entry->size);  /* AllocationSize */
+    Stream_Write_UINT32(output_stream, entry->attributes);  /* FileAttributes */
     Stream_Write_UINT32(output_stream, utf16_length+2); /* FileNameLength*/
     Stream_Write_UINT32(output_stream, 0); /* EaSize */
     Stream_Write_UINT8(output_stream,  0); /* ShortNameLength */
@@ -176,9 +161,9 @@ void guac_rdpdr_fs_process_query_both_directory_info(guac_rdpdr_device* device,
 }
 
 void guac_rdpdr_fs_process_query_names_info(guac_rdpdr_device* device,
-        const char* entry_name, int file_id, int completion_id) {
+        const guac_rdp_fs_dir_entry* entry, int completion_id) {
 
-    guac_rdp_fs_file* file;
+    const char* entry_name = entry->name;
 
     wStream* output_stream;
     int length = guac_utf8_strlen(entry_name);
@@ -188,12 +173,7 @@ void guac_rdpdr_fs_process_query_names_info(guac_rdpdr_device* device,
     guac_rdp_utf8_to_utf16((const unsigned char*) entry_name, length,
             (char*) utf16_entry_name, sizeof(utf16_entry_name));
 
-    /* Get file */
-    file = guac_rdp_fs_get_file((guac_rdp_fs*) device->data, file_id);
-    if (file == NULL)
-        return;
-
-    GUAC_RDP_DEBUG(2, "[file_id=%i (entry_name=\"%s\")]", file_id, entry_name);
+    GUAC_RDP_DEBUG(2, "[entry_name=\"%s\"]", entry_name);
 
     output_stream = guac_rdpdr_new_io_completion(device, completion_id,
             STATUS_SUCCESS, 4 + 12 + utf16_length + 2);
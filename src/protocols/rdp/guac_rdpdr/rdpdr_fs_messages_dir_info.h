@@ -35,6 +35,7 @@
 #include "config.h"
 
 #include "rdpdr_service.h"
+#include "rdp_fs.h"
 
 #ifdef ENABLE_WINPR
 #include <winpr/stream.h>
@@ -48,7 +49,7 @@
  * attributes."
  */
 void guac_rdpdr_fs_process_query_directory_info(guac_rdpdr_device* device,
-        const char* entry_name, int file_id, int completion_id);
+        const guac_rdp_fs_dir_entry* entry, int completion_id);
 
 /**
  * Processes a query request for FileFullDirectoryInformation. From the
@@ -56,7 +57,7 @@ void guac_rdpdr_fs_process_query_directory_info(guac_rdpdr_device* device,
  * attribute size."
  */
 void guac_rdpdr_fs_process_query_full_directory_info(guac_rdpdr_device* device,
-        const char* entry_name, int file_id, int completion_id);
+        const guac_rdp_fs_dir_entry* entry, int completion_id);
 
 /**
  * Processes a query request for FileBothDirectoryInformation. From the
@@ -64,14 +65,14 @@ void guac_rdpdr_fs_process_query_full_directory_info(guac_rdpdr_device* device,
  * extended attribute size and short name about a file or directory."
  */
 void guac_rdpdr_fs_process_query_both_directory_info(guac_rdpdr_device* device,
-        const char* entry_name, int file_id, int completion_id);
+        const guac_rdp_fs_dir_entry* entry, int completion_id);
 
 /**
  * Processes a query request for FileNamesInformation. From the documentation,
  * this is "detailed information on the names of files in a directory."
  */
 void guac_rdpdr_fs_process_query_names_info(guac_rdpdr_device* device,
-        const char* entry_name, int file_id, int completion_id);
+        const guac_rdp_fs_dir_entry* entry, int completion_id);
 
 #endif
 
@@ -25,6 +25,7 @@
 
 #include "client.h"
 #include "rdpdr_fs_messages.h"
+#include "rdpdr_io.h"
 #include "rdpdr_messages.h"
 #include "rdpdr_service.h"
 #include "rdp_fs.h"
@@ -79,6 +80,11 @@ static void guac_rdpdr_device_fs_iorequest_handler(guac_rdpdr_device* device,
             guac_rdpdr_fs_process_write(device, input_stream, file_id, completion_id);
             break;
 
+        /* Write buffered data of file */
+        case IRP_MJ_FLUSH_BUFFERS:
+            guac_rdpdr_fs_process_flush_buffers(device, input_stream, file_id, completion_id);
+            break;
+
         /* Device control request (Windows FSCTL_ control codes) */
         case IRP_MJ_DEVICE_CONTROL:
             guac_rdpdr_fs_process_device_control(device, input_stream, file_id, completion_id);
@@ -131,6 +137,11 @@ static void guac_rdpdr_device_fs_iorequest_handler(guac_rdpdr_device* device,
 }
 
 static void guac_rdpdr_device_fs_free_handler(guac_rdpdr_device* device) {
+
+    /* Stop I/O workers, if running */
+    if (device->io != NULL)
+        guac_rdpdr_io_free(device->io);
+
 }
 
 void guac_rdpdr_register_fs(guac_rdpdrPlugin* rdpdr) {
@@ -154,5 +165,9 @@ void guac_rdpdr_register_fs(guac_rdpdrPlugin* rdpdr) {
     /* Init data */
     device->data = data->filesystem;
 
+    /* Handle I/O requests asynchronously, such that slow filesystem access
+     * does not stall the RDP connection */
+    device->io = guac_rdpdr_io_alloc(device, GUAC_RDPDR_IO_MAX_WORKERS);
+
 }
 
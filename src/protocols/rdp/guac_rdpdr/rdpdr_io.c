@@ -0,0 +1,290 @@
+/*
+ * Copyright (C) 2013 Glyptodon LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "config.h"
+
+#include "rdpdr_io.h"
+#include "rdpdr_messages.h"
+#include "rdpdr_service.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include <guacamole/client.h>
+
+#ifdef ENABLE_WINPR
+#include <winpr/stream.h>
+#else
+#include "compat/winpr-stream.h"
+#endif
+
+/**
+ * Removes and returns the first queued request which may be handled now,
+ * or NULL if no such request exists. A request may not be handled while any
+ * other request for the same file is being handled or is queued ahead of it.
+ * Requests which are not ordered are never blocked and never block others.
+ * The pool lock must be held.
+ */
+static guac_rdpdr_io_request* __guac_rdpdr_io_next_request(guac_rdpdr_io* io) {
+
+    guac_rdpdr_io_request* previous = NULL;
+    guac_rdpdr_io_request* request;
+
+    for (request = io->first; request != NULL; request = request->next) {
+
+        guac_rdpdr_io_request* earlier;
+        int i;
+        int blocked = 0;
+
+        /* Skip if same file is being handled by any worker */
+        for (i=0; request->ordered && i<io->worker_count; i++) {
+            if (io->busy[i] && io->busy_file_id[i] == request->file_id) {
+                blocked = 1;
+                break;
+            }
+        }
+
+        /* Skip if earlier request for same file is still queued */
+        for (earlier = io->first;
+                request->ordered && !blocked && earlier != request;
+                earlier = earlier->next) {
+            if (earlier->ordered && earlier->file_id == request->file_id)
+                blocked = 1;
+        }
+
+        /* Remove first request which is not blocked */
+        if (!blocked) {
+
+            if (previous != NULL)
+                previous->next = request->next;
+            else
+                io->first = request->next;
+
+            if (io->last == request)
+                io->last = previous;
+
+            io->queued--;
+            return request;
+
+        }
+
+        previous = request;
+
+    }
+
+    return NULL;
+
+}
+
+/**
+ * Returns the index of the worker thread calling this function within the
+ * given pool.
+ */
+static int __guac_rdpdr_io_worker_index(guac_rdpdr_io* io) {
+
+    int i;
+    pthread_t self = pthread_self();
+
+    for (i=0; i<io->worker_count; i++) {
+        if (pthread_equal(io->workers[i], self))
+            break;
+    }
+
+    return i;
+
+}
+
+static void* guac_rdpdr_io_worker_thread(void* data) {
+
+    guac_rdpdr_io* io = (guac_rdpdr_io*) data;
+    guac_rdpdr_device* device = io->device;
+    int index;
+
+    pthread_mutex_lock(&(io->lock));
+
+    /* The thread ID is stored by pthread_create() before the lock is
+     * released by guac_rdpdr_io_alloc() */
+    index = __guac_rdpdr_io_worker_index(io);
+
+    while (!io->stopping) {
+
+        /* Wait for a request which can be handled */
+        guac_rdpdr_io_request* request = __guac_rdpdr_io_next_request(io);
+        if (request == NULL) {
+            pthread_cond_wait(&(io->request_available), &(io->lock));
+            continue;
+        }
+
+        /* Claim file for duration of request, if any */
+        io->busy[index] = request->ordered;
+        io->busy_file_id[index] = request->file_id;
+        pthread_cond_signal(&(io->space_available));
+        pthread_mutex_unlock(&(io->lock));
+
+        /* Handle request without blocking the channel */
+        device->iorequest_handler(device, request->input_stream,
+                request->file_id, request->completion_id,
+                request->major_func, request->minor_func);
+
+        Stream_Free(request->input_stream, TRUE);
+        free(request);
+
+        /* Release file, allowing later requests for it to proceed */
+        pthread_mutex_lock(&(io->lock));
+        io->busy[index] = 0;
+        pthread_cond_broadcast(&(io->request_available));
+
+    }
+
+    pthread_mutex_unlock(&(io->lock));
+    return NULL;
+
+}
+
+guac_rdpdr_io* guac_rdpdr_io_alloc(guac_rdpdr_device* device,
+        int worker_count) {
+
+    int i;
+    guac_rdpdr_io* io = malloc(sizeof(guac_rdpdr_io));
+
+    /* Limit number of workers to available storage */
+    if (worker_count > GUAC_RDPDR_IO_MAX_WORKERS)
+        worker_count = GUAC_RDPDR_IO_MAX_WORKERS;
+
+    io->device = device;
+    io->worker_count = worker_count;
+    io->first = NULL;
+    io->last = NULL;
+    io->queued = 0;
+    io->stopping = 0;
+
+    pthread_mutex_init(&(io->lock), NULL);
+    pthread_cond_init(&(io->request_available), NULL);
+    pthread_cond_init(&(io->space_available), NULL);
+
+    /* Start workers, holding lock until all thread IDs are known */
+    pthread_mutex_lock(&(io->lock));
+    for (i=0; i<io->worker_count; i++) {
+
+        io->busy[i] = 0;
+
+        if (pthread_create(&(io->workers[i]), NULL,
+                    guac_rdpdr_io_worker_thread, io)) {
+
+            guac_client_log_error(device->rdpdr->client,
+                    "Unable to start I/O worker for device %i (%s)",
+                    device->device_id, device->device_name);
+
+            /* Stop any workers already started */
+            io->stopping = 1;
+            pthread_cond_broadcast(&(io->request_available));
+            pthread_mutex_unlock(&(io->lock));
+
+            while (--i >= 0)
+                pthread_join(io->workers[i], NULL);
+
+            pthread_cond_destroy(&(io->space_available));
+            pthread_cond_destroy(&(io->request_available));
+            pthread_mutex_destroy(&(io->lock));
+            free(io);
+            return NULL;
+
+        }
+
+    }
+    pthread_mutex_unlock(&(io->lock));
+
+    return io;
+
+}
+
+void guac_rdpdr_io_submit(guac_rdpdr_io* io, wStream* input_stream,
+        int file_id, int completion_id, int major_func, int minor_func) {
+
+    int length = Stream_Length(input_stream)
+               - Stream_GetPosition(input_stream);
+
+    /* Copy remaining request data, as the input stream is reused */
+    guac_rdpdr_io_request* request = malloc(sizeof(guac_rdpdr_io_request));
+    request->input_stream = Stream_New(NULL, length > 0 ? length : 1);
+    Stream_Write(request->input_stream, Stream_Pointer(input_stream), length);
+    Stream_SetPosition(request->input_stream, 0);
+
+    request->file_id       = file_id;
+    request->ordered       = (major_func != IRP_MJ_CREATE);
+    request->completion_id = completion_id;
+    request->major_func    = major_func;
+    request->minor_func    = minor_func;
+    request->next          = NULL;
+
+    pthread_mutex_lock(&(io->lock));
+
+    /* Wait for space in queue */
+    while (io->queued >= GUAC_RDPDR_IO_QUEUE_SIZE && !io->stopping)
+        pthread_cond_wait(&(io->space_available), &(io->lock));
+
+    /* Append to queue */
+    if (io->last != NULL)
+        io->last->next = request;
+    else
+        io->first = request;
+
+    io->last = request;
+    io->queued++;
+
+    pthread_cond_signal(&(io->request_available));
+    pthread_mutex_unlock(&(io->lock));
+
+}
+
+void guac_rdpdr_io_free(guac_rdpdr_io* io) {
+
+    int i;
+    guac_rdpdr_io_request* request;
+
+    /* Signal all workers to stop */
+    pthread_mutex_lock(&(io->lock));
+    io->stopping = 1;
+    pthread_cond_broadcast(&(io->request_available));
+    pthread_cond_broadcast(&(io->space_available));
+    pthread_mutex_unlock(&(io->lock));
+
+    /* Wait for requests currently being handled */
+    for (i=0; i<io->worker_count; i++)
+        pthread_join(io->workers[i], NULL);
+
+    /* Discard any remaining requests */
+    request = io->first;
+    while (request != NULL) {
+        guac_rdpdr_io_request* next = request->next;
+        Stream_Free(request->input_stream, TRUE);
+        free(request);
+        request = next;
+    }
+
+    pthread_cond_destroy(&(io->space_available));
+    pthread_cond_destroy(&(io->request_available));
+    pthread_mutex_destroy(&(io->lock));
+    free(io);
+
+}
+
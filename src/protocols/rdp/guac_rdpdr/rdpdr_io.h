@@ -0,0 +1,198 @@
+/*
+ * Copyright (C) 2013 Glyptodon LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef __GUAC_RDPDR_IO_H
+#define __GUAC_RDPDR_IO_H
+
+#include "config.h"
+
+#include "rdpdr_service.h"
+
+#include <pthread.h>
+
+#ifdef ENABLE_WINPR
+#include <winpr/stream.h>
+#else
+#include "compat/winpr-stream.h"
+#endif
+
+/**
+ * The maximum number of worker threads servicing the I/O requests of each
+ * device.
+ */
+#define GUAC_RDPDR_IO_MAX_WORKERS 4
+
+/**
+ * The maximum number of I/O requests which may be queued for a single device
+ * at any one time. Once this limit is reached, the channel blocks until a
+ * worker becomes available.
+ */
+#define GUAC_RDPDR_IO_QUEUE_SIZE 64
+
+/**
+ * A single I/O request which has been received from the RDP server but not
+ * yet completed.
+ */
+typedef struct guac_rdpdr_io_request {
+
+    /**
+     * The remainder of the received request, following the common
+     * DR_DEVICE_IOREQUEST header. This stream is owned by the request.
+     */
+    wStream* input_stream;
+
+    /**
+     * The ID of the file this request applies to. Requests with the same
+     * file ID are always handled in the order received, unless the request
+     * is not ordered.
+     */
+    int file_id;
+
+    /**
+     * Non-zero if this request applies to an open file and must be ordered
+     * relative to other requests for that file, zero otherwise. Requests
+     * which open files (IRP_MJ_CREATE) do not yet have a file, and their
+     * file ID is meaningless.
+     */
+    int ordered;
+
+    /**
+     * The completion ID which must be used in the response to this request.
+     */
+    int completion_id;
+
+    /**
+     * The major function of this request (IRP_MJ_*).
+     */
+    int major_func;
+
+    /**
+     * The minor function of this request (IRP_MN_*).
+     */
+    int minor_func;
+
+    /**
+     * The next request in the queue, or NULL if this is the last request.
+     */
+    struct guac_rdpdr_io_request* next;
+
+} guac_rdpdr_io_request;
+
+/**
+ * Pool of worker threads which invokes the I/O request handler of a device
+ * outside the RDPDR channel callback, such that slow I/O does not block the
+ * rest of the RDP connection.
+ */
+struct guac_rdpdr_io {
+
+    /**
+     * The device whose requests are being handled.
+     */
+    guac_rdpdr_device* device;
+
+    /**
+     * Lock which guards all queue and worker state.
+     */
+    pthread_mutex_t lock;
+
+    /**
+     * Condition signalled whenever a request may have become available to
+     * an idle worker.
+     */
+    pthread_cond_t request_available;
+
+    /**
+     * Condition signalled whenever space becomes available within the queue.
+     */
+    pthread_cond_t space_available;
+
+    /**
+     * The first request in the queue, or NULL if the queue is empty.
+     */
+    guac_rdpdr_io_request* first;
+
+    /**
+     * The last request in the queue, or NULL if the queue is empty.
+     */
+    guac_rdpdr_io_request* last;
+
+    /**
+     * The number of requests currently queued.
+     */
+    int queued;
+
+    /**
+     * The number of worker threads within the pool.
+     */
+    int worker_count;
+
+    /**
+     * Whether each worker is currently handling an ordered request.
+     */
+    int busy[GUAC_RDPDR_IO_MAX_WORKERS];
+
+    /**
+     * The file ID of the ordered request currently being handled by each busy
+     * worker.
+     */
+    int busy_file_id[GUAC_RDPDR_IO_MAX_WORKERS];
+
+    /**
+     * Non-zero if the pool is being freed and all workers must stop.
+     */
+    int stopping;
+
+    /**
+     * All worker threads.
+     */
+    pthread_t workers[GUAC_RDPDR_IO_MAX_WORKERS];
+
+};
+
+/**
+ * Allocates a new pool of the given number of worker threads, which will
+ * handle I/O requests for the given device by invoking its I/O request
+ * handler. A pool having a single worker handles all requests strictly in
+ * the order received. Returns NULL if the worker threads cannot be created.
+ */
+guac_rdpdr_io* guac_rdpdr_io_alloc(guac_rdpdr_device* device,
+        int worker_count);
+
+/**
+ * Queues the remainder of the given I/O request for handling by the given
+ * pool. The data remaining within the input stream is copied, and the stream
+ * may be reused once this function returns. If the queue is full, this
+ * function blocks until space is available.
+ */
+void guac_rdpdr_io_submit(guac_rdpdr_io* io, wStream* input_stream,
+        int file_id, int completion_id, int major_func, int minor_func);
+
+/**
+ * Stops all workers of the given pool, waiting for any requests currently
+ * being handled, and frees the pool. Requests which are still queued are
+ * discarded.
+ */
+void guac_rdpdr_io_free(guac_rdpdr_io* io);
+
+#endif
+
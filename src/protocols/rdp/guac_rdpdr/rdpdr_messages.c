@@ -23,6 +23,7 @@
 #include "config.h"
 
 #include "client.h"
+#include "rdpdr_io.h"
 #include "rdpdr_messages.h"
 #include "rdpdr_printer.h"
 #include "rdpdr_service.h"
@@ -226,10 +227,17 @@ void guac_rdpdr_process_device_iorequest(guac_rdpdrPlugin* rdpdr, wStream* input
     /* If printer, run printer handlers */
     if (device_id >= 0 && device_id < rdpdr->devices_registered) {
 
-        /* Call handler on device */
         guac_rdpdr_device* device = &(rdpdr->devices[device_id]);
-        device->iorequest_handler(device, input_stream,
-                file_id, completion_id, major_func, minor_func);
+
+        /* Queue for handling by device workers, if any */
+        if (device->io != NULL)
+            guac_rdpdr_io_submit(device->io, input_stream,
+                    file_id, completion_id, major_func, minor_func);
+
+        /* Otherwise, call handler on device directly */
+        else
+            device->iorequest_handler(device, input_stream,
+                    file_id, completion_id, major_func, minor_func);
 
     }
 
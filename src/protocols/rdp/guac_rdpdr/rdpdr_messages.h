@@ -175,6 +175,7 @@
 #define IRP_MJ_CLOSE                    0x00000002
 #define IRP_MJ_READ                     0x00000003
 #define IRP_MJ_WRITE                    0x00000004
+#define IRP_MJ_FLUSH_BUFFERS            0x00000009
 #define IRP_MJ_DEVICE_CONTROL           0x0000000E
 #define IRP_MJ_QUERY_VOLUME_INFORMATION 0x0000000A
 #define IRP_MJ_SET_VOLUME_INFORMATION   0x0000000B
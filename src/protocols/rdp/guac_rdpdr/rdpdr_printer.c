@@ -23,16 +23,21 @@
 #include "config.h"
 
 #include "client.h"
+#include "debug.h"
+#include "rdpdr_io.h"
 #include "rdpdr_messages.h"
 #include "rdpdr_printer.h"
 #include "rdpdr_service.h"
 #include "rdp_status.h"
 
 #include <errno.h>
+#include <fcntl.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 #include <freerdp/utils/svc_plugin.h>
 #include <guacamole/protocol.h>
+#include <guacamole/timestamp.h>
 
 #ifdef ENABLE_WINPR
 #include <winpr/stream.h>
@@ -66,9 +71,11 @@ static void* guac_rdpdr_print_filter_output_thread(void* data) {
     char buffer[8192];
 
     /* Write all output as blobs */
-    while ((length = read(printer_data->printer_output, buffer, sizeof(buffer))) > 0)
+    while ((length = read(printer_data->printer_output, buffer, sizeof(buffer))) > 0) {
         guac_protocol_send_blob(device->rdpdr->client->socket,
                 printer_data->stream, buffer, length);
+        printer_data->bytes_sent += length;
+    }
 
     /* Log any error */
     if (length < 0)
@@ -78,9 +85,14 @@ static void* guac_rdpdr_print_filter_output_thread(void* data) {
 
 }
 
-static int guac_rdpdr_create_print_process(guac_rdpdr_device* device) {
-
-    guac_rdpdr_printer_data* printer_data = (guac_rdpdr_printer_data*) device->data;
+/**
+ * Starts a new PDF filter process, storing its PID and our side of its
+ * STDIN/STDOUT in the given locations. The stored file descriptors are
+ * close-on-exec, such that they are not inherited by other filter
+ * processes. Returns zero on success, non-zero on failure.
+ */
+static int guac_rdpdr_spawn_print_filter(guac_rdpdr_device* device,
+        pid_t* pid, int* input, int* output) {
 
     int child_pid;
     int stdin_pipe[2];
@@ -96,25 +108,15 @@ static int guac_rdpdr_create_print_process(guac_rdpdr_device* device) {
     /* Create STDOUT pipe */
     if (pipe(stdout_pipe)) {
         guac_client_log_error(device->rdpdr->client,
-                "Unable to create STDIN pipe for PDF filter process: %s", strerror(errno));
+                "Unable to create STDOUT pipe for PDF filter process: %s", strerror(errno));
         close(stdin_pipe[0]);
         close(stdin_pipe[1]);
         return 1;
     }
 
-    /* Store our side of stdin/stdout */
-    printer_data->printer_input  = stdin_pipe[1];
-    printer_data->printer_output = stdout_pipe[0];
-
-    /* Start output thread */
-    if (pthread_create(&(printer_data->printer_output_thread), NULL, guac_rdpdr_print_filter_output_thread, device)) {
-        guac_client_log_error(device->rdpdr->client, "Unable to fork PDF filter process");
-        close(stdin_pipe[0]);
-        close(stdin_pipe[1]);
-        close(stdout_pipe[0]);
-        close(stdout_pipe[1]);
-        return 1;
-    }
+    /* Do not leak our side of the pipes into any child process */
+    fcntl(stdin_pipe[1], F_SETFD, FD_CLOEXEC);
+    fcntl(stdout_pipe[0], F_SETFD, FD_CLOEXEC);
 
     /* Fork child process */
     child_pid = fork();
@@ -133,10 +135,6 @@ static int guac_rdpdr_create_print_process(guac_rdpdr_device* device) {
     /* Child process */
     if (child_pid == 0) {
 
-        /* Close unneeded ends of pipe */
-        close(stdin_pipe[1]);
-        close(stdout_pipe[0]);
-
         /* Reassign file descriptors as STDIN/STDOUT */
         dup2(stdin_pipe[0], STDIN_FILENO);
         dup2(stdout_pipe[1], STDOUT_FILENO);
@@ -159,6 +157,90 @@ static int guac_rdpdr_create_print_process(guac_rdpdr_device* device) {
     /* Close unneeded ends of pipe */
     close(stdin_pipe[0]);
     close(stdout_pipe[1]);
+
+    /* Store our side of stdin/stdout */
+    *pid    = child_pid;
+    *input  = stdin_pipe[1];
+    *output = stdout_pipe[0];
+    return 0;
+
+}
+
+/**
+ * Stops the idle filter process, if any, waiting for it to exit.
+ */
+static void guac_rdpdr_stop_spare_print_filter(guac_rdpdr_device* device) {
+
+    guac_rdpdr_printer_data* printer_data = (guac_rdpdr_printer_data*) device->data;
+
+    if (printer_data->spare_pid == -1)
+        return;
+
+    /* Filter exits upon reading EOF */
+    close(printer_data->spare_input);
+    close(printer_data->spare_output);
+    waitpid(printer_data->spare_pid, NULL, 0);
+
+    printer_data->spare_pid = -1;
+
+}
+
+/**
+ * Starts an idle filter process in advance of the next print job, if no such
+ * process is already running. Only one idle filter is kept per printer, thus
+ * at most two filter processes exist per connection.
+ */
+static void guac_rdpdr_start_spare_print_filter(guac_rdpdr_device* device) {
+
+    guac_rdpdr_printer_data* printer_data = (guac_rdpdr_printer_data*) device->data;
+
+    if (printer_data->spare_pid != -1)
+        return;
+
+    if (guac_rdpdr_spawn_print_filter(device, &(printer_data->spare_pid),
+                &(printer_data->spare_input), &(printer_data->spare_output)))
+        printer_data->spare_pid = -1;
+
+}
+
+static int guac_rdpdr_create_print_process(guac_rdpdr_device* device) {
+
+    guac_rdpdr_printer_data* printer_data = (guac_rdpdr_printer_data*) device->data;
+
+    /* Discard idle filter if it has exited unexpectedly */
+    if (printer_data->spare_pid != -1
+            && waitpid(printer_data->spare_pid, NULL, WNOHANG) != 0) {
+        close(printer_data->spare_input);
+        close(printer_data->spare_output);
+        printer_data->spare_pid = -1;
+    }
+
+    /* Use idle filter if available, starting a new filter otherwise */
+    if (printer_data->spare_pid != -1) {
+        GUAC_RDP_DEBUG(2, "Using idle PDF filter process PID=%i",
+                printer_data->spare_pid);
+        printer_data->printer_pid    = printer_data->spare_pid;
+        printer_data->printer_input  = printer_data->spare_input;
+        printer_data->printer_output = printer_data->spare_output;
+        printer_data->spare_pid = -1;
+    }
+
+    else if (guac_rdpdr_spawn_print_filter(device,
+                &(printer_data->printer_pid), &(printer_data->printer_input),
+                &(printer_data->printer_output)))
+        return 1;
+
+    /* Start output thread */
+    printer_data->bytes_sent = 0;
+    if (pthread_create(&(printer_data->printer_output_thread), NULL, guac_rdpdr_print_filter_output_thread, device)) {
+        guac_client_log_error(device->rdpdr->client, "Unable to start PDF filter output thread");
+        close(printer_data->printer_input);
+        close(printer_data->printer_output);
+        waitpid(printer_data->printer_pid, NULL, 0);
+        printer_data->printer_pid = -1;
+        return 1;
+    }
+
     return 0;
 
 }
@@ -174,6 +256,7 @@ void guac_rdpdr_process_print_job_create(guac_rdpdr_device* device,
 
     /* No bytes received yet */
     printer_data->bytes_received = 0;
+    printer_data->job_start = guac_timestamp_current();
     Stream_Write_UINT32(output_stream, 0); /* fileId */
 
     svc_plugin_send((rdpSvcPlugin*) device->rdpdr, output_stream);
@@ -239,18 +322,22 @@ void guac_rdpdr_process_print_job_write(guac_rdpdr_device* device,
         guac_protocol_send_file(device->rdpdr->client->socket,
                 printer_data->stream, "application/pdf", filename);
 
-        /* Start print process */
-        if (guac_rdpdr_create_print_process(device) != 0) {
-            status = STATUS_DEVICE_OFF_LINE;
-            length = 0;
-        }
+        /* Start print process, failing the job if impossible. The job is
+         * not retried for later writes. */
+        guac_rdpdr_create_print_process(device);
 
     }
 
     printer_data->bytes_received += length;
 
-    /* If not yet failed, write received data */
-    if (status == 0) {
+    /* Fail if print process could not be started */
+    if (printer_data->printer_pid == -1) {
+        status = STATUS_DEVICE_OFF_LINE;
+        length = 0;
+    }
+
+    /* Otherwise, write received data */
+    else {
 
         /* Write data to printer, translate output for RDP */
         length = write(printer_data->printer_input, buffer, length);
@@ -283,19 +370,34 @@ void guac_rdpdr_process_print_job_close(guac_rdpdr_device* device,
 
     Stream_Write_UINT32(output_stream, 0); /* padding*/
 
-    /* Close input and wait for output thread to finish */
-    close(printer_data->printer_input);
-    pthread_join(printer_data->printer_output_thread, NULL);
+    /* Finish conversion, if the filter was started */
+    if (printer_data->printer_pid != -1) {
+
+        /* Close input and wait for output thread to finish */
+        close(printer_data->printer_input);
+        pthread_join(printer_data->printer_output_thread, NULL);
+
+        /* Close file descriptors and reap filter */
+        close(printer_data->printer_output);
+        waitpid(printer_data->printer_pid, NULL, 0);
+        printer_data->printer_pid = -1;
 
-    /* Close file descriptors */
-    close(printer_data->printer_output);
+        guac_client_log_info(device->rdpdr->client, "Print job closed: "
+                "%i bytes in, %i bytes out, converted in %i ms",
+                printer_data->bytes_received, printer_data->bytes_sent,
+                (int) (guac_timestamp_current() - printer_data->job_start));
 
-    /* Close file */
-    guac_client_log_info(device->rdpdr->client, "Print job closed");
-    guac_protocol_send_end(device->rdpdr->client->socket, printer_data->stream);
+    }
+
+    /* Close file, if begun */
+    if (printer_data->bytes_received > 0)
+        guac_protocol_send_end(device->rdpdr->client->socket, printer_data->stream);
 
     svc_plugin_send((rdpSvcPlugin*) device->rdpdr, output_stream);
 
+    /* Prepare filter for next job outside of the job itself */
+    guac_rdpdr_start_spare_print_filter(device);
+
 }
 
 static void guac_rdpdr_device_printer_announce_handler(guac_rdpdr_device* device,
@@ -354,9 +456,18 @@ static void guac_rdpdr_device_printer_iorequest_handler(guac_rdpdr_device* devic
 }
 
 static void guac_rdpdr_device_printer_free_handler(guac_rdpdr_device* device) {
+
     guac_rdpdr_printer_data* printer_data = (guac_rdpdr_printer_data*) device->data;
+
+    /* Stop I/O worker, if running */
+    if (device->io != NULL)
+        guac_rdpdr_io_free(device->io);
+
+    guac_rdpdr_stop_spare_print_filter(device);
+
     guac_client_free_stream(device->rdpdr->client, printer_data->stream);
     free(device->data);
+
 }
 
 void guac_rdpdr_register_printer(guac_rdpdrPlugin* rdpdr) {
@@ -380,7 +491,14 @@ void guac_rdpdr_register_printer(guac_rdpdrPlugin* rdpdr) {
     /* Init data */
     printer_data = malloc(sizeof(guac_rdpdr_printer_data));
     printer_data->stream = guac_client_alloc_stream(rdpdr->client);
+    printer_data->printer_pid = -1;
+    printer_data->spare_pid = -1;
     device->data = printer_data;
 
+    /* Convert print jobs without blocking the channel. A single worker
+     * preserves the order of all requests, while the bounded request queue
+     * applies backpressure to the RDP server if conversion falls behind. */
+    device->io = guac_rdpdr_io_alloc(device, 1);
+
 }
 
@@ -26,7 +26,12 @@
 
 #include "config.h"
 
+#include <pthread.h>
+#include <sys/types.h>
+
 #include <freerdp/utils/svc_plugin.h>
+#include <guacamole/stream.h>
+#include <guacamole/timestamp.h>
 
 #ifdef ENABLE_WINPR
 #include <winpr/stream.h>
@@ -44,6 +49,12 @@ typedef struct guac_rdpdr_printer_data {
      */
     guac_stream* stream;
 
+    /**
+     * The PID of the filter process converting the current print job, or -1
+     * if no filter process is running for the current job.
+     */
+    pid_t printer_pid;
+
     /**
      * File descriptor that should be written to when sending documents to the
      * printer.
@@ -61,11 +72,38 @@ typedef struct guac_rdpdr_printer_data {
      */
     pthread_t printer_output_thread;
 
+    /**
+     * The PID of an idle filter process which has already been started in
+     * advance of the next print job, or -1 if no such process exists.
+     */
+    pid_t spare_pid;
+
+    /**
+     * File descriptor of the STDIN of the idle filter process.
+     */
+    int spare_input;
+
+    /**
+     * File descriptor of the STDOUT of the idle filter process.
+     */
+    int spare_output;
+
     /**
      * The number of bytes received in the current print job.
      */
     int bytes_received;
 
+    /**
+     * The number of bytes of filter output sent to the Guacamole client for
+     * the current print job.
+     */
+    int bytes_sent;
+
+    /**
+     * The time at which the current print job was created.
+     */
+    guac_timestamp job_start;
+
 } guac_rdpdr_printer_data;
 
 /**
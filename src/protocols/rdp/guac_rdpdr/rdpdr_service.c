@@ -240,8 +240,16 @@ void guac_rdpdr_start_download(guac_rdpdr_device* device, const char* path) {
         int i;
         char c;
 
-        /* Associate stream with transfer status */
+        /* Abort download if no streams remain */
         guac_stream* stream = guac_client_alloc_stream(client);
+        if (stream == NULL) {
+            guac_client_log_error(client, "Unable to download \"%s\": "
+                    "too many streams", path);
+            guac_rdp_fs_close((guac_rdp_fs*) device->data, file_id);
+            return;
+        }
+
+        /* Associate stream with transfer status */
         stream->data = rdp_stream = malloc(sizeof(guac_rdp_stream));
         stream->ack_handler = guac_rdp_download_ack_handler;
         rdp_stream->type = GUAC_RDP_DOWNLOAD_STREAM;
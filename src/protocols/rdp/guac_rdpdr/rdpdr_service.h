@@ -44,6 +44,7 @@
 
 typedef struct guac_rdpdrPlugin guac_rdpdrPlugin;
 typedef struct guac_rdpdr_device guac_rdpdr_device;
+typedef struct guac_rdpdr_io guac_rdpdr_io;
 
 /**
  * Handler for client device list announce. Each implementing device must write
@@ -104,6 +105,13 @@ struct guac_rdpdr_device {
      */
     void* data;
 
+    /**
+     * Pool of worker threads which handles the I/O requests of this device
+     * asynchronously, or NULL if I/O requests are handled directly within the
+     * channel callback.
+     */
+    guac_rdpdr_io* io;
+
 };
 
 /**
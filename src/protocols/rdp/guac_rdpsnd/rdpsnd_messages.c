@@ -26,7 +26,6 @@
 #include "rdpsnd_messages.h"
 #include "rdpsnd_service.h"
 
-#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -34,6 +33,7 @@
 #include <freerdp/utils/svc_plugin.h>
 #include <guacamole/audio.h>
 #include <guacamole/client.h>
+#include <guacamole/timestamp.h>
 
 #ifdef ENABLE_WINPR
 #include <winpr/stream.h>
@@ -57,9 +57,6 @@ void guac_rdpsnd_formats_handler(guac_rdpsndPlugin* rdpsnd,
     int output_body_size;
     unsigned char* output_stream_end;
 
-    rdp_guac_client_data* guac_client_data =
-        (rdp_guac_client_data*) audio->client->data;
-
     /* Format header */
     Stream_Seek(input_stream, 14);
     Stream_Read_UINT16(input_stream, server_format_count);
@@ -173,7 +170,6 @@ void guac_rdpsnd_formats_handler(guac_rdpsndPlugin* rdpsnd,
     Stream_SetPointer(output_stream, output_stream_end);
 
     /* Send accepted formats */
-    pthread_mutex_lock(&(guac_client_data->rdp_lock));
     svc_plugin_send((rdpSvcPlugin*)rdpsnd, output_stream);
 
     /* If version greater than 6, must send Quality Mode PDU */
@@ -190,8 +186,6 @@ void guac_rdpsnd_formats_handler(guac_rdpsndPlugin* rdpsnd,
         svc_plugin_send((rdpSvcPlugin*)rdpsnd, output_stream);
     }
 
-    pthread_mutex_unlock(&(guac_client_data->rdp_lock));
-
 }
 
 /* server is getting a feel of the round trip time */
@@ -202,9 +196,6 @@ void guac_rdpsnd_training_handler(guac_rdpsndPlugin* rdpsnd,
     int data_size;
     wStream* output_stream;
 
-    rdp_guac_client_data* guac_client_data =
-        (rdp_guac_client_data*) audio->client->data;
-
     /* Read timestamp and data size */
     Stream_Read_UINT16(input_stream, rdpsnd->server_timestamp);
     Stream_Read_UINT16(input_stream, data_size);
@@ -217,9 +208,7 @@ void guac_rdpsnd_training_handler(guac_rdpsndPlugin* rdpsnd,
     Stream_Write_UINT16(output_stream, rdpsnd->server_timestamp);
     Stream_Write_UINT16(output_stream, data_size);
 
-    pthread_mutex_lock(&(guac_client_data->rdp_lock));
     svc_plugin_send((rdpSvcPlugin*) rdpsnd, output_stream);
-    pthread_mutex_unlock(&(guac_client_data->rdp_lock));
 
 }
 
@@ -229,6 +218,8 @@ void guac_rdpsnd_wave_info_handler(guac_rdpsndPlugin* rdpsnd,
 
     unsigned char buffer[4];
     int format;
+    int previous_timestamp = rdpsnd->server_timestamp;
+    guac_timestamp timestamp;
 
     /* Read wave information */
     Stream_Read_UINT16(input_stream, rdpsnd->server_timestamp);
@@ -253,6 +244,18 @@ void guac_rdpsnd_wave_info_handler(guac_rdpsndPlugin* rdpsnd,
             rdpsnd->formats[format].channels,
             rdpsnd->formats[format].bps);
 
+    /* Timestamp packet by advancing local clock as far as server clock,
+     * mapping the first packet received to the current time */
+    timestamp = guac_timestamp_current();
+    if (rdpsnd->server_clock_valid) {
+        int elapsed = (rdpsnd->server_timestamp - previous_timestamp) & 0xFFFF;
+        timestamp = rdpsnd->server_clock + elapsed;
+    }
+
+    /* Map server timestamp to local time of packet */
+    rdpsnd->server_clock = guac_audio_stream_set_timestamp(audio, timestamp);
+    rdpsnd->server_clock_valid = TRUE;
+
     /* Write initial 4 bytes of data */
     guac_audio_stream_write_pcm(audio, buffer, 4);
 
@@ -264,9 +267,6 @@ void guac_rdpsnd_wave_handler(guac_rdpsndPlugin* rdpsnd,
 
     rdpSvcPlugin* plugin = (rdpSvcPlugin*)rdpsnd;
 
-    rdp_guac_client_data* guac_client_data =
-        (rdp_guac_client_data*) audio->client->data;
-
     /* Wave Confirmation PDU */
     wStream* output_stream = Stream_New(NULL, 8);
 
@@ -281,14 +281,14 @@ void guac_rdpsnd_wave_handler(guac_rdpsndPlugin* rdpsnd,
     Stream_Write_UINT8(output_stream, SNDC_WAVECONFIRM);
     Stream_Write_UINT8(output_stream, 0);
     Stream_Write_UINT16(output_stream, 4);
-    Stream_Write_UINT16(output_stream, rdpsnd->server_timestamp);
+    /* Report time of playback, including any client lag */
+    Stream_Write_UINT16(output_stream,
+            (rdpsnd->server_timestamp + audio->lag) & 0xFFFF);
     Stream_Write_UINT8(output_stream, rdpsnd->waveinfo_block_number);
     Stream_Write_UINT8(output_stream, 0);
 
     /* Send Wave Confirmation PDU */
-    pthread_mutex_lock(&(guac_client_data->rdp_lock));
     svc_plugin_send(plugin, output_stream);
-    pthread_mutex_unlock(&(guac_client_data->rdp_lock));
 
     /* We no longer expect to receive wave data */
     rdpsnd->next_pdu_is_wave = FALSE;
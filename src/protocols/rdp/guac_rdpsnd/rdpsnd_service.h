@@ -28,6 +28,7 @@
 
 #include <freerdp/utils/svc_plugin.h>
 #include <guacamole/audio.h>
+#include <guacamole/timestamp.h>
 
 #ifdef ENABLE_WINPR
 #include <winpr/stream.h>
@@ -105,6 +106,17 @@ typedef struct guac_rdpsndPlugin {
      */
     int server_timestamp;
 
+    /**
+     * Whether server_clock has been set by a previous WaveInfo PDU.
+     */
+    int server_clock_valid;
+
+    /**
+     * The local time at which the audio of the last WaveInfo PDU was to be
+     * played, corresponding to server_timestamp.
+     */
+    guac_timestamp server_clock;
+
     /**
      * All formats agreed upon by server and client during the initial format
      * exchange. All of these formats will be PCM, which is the only format
@@ -24,6 +24,10 @@
 
 #include "client.h"
 #include "rdp_bitmap.h"
+#include "rdp_cache_policy.h"
+#include "rdp_decoder.h"
+#include "rdp_input.h"
+#include "rdp_offscreen.h"
 
 #include <pthread.h>
 #include <stdio.h>
@@ -46,6 +50,7 @@
 void guac_rdp_cache_bitmap(rdpContext* context, rdpBitmap* bitmap) {
 
     guac_client* client = ((rdp_freerdp_context*) context)->client;
+    rdp_guac_client_data* client_data = (rdp_guac_client_data*) client->data;
     guac_socket* socket = client->socket; 
 
     /* Allocate buffer */
@@ -71,6 +76,35 @@ void guac_rdp_cache_bitmap(rdpContext* context, rdpBitmap* bitmap) {
     /* Store buffer reference in bitmap */
     ((guac_rdp_bitmap*) bitmap)->layer = buffer;
 
+    /* Account for buffer, evicting other bitmaps if necessary */
+    guac_rdp_cache_policy_add(client_data->cache_policy,
+            (guac_rdp_bitmap*) bitmap);
+
+}
+
+/**
+ * Initializes the Guacamole-specific state of the given bitmap, which must
+ * already contain 32-bit RGB image data, if any.
+ */
+static void __guac_rdp_bitmap_init(rdpBitmap* bitmap) {
+
+    /* No corresponding layer yet - caching is deferred. */
+    ((guac_rdp_bitmap*) bitmap)->layer = NULL;
+
+    /* Start at zero usage */
+    ((guac_rdp_bitmap*) bitmap)->used = 0;
+    ((guac_rdp_bitmap*) bitmap)->drawn = 0;
+    ((guac_rdp_bitmap*) bitmap)->surface = 0;
+
+    /* Not yet cached */
+    ((guac_rdp_bitmap*) bitmap)->next = NULL;
+    ((guac_rdp_bitmap*) bitmap)->prev = NULL;
+
+    /* Not yet a server-side surface */
+    ((guac_rdp_bitmap*) bitmap)->shadow = NULL;
+    ((guac_rdp_bitmap*) bitmap)->offscreen_next = NULL;
+    ((guac_rdp_bitmap*) bitmap)->offscreen_prev = NULL;
+
 }
 
 void guac_rdp_bitmap_new(rdpContext* context, rdpBitmap* bitmap) {
@@ -97,51 +131,56 @@ void guac_rdp_bitmap_new(rdpContext* context, rdpBitmap* bitmap) {
 
     }
 
-    /* No corresponding layer yet - caching is deferred. */
-    ((guac_rdp_bitmap*) bitmap)->layer = NULL;
-
-    /* Start at zero usage */
-    ((guac_rdp_bitmap*) bitmap)->used = 0;
+    __guac_rdp_bitmap_init(bitmap);
 
 }
 
 void guac_rdp_bitmap_paint(rdpContext* context, rdpBitmap* bitmap) {
 
     guac_client* client = ((rdp_freerdp_context*) context)->client;
+    rdp_guac_client_data* client_data = (rdp_guac_client_data*) client->data;
     guac_socket* socket = client->socket;
 
     int width = bitmap->right - bitmap->left + 1;
     int height = bitmap->bottom - bitmap->top + 1;
 
-    /* If not cached, cache if necessary */
+    /* If not cached, cache if worthwhile */
     if (((guac_rdp_bitmap*) bitmap)->layer == NULL
-            && ((guac_rdp_bitmap*) bitmap)->used >= 1)
+            && guac_rdp_cache_policy_should_cache(client_data->cache_policy,
+                (guac_rdp_bitmap*) bitmap, width, height))
         guac_rdp_cache_bitmap(context, bitmap);
 
     /* If cached, retrieve from cache */
-    if (((guac_rdp_bitmap*) bitmap)->layer != NULL)
+    if (((guac_rdp_bitmap*) bitmap)->layer != NULL) {
+        guac_rdp_paint_flush(client_data->paint);
         guac_protocol_send_copy(socket,
                 ((guac_rdp_bitmap*) bitmap)->layer,
                 0, 0, width, height,
                 GUAC_COMP_OVER,
                 GUAC_DEFAULT_LAYER, bitmap->left, bitmap->top);
+        guac_rdp_cache_policy_draw_cached(client_data->cache_policy,
+                (guac_rdp_bitmap*) bitmap);
+
+        /* Mirror copied data within shadow surface */
+        if (client_data->shadow != NULL) {
+            if (bitmap->data != NULL)
+                guac_rdp_shadow_draw(client_data->shadow,
+                        bitmap->left, bitmap->top, width, height,
+                        bitmap->data, 4*bitmap->width);
+            else
+                guac_rdp_shadow_invalidate(client_data->shadow,
+                        bitmap->left, bitmap->top, width, height);
+        }
 
-    /* Otherwise, draw with stored image data */
-    else if (bitmap->data != NULL) {
-
-        /* Create surface from image data */
-        cairo_surface_t* surface = cairo_image_surface_create_for_data(
-            bitmap->data, CAIRO_FORMAT_RGB24,
-            width, height, 4*bitmap->width);
-
-        /* Send surface to buffer */
-        guac_protocol_send_png(socket,
-                GUAC_COMP_OVER, GUAC_DEFAULT_LAYER,
-                bitmap->left, bitmap->top, surface);
-
-        /* Free surface */
-        cairo_surface_destroy(surface);
+    }
 
+    /* Otherwise, draw with stored image data at end of paint */
+    else if (bitmap->data != NULL) {
+        guac_rdp_paint_image(client_data->paint, GUAC_DEFAULT_LAYER,
+                bitmap->left, bitmap->top, width, height,
+                bitmap->data, 4*bitmap->width);
+        guac_rdp_cache_policy_draw_inline(client_data->cache_policy,
+                (guac_rdp_bitmap*) bitmap, width, height);
     }
 
     /* Increment usage counter */
@@ -151,19 +190,28 @@ void guac_rdp_bitmap_paint(rdpContext* context, rdpBitmap* bitmap) {
 
 void guac_rdp_bitmap_free(rdpContext* context, rdpBitmap* bitmap) {
     guac_client* client = ((rdp_freerdp_context*) context)->client;
+    rdp_guac_client_data* client_data = (rdp_guac_client_data*) client->data;
+
+    /* If composed server-side, free contents */
+    guac_rdp_offscreen_remove(client_data->offscreen,
+            (guac_rdp_bitmap*) bitmap);
 
     /* If cached, free buffer */
-    if (((guac_rdp_bitmap*) bitmap)->layer != NULL)
-        guac_client_free_buffer(client, ((guac_rdp_bitmap*) bitmap)->layer);
+    guac_rdp_cache_policy_remove(client_data->cache_policy,
+            (guac_rdp_bitmap*) bitmap);
 
 }
 
 void guac_rdp_bitmap_setsurface(rdpContext* context, rdpBitmap* bitmap, BOOL primary) {
     guac_client* client = ((rdp_freerdp_context*) context)->client;
+    rdp_guac_client_data* client_data = (rdp_guac_client_data*) client->data;
+    guac_rdp_bitmap* guac_bitmap = (guac_rdp_bitmap*) bitmap;
 
-    if (primary)
-        ((rdp_guac_client_data*) client->data)->current_surface
-            = GUAC_DEFAULT_LAYER;
+    if (primary) {
+        client_data->current_surface = GUAC_DEFAULT_LAYER;
+        client_data->current_shadow = client_data->shadow;
+        client_data->paint->offscreen = NULL;
+    }
 
     else {
 
@@ -173,12 +221,32 @@ void guac_rdp_bitmap_setsurface(rdpContext* context, rdpBitmap* bitmap, BOOL pri
             return;
         }
 
-        /* If not available as a surface, make available. */
-        if (((guac_rdp_bitmap*) bitmap)->layer == NULL)
-            guac_rdp_cache_bitmap(context, bitmap);
+        /* Contents of surfaces exist only server-side or client-side */
+        guac_bitmap->surface = 1;
+
+        /* Compose new surfaces server-side, if possible */
+        if (guac_bitmap->shadow == NULL && guac_bitmap->layer == NULL)
+            guac_rdp_offscreen_add(client_data->offscreen, guac_bitmap);
+
+        /* Draw server-side only if composed server-side */
+        if (guac_bitmap->shadow != NULL) {
+            guac_rdp_offscreen_touch(client_data->offscreen, guac_bitmap);
+            client_data->current_surface = NULL;
+            client_data->current_shadow = guac_bitmap->shadow;
+            client_data->paint->offscreen = guac_bitmap->shadow;
+        }
 
-        ((rdp_guac_client_data*) client->data)->current_surface 
-            = ((guac_rdp_bitmap*) bitmap)->layer;
+        /* Otherwise, draw to buffer, making available if necessary */
+        else {
+
+            if (guac_bitmap->layer == NULL)
+                guac_rdp_cache_bitmap(context, bitmap);
+
+            client_data->current_surface = guac_bitmap->layer;
+            client_data->current_shadow = NULL;
+            client_data->paint->offscreen = NULL;
+
+        }
 
     }
 
@@ -210,3 +278,48 @@ void guac_rdp_bitmap_decompress(rdpContext* context, rdpBitmap* bitmap, UINT8* d
 
 }
 
+void guac_rdp_bitmap_update(rdpContext* context, BITMAP_UPDATE* bitmap_update) {
+
+    guac_client* client = ((rdp_freerdp_context*) context)->client;
+    rdp_guac_client_data* client_data = (rdp_guac_client_data*) client->data;
+    rdpBitmap* bitmap = client_data->update_bitmap;
+
+    int i;
+
+    /* Decode all rectangles in parallel */
+    guac_rdp_decoder_start(client_data->decoder, bitmap_update);
+
+    /* Draw each rectangle in order as soon as it is decoded */
+    for (i = 0; i < bitmap_update->number; i++) {
+
+        BITMAP_DATA* bitmap_data = &(bitmap_update->rectangles[i]);
+        unsigned char* data = guac_rdp_decoder_wait(client_data->decoder, i);
+
+        /* Release previous rectangle */
+        guac_rdp_bitmap_free(context, bitmap);
+        free(bitmap->data);
+
+        Bitmap_SetRectangle(context, bitmap,
+                bitmap_data->destLeft, bitmap_data->destTop,
+                bitmap_data->destRight, bitmap_data->destBottom);
+
+        Bitmap_SetDimensions(context, bitmap,
+                bitmap_data->width, bitmap_data->height);
+
+        /* Store decoded image data */
+        bitmap->data = data;
+        bitmap->compressed = FALSE;
+        bitmap->bpp = bitmap_data->bitsPerPixel;
+        bitmap->length = bitmap_data->width * bitmap_data->height
+                       * (bitmap_data->bitsPerPixel + 7) / 8;
+
+        __guac_rdp_bitmap_init(bitmap);
+        guac_rdp_bitmap_paint(context, bitmap);
+
+        /* Do not delay input behind large updates */
+        guac_rdp_input_queue_flush(client_data->input_queue, context->input);
+
+    }
+
+}
+
@@ -26,6 +26,8 @@
 
 #include "config.h"
 
+#include "rdp_shadow.h"
+
 #include <freerdp/freerdp.h>
 #include <guacamole/protocol.h>
 
@@ -52,6 +54,50 @@ typedef struct guac_rdp_bitmap {
      */
     int used;
 
+    /**
+     * The total number of pixels of this bitmap which have been sent inline,
+     * rather than copied from a cached buffer.
+     */
+    int drawn;
+
+    /**
+     * Whether this bitmap has been used as a drawing surface. The contents
+     * of such bitmaps exist only within their buffers or shadow surfaces,
+     * and thus cannot be evicted from the cache.
+     */
+    int surface;
+
+    /**
+     * The server-side contents of this bitmap, if it is an offscreen surface
+     * composed server-side, or NULL otherwise. Such surfaces have no
+     * client-side buffer.
+     */
+    guac_rdp_shadow* shadow;
+
+    /**
+     * The next-least-recently used server-side offscreen surface, or NULL if
+     * this bitmap is not stored server-side or is the least-recently used.
+     */
+    struct guac_rdp_bitmap* offscreen_next;
+
+    /**
+     * The next-most-recently used server-side offscreen surface, or NULL if
+     * this bitmap is not stored server-side or is the most-recently used.
+     */
+    struct guac_rdp_bitmap* offscreen_prev;
+
+    /**
+     * The next-most-recently used cached bitmap, or NULL if this bitmap is
+     * not cached or is the least-recently used.
+     */
+    struct guac_rdp_bitmap* next;
+
+    /**
+     * The next-least-recently used cached bitmap, or NULL if this bitmap is
+     * not cached or is the most-recently used.
+     */
+    struct guac_rdp_bitmap* prev;
+
 } guac_rdp_bitmap;
 
 void guac_rdp_cache_bitmap(rdpContext* context, rdpBitmap* bitmap);
@@ -60,6 +106,16 @@ void guac_rdp_bitmap_paint(rdpContext* context, rdpBitmap* bitmap);
 void guac_rdp_bitmap_free(rdpContext* context, rdpBitmap* bitmap);
 void guac_rdp_bitmap_setsurface(rdpContext* context, rdpBitmap* bitmap, BOOL primary);
 
+/**
+ * Handler for bitmap updates, replacing the handler provided by FreeRDP. The
+ * rectangles of the update are decompressed and converted in parallel, and
+ * drawn in their original order.
+ *
+ * @param context The rdpContext associated with the current RDP session.
+ * @param bitmap_update The bitmap update received.
+ */
+void guac_rdp_bitmap_update(rdpContext* context, BITMAP_UPDATE* bitmap_update);
+
 #ifdef LEGACY_RDPBITMAP
 void guac_rdp_bitmap_decompress(rdpContext* context, rdpBitmap* bitmap, UINT8* data,
         int width, int height, int bpp, int length, BOOL compressed);
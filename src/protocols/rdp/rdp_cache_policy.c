@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2013 Glyptodon LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "config.h"
+
+#include "client.h"
+#include "debug.h"
+#include "rdp_bitmap.h"
+#include "rdp_cache_policy.h"
+
+#include <stdlib.h>
+
+#include <freerdp/freerdp.h>
+#include <guacamole/client.h>
+#include <guacamole/protocol.h>
+
+/**
+ * Returns the number of bytes of client-side buffer memory required to
+ * cache the given bitmap.
+ */
+static int __guac_rdp_cache_policy_bitmap_size(guac_rdp_bitmap* bitmap) {
+    return bitmap->bitmap.width * bitmap->bitmap.height * 4;
+}
+
+/**
+ * Removes the given cached bitmap from the list of cached bitmaps, without
+ * otherwise affecting the bitmap.
+ */
+static void __guac_rdp_cache_policy_unlink(guac_rdp_cache_policy* policy,
+        guac_rdp_bitmap* bitmap) {
+
+    if (bitmap->prev != NULL)
+        bitmap->prev->next = bitmap->next;
+    else
+        policy->first = bitmap->next;
+
+    if (bitmap->next != NULL)
+        bitmap->next->prev = bitmap->prev;
+    else
+        policy->last = bitmap->prev;
+
+    bitmap->prev = NULL;
+    bitmap->next = NULL;
+
+}
+
+/**
+ * Adds the given bitmap to the head of the list of cached bitmaps, marking
+ * it as the most-recently used.
+ */
+static void __guac_rdp_cache_policy_link(guac_rdp_cache_policy* policy,
+        guac_rdp_bitmap* bitmap) {
+
+    bitmap->prev = NULL;
+    bitmap->next = policy->first;
+
+    if (policy->first != NULL)
+        policy->first->prev = bitmap;
+    else
+        policy->last = bitmap;
+
+    policy->first = bitmap;
+
+}
+
+guac_rdp_cache_policy* guac_rdp_cache_policy_alloc(guac_client* client,
+        int budget) {
+
+    guac_rdp_cache_policy* policy = calloc(1, sizeof(guac_rdp_cache_policy));
+    if (policy == NULL)
+        return NULL;
+
+    policy->client = client;
+    policy->budget = budget;
+
+    return policy;
+
+}
+
+void guac_rdp_cache_policy_free(guac_rdp_cache_policy* policy) {
+
+    guac_rdp_cache_policy_stats* stats = &(policy->stats);
+
+    guac_client_log_info(policy->client,
+            "Bitmap cache: %i uploads, %i evictions, %i cached draws, "
+            "%i inline draws, peak usage %i of %i KiB",
+            stats->uploads, stats->evictions, stats->cached_draws,
+            stats->inline_draws, stats->peak_size / 1024,
+            policy->budget / 1024);
+
+    free(policy);
+
+}
+
+int guac_rdp_cache_policy_should_cache(guac_rdp_cache_policy* policy,
+        guac_rdp_bitmap* bitmap, int width, int height) {
+
+    int size = bitmap->bitmap.width * bitmap->bitmap.height;
+
+    /* Bitmaps without image data cannot be uploaded */
+    if (bitmap->bitmap.data == NULL)
+        return 0;
+
+    /* Never cache bitmaps which would dominate the budget */
+    if (size * 4 > policy->budget / GUAC_RDP_CACHE_POLICY_MAX_FRACTION)
+        return 0;
+
+    /* Cache only reused bitmaps whose inline cost exceeds an upload */
+    return bitmap->used >= 1 && bitmap->drawn + width * height >= size;
+
+}
+
+void guac_rdp_cache_policy_draw_inline(guac_rdp_cache_policy* policy,
+        guac_rdp_bitmap* bitmap, int width, int height) {
+
+    bitmap->drawn += width * height;
+    policy->stats.inline_draws++;
+
+}
+
+void guac_rdp_cache_policy_draw_cached(guac_rdp_cache_policy* policy,
+        guac_rdp_bitmap* bitmap) {
+
+    /* Mark as most-recently used */
+    if (policy->first != bitmap) {
+        __guac_rdp_cache_policy_unlink(policy, bitmap);
+        __guac_rdp_cache_policy_link(policy, bitmap);
+    }
+
+    policy->stats.cached_draws++;
+
+}
+
+void guac_rdp_cache_policy_add(guac_rdp_cache_policy* policy,
+        guac_rdp_bitmap* bitmap) {
+
+    int size = __guac_rdp_cache_policy_bitmap_size(bitmap);
+    guac_rdp_bitmap* current = policy->last;
+
+    /* Evict least-recently used bitmaps until new bitmap fits */
+    while (policy->size + size > policy->budget && current != NULL) {
+
+        guac_rdp_bitmap* candidate = current;
+        current = current->prev;
+
+        /* Surfaces cannot be reconstructed, and must be kept */
+        if (candidate->surface)
+            continue;
+
+        GUAC_RDP_DEBUG(2, "Evicting %ix%i bitmap (used %i times)",
+                candidate->bitmap.width, candidate->bitmap.height,
+                candidate->used);
+
+        guac_rdp_cache_policy_remove(policy, candidate);
+        policy->stats.evictions++;
+
+    }
+
+    /* Track new bitmap as most-recently used */
+    __guac_rdp_cache_policy_link(policy, bitmap);
+    policy->size += size;
+    policy->stats.uploads++;
+
+    if (policy->size > policy->stats.peak_size)
+        policy->stats.peak_size = policy->size;
+
+}
+
+void guac_rdp_cache_policy_remove(guac_rdp_cache_policy* policy,
+        guac_rdp_bitmap* bitmap) {
+
+    guac_client* client = policy->client;
+    rdp_guac_client_data* client_data = (rdp_guac_client_data*) client->data;
+
+    /* Nothing to do if not cached */
+    if (bitmap->layer == NULL)
+        return;
+
+    /* Deferred drawing may target this buffer */
+    guac_rdp_paint_flush(client_data->paint);
+
+    /* Release client-side buffer */
+    guac_protocol_send_dispose(client->socket, bitmap->layer);
+    guac_client_free_buffer(client, bitmap->layer);
+    bitmap->layer = NULL;
+
+    /* Inline drawing starts over if bitmap is cached again */
+    bitmap->drawn = 0;
+
+    __guac_rdp_cache_policy_unlink(policy, bitmap);
+    policy->size -= __guac_rdp_cache_policy_bitmap_size(bitmap);
+
+}
+
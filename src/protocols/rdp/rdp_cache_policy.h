@@ -0,0 +1,239 @@
+/*
+ * Copyright (C) 2013 Glyptodon LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef _GUAC_RDP_RDP_CACHE_POLICY_H
+#define _GUAC_RDP_RDP_CACHE_POLICY_H
+
+#include "config.h"
+
+#include "rdp_bitmap.h"
+
+#include <guacamole/client.h>
+
+/**
+ * The maximum number of bytes of client-side buffer memory which may be used
+ * to cache bitmaps, assuming four bytes per pixel.
+ */
+#define GUAC_RDP_CACHE_POLICY_BUDGET (64*1024*1024)
+
+/**
+ * The divisor applied to the cache budget to determine the size of the
+ * largest bitmap which will be cached solely for the sake of reuse. Larger
+ * bitmaps are always sent inline unless needed as a surface or for a
+ * transfer.
+ */
+#define GUAC_RDP_CACHE_POLICY_MAX_FRACTION 8
+
+/**
+ * Statistics describing the effectiveness of bitmap caching, maintained for
+ * the sake of tuning.
+ */
+typedef struct guac_rdp_cache_policy_stats {
+
+    /**
+     * The number of draws which were sent inline as PNG, as the bitmap was
+     * not cached.
+     */
+    int inline_draws;
+
+    /**
+     * The number of draws which copied from an already-cached bitmap.
+     */
+    int cached_draws;
+
+    /**
+     * The number of bitmaps uploaded to client-side buffers.
+     */
+    int uploads;
+
+    /**
+     * The number of bitmaps evicted from client-side buffers to remain
+     * within budget.
+     */
+    int evictions;
+
+    /**
+     * The largest number of bytes of client-side buffer memory in use at
+     * any one time.
+     */
+    int peak_size;
+
+} guac_rdp_cache_policy_stats;
+
+/**
+ * Decides which bitmaps are cached within client-side buffers, tracking the
+ * reuse and recency of each bitmap, and evicting the least-recently used
+ * bitmaps when the memory budget would be exceeded.
+ */
+typedef struct guac_rdp_cache_policy {
+
+    /**
+     * The client owning all cached bitmaps.
+     */
+    guac_client* client;
+
+    /**
+     * The maximum number of bytes of client-side buffer memory which may be
+     * used by cached bitmaps.
+     */
+    int budget;
+
+    /**
+     * The number of bytes of client-side buffer memory currently used by
+     * cached bitmaps.
+     */
+    int size;
+
+    /**
+     * The most-recently used cached bitmap, or NULL if no bitmaps are
+     * cached.
+     */
+    guac_rdp_bitmap* first;
+
+    /**
+     * The least-recently used cached bitmap, or NULL if no bitmaps are
+     * cached.
+     */
+    guac_rdp_bitmap* last;
+
+    /**
+     * Statistics describing cache effectiveness.
+     */
+    guac_rdp_cache_policy_stats stats;
+
+} guac_rdp_cache_policy;
+
+/**
+ * Allocates a new cache policy which will keep cached bitmaps within the
+ * given budget.
+ *
+ * @param client
+ *     The client owning all cached bitmaps.
+ *
+ * @param budget
+ *     The maximum number of bytes of client-side buffer memory which may be
+ *     used by cached bitmaps.
+ *
+ * @return
+ *     A newly-allocated cache policy, or NULL if allocation fails.
+ */
+guac_rdp_cache_policy* guac_rdp_cache_policy_alloc(guac_client* client,
+        int budget);
+
+/**
+ * Logs the statistics of the given cache policy and frees it. Any bitmaps
+ * still cached are not affected.
+ *
+ * @param policy
+ *     The cache policy to free.
+ */
+void guac_rdp_cache_policy_free(guac_rdp_cache_policy* policy);
+
+/**
+ * Returns whether the given bitmap, which is not yet cached, should be
+ * uploaded to a client-side buffer rather than drawing the given portion of
+ * it inline. Bitmaps are cached only once they have been used before, and
+ * only once sending the given portion inline would bring the total number of
+ * pixels sent inline for that bitmap to at least the size of the bitmap.
+ * Bitmaps too large relative to the budget are never cached by this policy.
+ *
+ * @param policy
+ *     The cache policy to consult.
+ *
+ * @param bitmap
+ *     The bitmap about to be drawn.
+ *
+ * @param width
+ *     The width of the portion of the bitmap being drawn, in pixels.
+ *
+ * @param height
+ *     The height of the portion of the bitmap being drawn, in pixels.
+ *
+ * @return
+ *     Non-zero if the bitmap should be cached, zero otherwise.
+ */
+int guac_rdp_cache_policy_should_cache(guac_rdp_cache_policy* policy,
+        guac_rdp_bitmap* bitmap, int width, int height);
+
+/**
+ * Records that the given portion of the given bitmap has been drawn inline.
+ *
+ * @param policy
+ *     The cache policy to update.
+ *
+ * @param bitmap
+ *     The bitmap drawn.
+ *
+ * @param width
+ *     The width of the portion of the bitmap drawn, in pixels.
+ *
+ * @param height
+ *     The height of the portion of the bitmap drawn, in pixels.
+ */
+void guac_rdp_cache_policy_draw_inline(guac_rdp_cache_policy* policy,
+        guac_rdp_bitmap* bitmap, int width, int height);
+
+/**
+ * Records that the given cached bitmap has been drawn, marking it as the
+ * most-recently used.
+ *
+ * @param policy
+ *     The cache policy to update.
+ *
+ * @param bitmap
+ *     The cached bitmap drawn.
+ */
+void guac_rdp_cache_policy_draw_cached(guac_rdp_cache_policy* policy,
+        guac_rdp_bitmap* bitmap);
+
+/**
+ * Records that the given bitmap has just been uploaded to a client-side
+ * buffer, evicting least-recently used bitmaps as necessary to remain within
+ * budget. Bitmaps which have been used as drawing surfaces are never evicted,
+ * as their contents exist only within the client-side buffer.
+ *
+ * @param policy
+ *     The cache policy to update.
+ *
+ * @param bitmap
+ *     The newly-cached bitmap.
+ */
+void guac_rdp_cache_policy_add(guac_rdp_cache_policy* policy,
+        guac_rdp_bitmap* bitmap);
+
+/**
+ * Removes the given bitmap from the cache, disposing of and freeing its
+ * client-side buffer. If the bitmap is not cached, this function has no
+ * effect.
+ *
+ * @param policy
+ *     The cache policy to update.
+ *
+ * @param bitmap
+ *     The bitmap to remove.
+ */
+void guac_rdp_cache_policy_remove(guac_rdp_cache_policy* policy,
+        guac_rdp_bitmap* bitmap);
+
+#endif
+
@@ -31,6 +31,9 @@
 #include <freerdp/utils/event.h>
 #include <guacamole/client.h>
 #include <guacamole/protocol.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
 
 #ifdef ENABLE_WINPR
 #include <winpr/wtypes.h>
@@ -172,11 +175,13 @@ void guac_rdp_process_cb_data_request(guac_client* client,
         RDP_CB_DATA_REQUEST_EVENT* event) {
 
     rdp_guac_client_data* client_data = (rdp_guac_client_data*) client->data;
+    guac_common_clipboard* clipboard = client_data->clipboard;
     rdpChannels* channels = client_data->rdp_inst->context->channels;
 
     guac_iconv_write* writer;
-    const char* input = client_data->clipboard->buffer;
-    char* output = malloc(GUAC_RDP_CLIPBOARD_MAX_LENGTH);
+    const char* input;
+    char* output;
+    int output_size;
 
     RDP_CB_DATA_RESPONSE_EVENT* data_response;
 
@@ -198,6 +203,13 @@ void guac_rdp_process_cb_data_request(guac_client* client,
 
     }
 
+    /* Clipboard may be replaced by the user while being read */
+    pthread_mutex_lock(&(clipboard->lock));
+
+    /* Each byte of UTF-8 requires at most two bytes of output */
+    output_size = (clipboard->length + 1) * 2;
+    output = malloc(output_size);
+
     /* Create new data response */
     data_response = (RDP_CB_DATA_RESPONSE_EVENT*) freerdp_event_new(
                 CliprdrChannel_Class,
@@ -206,10 +218,13 @@ void guac_rdp_process_cb_data_request(guac_client* client,
 
     /* Set data and size */
     data_response->data = (BYTE*) output;
-    guac_iconv(GUAC_READ_UTF8, &input, client_data->clipboard->length,
-               writer, &output, GUAC_RDP_CLIPBOARD_MAX_LENGTH);
+    input = clipboard->buffer;
+    guac_iconv(GUAC_READ_UTF8, &input, clipboard->length,
+               writer, &output, output_size);
     data_response->size = ((BYTE*) output) - data_response->data;
 
+    pthread_mutex_unlock(&(clipboard->lock));
+
     /* Send response */
     freerdp_channels_send_event(channels, (wMessage*) data_response);
 
@@ -219,11 +234,14 @@ void guac_rdp_process_cb_data_response(guac_client* client,
         RDP_CB_DATA_RESPONSE_EVENT* event) {
 
     rdp_guac_client_data* client_data = (rdp_guac_client_data*) client->data;
-    char received_data[GUAC_RDP_CLIPBOARD_MAX_LENGTH];
+
+    /* Each byte of input requires at most three bytes of UTF-8 */
+    int output_size = event->size * 3 + 1;
+    char* received_data;
 
     guac_iconv_read* reader;
     const char* input = (char*) event->data;
-    char* output = received_data;
+    char* output;
 
     /* Find correct source encoding */
     switch (client_data->requested_clipboard_format) {
@@ -246,16 +264,21 @@ void guac_rdp_process_cb_data_response(guac_client* client,
 
     }
 
+    received_data = malloc(output_size);
+    output = received_data;
+
     /* Convert send clipboard data */
     if (guac_iconv(reader, &input, event->size,
-            GUAC_WRITE_UTF8, &output, sizeof(received_data))) {
+            GUAC_WRITE_UTF8, &output, output_size)) {
 
-        int length = strnlen(received_data, sizeof(received_data));
+        int length = strnlen(received_data, output_size);
         guac_common_clipboard_reset(client_data->clipboard, "text/plain");
         guac_common_clipboard_append(client_data->clipboard, received_data, length);
         guac_common_clipboard_send(client_data->clipboard, client);
 
     }
 
+    free(received_data);
+
 }
 
@@ -0,0 +1,235 @@
+/*
+ * Copyright (C) 2013 Glyptodon LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "config.h"
+
+#include "rdp_decoder.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <freerdp/codec/bitmap.h>
+#include <freerdp/codec/color.h>
+#include <freerdp/freerdp.h>
+
+#ifdef ENABLE_WINPR
+#include <winpr/wtypes.h>
+#else
+#include "compat/winpr-wtypes.h"
+#endif
+
+/**
+ * Decompresses the given rectangle and converts the result to 32-bit RGB,
+ * exactly as guac_rdp_bitmap_decompress() and guac_rdp_bitmap_new() would.
+ * This function touches no shared state other than the (read-only) color
+ * conversion structure, and thus may be called from any thread.
+ */
+static unsigned char* __guac_rdp_decoder_decode(guac_rdp_decoder* decoder,
+        BITMAP_DATA* bitmap_data) {
+
+    int width = bitmap_data->width;
+    int height = bitmap_data->height;
+    int bpp = bitmap_data->bitsPerPixel;
+
+    unsigned char* image_buffer;
+    UINT8* data = (UINT8*) malloc(width * height * (bpp + 7) / 8);
+
+    if (bitmap_data->compressed)
+        bitmap_decompress(bitmap_data->bitmapDataStream, data, width, height,
+                bitmap_data->bitmapLength, bpp, bpp);
+    else
+        freerdp_image_flip(bitmap_data->bitmapDataStream, data,
+                width, height, bpp);
+
+    /* Convert image data to 32-bit RGB */
+    image_buffer = freerdp_image_convert(data, NULL, width, height,
+            decoder->color_depth, 32, decoder->clrconv);
+
+    if (image_buffer != data)
+        free(data);
+
+    return image_buffer;
+
+}
+
+/**
+ * Claims the next unclaimed job, decodes it, and marks it as done. The
+ * decoder lock must be held when this function is called, and is released
+ * while decoding.
+ */
+static void __guac_rdp_decoder_run_job(guac_rdp_decoder* decoder) {
+
+    guac_rdp_decoder_job* job = &(decoder->jobs[decoder->next_job++]);
+
+    pthread_mutex_unlock(&(decoder->lock));
+    unsigned char* data = __guac_rdp_decoder_decode(decoder, job->bitmap_data);
+    pthread_mutex_lock(&(decoder->lock));
+
+    job->data = data;
+    job->done = 1;
+    pthread_cond_broadcast(&(decoder->job_done));
+
+}
+
+static void* __guac_rdp_decoder_thread(void* arg) {
+
+    guac_rdp_decoder* decoder = (guac_rdp_decoder*) arg;
+
+    pthread_mutex_lock(&(decoder->lock));
+
+    while (decoder->running) {
+
+        /* Decode jobs as long as any remain */
+        if (decoder->next_job < decoder->job_count)
+            __guac_rdp_decoder_run_job(decoder);
+
+        /* Otherwise, wait for more */
+        else
+            pthread_cond_wait(&(decoder->jobs_available), &(decoder->lock));
+
+    }
+
+    pthread_mutex_unlock(&(decoder->lock));
+    return NULL;
+
+}
+
+guac_rdp_decoder* guac_rdp_decoder_alloc(CLRCONV* clrconv, int color_depth) {
+
+    guac_rdp_decoder* decoder = malloc(sizeof(guac_rdp_decoder));
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+
+    decoder->clrconv = clrconv;
+    decoder->color_depth = color_depth;
+    decoder->jobs = NULL;
+    decoder->job_count = 0;
+    decoder->jobs_size = 0;
+    decoder->next_job = 0;
+    decoder->running = 1;
+
+    pthread_mutex_init(&(decoder->lock), NULL);
+    pthread_cond_init(&(decoder->jobs_available), NULL);
+    pthread_cond_init(&(decoder->job_done), NULL);
+
+    /* The thread handling each update decodes, too */
+    decoder->thread_count = 0;
+    while (decoder->thread_count < processors - 1
+            && decoder->thread_count < GUAC_RDP_DECODER_MAX_THREADS) {
+
+        /* Continue with fewer threads if no more can be created */
+        if (pthread_create(&(decoder->threads[decoder->thread_count]), NULL,
+                    __guac_rdp_decoder_thread, decoder))
+            break;
+
+        decoder->thread_count++;
+
+    }
+
+    return decoder;
+
+}
+
+void guac_rdp_decoder_free(guac_rdp_decoder* decoder) {
+
+    int i;
+
+    /* Stop all worker threads */
+    pthread_mutex_lock(&(decoder->lock));
+    decoder->running = 0;
+    pthread_cond_broadcast(&(decoder->jobs_available));
+    pthread_mutex_unlock(&(decoder->lock));
+
+    for (i = 0; i < decoder->thread_count; i++)
+        pthread_join(decoder->threads[i], NULL);
+
+    pthread_cond_destroy(&(decoder->job_done));
+    pthread_cond_destroy(&(decoder->jobs_available));
+    pthread_mutex_destroy(&(decoder->lock));
+
+    free(decoder->jobs);
+    free(decoder);
+
+}
+
+void guac_rdp_decoder_start(guac_rdp_decoder* decoder,
+        BITMAP_UPDATE* bitmap_update) {
+
+    int i;
+    int count = bitmap_update->number;
+
+    pthread_mutex_lock(&(decoder->lock));
+
+    /* Grow job array if necessary */
+    if (count > decoder->jobs_size) {
+        decoder->jobs_size = count;
+        decoder->jobs = realloc(decoder->jobs,
+                sizeof(guac_rdp_decoder_job) * count);
+    }
+
+    for (i = 0; i < count; i++) {
+        guac_rdp_decoder_job* job = &(decoder->jobs[i]);
+        job->bitmap_data = &(bitmap_update->rectangles[i]);
+        job->data = NULL;
+        job->done = 0;
+    }
+
+    decoder->job_count = count;
+    decoder->next_job = 0;
+
+    /* Wake workers only if there is more than the current thread can start */
+    if (count > 1)
+        pthread_cond_broadcast(&(decoder->jobs_available));
+
+    pthread_mutex_unlock(&(decoder->lock));
+
+}
+
+unsigned char* guac_rdp_decoder_wait(guac_rdp_decoder* decoder, int index) {
+
+    guac_rdp_decoder_job* job;
+
+    pthread_mutex_lock(&(decoder->lock));
+
+    job = &(decoder->jobs[index]);
+    while (!job->done) {
+
+        /* Help decode while jobs remain unclaimed */
+        if (decoder->next_job < decoder->job_count)
+            __guac_rdp_decoder_run_job(decoder);
+
+        /* Otherwise, wait for the requested job to be completed */
+        else
+            pthread_cond_wait(&(decoder->job_done), &(decoder->lock));
+
+    }
+
+    /* Once all jobs are retrieved, the update no longer needs decoding */
+    if (index == decoder->job_count - 1)
+        decoder->job_count = decoder->next_job = 0;
+
+    pthread_mutex_unlock(&(decoder->lock));
+
+    return job->data;
+
+}
+
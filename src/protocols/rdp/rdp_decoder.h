@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2013 Glyptodon LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _GUAC_RDP_RDP_DECODER_H
+#define _GUAC_RDP_RDP_DECODER_H
+
+#include "config.h"
+
+#include <pthread.h>
+
+#include <freerdp/codec/color.h>
+#include <freerdp/freerdp.h>
+
+/**
+ * The maximum number of worker threads which will decode bitmap updates in
+ * parallel with the thread handling the update.
+ */
+#define GUAC_RDP_DECODER_MAX_THREADS 7
+
+/**
+ * A single rectangle of a bitmap update, decoded by whichever thread claims
+ * it first.
+ */
+typedef struct guac_rdp_decoder_job {
+
+    /**
+     * The rectangle to decode, as received from the RDP server.
+     */
+    BITMAP_DATA* bitmap_data;
+
+    /**
+     * The decoded image data, in 32-bit RGB, or NULL if decoding has not
+     * yet completed.
+     */
+    unsigned char* data;
+
+    /**
+     * Non-zero if this rectangle has been fully decoded.
+     */
+    int done;
+
+} guac_rdp_decoder_job;
+
+/**
+ * A pool of threads which decompress and convert the independent rectangles
+ * of a bitmap update in parallel. The thread handling the update takes part
+ * in decoding, and receives decoded rectangles in their original order, such
+ * that each can be drawn while later rectangles are still being decoded.
+ */
+typedef struct guac_rdp_decoder {
+
+    /**
+     * The color conversion structure to use when converting decompressed
+     * image data to 32-bit RGB.
+     */
+    CLRCONV* clrconv;
+
+    /**
+     * The color depth of all received image data, in bits per pixel.
+     */
+    int color_depth;
+
+    /**
+     * The number of worker threads in this pool.
+     */
+    int thread_count;
+
+    /**
+     * All worker threads in this pool.
+     */
+    pthread_t threads[GUAC_RDP_DECODER_MAX_THREADS];
+
+    /**
+     * Lock which guards all jobs and the state of the pool.
+     */
+    pthread_mutex_t lock;
+
+    /**
+     * Condition signalled when new jobs are available, or when worker
+     * threads must stop.
+     */
+    pthread_cond_t jobs_available;
+
+    /**
+     * Condition signalled whenever a job is completed.
+     */
+    pthread_cond_t job_done;
+
+    /**
+     * All jobs of the bitmap update being decoded.
+     */
+    guac_rdp_decoder_job* jobs;
+
+    /**
+     * The number of jobs of the bitmap update being decoded.
+     */
+    int job_count;
+
+    /**
+     * The number of slots available within the jobs array.
+     */
+    int jobs_size;
+
+    /**
+     * The index of the next job not yet claimed by any thread.
+     */
+    int next_job;
+
+    /**
+     * Non-zero while worker threads should continue waiting for jobs.
+     */
+    int running;
+
+} guac_rdp_decoder;
+
+/**
+ * Allocates a new decoder, starting one worker thread for each available
+ * processor beyond the first, up to GUAC_RDP_DECODER_MAX_THREADS. On
+ * single-processor hosts, all decoding happens within the thread handling
+ * each update.
+ *
+ * @param clrconv The color conversion structure to use when converting
+ *                decompressed image data.
+ * @param color_depth The color depth of all received image data.
+ * @return A new decoder.
+ */
+guac_rdp_decoder* guac_rdp_decoder_alloc(CLRCONV* clrconv, int color_depth);
+
+/**
+ * Stops all worker threads of the given decoder and frees the decoder.
+ *
+ * @param decoder The decoder to free.
+ */
+void guac_rdp_decoder_free(guac_rdp_decoder* decoder);
+
+/**
+ * Begins decoding all rectangles of the given bitmap update. Each rectangle
+ * must then be retrieved, in order, with guac_rdp_decoder_wait() before the
+ * update is released or another update is started.
+ *
+ * @param decoder The decoder to use.
+ * @param bitmap_update The bitmap update to decode.
+ */
+void guac_rdp_decoder_start(guac_rdp_decoder* decoder,
+        BITMAP_UPDATE* bitmap_update);
+
+/**
+ * Waits for the rectangle having the given index within the current bitmap
+ * update to be decoded, decoding pending rectangles while waiting. The
+ * returned data is 32-bit RGB and must be freed by the caller.
+ *
+ * @param decoder The decoder to use.
+ * @param index The index of the rectangle to wait for.
+ * @return The decoded image data.
+ */
+unsigned char* guac_rdp_decoder_wait(guac_rdp_decoder* decoder, int index);
+
+#endif
+
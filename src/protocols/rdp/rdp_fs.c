@@ -31,6 +31,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <fnmatch.h>
+#include <inttypes.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
@@ -38,24 +39,443 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
+
 #include <guacamole/pool.h>
 
-guac_rdp_fs* guac_rdp_fs_alloc(const char* drive_path) {
+guac_rdp_fs* guac_rdp_fs_alloc(const char* drive_path, int write_behind) {
 
+    int i;
     guac_rdp_fs* fs = malloc(sizeof(guac_rdp_fs));
 
     fs->drive_path = strdup(drive_path);
     fs->file_id_pool = guac_pool_alloc(0);
     fs->open_files = 0;
+    fs->write_behind = write_behind;
+
+    /* Init empty file table */
+    fs->file_table_size = GUAC_RDP_FS_INITIAL_FILES;
+    fs->files = malloc(sizeof(guac_rdp_fs_file*) * fs->file_table_size);
+    for (i=0; i<fs->file_table_size; i++)
+        fs->files[i] = NULL;
+
+    /* Init empty directory cache */
+    for (i=0; i<GUAC_RDP_FS_DIR_CACHE_SIZE; i++)
+        fs->dir_cache[i] = NULL;
+
+    fs->dir_cache_clock = 0;
 
+#ifdef HAVE_SYS_INOTIFY_H
+    /* Watch cached directories for changes, if possible */
+    fs->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#else
+    fs->inotify_fd = -1;
+#endif
+
+    pthread_mutex_init(&(fs->lock), NULL);
     return fs;
 
 }
 
+/**
+ * Releases a reference to the given directory snapshot, freeing the snapshot
+ * if no references remain. The filesystem lock must be held if the
+ * filesystem is in use by other threads.
+ */
+static void __guac_rdp_fs_release_snapshot(guac_rdp_fs_dir_snapshot* snapshot) {
+
+    int i;
+
+    /* Do not free if still in use */
+    if (--snapshot->refcount > 0)
+        return;
+
+    /* Free all entries */
+    for (i=0; i<snapshot->entry_count; i++)
+        free(snapshot->entries[i].name);
+
+    free(snapshot->entries);
+    free(snapshot);
+
+}
+
 void guac_rdp_fs_free(guac_rdp_fs* fs) {
+
+    int i;
+
+    /* Release all cached directory snapshots */
+    for (i=0; i<GUAC_RDP_FS_DIR_CACHE_SIZE; i++) {
+        if (fs->dir_cache[i] != NULL)
+            __guac_rdp_fs_release_snapshot(fs->dir_cache[i]);
+    }
+
+    if (fs->inotify_fd != -1)
+        close(fs->inotify_fd);
+
+    /* Free file table */
+    for (i=0; i<fs->file_table_size; i++) {
+        guac_rdp_fs_file* file = fs->files[i];
+        if (file != NULL) {
+            pthread_mutex_destroy(&(file->buffer_lock));
+            free(file->read_buffer);
+            free(file->write_buffer);
+            free(file);
+        }
+    }
+
+    free(fs->files);
+    pthread_mutex_destroy(&(fs->lock));
     guac_pool_free(fs->file_id_pool);
     free(fs->drive_path);
     free(fs);
+
+}
+
+/**
+ * Marks all cached directory snapshots as stale, such that they will be
+ * re-read when next used. This is invoked whenever the filesystem is modified
+ * through the virtual filesystem itself.
+ */
+static void __guac_rdp_fs_invalidate_dirs(guac_rdp_fs* fs) {
+
+    int i;
+
+    pthread_mutex_lock(&(fs->lock));
+
+    for (i=0; i<GUAC_RDP_FS_DIR_CACHE_SIZE; i++) {
+        if (fs->dir_cache[i] != NULL)
+            fs->dir_cache[i]->stale = 1;
+    }
+
+    pthread_mutex_unlock(&(fs->lock));
+
+}
+
+/**
+ * Writes any data within the write-behind buffer of the given file to the
+ * underlying file. Returns zero on success, or an error code if an error
+ * occurs. The buffer is emptied in either case. The buffer lock of the file
+ * must be held.
+ */
+static int __guac_rdp_fs_flush(guac_rdp_fs_file* file) {
+
+    int flushed = 0;
+
+    /* Write all buffered data */
+    while (flushed < file->write_buffer_length) {
+
+        int bytes_written = pwrite(file->fd,
+                file->write_buffer + flushed,
+                file->write_buffer_length - flushed,
+                file->write_buffer_offset + flushed);
+
+        /* Translate errno on error, discarding remaining data */
+        if (bytes_written < 0) {
+            GUAC_RDP_DEBUG(1, "pwrite() of buffered data failed: \"%s\"",
+                    file->real_path);
+            file->write_buffer_length = 0;
+            return guac_rdp_fs_get_errorcode(errno);
+        }
+
+        flushed += bytes_written;
+
+    }
+
+    file->write_buffer_length = 0;
+    return 0;
+
+}
+
+/**
+ * Writes any buffered data of the given file on behalf of another operation,
+ * deferring any error to the next write or flush of the file, and discards
+ * any data read ahead if requested. Returns non-zero if buffered data was
+ * written, zero otherwise. The buffer lock of the file must not be held.
+ */
+static int __guac_rdp_fs_sync_file(guac_rdp_fs_file* file, int invalidate) {
+
+    int flushed = 0;
+
+    pthread_mutex_lock(&(file->buffer_lock));
+
+    if (file->write_buffer_length > 0) {
+        int result = __guac_rdp_fs_flush(file);
+        if (result && !file->deferred_error)
+            file->deferred_error = result;
+        flushed = 1;
+    }
+
+    if (invalidate)
+        file->read_buffer_length = 0;
+
+    pthread_mutex_unlock(&(file->buffer_lock));
+    return flushed;
+
+}
+
+/**
+ * Writes the buffered data of all other open handles of the same underlying
+ * file as the given file, such that the underlying file is up to date, and
+ * discards any data they have read ahead if requested. Returns non-zero if
+ * buffered data was written, zero otherwise. Neither the filesystem lock nor
+ * the buffer lock of the given file may be held.
+ */
+static int __guac_rdp_fs_sync_handles(guac_rdp_fs* fs,
+        guac_rdp_fs_file* file, int invalidate) {
+
+    int flushed = 0;
+    int i;
+
+    /* Nothing to synchronize if the file is unknown or the only open file */
+    if (file->inode == 0)
+        return 0;
+
+    pthread_mutex_lock(&(fs->lock));
+
+    for (i=0; fs->open_files > 1 && i<fs->file_table_size; i++) {
+
+        guac_rdp_fs_file* other = fs->files[i];
+
+        /* Skip closed files and files other than the given file */
+        if (other == NULL || other == file || other->fd == -1
+                || other->device != file->device
+                || other->inode != file->inode)
+            continue;
+
+        flushed |= __guac_rdp_fs_sync_file(other, invalidate);
+
+    }
+
+    pthread_mutex_unlock(&(fs->lock));
+    return flushed;
+
+}
+
+/**
+ * Reads all pending inotify events, marking the cached directory snapshots
+ * affected as stale. If inotify is unavailable, this function has no effect.
+ * The filesystem lock must be held.
+ */
+static void __guac_rdp_fs_process_changes(guac_rdp_fs* fs) {
+
+#ifdef HAVE_SYS_INOTIFY_H
+    char buffer[4096]
+        __attribute__ ((aligned(__alignof__(struct inotify_event))));
+
+    int length;
+
+    if (fs->inotify_fd == -1)
+        return;
+
+    /* Read all events currently available */
+    while ((length = read(fs->inotify_fd, buffer, sizeof(buffer))) > 0) {
+
+        char* current = buffer;
+        while (current < buffer + length) {
+
+            struct inotify_event* event = (struct inotify_event*) current;
+            int i;
+
+            /* Mark affected directory as stale, or all directories if
+             * events were lost */
+            for (i=0; i<GUAC_RDP_FS_DIR_CACHE_SIZE; i++) {
+                guac_rdp_fs_dir_snapshot* snapshot = fs->dir_cache[i];
+                if (snapshot != NULL && (snapshot->watch == event->wd
+                            || (event->mask & IN_Q_OVERFLOW)))
+                    snapshot->stale = 1;
+            }
+
+            current += sizeof(struct inotify_event) + event->len;
+
+        }
+
+    }
+#endif
+
+}
+
+/**
+ * Reads the entire contents of the given directory, including the metadata
+ * of each entry, returning a new snapshot with a single reference, or NULL
+ * if the directory cannot be read.
+ */
+static guac_rdp_fs_dir_snapshot* __guac_rdp_fs_read_snapshot(int fd,
+        struct stat* dir_stat) {
+
+    guac_rdp_fs_dir_snapshot* snapshot;
+    struct dirent* dirent;
+    int capacity = 64;
+    DIR* dir;
+
+    /* Open independent directory stream, leaving the given fd untouched */
+    int dir_fd = openat(fd, ".", O_RDONLY | O_DIRECTORY);
+    if (dir_fd == -1)
+        return NULL;
+
+    dir = fdopendir(dir_fd);
+    if (dir == NULL) {
+        close(dir_fd);
+        return NULL;
+    }
+
+    snapshot = malloc(sizeof(guac_rdp_fs_dir_snapshot));
+    snapshot->device = dir_stat->st_dev;
+    snapshot->inode = dir_stat->st_ino;
+    snapshot->mtime = dir_stat->st_mtim;
+    snapshot->watch = -1;
+    snapshot->stale = 0;
+    snapshot->refcount = 1;
+    snapshot->last_used = 0;
+    snapshot->entry_count = 0;
+    snapshot->entries = malloc(sizeof(guac_rdp_fs_dir_entry) * capacity);
+
+    /* Stat each entry relative to the directory as it is read */
+    while ((dirent = readdir(dir)) != NULL) {
+
+        guac_rdp_fs_dir_entry* entry;
+        struct stat entry_stat;
+
+        /* Skip entries which have vanished or cannot be read */
+        if (fstatat(dir_fd, dirent->d_name, &entry_stat, 0))
+            continue;
+
+        /* Expand entry storage if necessary */
+        if (snapshot->entry_count == capacity) {
+            capacity *= 2;
+            snapshot->entries = realloc(snapshot->entries,
+                    sizeof(guac_rdp_fs_dir_entry) * capacity);
+        }
+
+        /* Store name and metadata */
+        entry = &(snapshot->entries[snapshot->entry_count++]);
+        entry->name  = strdup(dirent->d_name);
+        entry->size  = entry_stat.st_size;
+        entry->ctime = WINDOWS_TIME(entry_stat.st_ctime);
+        entry->mtime = WINDOWS_TIME(entry_stat.st_mtime);
+        entry->atime = WINDOWS_TIME(entry_stat.st_atime);
+
+        /* Set type */
+        if (S_ISDIR(entry_stat.st_mode))
+            entry->attributes = FILE_ATTRIBUTE_DIRECTORY;
+        else
+            entry->attributes = FILE_ATTRIBUTE_NORMAL;
+
+    }
+
+    closedir(dir);
+    return snapshot;
+
+}
+
+/**
+ * Returns a new reference to an up-to-date snapshot of the given directory,
+ * reading the directory only if no valid snapshot is cached, or NULL if the
+ * directory cannot be read. The filesystem lock must be held.
+ */
+static guac_rdp_fs_dir_snapshot* __guac_rdp_fs_get_snapshot(guac_rdp_fs* fs,
+        guac_rdp_fs_file* file) {
+
+    guac_rdp_fs_dir_snapshot* snapshot;
+    struct stat dir_stat;
+    int slot = 0;
+    int i;
+
+    if (fstat(file->fd, &dir_stat))
+        return NULL;
+
+    __guac_rdp_fs_process_changes(fs);
+
+    /* Find cached snapshot of same directory, or least-recently-used slot */
+    for (i=0; i<GUAC_RDP_FS_DIR_CACHE_SIZE; i++) {
+
+        snapshot = fs->dir_cache[i];
+
+        /* Use any empty slot */
+        if (snapshot == NULL) {
+            if (fs->dir_cache[slot] != NULL)
+                slot = i;
+            continue;
+        }
+
+        /* Replace existing snapshot of same directory */
+        if (snapshot->device == dir_stat.st_dev
+                && snapshot->inode == dir_stat.st_ino) {
+            slot = i;
+            break;
+        }
+
+        /* Otherwise, track least-recently-used */
+        if (fs->dir_cache[slot] != NULL
+                && snapshot->last_used < fs->dir_cache[slot]->last_used)
+            slot = i;
+
+    }
+
+    snapshot = fs->dir_cache[slot];
+
+    /* Use cached snapshot if directory is unchanged */
+    if (snapshot != NULL
+            && !snapshot->stale
+            && snapshot->device == dir_stat.st_dev
+            && snapshot->inode == dir_stat.st_ino
+            && snapshot->mtime.tv_sec == dir_stat.st_mtim.tv_sec
+            && snapshot->mtime.tv_nsec == dir_stat.st_mtim.tv_nsec) {
+
+        GUAC_RDP_DEBUG(2, "Using cached snapshot of \"%s\"",
+                file->absolute_path);
+
+        snapshot->last_used = ++fs->dir_cache_clock;
+        snapshot->refcount++;
+        return snapshot;
+
+    }
+
+    /* Otherwise, read directory */
+    GUAC_RDP_DEBUG(2, "Reading snapshot of \"%s\"", file->absolute_path);
+
+    /* Sizes of entries must reflect data still being buffered */
+    for (i=0; i<fs->file_table_size; i++) {
+        guac_rdp_fs_file* buffered = fs->files[i];
+        if (buffered != NULL && buffered->fd != -1)
+            __guac_rdp_fs_sync_file(buffered, 0);
+    }
+
+    snapshot = __guac_rdp_fs_read_snapshot(file->fd, &dir_stat);
+    if (snapshot == NULL)
+        return NULL;
+
+#ifdef HAVE_SYS_INOTIFY_H
+    /* Watch directory for changes to its entries */
+    if (fs->inotify_fd != -1)
+        snapshot->watch = inotify_add_watch(fs->inotify_fd, file->real_path,
+                IN_ATTRIB | IN_CLOSE_WRITE | IN_MODIFY | IN_CREATE
+                | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO
+                | IN_DELETE_SELF | IN_MOVE_SELF);
+#endif
+
+    /* Replace previous occupant of slot */
+    if (fs->dir_cache[slot] != NULL) {
+
+#ifdef HAVE_SYS_INOTIFY_H
+        /* Stop watching evicted directory, unless it is the same directory */
+        guac_rdp_fs_dir_snapshot* evicted = fs->dir_cache[slot];
+        if (evicted->watch != -1 && evicted->watch != snapshot->watch)
+            inotify_rm_watch(fs->inotify_fd, evicted->watch);
+#endif
+
+        __guac_rdp_fs_release_snapshot(fs->dir_cache[slot]);
+
+    }
+
+    /* Cache snapshot, holding one reference for the cache itself */
+    snapshot->last_used = ++fs->dir_cache_clock;
+    snapshot->refcount++;
+    fs->dir_cache[slot] = snapshot;
+
+    return snapshot;
+
 }
 
 /**
@@ -152,6 +572,7 @@ int guac_rdp_fs_open(guac_rdp_fs* fs, const char* path,
     char normalized_path[GUAC_RDP_FS_MAX_PATH];
 
     struct stat file_stat;
+    int stat_result;
     int fd;
     int file_id;
     guac_rdp_fs_file* file;
@@ -164,10 +585,13 @@ int guac_rdp_fs_open(guac_rdp_fs* fs, const char* path,
                       create_options);
 
     /* If no files available, return too many open */
+    pthread_mutex_lock(&(fs->lock));
     if (fs->open_files >= GUAC_RDP_FS_MAX_FILES) {
+        pthread_mutex_unlock(&(fs->lock));
         GUAC_RDP_DEBUG(1, "%s", "Failure - too many open files.");
         return GUAC_RDP_FS_ENFILE;
     }
+    pthread_mutex_unlock(&(fs->lock));
 
     /* If path empty, transform to root path */
     if (path[0] == '\0')
@@ -259,6 +683,10 @@ int guac_rdp_fs_open(guac_rdp_fs* fs, const char* path,
             }
         }
 
+        /* Directory contents of parent have changed */
+        else
+            __guac_rdp_fs_invalidate_dirs(fs);
+
         /* Unset O_CREAT and O_EXCL as directory must exist before open() */
         flags &= ~(O_CREAT | O_EXCL);
 
@@ -282,12 +710,59 @@ int guac_rdp_fs_open(guac_rdp_fs* fs, const char* path,
         return guac_rdp_fs_get_errorcode(errno);
     }
 
-    /* Get file ID, init file */
+    /* Directory contents may have changed if file was created or replaced */
+    if (flags & (O_CREAT | O_TRUNC))
+        __guac_rdp_fs_invalidate_dirs(fs);
+
+    /* Attempt to pull file information */
+    stat_result = fstat(fd, &file_stat);
+
+    /* Get file ID, growing file table if necessary */
+    pthread_mutex_lock(&(fs->lock));
     file_id = guac_pool_next_int(fs->file_id_pool);
-    file = &(fs->files[file_id]);
+    if (file_id >= fs->file_table_size) {
+
+        int i;
+        int new_size = fs->file_table_size * 2;
+        while (new_size <= file_id)
+            new_size *= 2;
+
+        fs->files = realloc(fs->files, sizeof(guac_rdp_fs_file*) * new_size);
+        for (i=fs->file_table_size; i<new_size; i++)
+            fs->files[i] = NULL;
+
+        fs->file_table_size = new_size;
+
+    }
+
+    /* Allocate file structure if never before used */
+    file = fs->files[file_id];
+    if (file == NULL) {
+        file = fs->files[file_id] = malloc(sizeof(guac_rdp_fs_file));
+        file->read_buffer = NULL;
+        file->write_buffer = NULL;
+        pthread_mutex_init(&(file->buffer_lock), NULL);
+    }
+
+    /* Init identity and buffers before other handles may see the file */
+    file->device = stat_result == 0 ? file_stat.st_dev : 0;
+    file->inode  = stat_result == 0 ? file_stat.st_ino : 0;
+    file->read_buffer_offset = 0;
+    file->read_buffer_length = 0;
+    file->next_read_offset = 0;
+    file->write_buffer_offset = 0;
+    file->write_buffer_length = 0;
+    file->deferred_error = 0;
+
+    /* Init file */
     file->id = file_id;
     file->fd  = fd;
-    file->dir = NULL;
+    fs->open_files++;
+    pthread_mutex_unlock(&(fs->lock));
+
+    file->flags = flags;
+    file->dir_snapshot = NULL;
+    file->dir_index = 0;
     file->dir_pattern[0] = '\0';
     file->absolute_path = strdup(normalized_path);
     file->real_path = strdup(real_path);
@@ -295,8 +770,8 @@ int guac_rdp_fs_open(guac_rdp_fs* fs, const char* path,
 
     GUAC_RDP_DEBUG(2, "Opened \"%s\" as file_id=%i", normalized_path, file_id);
 
-    /* Attempt to pull file information */
-    if (fstat(fd, &file_stat) == 0) {
+    /* Load file information, if available */
+    if (stat_result == 0) {
 
         /* Load size and times */
         file->size  = file_stat.st_size;
@@ -324,13 +799,101 @@ int guac_rdp_fs_open(guac_rdp_fs* fs, const char* path,
 
     }
 
-    fs->open_files++;
-
     return file_id;
 
 }
 
-int guac_rdp_fs_read(guac_rdp_fs* fs, int file_id, int offset,
+/**
+ * Reads up to the given length of bytes from the given offset within the
+ * given file, using the read-ahead buffer of the file where possible.
+ * Returns the number of bytes read, zero on EOF, or an error code if an
+ * error occurs. The buffer lock of the file must be held.
+ */
+static int __guac_rdp_fs_read(guac_rdp_fs_file* file, uint64_t offset,
+        void* buffer, int length) {
+
+    int result;
+    int bytes_read = 0;
+
+    /* Buffered writes must be visible to reads */
+    result = __guac_rdp_fs_flush(file);
+    if (result)
+        return result;
+
+    /* Read directly unless reading a read-only file sequentially or from
+     * data already read ahead */
+    if ((file->flags & O_ACCMODE) != O_RDONLY
+            || (offset != file->next_read_offset
+                && (offset < file->read_buffer_offset
+                    || offset >= file->read_buffer_offset
+                               + file->read_buffer_length))) {
+
+        bytes_read = pread(file->fd, buffer, length, offset);
+
+        /* Translate errno on error */
+        if (bytes_read < 0)
+            return guac_rdp_fs_get_errorcode(errno);
+
+        file->next_read_offset = offset + bytes_read;
+        return bytes_read;
+
+    }
+
+    /* Otherwise, read through read-ahead buffer */
+    while (bytes_read < length) {
+
+        int available;
+        uint64_t current = offset + bytes_read;
+
+        /* Refill buffer if requested data not present */
+        if (current < file->read_buffer_offset
+                || current >= file->read_buffer_offset
+                            + file->read_buffer_length) {
+
+            int buffered;
+
+            if (file->read_buffer == NULL)
+                file->read_buffer = malloc(GUAC_RDP_FS_BUFFER_SIZE);
+
+            buffered = pread(file->fd, file->read_buffer,
+                    GUAC_RDP_FS_BUFFER_SIZE, current);
+
+            /* Translate errno on error */
+            if (buffered < 0) {
+                file->read_buffer_length = 0;
+                return guac_rdp_fs_get_errorcode(errno);
+            }
+
+            file->read_buffer_offset = current;
+            file->read_buffer_length = buffered;
+
+            /* Stop at EOF */
+            if (buffered == 0)
+                break;
+
+        }
+
+        /* Copy as much as possible from buffer */
+        available = file->read_buffer_offset + file->read_buffer_length
+                  - current;
+
+        if (available > length - bytes_read)
+            available = length - bytes_read;
+
+        memcpy((char*) buffer + bytes_read,
+                file->read_buffer + (current - file->read_buffer_offset),
+                available);
+
+        bytes_read += available;
+
+    }
+
+    file->next_read_offset = offset + bytes_read;
+    return bytes_read;
+
+}
+
+int guac_rdp_fs_read(guac_rdp_fs* fs, int file_id, uint64_t offset,
         void* buffer, int length) {
 
     int bytes_read;
@@ -341,19 +904,92 @@ int guac_rdp_fs_read(guac_rdp_fs* fs, int file_id, int offset,
         return GUAC_RDP_FS_EINVAL;
     }
 
-    /* Attempt read */
-    lseek(file->fd, offset, SEEK_SET);
-    bytes_read = read(file->fd, buffer, length);
+    /* Writes buffered by other handles of the same file must be visible */
+    if (__guac_rdp_fs_sync_handles(fs, file, 0)) {
+        pthread_mutex_lock(&(file->buffer_lock));
+        file->read_buffer_length = 0;
+        pthread_mutex_unlock(&(file->buffer_lock));
+    }
+
+    pthread_mutex_lock(&(file->buffer_lock));
+    bytes_read = __guac_rdp_fs_read(file, offset, buffer, length);
+    pthread_mutex_unlock(&(file->buffer_lock));
+
+    return bytes_read;
+
+}
+
+/**
+ * Writes the given length of bytes at the given offset within the given
+ * file, collecting small sequential writes within the write-behind buffer of
+ * the file if write-behind is enabled for the given filesystem. Returns the
+ * number of bytes written, or an error code if an error occurs. The buffer
+ * lock of the file must be held.
+ */
+static int __guac_rdp_fs_write(guac_rdp_fs* fs, guac_rdp_fs_file* file,
+        uint64_t offset,
+        void* buffer, int length) {
+
+    int result;
+    int bytes_written;
+
+    /* Report failure to write data flushed through another handle */
+    if (file->deferred_error) {
+        result = file->deferred_error;
+        file->deferred_error = 0;
+        return result;
+    }
+
+    /* Previously read-ahead data may now be invalid */
+    file->read_buffer_length = 0;
+
+    /* Append to write-behind buffer if sequential and space remains */
+    if (file->write_buffer_length > 0
+            && offset == file->write_buffer_offset + file->write_buffer_length
+            && file->write_buffer_length + length <= GUAC_RDP_FS_BUFFER_SIZE) {
+
+        memcpy(file->write_buffer + file->write_buffer_length,
+                buffer, length);
+
+        file->write_buffer_length += length;
+        file->bytes_written += length;
+        return length;
+
+    }
+
+    /* Otherwise, write any previously-buffered data */
+    result = __guac_rdp_fs_flush(file);
+    if (result)
+        return result;
+
+    /* Begin buffering again if enabled and data is small enough */
+    if (fs->write_behind && length < GUAC_RDP_FS_BUFFER_SIZE) {
+
+        if (file->write_buffer == NULL)
+            file->write_buffer = malloc(GUAC_RDP_FS_BUFFER_SIZE);
+
+        memcpy(file->write_buffer, buffer, length);
+        file->write_buffer_offset = offset;
+        file->write_buffer_length = length;
+
+        file->bytes_written += length;
+        return length;
+
+    }
+
+    /* Write large blocks directly */
+    bytes_written = pwrite(file->fd, buffer, length, offset);
 
     /* Translate errno on error */
-    if (bytes_read < 0)
+    if (bytes_written < 0)
         return guac_rdp_fs_get_errorcode(errno);
 
-    return bytes_read;
+    file->bytes_written += bytes_written;
+    return bytes_written;
 
 }
 
-int guac_rdp_fs_write(guac_rdp_fs* fs, int file_id, int offset,
+int guac_rdp_fs_write(guac_rdp_fs* fs, int file_id, uint64_t offset,
         void* buffer, int length) {
 
     int bytes_written;
@@ -364,19 +1000,48 @@ int guac_rdp_fs_write(guac_rdp_fs* fs, int file_id, int offset,
         return GUAC_RDP_FS_EINVAL;
     }
 
-    /* Attempt write */
-    lseek(file->fd, offset, SEEK_SET);
-    bytes_written = write(file->fd, buffer, length);
+    /* Earlier writes buffered by other handles must not overwrite this data */
+    __guac_rdp_fs_sync_handles(fs, file, 0);
 
-    /* Translate errno on error */
-    if (bytes_written < 0)
-        return guac_rdp_fs_get_errorcode(errno);
+    pthread_mutex_lock(&(file->buffer_lock));
+    bytes_written = __guac_rdp_fs_write(fs, file, offset, buffer, length);
+    pthread_mutex_unlock(&(file->buffer_lock));
+
+    /* Data read ahead by other handles may now be invalid */
+    __guac_rdp_fs_sync_handles(fs, file, 1);
+
+    /* Size of file within cached directory listings may have changed */
+    __guac_rdp_fs_invalidate_dirs(fs);
 
-    file->bytes_written += bytes_written;
     return bytes_written;
 
 }
 
+int guac_rdp_fs_flush(guac_rdp_fs* fs, int file_id) {
+
+    int result;
+
+    guac_rdp_fs_file* file = guac_rdp_fs_get_file(fs, file_id);
+    if (file == NULL) {
+        GUAC_RDP_DEBUG(1, "Flush of bad file_id: %i", file_id);
+        return GUAC_RDP_FS_EINVAL;
+    }
+
+    pthread_mutex_lock(&(file->buffer_lock));
+
+    result = __guac_rdp_fs_flush(file);
+
+    /* Report failure to write data flushed through another handle */
+    if (!result)
+        result = file->deferred_error;
+
+    file->deferred_error = 0;
+
+    pthread_mutex_unlock(&(file->buffer_lock));
+    return result;
+
+}
+
 int guac_rdp_fs_rename(guac_rdp_fs* fs, int file_id,
         const char* new_path) {
 
@@ -407,6 +1072,7 @@ int guac_rdp_fs_rename(guac_rdp_fs* fs, int file_id,
         return guac_rdp_fs_get_errorcode(errno);
     }
 
+    __guac_rdp_fs_invalidate_dirs(fs);
     return 0;
 
 }
@@ -434,11 +1100,14 @@ int guac_rdp_fs_delete(guac_rdp_fs* fs, int file_id) {
         return guac_rdp_fs_get_errorcode(errno);
     }
 
+    __guac_rdp_fs_invalidate_dirs(fs);
     return 0;
 
 }
 
-int guac_rdp_fs_truncate(guac_rdp_fs* fs, int file_id, int length) {
+int guac_rdp_fs_truncate(guac_rdp_fs* fs, int file_id, uint64_t length) {
+
+    int result;
 
     /* Get file */
     guac_rdp_fs_file* file = guac_rdp_fs_get_file(fs, file_id);
@@ -447,77 +1116,139 @@ int guac_rdp_fs_truncate(guac_rdp_fs* fs, int file_id, int length) {
         return GUAC_RDP_FS_EINVAL;
     }
 
+    /* Write data buffered by other handles before truncating */
+    __guac_rdp_fs_sync_handles(fs, file, 0);
+
+    pthread_mutex_lock(&(file->buffer_lock));
+
+    /* Write buffered data before truncating */
+    result = __guac_rdp_fs_flush(file);
+
+    /* Previously read-ahead data may now be invalid */
+    file->read_buffer_length = 0;
+
     /* Attempt truncate */
-    if (ftruncate(file->fd, length)) {
-        GUAC_RDP_DEBUG(1, "ftruncate() to %i bytes failed: \"%s\"",
+    if (!result && ftruncate(file->fd, length)) {
+        GUAC_RDP_DEBUG(1, "ftruncate() to %" PRIu64 " bytes failed: \"%s\"",
                 length, file->real_path);
-        return guac_rdp_fs_get_errorcode(errno);
+        result = guac_rdp_fs_get_errorcode(errno);
     }
 
+    pthread_mutex_unlock(&(file->buffer_lock));
+
+    if (result)
+        return result;
+
+    /* Data read ahead by other handles may now be invalid */
+    __guac_rdp_fs_sync_handles(fs, file, 1);
+
+    __guac_rdp_fs_invalidate_dirs(fs);
     return 0;
 
 }
 
-void guac_rdp_fs_close(guac_rdp_fs* fs, int file_id) {
+int guac_rdp_fs_close(guac_rdp_fs* fs, int file_id) {
+
+    int fd;
+    int result;
 
     guac_rdp_fs_file* file = guac_rdp_fs_get_file(fs, file_id);
     if (file == NULL) {
         GUAC_RDP_DEBUG(2, "Ignoring close for bad file_id: %i",
                 file_id);
-        return;
+        return GUAC_RDP_FS_EINVAL;
     }
 
-    file = &(fs->files[file_id]);
-
     GUAC_RDP_DEBUG(2, "Closed \"%s\" (file_id=%i)",
             file->absolute_path, file_id);
 
-    /* Close directory, if open */
-    if (file->dir != NULL)
-        closedir(file->dir);
+    /* Write any buffered data, reporting any failure not yet reported */
+    pthread_mutex_lock(&(file->buffer_lock));
 
-    /* Close file */
-    close(file->fd);
+    result = __guac_rdp_fs_flush(file);
+    if (!result)
+        result = file->deferred_error;
+
+    file->deferred_error = 0;
+
+    pthread_mutex_unlock(&(file->buffer_lock));
+
+    if (result)
+        GUAC_RDP_DEBUG(1, "Buffered data lost on close of \"%s\"",
+                file->absolute_path);
 
     /* Free name */
     free(file->absolute_path);
     free(file->real_path);
 
+    pthread_mutex_lock(&(fs->lock));
+
+    /* Release directory snapshot, if any */
+    if (file->dir_snapshot != NULL)
+        __guac_rdp_fs_release_snapshot(file->dir_snapshot);
+
+    /* Mark file closed */
+    fd = file->fd;
+    file->fd = -1;
+
     /* Free ID back to pool */
     guac_pool_free_int(fs->file_id_pool, file_id);
     fs->open_files--;
 
-}
+    pthread_mutex_unlock(&(fs->lock));
 
-const char* guac_rdp_fs_read_dir(guac_rdp_fs* fs, int file_id) {
+    /* Close file outside lock, as close() may block on network filesystems */
+    if (close(fd) && !result)
+        result = guac_rdp_fs_get_errorcode(errno);
 
-    guac_rdp_fs_file* file;
+    return result;
+
+}
 
-    struct dirent* result;
+const guac_rdp_fs_dir_entry* guac_rdp_fs_read_dir(guac_rdp_fs* fs,
+        int file_id) {
 
-    /* Only read if file ID is valid */
-    if (file_id < 0 || file_id >= GUAC_RDP_FS_MAX_FILES)
-        return NULL;
+    guac_rdp_fs_dir_snapshot* snapshot;
 
-    file = &(fs->files[file_id]);
+    guac_rdp_fs_file* file = guac_rdp_fs_get_file(fs, file_id);
+    if (file == NULL)
+        return NULL;
 
-    /* Open directory if not yet open, stop if error */
-    if (file->dir == NULL) {
-        file->dir = fdopendir(file->fd);
-        if (file->dir == NULL)
+    /* Take snapshot of directory if not yet read, stop if error */
+    if (file->dir_snapshot == NULL) {
+        pthread_mutex_lock(&(fs->lock));
+        file->dir_snapshot = __guac_rdp_fs_get_snapshot(fs, file);
+        pthread_mutex_unlock(&(fs->lock));
+        file->dir_index = 0;
+        if (file->dir_snapshot == NULL)
             return NULL;
     }
 
-    /* Read next entry, stop if error */
-    if (readdir_r(file->dir, &(file->__dirent), &result))
-        return NULL;
-
     /* If no more entries, return NULL */
-    if (result == NULL)
+    snapshot = file->dir_snapshot;
+    if (file->dir_index >= snapshot->entry_count)
         return NULL;
 
-    /* Return filename */
-    return file->__dirent.d_name;
+    /* Return next entry */
+    return &(snapshot->entries[file->dir_index++]);
+
+}
+
+void guac_rdp_fs_rewind_dir(guac_rdp_fs* fs, int file_id) {
+
+    guac_rdp_fs_file* file = guac_rdp_fs_get_file(fs, file_id);
+    if (file == NULL)
+        return;
+
+    /* Release current snapshot, such that the next read takes a new one */
+    if (file->dir_snapshot != NULL) {
+        pthread_mutex_lock(&(fs->lock));
+        __guac_rdp_fs_release_snapshot(file->dir_snapshot);
+        pthread_mutex_unlock(&(fs->lock));
+        file->dir_snapshot = NULL;
+    }
+
+    file->dir_index = 0;
 
 }
 
@@ -632,12 +1363,19 @@ int guac_rdp_fs_convert_path(const char* parent, const char* rel_path, char* abs
 
 guac_rdp_fs_file* guac_rdp_fs_get_file(guac_rdp_fs* fs, int file_id) {
 
-    /* Validate ID */
-    if (file_id < 0 || file_id >= GUAC_RDP_FS_MAX_FILES)
-        return NULL;
+    guac_rdp_fs_file* file = NULL;
+
+    pthread_mutex_lock(&(fs->lock));
+
+    /* Return file at given ID, if valid and open */
+    if (file_id >= 0 && file_id < fs->file_table_size) {
+        file = fs->files[file_id];
+        if (file != NULL && file->fd == -1)
+            file = NULL;
+    }
 
-    /* Return file at given ID */
-    return &(fs->files[file_id]);
+    pthread_mutex_unlock(&(fs->lock));
+    return file;
 
 }
 
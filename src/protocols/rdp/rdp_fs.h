@@ -38,15 +38,34 @@
 #include "config.h"
 
 #include <dirent.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <sys/types.h>
+#include <time.h>
 
 #include <guacamole/pool.h>
 
 /**
- * The maximum number of file IDs to provide.
+ * The maximum number of file IDs to provide. The file table grows as needed
+ * up to this size.
  */
-#define GUAC_RDP_FS_MAX_FILES 128
+#define GUAC_RDP_FS_MAX_FILES 4096
+
+/**
+ * The number of entries initially allocated within the file table.
+ */
+#define GUAC_RDP_FS_INITIAL_FILES 32
+
+/**
+ * The size of the read-ahead and write-behind buffers allocated for files
+ * which are read or written sequentially, in bytes.
+ */
+#define GUAC_RDP_FS_BUFFER_SIZE 262144
+
+/**
+ * The maximum number of directory snapshots to cache.
+ */
+#define GUAC_RDP_FS_DIR_CACHE_SIZE 8
 
 /**
  * The maximum number of bytes in a path string.
@@ -184,6 +203,102 @@
  */
 #define WINDOWS_TIME(t) ((t - ((uint64_t) 11644473600)) * 10000000)
 
+/**
+ * The name and metadata of a single entry within a directory, as would be
+ * reported by a directory query.
+ */
+typedef struct guac_rdp_fs_dir_entry {
+
+    /**
+     * The name of this entry, not including the path of its directory.
+     */
+    char* name;
+
+    /**
+     * Bitwise OR of all associated Windows file attributes.
+     */
+    int attributes;
+
+    /**
+     * The size of this entry, in bytes.
+     */
+    uint64_t size;
+
+    /**
+     * The time this entry was created, as a Windows timestamp.
+     */
+    uint64_t ctime;
+
+    /**
+     * The time this entry was last modified, as a Windows timestamp.
+     */
+    uint64_t mtime;
+
+    /**
+     * The time this entry was last accessed, as a Windows timestamp.
+     */
+    uint64_t atime;
+
+} guac_rdp_fs_dir_entry;
+
+/**
+ * The contents of a directory at a point in time, gathered with a single pass
+ * over the directory. Snapshots are cached by the filesystem and shared
+ * between all files enumerating the same directory.
+ */
+typedef struct guac_rdp_fs_dir_snapshot {
+
+    /**
+     * The device containing the directory.
+     */
+    dev_t device;
+
+    /**
+     * The inode of the directory.
+     */
+    ino_t inode;
+
+    /**
+     * The modification time of the directory when this snapshot was taken.
+     */
+    struct timespec mtime;
+
+    /**
+     * The inotify watch descriptor of the directory, or -1 if the directory
+     * is not being watched.
+     */
+    int watch;
+
+    /**
+     * Non-zero if the directory may have changed since this snapshot was
+     * taken, zero otherwise.
+     */
+    int stale;
+
+    /**
+     * The number of references to this snapshot, including the reference
+     * held by the cache, if any.
+     */
+    int refcount;
+
+    /**
+     * The value of the filesystem cache clock when this snapshot was last
+     * used.
+     */
+    int last_used;
+
+    /**
+     * All entries within the directory.
+     */
+    guac_rdp_fs_dir_entry* entries;
+
+    /**
+     * The number of entries within the directory.
+     */
+    int entry_count;
+
+} guac_rdp_fs_dir_snapshot;
+
 /**
  * An arbitrary file on the virtual filesystem of the Guacamole drive.
  */
@@ -205,21 +320,91 @@ typedef struct guac_rdp_fs_file {
     char* real_path;
 
     /**
-     * Associated local file descriptor.
+     * Associated local file descriptor, or -1 if this file is not open.
      */
     int fd;
 
     /**
-     * Associated directory stream, if any. This field only applies
-     * if the file is being used as a directory.
+     * The flags passed to open() when this file was opened.
+     */
+    int flags;
+
+    /**
+     * The device containing the underlying file, used along with its inode
+     * to find other open handles of the same file.
+     */
+    dev_t device;
+
+    /**
+     * The inode of the underlying file, or zero if unknown.
+     */
+    ino_t inode;
+
+    /**
+     * Lock which guards the read-ahead and write-behind buffers of this file.
+     * As these buffers are flushed and invalidated by operations on other
+     * handles of the same file, this lock must be held while they are used.
+     * If the filesystem lock is also needed, it must be acquired first.
+     */
+    pthread_mutex_t buffer_lock;
+
+    /**
+     * Buffer containing data read ahead of the last read, or NULL if no data
+     * has yet been read ahead. Read-ahead is only used for files opened
+     * read-only.
+     */
+    unsigned char* read_buffer;
+
+    /**
+     * The offset within the file of the first byte in read_buffer.
+     */
+    uint64_t read_buffer_offset;
+
+    /**
+     * The number of valid bytes within read_buffer.
+     */
+    int read_buffer_length;
+
+    /**
+     * The offset immediately following the last byte read. Reads beginning
+     * at this offset are considered sequential, and will be read ahead.
+     */
+    uint64_t next_read_offset;
+
+    /**
+     * Buffer containing data written but not yet flushed to the file, or
+     * NULL if no data has yet been buffered.
+     */
+    unsigned char* write_buffer;
+
+    /**
+     * The offset within the file at which the data in write_buffer is to be
+     * written.
+     */
+    uint64_t write_buffer_offset;
+
+    /**
+     * The number of bytes within write_buffer awaiting flush.
+     */
+    int write_buffer_length;
+
+    /**
+     * The error which occurred when the buffered data of this file was
+     * written on behalf of another operation, or zero if no such error has
+     * occurred. This error is reported by the next write, flush or close.
      */
-    DIR* dir;
+    int deferred_error;
 
     /**
-     * The last read dirent structure. This is used if traversing the contents
-     * of a directory.
+     * Snapshot of the directory contents being traversed, if any. This field
+     * only applies if the file is being used as a directory.
      */
-    struct dirent __dirent;
+    guac_rdp_fs_dir_snapshot* dir_snapshot;
+
+    /**
+     * The index of the next entry within dir_snapshot to be read.
+     */
+    int dir_index;
 
     /**
      * The pattern the check directory contents against, if any.
@@ -234,7 +419,7 @@ typedef struct guac_rdp_fs_file {
     /**
      * The size of this file, in bytes.
      */
-    int size;
+    uint64_t size;
 
     /**
      * The time this file was created, as a Windows timestamp.
@@ -279,9 +464,48 @@ typedef struct guac_rdp_fs {
     guac_pool* file_id_pool;
 
     /**
-     * All available file structures.
+     * All file structures allocated thus far, indexed by file ID. Entries
+     * which have never been used are NULL.
+     */
+    guac_rdp_fs_file** files;
+
+    /**
+     * The number of entries within the files array.
+     */
+    int file_table_size;
+
+    /**
+     * Recently-read directory snapshots. Unused entries are NULL.
+     */
+    guac_rdp_fs_dir_snapshot* dir_cache[GUAC_RDP_FS_DIR_CACHE_SIZE];
+
+    /**
+     * Clock incremented each time a directory snapshot is used, for the sake
+     * of evicting the least-recently-used snapshot.
      */
-    guac_rdp_fs_file files[GUAC_RDP_FS_MAX_FILES];
+    int dir_cache_clock;
+
+    /**
+     * The inotify file descriptor used to detect changes to cached
+     * directories, or -1 if changes are detected only through directory
+     * modification times.
+     */
+    int inotify_fd;
+
+    /**
+     * Non-zero if small sequential writes are to be collected within the
+     * write-behind buffer of each file, zero if all writes are to be written
+     * immediately.
+     */
+    int write_behind;
+
+    /**
+     * Lock which guards the file table, file ID pool and directory cache,
+     * such that the filesystem may be used from multiple threads. The state
+     * of each individual file is not guarded; operations on the same file
+     * must not be performed concurrently.
+     */
+    pthread_mutex_t lock;
 
 } guac_rdp_fs;
 
@@ -308,9 +532,11 @@ typedef struct guac_rdp_fs_info {
 } guac_rdp_fs_info;
 
 /**
- * Allocates a new filesystem given a root path.
+ * Allocates a new filesystem given a root path. If write_behind is non-zero,
+ * small sequential writes are buffered, and any failure to write buffered
+ * data is reported by a later operation on the same file.
  */
-guac_rdp_fs* guac_rdp_fs_alloc(const char* drive_path);
+guac_rdp_fs* guac_rdp_fs_alloc(const char* drive_path, int write_behind);
 
 /**
  * Frees the given filesystem.
@@ -344,19 +570,34 @@ int guac_rdp_fs_open(guac_rdp_fs* fs, const char* path,
 /**
  * Reads up to the given length of bytes from the given offset within the
  * file having the given ID. Returns the number of bytes read, zero on EOF,
- * and an error code if an error occurs.
+ * and an error code if an error occurs. Sequential reads of files opened
+ * read-only are served from a read-ahead buffer.
  */
-int guac_rdp_fs_read(guac_rdp_fs* fs, int file_id, int offset,
+int guac_rdp_fs_read(guac_rdp_fs* fs, int file_id, uint64_t offset,
         void* buffer, int length);
 
 /**
  * Writes up to the given length of bytes from the given offset within the
  * file having the given ID. Returns the number of bytes written, and an
- * error code if an error occurs.
- */
-int guac_rdp_fs_write(guac_rdp_fs* fs, int file_id, int offset,
+ * error code if an error occurs. If write-behind is enabled, small sequential
+ * writes are collected within a write-behind buffer, which is flushed when
+ * the file is read, written, truncated, flushed or closed through any handle,
+ * when a directory is listed, or when a non-sequential write occurs. Errors
+ * which occur while flushing are returned by the operation causing the
+ * flush, or by the next write, flush or close of this file if caused through
+ * another handle.
+ */
+int guac_rdp_fs_write(guac_rdp_fs* fs, int file_id, uint64_t offset,
         void* buffer, int length);
 
+/**
+ * Writes any data within the write-behind buffer of the file having the
+ * given ID to the underlying file. Returns zero on success, or an error code
+ * if an error occurs, including any earlier failure to write buffered data
+ * not yet reported.
+ */
+int guac_rdp_fs_flush(guac_rdp_fs* fs, int file_id);
+
 /**
  * Renames (moves) the file with the given ID to the new path specified.
  * Returns zero on success, or an error code if an error occurs.
@@ -373,12 +614,15 @@ int guac_rdp_fs_delete(guac_rdp_fs* fs, int file_id);
  * Truncates the file with the given ID to the given length (in bytes), which
  * may be larger.
  */
-int guac_rdp_fs_truncate(guac_rdp_fs* fs, int file_id, int length);
+int guac_rdp_fs_truncate(guac_rdp_fs* fs, int file_id, uint64_t length);
 
 /**
  * Frees the given file ID, allowing future open operations to reuse it.
+ * Any buffered data is written first. Returns zero on success, or an error
+ * code if buffered data could not be written, in which case the file is
+ * still closed.
  */
-void guac_rdp_fs_close(guac_rdp_fs* fs, int file_id);
+int guac_rdp_fs_close(guac_rdp_fs* fs, int file_id);
 
 /**
  * Given an arbitrary path, which may contain ".." and ".", creates an
@@ -392,10 +636,20 @@ int guac_rdp_fs_normalize_path(const char* path, char* abs_path);
 int guac_rdp_fs_convert_path(const char* parent, const char* rel_path, char* abs_path);
 
 /**
- * Returns the next filename within the directory having the given file ID,
- * or NULL if no more files.
+ * Returns the next entry within the directory having the given file ID, or
+ * NULL if no more entries. Entries are read from a cached snapshot of the
+ * directory, such that the entries themselves need not be opened. The
+ * returned entry remains valid until the file is closed or rewound.
+ */
+const guac_rdp_fs_dir_entry* guac_rdp_fs_read_dir(guac_rdp_fs* fs,
+        int file_id);
+
+/**
+ * Restarts enumeration of the directory having the given file ID, such that
+ * the next call to guac_rdp_fs_read_dir() returns the first entry of an
+ * up-to-date snapshot of the directory.
  */
-const char* guac_rdp_fs_read_dir(guac_rdp_fs* fs, int file_id);
+void guac_rdp_fs_rewind_dir(guac_rdp_fs* fs, int file_id);
 
 /**
  * Returns the file having the given ID, or NULL if no such file exists.
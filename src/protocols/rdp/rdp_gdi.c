@@ -24,11 +24,21 @@
 
 #include "client.h"
 #include "rdp_bitmap.h"
+#include "rdp_cache_policy.h"
+#include "rdp_gdi.h"
+#include "rdp_input.h"
+#include "rdp_offscreen.h"
+#include "rdp_shadow.h"
 
 #include <pthread.h>
 #include <freerdp/freerdp.h>
+#include <freerdp/codec/rfx.h>
 #include <guacamole/client.h>
 
+#ifdef HAVE_FREERDP_NSCODEC
+#include <freerdp/codec/nsc.h>
+#endif
+
 #ifdef ENABLE_WINPR
 #include <winpr/wtypes.h>
 #else
@@ -93,6 +103,254 @@ guac_transfer_function guac_rdp_rop3_transfer_function(guac_client* client,
 
 }
 
+/**
+ * The standard 8x8 hatch patterns, in the order of their hatch indices. Each
+ * byte is one row of the pattern, with the most significant bit being the
+ * leftmost pixel. As with monochrome pattern brushes, cleared bits are drawn
+ * with the foreground color and set bits with the background color.
+ */
+static const unsigned char guac_rdp_hatch_patterns[6][8] = {
+    { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00 }, /* HS_HORIZONTAL */
+    { 0xF7, 0xF7, 0xF7, 0xF7, 0xF7, 0xF7, 0xF7, 0xF7 }, /* HS_VERTICAL   */
+    { 0xFE, 0xFD, 0xFB, 0xF7, 0xEF, 0xDF, 0xBF, 0x7F }, /* HS_FDIAGONAL  */
+    { 0x7F, 0xBF, 0xDF, 0xEF, 0xF7, 0xFB, 0xFD, 0xFE }, /* HS_BDIAGONAL  */
+    { 0xF7, 0xF7, 0xF7, 0x00, 0xF7, 0xF7, 0xF7, 0xF7 }, /* HS_CROSS      */
+    { 0x7E, 0xBD, 0xDB, 0xE7, 0xE7, 0xDB, 0xBD, 0x7E }  /* HS_DIACROSS   */
+};
+
+/**
+ * Expands the given monochrome 8x8 pattern into the given brush using the
+ * given colors.
+ */
+static void __guac_rdp_gdi_mono_brush(guac_rdp_shadow_brush* brush,
+        const unsigned char* pattern, uint32_t fore, uint32_t back) {
+
+    int row, col;
+
+    for (row = 0; row < GUAC_RDP_SHADOW_BRUSH_SIZE; row++) {
+        for (col = 0; col < GUAC_RDP_SHADOW_BRUSH_SIZE; col++)
+            brush->pattern[row][col] =
+                (pattern[row] & (0x80 >> col)) ? back : fore;
+    }
+
+}
+
+/**
+ * Expands the brush of the given PATBLT order into the given brush,
+ * converting all colors to 24-bit RGB. Returns zero on success, or non-zero
+ * if the brush style is not supported.
+ */
+static int __guac_rdp_gdi_brush(rdpContext* context, PATBLT_ORDER* patblt,
+        guac_rdp_shadow_brush* brush) {
+
+    guac_client* client = ((rdp_freerdp_context*) context)->client;
+    rdp_guac_client_data* data = (rdp_guac_client_data*) client->data;
+    CLRCONV* clrconv = ((rdp_freerdp_context*) context)->clrconv;
+
+    rdpBrush* source = &(patblt->brush);
+    int row, col;
+
+    uint32_t fore = freerdp_color_convert_var(patblt->foreColor,
+            data->settings.color_depth, 32, clrconv) & 0xFFFFFF;
+
+    uint32_t back = freerdp_color_convert_var(patblt->backColor,
+            data->settings.color_depth, 32, clrconv) & 0xFFFFFF;
+
+    brush->x = source->x;
+    brush->y = source->y;
+
+    switch (source->style) {
+
+        /* Solid brushes are the foreground color */
+        case GDI_BS_SOLID:
+            for (row = 0; row < GUAC_RDP_SHADOW_BRUSH_SIZE; row++)
+                for (col = 0; col < GUAC_RDP_SHADOW_BRUSH_SIZE; col++)
+                    brush->pattern[row][col] = fore;
+            return 0;
+
+        /* Standard hatch patterns */
+        case GDI_BS_HATCHED:
+
+            if (source->hatch >= sizeof(guac_rdp_hatch_patterns)
+                                 / sizeof(guac_rdp_hatch_patterns[0]))
+                return 1;
+
+            __guac_rdp_gdi_mono_brush(brush,
+                    guac_rdp_hatch_patterns[source->hatch], fore, back);
+            return 0;
+
+        /* Patterns, possibly restored from the brush cache */
+        case GDI_BS_PATTERN:
+
+            if (source->data == NULL)
+                return 1;
+
+            /* Monochrome patterns use the order's colors */
+            if (source->bpp <= 1) {
+                __guac_rdp_gdi_mono_brush(brush, source->data, fore, back);
+                return 0;
+            }
+
+            /* Color patterns are stored in the server's color depth */
+            else {
+
+                int bytes_per_pixel = (source->bpp + 7) / 8;
+                const unsigned char* pixel = source->data;
+
+                for (row = 0; row < GUAC_RDP_SHADOW_BRUSH_SIZE; row++) {
+                    for (col = 0; col < GUAC_RDP_SHADOW_BRUSH_SIZE; col++) {
+
+                        /* Read little-endian pixel */
+                        uint32_t value = 0;
+                        int i;
+                        for (i = bytes_per_pixel - 1; i >= 0; i--)
+                            value = (value << 8) | pixel[i];
+
+                        brush->pattern[row][col] = freerdp_color_convert_var(
+                                value, source->bpp, 32, clrconv) & 0xFFFFFF;
+
+                        pixel += bytes_per_pixel;
+
+                    }
+                }
+
+                return 0;
+
+            }
+
+    }
+
+    /* Unsupported style */
+    return 1;
+
+}
+
+/**
+ * Clips the source rectangle of an operation reading from the given bitmap
+ * to the bounds of that bitmap, adjusting the destination rectangle to
+ * match. Returns non-zero if nothing remains to be drawn.
+ */
+static int __guac_rdp_gdi_clip_source(guac_rdp_bitmap* bitmap,
+        int* x_src, int* y_src, int* x, int* y, int* w, int* h) {
+
+    int width = bitmap->bitmap.width;
+    int height = bitmap->bitmap.height;
+
+    /* Clip left and top, shifting destination */
+    if (*x_src < 0) {
+        *w += *x_src;
+        *x -= *x_src;
+        *x_src = 0;
+    }
+
+    if (*y_src < 0) {
+        *h += *y_src;
+        *y -= *y_src;
+        *y_src = 0;
+    }
+
+    /* Clip right and bottom */
+    if (*x_src + *w > width)
+        *w = width - *x_src;
+
+    if (*y_src + *h > height)
+        *h = height - *y_src;
+
+    return *w <= 0 || *h <= 0;
+
+}
+
+/**
+ * Returns the data of the given bitmap at the given coordinates, in 32-bit
+ * RGB with four bytes per pixel, or NULL if the current contents of the bitmap
+ * are known only to the client, as is the case for offscreen surfaces which
+ * are not composed server-side. The number of bytes in each row is stored in
+ * the given stride.
+ */
+static const unsigned char* __guac_rdp_gdi_bitmap_data(
+        guac_rdp_bitmap* bitmap, int x, int y, int* stride) {
+
+    /* Use server-side contents of offscreen surfaces */
+    if (bitmap->shadow != NULL) {
+        *stride = bitmap->shadow->stride;
+        return bitmap->shadow->buffer + y*bitmap->shadow->stride + 4*x;
+    }
+
+    if (bitmap->surface || bitmap->bitmap.data == NULL)
+        return NULL;
+
+    *stride = 4*bitmap->bitmap.width;
+    return bitmap->bitmap.data + 4*(x + y*bitmap->bitmap.width);
+
+}
+
+/**
+ * Evaluates the given ROP3 opcode against the shadow surface of the current
+ * surface, deferring only the resulting pixels if the current surface is the
+ * default layer, if all required inputs are known server-side. Returns
+ * non-zero if the operation was handled, or zero if the client must perform
+ * the operation itself.
+ */
+static int __guac_rdp_gdi_shadow_rop3(rdp_guac_client_data* data,
+        const guac_layer* layer, int rop3, int x, int y, int w, int h,
+        const unsigned char* src, int src_stride,
+        const guac_rdp_shadow_brush* brush) {
+
+    guac_rdp_shadow* shadow = data->current_shadow;
+
+    /* Only surfaces known server-side can be evaluated */
+    if (shadow == NULL)
+        return 0;
+
+    /* Source, pattern, and destination must be known if used */
+    if (guac_rdp_shadow_rop3_uses_source(rop3) && src == NULL)
+        return 0;
+
+    if (guac_rdp_shadow_rop3_uses_pattern(rop3) && brush == NULL)
+        return 0;
+
+    if (guac_rdp_shadow_rop3_uses_dest(rop3)
+            && !guac_rdp_shadow_is_valid(shadow, x, y, w, h))
+        return 0;
+
+    guac_rdp_shadow_rop3(shadow, rop3, x, y, w, h, src, src_stride, brush);
+
+    /* Send result unless drawn to a server-side offscreen surface */
+    if (layer != NULL)
+        guac_rdp_paint_shadow(data->paint, x, y, w, h);
+
+    return 1;
+
+}
+
+/**
+ * Returns the client-side layer of the current surface, first moving the
+ * current surface to the client if it is composed server-side. This must be
+ * invoked before any drawing which can only be performed client-side.
+ */
+static const guac_layer* __guac_rdp_gdi_client_surface(
+        rdp_guac_client_data* data) {
+
+    if (data->current_surface == NULL)
+        guac_rdp_offscreen_spill_current(data->offscreen);
+
+    return data->current_surface;
+
+}
+
+/**
+ * Marks the given rectangle of the shadow surface as unknown if the given
+ * layer is the default layer, as must be done whenever the client draws data
+ * to the default layer which is not known server-side.
+ */
+static void __guac_rdp_gdi_shadow_invalidate(rdp_guac_client_data* data,
+        const guac_layer* layer, int x, int y, int w, int h) {
+
+    if (data->shadow != NULL && layer == GUAC_DEFAULT_LAYER)
+        guac_rdp_shadow_invalidate(data->shadow, x, y, w, h);
+
+}
+
 void guac_rdp_gdi_dstblt(rdpContext* context, DSTBLT_ORDER* dstblt) {
 
     guac_client* client = ((rdp_freerdp_context*) context)->client;
@@ -114,23 +372,28 @@ void guac_rdp_gdi_dstblt(rdpContext* context, DSTBLT_ORDER* dstblt) {
         case 0:
 
             /* Send black rectangle */
-            guac_protocol_send_rect(client->socket, current_layer, x, y, w, h);
-
-            guac_protocol_send_cfill(client->socket,
-                    GUAC_COMP_OVER, current_layer,
-                    0, 0, 0, 255);
+            guac_rdp_paint_rect(data->paint, current_layer, x, y, w, h,
+                    0x000000);
 
             break;
 
         /* DSTINVERT */
         case 0x55:
 
-            /* Invert */
+            /* Invert server-side, if possible */
+            if (__guac_rdp_gdi_shadow_rop3(data, current_layer, 0x55,
+                        x, y, w, h, NULL, 0, NULL))
+                break;
+
+            /* Otherwise, invert client-side */
+            current_layer = __guac_rdp_gdi_client_surface(data);
+            guac_rdp_paint_flush(data->paint);
             guac_protocol_send_transfer(client->socket,
                     current_layer, x, y, w, h,
                     GUAC_TRANSFER_BINARY_NDEST,
                     current_layer, x, y);
 
+            __guac_rdp_gdi_shadow_invalidate(data, current_layer, x, y, w, h);
             break;
 
         /* NOP */
@@ -139,15 +402,17 @@ void guac_rdp_gdi_dstblt(rdpContext* context, DSTBLT_ORDER* dstblt) {
 
         /* Whiteness */
         case 0xFF:
-            guac_protocol_send_rect(client->socket, current_layer, x, y, w, h);
-
-            guac_protocol_send_cfill(client->socket,
-                    GUAC_COMP_OVER, current_layer,
-                    0xFF, 0xFF, 0xFF, 0xFF);
+            guac_rdp_paint_rect(data->paint, current_layer, x, y, w, h,
+                    0xFFFFFF);
             break;
 
-        /* Unsupported ROP3 */
+        /* Evaluate any other ROP3 server-side */
         default:
+
+            if (__guac_rdp_gdi_shadow_rop3(data, current_layer, dstblt->bRop,
+                        x, y, w, h, NULL, 0, NULL))
+                break;
+
             guac_client_log_info(client,
                     "guac_rdp_gdi_dstblt(rop3=0x%x)", dstblt->bRop);
 
@@ -158,14 +423,12 @@ void guac_rdp_gdi_dstblt(rdpContext* context, DSTBLT_ORDER* dstblt) {
 void guac_rdp_gdi_patblt(rdpContext* context, PATBLT_ORDER* patblt) {
 
     /*
-     * Note that this is not a full implementation of PATBLT. This is a
-     * fallback implementation which only renders a solid block of background
-     * color using the specified ROP3 operation, ignoring whatever brush
-     * was actually specified.
-     *
      * As libguac-client-rdp explicitly tells the server not to send PATBLT,
-     * well-behaved RDP servers will not use this operation at all, while
-     * others will at least have a fallback.
+     * well-behaved RDP servers will not use this operation at all. When it is
+     * used against a surface whose contents are known server-side, the brush
+     * and ROP3 are evaluated fully against that surface's shadow. Otherwise,
+     * this falls back to rendering a solid block of foreground color,
+     * ignoring whatever brush was actually specified.
      */
 
     /* Get client and current layer */
@@ -180,9 +443,23 @@ void guac_rdp_gdi_patblt(rdpContext* context, PATBLT_ORDER* patblt) {
 
     rdp_guac_client_data* data = (rdp_guac_client_data*) client->data;
 
+    /* Expanded brush, if supported */
+    guac_rdp_shadow_brush brush;
+    int brush_supported;
+
     /* Layer for actual transfer */
     guac_layer* buffer;
 
+    /* Clip operation to bounds */
+    if (guac_rdp_clip_rect(data, &x, &y, &w, &h))
+        return;
+
+    /* Evaluate server-side, if possible */
+    brush_supported = !__guac_rdp_gdi_brush(context, patblt, &brush);
+    if (__guac_rdp_gdi_shadow_rop3(data, current_layer, patblt->bRop,
+                x, y, w, h, NULL, 0, brush_supported ? &brush : NULL))
+        return;
+
     /*
      * Warn that rendering is a fallback, as the server should not be sending
      * this order.
@@ -190,9 +467,11 @@ void guac_rdp_gdi_patblt(rdpContext* context, PATBLT_ORDER* patblt) {
     guac_client_log_info(client, "Using fallback PATBLT (server is ignoring "
             "negotiated client capabilities)");
 
-    /* Clip operation to bounds */
-    if (guac_rdp_clip_rect(data, &x, &y, &w, &h))
-        return;
+    /* Fallback rendering is performed client-side */
+    current_layer = __guac_rdp_gdi_client_surface(data);
+
+    /* Send deferred drawing first */
+    guac_rdp_paint_flush(data->paint);
 
     /* Render rectangle based on ROP */
     switch (patblt->bRop) {
@@ -263,6 +542,9 @@ void guac_rdp_gdi_patblt(rdpContext* context, PATBLT_ORDER* patblt) {
 
     }
 
+    /* Fallback rendering is only approximate */
+    __guac_rdp_gdi_shadow_invalidate(data, current_layer, x, y, w, h);
+
 }
 
 void guac_rdp_gdi_scrblt(rdpContext* context, SCRBLT_ORDER* scrblt) {
@@ -287,11 +569,37 @@ void guac_rdp_gdi_scrblt(rdpContext* context, SCRBLT_ORDER* scrblt) {
     x_src += x - scrblt->nLeftRect;
     y_src += y - scrblt->nTopRect;
 
+    /* Compose server-side surfaces locally if screen contents are known */
+    if (current_layer == NULL) {
+
+        guac_rdp_shadow* shadow = data->shadow;
+
+        if (shadow != NULL
+                && x_src >= 0 && y_src >= 0
+                && x_src + w <= shadow->width
+                && y_src + h <= shadow->height
+                && guac_rdp_shadow_is_valid(shadow, x_src, y_src, w, h)) {
+            guac_rdp_shadow_draw(data->current_shadow, x, y, w, h,
+                    shadow->buffer + y_src*shadow->stride + 4*x_src,
+                    shadow->stride);
+            return;
+        }
+
+        /* Otherwise, copy client-side */
+        current_layer = __guac_rdp_gdi_client_surface(data);
+
+    }
+
     /* Copy screen rect to current surface */
+    guac_rdp_paint_flush(data->paint);
     guac_protocol_send_copy(client->socket,
             GUAC_DEFAULT_LAYER, x_src, y_src, w, h,
             GUAC_COMP_OVER, current_layer, x, y);
 
+    /* Mirror copies within the default layer */
+    if (data->shadow != NULL && current_layer == GUAC_DEFAULT_LAYER)
+        guac_rdp_shadow_copy(data->shadow, x_src, y_src, w, h, x, y);
+
 }
 
 void guac_rdp_gdi_memblt(rdpContext* context, MEMBLT_ORDER* memblt) {
@@ -309,6 +617,10 @@ void guac_rdp_gdi_memblt(rdpContext* context, MEMBLT_ORDER* memblt) {
     int x_src = memblt->nXSrc;
     int y_src = memblt->nYSrc;
 
+    /* Source image data, if known server-side */
+    const unsigned char* src;
+    int src_stride = 0;
+
     rdp_guac_client_data* data = (rdp_guac_client_data*) client->data;
 
     /* Make sure that the recieved bitmap is not NULL before processing */
@@ -325,15 +637,18 @@ void guac_rdp_gdi_memblt(rdpContext* context, MEMBLT_ORDER* memblt) {
     x_src += x - memblt->nLeftRect;
     y_src += y - memblt->nTopRect;
 
+    /* Read only within the bounds of the source bitmap */
+    if (__guac_rdp_gdi_clip_source(bitmap, &x_src, &y_src, &x, &y, &w, &h))
+        return;
+
+    src = __guac_rdp_gdi_bitmap_data(bitmap, x_src, y_src, &src_stride);
+
     switch (memblt->bRop) {
 
         /* If blackness, send black rectangle */
         case 0x00:
-            guac_protocol_send_rect(client->socket, current_layer, x, y, w, h);
-
-            guac_protocol_send_cfill(client->socket,
-                    GUAC_COMP_OVER, current_layer,
-                    0x00, 0x00, 0x00, 0xFF);
+            guac_rdp_paint_rect(data->paint, current_layer, x, y, w, h,
+                    0x000000);
             break;
 
         /* If NOP, do nothing */
@@ -343,36 +658,75 @@ void guac_rdp_gdi_memblt(rdpContext* context, MEMBLT_ORDER* memblt) {
         /* If operation is just SRC, simply copy */
         case 0xCC: 
 
-            /* If not cached, cache if necessary */
-            if (((guac_rdp_bitmap*) bitmap)->layer == NULL
-                    && ((guac_rdp_bitmap*) bitmap)->used >= 1)
-                guac_rdp_cache_bitmap(context, memblt->bitmap);
+            /* Compose server-side surfaces locally if source is known */
+            if (current_layer == NULL && src != NULL) {
 
-            /* If not cached, send as PNG */
-            if (bitmap->layer == NULL) {
-                if (memblt->bitmap->data != NULL) {
+                /* Copies within a surface may overlap */
+                if (bitmap->shadow == data->current_shadow)
+                    guac_rdp_shadow_copy(bitmap->shadow,
+                            x_src, y_src, w, h, x, y);
+                else
+                    guac_rdp_shadow_draw(data->current_shadow, x, y, w, h,
+                            src, src_stride);
+
+                bitmap->used++;
+                break;
+
+            }
 
-                    /* Create surface from image data */
-                    cairo_surface_t* surface = cairo_image_surface_create_for_data(
-                        memblt->bitmap->data + 4*(x_src + y_src*memblt->bitmap->width),
-                        CAIRO_FORMAT_RGB24, w, h, 4*memblt->bitmap->width);
+            /* Send only the copied portion of server-side surfaces */
+            if (bitmap->shadow != NULL) {
+                guac_rdp_offscreen_touch(data->offscreen, bitmap);
+                guac_rdp_paint_image(data->paint, current_layer,
+                        x, y, w, h, src, src_stride);
+                bitmap->used++;
+                break;
+            }
 
-                    /* Send surface to buffer */
-                    guac_protocol_send_png(socket,
-                            GUAC_COMP_OVER, current_layer,
-                            x, y, surface);
+            /* Otherwise, copy client-side */
+            current_layer = __guac_rdp_gdi_client_surface(data);
 
-                    /* Free surface */
-                    cairo_surface_destroy(surface);
+            /* If not cached, cache if worthwhile */
+            if (bitmap->layer == NULL
+                    && guac_rdp_cache_policy_should_cache(data->cache_policy,
+                        bitmap, w, h))
+                guac_rdp_cache_bitmap(context, memblt->bitmap);
 
+            /* If not cached, send as PNG at end of paint */
+            if (bitmap->layer == NULL) {
+                if (memblt->bitmap->data != NULL) {
+                    guac_rdp_paint_image(data->paint, current_layer,
+                            x, y, w, h,
+                            memblt->bitmap->data
+                                + 4*(x_src + y_src*memblt->bitmap->width),
+                            4*memblt->bitmap->width);
+                    guac_rdp_cache_policy_draw_inline(data->cache_policy,
+                            bitmap, w, h);
                 }
             }
 
             /* Otherwise, copy */
-            else
+            else {
+
+                guac_rdp_paint_flush(data->paint);
                 guac_protocol_send_copy(socket,
                         bitmap->layer, x_src, y_src, w, h,
                         GUAC_COMP_OVER, current_layer, x, y);
+                guac_rdp_cache_policy_draw_cached(data->cache_policy,
+                        bitmap);
+
+                /* Mirror copied data, if known */
+                if (data->shadow != NULL
+                        && current_layer == GUAC_DEFAULT_LAYER) {
+                    if (src != NULL)
+                        guac_rdp_shadow_draw(data->shadow, x, y, w, h,
+                                src, src_stride);
+                    else
+                        guac_rdp_shadow_invalidate(data->shadow,
+                                x, y, w, h);
+                }
+
+            }
 
             /* Increment usage counter */
             ((guac_rdp_bitmap*) bitmap)->used++;
@@ -381,16 +735,33 @@ void guac_rdp_gdi_memblt(rdpContext* context, MEMBLT_ORDER* memblt) {
 
         /* If whiteness, send white rectangle */
         case 0xFF:
-            guac_protocol_send_rect(client->socket, current_layer, x, y, w, h);
-
-            guac_protocol_send_cfill(client->socket,
-                    GUAC_COMP_OVER, current_layer,
-                    0xFF, 0xFF, 0xFF, 0xFF);
+            guac_rdp_paint_rect(data->paint, current_layer, x, y, w, h,
+                    0xFFFFFF);
             break;
 
-        /* Otherwise, use transfer */
+        /* Otherwise, evaluate server-side or use transfer */
         default:
 
+            /* Source must not change while being read */
+            if (bitmap->shadow != NULL
+                    && bitmap->shadow == data->current_shadow)
+                src = NULL;
+
+            /* Send only the result, if it can be computed locally */
+            if (__guac_rdp_gdi_shadow_rop3(data, current_layer, memblt->bRop,
+                        x, y, w, h, src, src_stride, NULL)) {
+                guac_rdp_cache_policy_draw_inline(data->cache_policy,
+                        bitmap, w, h);
+                bitmap->used++;
+                break;
+            }
+
+            /* Otherwise, both source and destination must be client-side */
+            current_layer = __guac_rdp_gdi_client_surface(data);
+            guac_rdp_offscreen_spill(data->offscreen, bitmap);
+
+            guac_rdp_paint_flush(data->paint);
+
             /* If not available as a surface, make available. */
             if (bitmap->layer == NULL)
                 guac_rdp_cache_bitmap(context, memblt->bitmap);
@@ -400,6 +771,9 @@ void guac_rdp_gdi_memblt(rdpContext* context, MEMBLT_ORDER* memblt) {
                     guac_rdp_rop3_transfer_function(client, memblt->bRop),
                     current_layer, x, y);
 
+            guac_rdp_cache_policy_draw_cached(data->cache_policy, bitmap);
+            __guac_rdp_gdi_shadow_invalidate(data, current_layer, x, y, w, h);
+
             /* Increment usage counter */
             ((guac_rdp_bitmap*) bitmap)->used++;
 
@@ -430,14 +804,9 @@ void guac_rdp_gdi_opaquerect(rdpContext* context, OPAQUE_RECT_ORDER* opaque_rect
     if (guac_rdp_clip_rect(data, &x, &y, &w, &h))
         return;
 
-    guac_protocol_send_rect(client->socket, current_layer, x, y, w, h);
-
-    guac_protocol_send_cfill(client->socket,
-            GUAC_COMP_OVER, current_layer,
-            (color >> 16) & 0xFF,
-            (color >> 8 ) & 0xFF,
-            (color      ) & 0xFF,
-            255);
+    /* Fill rectangle at end of paint */
+    guac_rdp_paint_rect(data->paint, current_layer, x, y, w, h,
+            color & 0xFFFFFF);
 
 }
 
@@ -473,7 +842,155 @@ void guac_rdp_gdi_set_bounds(rdpContext* context, rdpBounds* bounds) {
 
 }
 
+/**
+ * Decodes the given RemoteFX surface bits, deferring the drawing of each
+ * decoded tile, clipped to the rectangles updated by the message, until the
+ * end of the current paint. Neighboring tiles are thus combined into larger
+ * images as the paint is flushed.
+ */
+static void __guac_rdp_gdi_surface_bits_rfx(rdpContext* context,
+        SURFACE_BITS_COMMAND* surface_bits) {
+
+    guac_client* client = ((rdp_freerdp_context*) context)->client;
+    rdp_guac_client_data* data = (rdp_guac_client_data*) client->data;
+    RFX_CONTEXT* rfx = ((rdp_freerdp_context*) context)->rfx;
+
+    RFX_MESSAGE* message;
+    int num_rects, num_tiles;
+    int i, j;
+
+    /* Ignore RemoteFX if not negotiated */
+    if (rfx == NULL)
+        return;
+
+    /* Decode all tiles */
+    message = rfx_process_message(rfx, surface_bits->bitmapData,
+            surface_bits->bitmapDataLength);
+    if (message == NULL)
+        return;
+
+#ifdef HAVE_RFX_MESSAGE_NUMTILES
+    num_rects = message->numRects;
+    num_tiles = message->numTiles;
+#else
+    num_rects = message->num_rects;
+    num_tiles = message->num_tiles;
+#endif
+
+    /* Draw only the portions of each tile within each updated rect */
+    for (i = 0; i < num_tiles; i++) {
+
+        RFX_TILE* tile = message->tiles[i];
+
+        for (j = 0; j < num_rects; j++) {
+
+            RFX_RECT* rect = &(message->rects[j]);
+
+            /* Intersect tile with rect */
+            int left   = tile->x;
+            int top    = tile->y;
+            int right  = tile->x + GUAC_RDP_RFX_TILE_SIZE;
+            int bottom = tile->y + GUAC_RDP_RFX_TILE_SIZE;
+
+            if (left   < rect->x) left = rect->x;
+            if (top    < rect->y) top  = rect->y;
+            if (right  > rect->x + rect->width)  right  = rect->x + rect->width;
+            if (bottom > rect->y + rect->height) bottom = rect->y + rect->height;
+
+            if (right <= left || bottom <= top)
+                continue;
+
+            guac_rdp_paint_image(data->paint, GUAC_DEFAULT_LAYER,
+                    surface_bits->destLeft + left,
+                    surface_bits->destTop  + top,
+                    right - left, bottom - top,
+                    tile->data + 4 * ((top - tile->y) * GUAC_RDP_RFX_TILE_SIZE
+                                    + (left - tile->x)),
+                    4 * GUAC_RDP_RFX_TILE_SIZE);
+
+        }
+
+    }
+
+    rfx_message_free(rfx, message);
+
+}
+
+void guac_rdp_gdi_surface_bits(rdpContext* context,
+        SURFACE_BITS_COMMAND* surface_bits) {
+
+    guac_client* client = ((rdp_freerdp_context*) context)->client;
+    rdp_guac_client_data* data = (rdp_guac_client_data*) client->data;
+
+    int width  = surface_bits->width;
+    int height = surface_bits->height;
+
+    switch (surface_bits->codecID) {
+
+        /* RemoteFX */
+        case GUAC_RDP_CODEC_ID_REMOTEFX:
+            __guac_rdp_gdi_surface_bits_rfx(context, surface_bits);
+            break;
+
+#ifdef HAVE_FREERDP_NSCODEC
+        /* NSCodec (decoded image is bottom-up) */
+        case GUAC_RDP_CODEC_ID_NSCODEC: {
+
+            NSC_CONTEXT* nsc = ((rdp_freerdp_context*) context)->nsc;
+
+            /* Ignore NSCodec if not negotiated */
+            if (nsc == NULL || width <= 0 || height <= 0)
+                break;
+
+            nsc_process_message(nsc, surface_bits->bpp, width, height,
+                    surface_bits->bitmapData,
+                    surface_bits->bitmapDataLength);
+
+            guac_rdp_paint_image(data->paint, GUAC_DEFAULT_LAYER,
+                    surface_bits->destLeft, surface_bits->destTop,
+                    width, height,
+                    nsc->BitmapData + 4 * width * (height - 1),
+                    -4 * width);
+
+            break;
+        }
+#endif
+
+        /* Uncompressed 32-bit image data (bottom-up) */
+        case GUAC_RDP_CODEC_ID_NONE:
+
+            if (surface_bits->bpp != 32 || width <= 0 || height <= 0
+                    || surface_bits->bitmapDataLength < 4 * width * height)
+                break;
+
+            guac_rdp_paint_image(data->paint, GUAC_DEFAULT_LAYER,
+                    surface_bits->destLeft, surface_bits->destTop,
+                    width, height,
+                    surface_bits->bitmapData + 4 * width * (height - 1),
+                    -4 * width);
+
+            break;
+
+        /* Unsupported codec */
+        default:
+            guac_client_log_info(client,
+                    "Ignoring surface bits with unsupported codec 0x%02X",
+                    surface_bits->codecID);
+
+    }
+
+}
+
 void guac_rdp_gdi_end_paint(rdpContext* context) {
-    /* IGNORE */
+
+    guac_client* client = ((rdp_freerdp_context*) context)->client;
+    rdp_guac_client_data* data = (rdp_guac_client_data*) client->data;
+
+    /* Send all drawing deferred during this paint */
+    guac_rdp_paint_flush(data->paint);
+
+    /* Send input received while drawing */
+    guac_rdp_input_queue_flush(data->input_queue, context->input);
+
 }
 
@@ -29,7 +29,27 @@
 #include <freerdp/freerdp.h>
 #include <guacamole/protocol.h>
 
-guac_composite_mode guac_rdp_rop3_transfer_function(guac_client* client,
+/**
+ * The codec ID of uncompressed surface bits, as defined by MS-RDPBCGR.
+ */
+#define GUAC_RDP_CODEC_ID_NONE 0x00
+
+/**
+ * The codec ID of NSCodec-encoded surface bits, as defined by MS-RDPBCGR.
+ */
+#define GUAC_RDP_CODEC_ID_NSCODEC 0x01
+
+/**
+ * The codec ID of RemoteFX-encoded surface bits, as defined by MS-RDPBCGR.
+ */
+#define GUAC_RDP_CODEC_ID_REMOTEFX 0x03
+
+/**
+ * The width and height of each RemoteFX tile, in pixels.
+ */
+#define GUAC_RDP_RFX_TILE_SIZE 64
+
+guac_transfer_function guac_rdp_rop3_transfer_function(guac_client* client,
         int rop3);
 
 void guac_rdp_gdi_dstblt(rdpContext* context, DSTBLT_ORDER* dstblt);
@@ -39,6 +59,20 @@ void guac_rdp_gdi_memblt(rdpContext* context, MEMBLT_ORDER* memblt);
 void guac_rdp_gdi_opaquerect(rdpContext* context, OPAQUE_RECT_ORDER* opaque_rect);
 void guac_rdp_gdi_palette_update(rdpContext* context, PALETTE_UPDATE* palette);
 void guac_rdp_gdi_set_bounds(rdpContext* context, rdpBounds* bounds);
+
+/**
+ * Handles a surface bits command, decoding the RemoteFX, NSCodec or
+ * uncompressed image data it contains and drawing the result to the default
+ * layer at the end of the current paint.
+ *
+ * @param context
+ *     The rdpContext of the RDP connection receiving the command.
+ *
+ * @param surface_bits
+ *     The received surface bits command.
+ */
+void guac_rdp_gdi_surface_bits(rdpContext* context,
+        SURFACE_BITS_COMMAND* surface_bits);
 void guac_rdp_gdi_end_paint(rdpContext* context);
 
 #endif
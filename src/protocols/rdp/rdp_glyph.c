@@ -26,10 +26,13 @@
 #include "rdp_glyph.h"
 
 #include <pthread.h>
+#include <stdlib.h>
 
+#include <cairo/cairo.h>
 #include <freerdp/freerdp.h>
 #include <guacamole/client.h>
 #include <guacamole/error.h>
+#include <guacamole/protocol.h>
 
 #ifdef ENABLE_WINPR
 #include <winpr/wtypes.h>
@@ -93,33 +96,124 @@ void guac_rdp_glyph_new(rdpContext* context, rdpGlyph* glyph) {
     ((guac_rdp_glyph*) glyph)->surface = cairo_image_surface_create_for_data(
             image_buffer, CAIRO_FORMAT_ARGB32, width, height, stride);
 
+    /* Glyph will be sent to client when first drawn */
+    ((guac_rdp_glyph*) glyph)->layer = NULL;
+
 }
 
 void guac_rdp_glyph_draw(rdpContext* context, rdpGlyph* glyph, int x, int y) {
 
     guac_client* client = ((rdp_freerdp_context*) context)->client;
     rdp_guac_client_data* guac_client_data = (rdp_guac_client_data*) client->data;
+    guac_rdp_glyph* guac_glyph = (guac_rdp_glyph*) glyph;
+
+    int width  = glyph->cx;
+    int height = glyph->cy;
 
     /* Do not attempt to draw glyphs if glyph drawing is not begun */
-    if (guac_client_data->glyph_cairo == NULL)
+    if (!guac_client_data->glyph_drawing)
         return;
 
-    /* Use glyph as mask */
-    cairo_mask_surface(
-            guac_client_data->glyph_cairo,
-            ((guac_rdp_glyph*) glyph)->surface, x, y);
+    /* Ignore empty glyphs (such as spaces) */
+    if (width <= 0 || height <= 0)
+        return;
+
+    /* Send glyph mask to client if not yet sent, unless drawing to a
+     * server-side offscreen surface */
+    if (guac_glyph->layer == NULL
+            && guac_client_data->current_surface != NULL) {
+        guac_glyph->layer = guac_client_alloc_buffer(client);
+        guac_protocol_send_png(client->socket, GUAC_COMP_SRC,
+                guac_glyph->layer, 0, 0, guac_glyph->surface);
+    }
+
+    /* Record glyph position if text will be mirrored in shadow surface */
+    if (guac_client_data->current_shadow != NULL) {
+
+        guac_rdp_glyph_position* position;
+
+        /* Grow list of positions as necessary */
+        if (guac_client_data->glyph_count
+                == guac_client_data->glyph_positions_size) {
+
+            int size = guac_client_data->glyph_positions_size * 2;
+            if (size == 0)
+                size = 64;
+
+            position = realloc(guac_client_data->glyph_positions,
+                    size * sizeof(guac_rdp_glyph_position));
+
+            /* If out of memory, text cannot be mirrored */
+            if (position == NULL)
+                guac_rdp_shadow_invalidate(guac_client_data->current_shadow,
+                        x, y, width, height);
+
+            else {
+                guac_client_data->glyph_positions = position;
+                guac_client_data->glyph_positions_size = size;
+            }
+
+        }
+
+        if (guac_client_data->glyph_count
+                < guac_client_data->glyph_positions_size) {
+            position = &(guac_client_data->glyph_positions[
+                    guac_client_data->glyph_count++]);
+            position->glyph = guac_glyph;
+            position->x = x;
+            position->y = y;
+        }
+
+    }
+
+    /* Add glyph mask to text run, unless never sent */
+    if (guac_client_data->current_surface != NULL)
+        guac_protocol_send_copy(client->socket,
+                guac_glyph->layer, 0, 0, width, height,
+                GUAC_COMP_OVER, guac_client_data->glyph_buffer, x, y);
+
+    /* Expand bounds of text run to include glyph */
+    if (guac_client_data->glyph_right <= guac_client_data->glyph_left
+            || guac_client_data->glyph_bottom <= guac_client_data->glyph_top) {
+        guac_client_data->glyph_left   = x;
+        guac_client_data->glyph_top    = y;
+        guac_client_data->glyph_right  = x + width;
+        guac_client_data->glyph_bottom = y + height;
+    }
+    else {
+
+        if (x < guac_client_data->glyph_left)
+            guac_client_data->glyph_left = x;
+
+        if (y < guac_client_data->glyph_top)
+            guac_client_data->glyph_top = y;
+
+        if (x + width > guac_client_data->glyph_right)
+            guac_client_data->glyph_right = x + width;
+
+        if (y + height > guac_client_data->glyph_bottom)
+            guac_client_data->glyph_bottom = y + height;
+
+    }
 
 }
 
 void guac_rdp_glyph_free(rdpContext* context, rdpGlyph* glyph) {
 
+    guac_client* client = ((rdp_freerdp_context*) context)->client;
+    guac_rdp_glyph* guac_glyph = (guac_rdp_glyph*) glyph;
+
     unsigned char* image_buffer = cairo_image_surface_get_data(
-            ((guac_rdp_glyph*) glyph)->surface);
+            guac_glyph->surface);
 
     /* Free surface */
-    cairo_surface_destroy(((guac_rdp_glyph*) glyph)->surface);
+    cairo_surface_destroy(guac_glyph->surface);
     free(image_buffer);
 
+    /* If sent to client, free buffer */
+    if (guac_glyph->layer != NULL)
+        guac_client_free_buffer(client, guac_glyph->layer);
+
 }
 
 void guac_rdp_glyph_begindraw(rdpContext* context,
@@ -128,6 +222,7 @@ void guac_rdp_glyph_begindraw(rdpContext* context,
     guac_client* client = ((rdp_freerdp_context*) context)->client;
     rdp_guac_client_data* guac_client_data =
         (rdp_guac_client_data*) client->data;
+    const guac_layer* current_layer = guac_client_data->current_surface;
 
     /* Convert foreground color */
     fgcolor = freerdp_color_convert_var(fgcolor,
@@ -135,15 +230,9 @@ void guac_rdp_glyph_begindraw(rdpContext* context,
             ((rdp_freerdp_context*) context)->clrconv);
 
     /* Fill background with color if specified */
-    if (width != 0 && height != 0) {
-
-        /* Prepare for opaque glyphs */
-        guac_client_data->glyph_surface = 
-            guac_client_data->opaque_glyph_surface;
-
-        /* Create cairo instance */
-        guac_client_data->glyph_cairo = cairo_create(
-            guac_client_data->glyph_surface);
+    if (width != 0 && height != 0
+            && !guac_rdp_clip_rect(guac_client_data,
+                &x, &y, &width, &height)) {
 
         /* Convert background color */
         bgcolor = freerdp_color_convert_var(bgcolor,
@@ -151,46 +240,102 @@ void guac_rdp_glyph_begindraw(rdpContext* context,
                 ((rdp_freerdp_context*) context)->clrconv);
 
         /* Fill background */
-        cairo_rectangle(guac_client_data->glyph_cairo,
-                x, y, width, height);
+        guac_rdp_paint_rect(guac_client_data->paint, current_layer,
+                x, y, width, height, bgcolor & 0xFFFFFF);
 
-        cairo_set_source_rgb(guac_client_data->glyph_cairo,
-                ((bgcolor & 0xFF0000) >> 16) / 255.0,
-                ((bgcolor & 0x00FF00) >> 8 ) / 255.0,
-                ( bgcolor & 0x0000FF       ) / 255.0);
+    }
 
-        cairo_fill(guac_client_data->glyph_cairo);
+    /* Begin new, empty text run */
+    guac_client_data->glyph_drawing = 1;
+    guac_client_data->glyph_count = 0;
+    guac_client_data->glyph_color = fgcolor & 0xFFFFFF;
+    guac_client_data->glyph_left   = 0;
+    guac_client_data->glyph_top    = 0;
+    guac_client_data->glyph_right  = 0;
+    guac_client_data->glyph_bottom = 0;
 
+}
+
+/**
+ * Restricts the bounds of the current text run to the given rectangle, if
+ * non-empty, and to the current clipping region. Returns zero if anything of
+ * the text run remains to be drawn, in which case the clipped bounds are
+ * stored in the given coordinates and dimensions, or non-zero if nothing
+ * remains.
+ */
+static int __guac_rdp_glyph_clip_run(rdp_guac_client_data* guac_client_data,
+        int x, int y, int width, int height,
+        int* run_x, int* run_y, int* run_width, int* run_height) {
+
+    /* Bounds of all glyphs within text run */
+    int left   = guac_client_data->glyph_left;
+    int top    = guac_client_data->glyph_top;
+    int right  = guac_client_data->glyph_right;
+    int bottom = guac_client_data->glyph_bottom;
+
+    /* Restrict text to given rectangle, if any */
+    if (width > 0 && height > 0) {
+        if (x > left) left = x;
+        if (y > top)  top  = y;
+        if (x + width  < right)  right  = x + width;
+        if (y + height < bottom) bottom = y + height;
     }
 
-    /* Otherwise, prepare for transparent glyphs  */
-    else {
+    /* Ensure text does not extend past top or left edges */
+    if (left < 0) left = 0;
+    if (top  < 0) top  = 0;
+
+    if (right <= left || bottom <= top)
+        return 1;
 
-        /* Select transparent glyph surface */
-        guac_client_data->glyph_surface = 
-            guac_client_data->trans_glyph_surface;
+    *run_x = left;
+    *run_y = top;
+    *run_width  = right  - left;
+    *run_height = bottom - top;
 
-        guac_client_data->glyph_cairo = cairo_create(
-            guac_client_data->glyph_surface);
+    /* Restrict text to clipping region, if any */
+    return guac_rdp_clip_rect(guac_client_data,
+            run_x, run_y, run_width, run_height);
 
-        /* Clear surface */
-        cairo_set_operator(guac_client_data->glyph_cairo,
-            CAIRO_OPERATOR_SOURCE);
+}
+
+/**
+ * Draws all glyphs of the current text run to the shadow surface of the
+ * current surface, if any, clipped as the text run would be clipped when
+ * drawn client-side. The recorded glyph positions are then cleared.
+ */
+static void __guac_rdp_glyph_shadow_text(
+        rdp_guac_client_data* guac_client_data,
+        int x, int y, int width, int height) {
 
-        cairo_set_source_rgba(guac_client_data->glyph_cairo, 0, 0, 0, 0);
-        cairo_paint(guac_client_data->glyph_cairo);
+    int i;
+    int run_x, run_y, run_width, run_height;
 
-        /* Restore operator */
-        cairo_set_operator(guac_client_data->glyph_cairo,
-            CAIRO_OPERATOR_OVER);
+    if (guac_client_data->current_shadow != NULL
+            && !__guac_rdp_glyph_clip_run(guac_client_data, x, y,
+                width, height, &run_x, &run_y, &run_width, &run_height)) {
+
+        for (i = 0; i < guac_client_data->glyph_count; i++) {
+
+            guac_rdp_glyph_position* position =
+                &(guac_client_data->glyph_positions[i]);
+
+            cairo_surface_t* surface = position->glyph->surface;
+
+            guac_rdp_shadow_glyph(guac_client_data->current_shadow,
+                    run_x, run_y, run_width, run_height,
+                    position->x, position->y,
+                    cairo_image_surface_get_width(surface),
+                    cairo_image_surface_get_height(surface),
+                    cairo_image_surface_get_data(surface),
+                    cairo_image_surface_get_stride(surface),
+                    guac_client_data->glyph_color);
+
+        }
 
     }
 
-    /* Prepare for glyph drawing */
-    cairo_set_source_rgb(guac_client_data->glyph_cairo,
-            ((fgcolor & 0xFF0000) >> 16) / 255.0,
-            ((fgcolor & 0x00FF00) >> 8 ) / 255.0,
-            ( fgcolor & 0x0000FF       ) / 255.0);
+    guac_client_data->glyph_count = 0;
 
 }
 
@@ -200,43 +345,59 @@ void guac_rdp_glyph_enddraw(rdpContext* context,
     guac_client* client = ((rdp_freerdp_context*) context)->client;
     rdp_guac_client_data* guac_client_data = (rdp_guac_client_data*) client->data;
     const guac_layer* current_layer = ((rdp_guac_client_data*) client->data)->current_surface;
+    const guac_layer* glyph_buffer = guac_client_data->glyph_buffer;
 
-    /* Use glyph surface to provide image data for glyph rectangle */
-    cairo_surface_t* glyph_surface = guac_client_data->glyph_surface;
-    int stride = cairo_image_surface_get_stride(glyph_surface);
-
-    /* Calculate bounds */
-    int max_width = cairo_image_surface_get_width(glyph_surface) - x;
-    int max_height = cairo_image_surface_get_height(glyph_surface) - y;
+    /* Bounds of all glyphs within text run */
+    int run_x = guac_client_data->glyph_left;
+    int run_y = guac_client_data->glyph_top;
+    int run_width  = guac_client_data->glyph_right  - run_x;
+    int run_height = guac_client_data->glyph_bottom - run_y;
 
-    /* Ensure dimensions of glyph do not exceed bounds */
-    if (width > max_width) width = max_width;
-    if (height > max_height) height = max_height;
+    /* Text run is complete */
+    guac_client_data->glyph_drawing = 0;
 
-    /* Clip operation to clipping region, if any */
-    if (!guac_rdp_clip_rect(guac_client_data, &x, &y, &width, &height)) {
-
-        /* Ensure data is ready */
-        cairo_surface_flush(glyph_surface);
-
-        /* Create surface for subsection with text */
-        cairo_surface_t* surface = cairo_image_surface_create_for_data(
-                cairo_image_surface_get_data(glyph_surface) + 4*x + y*stride,
-                cairo_image_surface_get_format(glyph_surface),
-                width, height, stride);
-
-        /* Send surface with all glyphs to layer */
-        guac_protocol_send_png(client->socket,
-                GUAC_COMP_OVER, current_layer, x, y,
-                surface);
+    /* Nothing to draw if no glyphs drawn */
+    if (run_width <= 0 || run_height <= 0)
+        return;
 
-        /* Destroy surface */
-        cairo_surface_destroy(surface);
+    /* Text drawn to server-side offscreen surfaces is composed locally */
+    if (current_layer == NULL) {
+        __guac_rdp_glyph_shadow_text(guac_client_data, x, y, width, height);
+        return;
+    }
 
+    /* Color glyph masks using foreground color */
+    guac_protocol_send_rect(client->socket, glyph_buffer,
+            run_x, run_y, run_width, run_height);
+
+    guac_protocol_send_cfill(client->socket,
+            GUAC_COMP_ATOP, glyph_buffer,
+            (guac_client_data->glyph_color & 0xFF0000) >> 16,
+            (guac_client_data->glyph_color & 0x00FF00) >> 8,
+            (guac_client_data->glyph_color & 0x0000FF),
+            0xFF);
+
+    /* Mirror colored text within shadow surface, if any */
+    __guac_rdp_glyph_shadow_text(guac_client_data, x, y, width, height);
+
+    /* Restrict text to given rectangle and clipping region, if any */
+    if (!__guac_rdp_glyph_clip_run(guac_client_data, x, y, width, height,
+                &run_x, &run_y, &run_width, &run_height)) {
+        guac_rdp_paint_flush(guac_client_data->paint);
+        guac_protocol_send_copy(client->socket,
+                glyph_buffer, run_x, run_y, run_width, run_height,
+                GUAC_COMP_OVER, current_layer, run_x, run_y);
     }
 
-    /* Destroy cairo instance */
-    cairo_destroy(guac_client_data->glyph_cairo);
+    /* Clear text run from buffer */
+    guac_protocol_send_rect(client->socket, glyph_buffer,
+            guac_client_data->glyph_left, guac_client_data->glyph_top,
+            guac_client_data->glyph_right  - guac_client_data->glyph_left,
+            guac_client_data->glyph_bottom - guac_client_data->glyph_top);
+
+    guac_protocol_send_cfill(client->socket,
+            GUAC_COMP_ROUT, glyph_buffer,
+            0x00, 0x00, 0x00, 0xFF);
 
 }
 
@@ -34,6 +34,8 @@
 #include "compat/winpr-wtypes.h"
 #endif
 
+#include <cairo/cairo.h>
+#include <guacamole/layer.h>
 #include <guacamole/protocol.h>
 
 typedef struct guac_rdp_glyph {
@@ -48,8 +50,37 @@ typedef struct guac_rdp_glyph {
      */
     cairo_surface_t* surface;
 
+    /**
+     * Buffer containing the glyph as an alpha mask, or NULL if the glyph has
+     * not yet been sent to the client. Glyphs are sent only when first drawn,
+     * and are thereafter drawn by copying from this buffer.
+     */
+    guac_layer* layer;
+
 } guac_rdp_glyph;
 
+/**
+ * A glyph drawn at a specific position within a text run.
+ */
+typedef struct guac_rdp_glyph_position {
+
+    /**
+     * The glyph drawn.
+     */
+    guac_rdp_glyph* glyph;
+
+    /**
+     * The X coordinate of the upper-left corner of the glyph.
+     */
+    int x;
+
+    /**
+     * The Y coordinate of the upper-left corner of the glyph.
+     */
+    int y;
+
+} guac_rdp_glyph_position;
+
 void guac_rdp_glyph_new(rdpContext* context, rdpGlyph* glyph);
 void guac_rdp_glyph_draw(rdpContext* context, rdpGlyph* glyph, int x, int y);
 void guac_rdp_glyph_free(rdpContext* context, rdpGlyph* glyph);
@@ -0,0 +1,252 @@
+/*
+ * Copyright (C) 2013 Glyptodon LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "config.h"
+
+#include "rdp_input.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#ifdef HAVE_CLOCK_GETTIME
+#include <time.h>
+#else
+#include <sys/time.h>
+#endif
+
+#include <freerdp/freerdp.h>
+#include <guacamole/client.h>
+
+guac_rdp_input_queue* guac_rdp_input_queue_alloc(guac_client* client) {
+
+    guac_rdp_input_queue* queue = malloc(sizeof(guac_rdp_input_queue));
+    if (queue == NULL)
+        return NULL;
+
+    /* Init wake pipe, never blocking on either end */
+    if (pipe(queue->wake_fds)) {
+        free(queue);
+        return NULL;
+    }
+
+    fcntl(queue->wake_fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(queue->wake_fds[1], F_SETFL, O_NONBLOCK);
+
+    queue->client = client;
+    queue->head = 0;
+    queue->length = 0;
+
+    pthread_mutex_init(&(queue->lock), NULL);
+    pthread_cond_init(&(queue->space_available), NULL);
+
+    return queue;
+
+}
+
+void guac_rdp_input_queue_free(guac_rdp_input_queue* queue) {
+
+    pthread_cond_destroy(&(queue->space_available));
+    pthread_mutex_destroy(&(queue->lock));
+
+    close(queue->wake_fds[0]);
+    close(queue->wake_fds[1]);
+
+    free(queue);
+
+}
+
+int guac_rdp_input_queue_fd(guac_rdp_input_queue* queue) {
+    return queue->wake_fds[0];
+}
+
+/**
+ * Waits for space within the given queue, returning non-zero if the client
+ * stopped before space became available. The queue lock must be held.
+ */
+static int __guac_rdp_input_queue_wait(guac_rdp_input_queue* queue) {
+
+    while (queue->length == GUAC_RDP_INPUT_QUEUE_SIZE) {
+
+        struct timespec deadline;
+
+        /* Give up if events will never be sent */
+        if (queue->client->state != GUAC_CLIENT_RUNNING)
+            return 1;
+
+#ifdef HAVE_CLOCK_GETTIME
+
+        /* Get current time */
+        clock_gettime(CLOCK_REALTIME, &deadline);
+
+#else
+
+        struct timeval current;
+
+        /* Get current time */
+        gettimeofday(&current, NULL);
+        deadline.tv_sec  = current.tv_sec;
+        deadline.tv_nsec = current.tv_usec * 1000;
+
+#endif
+
+        /* Calculate time that waiting must stop */
+        deadline.tv_sec  +=  GUAC_RDP_INPUT_QUEUE_TIMEOUT / 1000;
+        deadline.tv_nsec += (GUAC_RDP_INPUT_QUEUE_TIMEOUT % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+
+        pthread_cond_timedwait(&(queue->space_available), &(queue->lock),
+                &deadline);
+
+    }
+
+    return 0;
+
+}
+
+/**
+ * Adds the given event to the end of the given queue, waking the RDP thread
+ * if the queue was empty.
+ */
+static void __guac_rdp_input_queue_add(guac_rdp_input_queue* queue,
+        guac_rdp_input_event* event) {
+
+    pthread_mutex_lock(&(queue->lock));
+
+    /* Drop events only if the RDP thread is gone */
+    if (__guac_rdp_input_queue_wait(queue)) {
+        pthread_mutex_unlock(&(queue->lock));
+        return;
+    }
+
+    queue->events[(queue->head + queue->length)
+        % GUAC_RDP_INPUT_QUEUE_SIZE] = *event;
+
+    /* Wake RDP thread when first event is queued */
+    if (queue->length++ == 0) {
+        char wake = 0;
+        if (write(queue->wake_fds[1], &wake, 1) < 0 && errno != EAGAIN)
+            guac_client_log_error(queue->client,
+                    "Unable to wake RDP thread for queued input.");
+    }
+
+    pthread_mutex_unlock(&(queue->lock));
+
+}
+
+void guac_rdp_input_queue_mouse(guac_rdp_input_queue* queue,
+        int flags, int x, int y) {
+
+    guac_rdp_input_event event = {
+        .type  = GUAC_RDP_INPUT_MOUSE,
+        .flags = flags,
+        .x     = x,
+        .y     = y
+    };
+
+    __guac_rdp_input_queue_add(queue, &event);
+
+}
+
+void guac_rdp_input_queue_keyboard(guac_rdp_input_queue* queue,
+        int flags, int scancode) {
+
+    guac_rdp_input_event event = {
+        .type  = GUAC_RDP_INPUT_KEYBOARD,
+        .flags = flags,
+        .code  = scancode
+    };
+
+    __guac_rdp_input_queue_add(queue, &event);
+
+}
+
+void guac_rdp_input_queue_unicode(guac_rdp_input_queue* queue,
+        int flags, int codepoint) {
+
+    guac_rdp_input_event event = {
+        .type  = GUAC_RDP_INPUT_UNICODE,
+        .flags = flags,
+        .code  = codepoint
+    };
+
+    __guac_rdp_input_queue_add(queue, &event);
+
+}
+
+void guac_rdp_input_queue_flush(guac_rdp_input_queue* queue,
+        rdpInput* input) {
+
+    guac_rdp_input_event events[GUAC_RDP_INPUT_QUEUE_SIZE];
+    char discard[GUAC_RDP_INPUT_QUEUE_SIZE];
+    int count;
+    int i;
+
+    pthread_mutex_lock(&(queue->lock));
+
+    /* Take all queued events, leaving the queue empty */
+    count = queue->length;
+    for (i = 0; i < count; i++)
+        events[i] = queue->events[(queue->head + i)
+            % GUAC_RDP_INPUT_QUEUE_SIZE];
+
+    queue->head = (queue->head + count) % GUAC_RDP_INPUT_QUEUE_SIZE;
+    queue->length = 0;
+
+    /* The wake pipe is readable only while events are queued */
+    if (count > 0) {
+        while (read(queue->wake_fds[0], discard, sizeof(discard)) > 0);
+        pthread_cond_broadcast(&(queue->space_available));
+    }
+
+    pthread_mutex_unlock(&(queue->lock));
+
+    /* Send events outside the lock, such that queueing never waits on I/O */
+    for (i = 0; i < count; i++) {
+
+        guac_rdp_input_event* event = &(events[i]);
+
+        switch (event->type) {
+
+            case GUAC_RDP_INPUT_MOUSE:
+                input->MouseEvent(input, event->flags, event->x, event->y);
+                break;
+
+            case GUAC_RDP_INPUT_KEYBOARD:
+                input->KeyboardEvent(input, event->flags, event->code);
+                break;
+
+            case GUAC_RDP_INPUT_UNICODE:
+                input->UnicodeKeyboardEvent(input, event->flags, event->code);
+                break;
+
+        }
+
+    }
+
+}
+
@@ -0,0 +1,215 @@
+/*
+ * Copyright (C) 2013 Glyptodon LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _GUAC_RDP_RDP_INPUT_H
+#define _GUAC_RDP_RDP_INPUT_H
+
+#include "config.h"
+
+#include <pthread.h>
+
+#include <freerdp/freerdp.h>
+#include <guacamole/client.h>
+
+/**
+ * The maximum number of input events which may be queued before the thread
+ * queueing further events must wait for the RDP thread to send them.
+ */
+#define GUAC_RDP_INPUT_QUEUE_SIZE 256
+
+/**
+ * The number of milliseconds to wait for space within a full input queue
+ * before checking whether the client is still running.
+ */
+#define GUAC_RDP_INPUT_QUEUE_TIMEOUT 250
+
+/**
+ * All types of input event which may be queued.
+ */
+typedef enum guac_rdp_input_event_type {
+
+    /**
+     * A mouse event, sent with MouseEvent().
+     */
+    GUAC_RDP_INPUT_MOUSE,
+
+    /**
+     * A keyboard event, sent with KeyboardEvent().
+     */
+    GUAC_RDP_INPUT_KEYBOARD,
+
+    /**
+     * A Unicode keyboard event, sent with UnicodeKeyboardEvent().
+     */
+    GUAC_RDP_INPUT_UNICODE
+
+} guac_rdp_input_event_type;
+
+/**
+ * A single input event which has been queued but not yet sent.
+ */
+typedef struct guac_rdp_input_event {
+
+    /**
+     * The type of this event.
+     */
+    guac_rdp_input_event_type type;
+
+    /**
+     * The RDP flags of this event.
+     */
+    int flags;
+
+    /**
+     * The X coordinate of the mouse pointer, if this is a mouse event.
+     */
+    int x;
+
+    /**
+     * The Y coordinate of the mouse pointer, if this is a mouse event.
+     */
+    int y;
+
+    /**
+     * The scancode or Unicode codepoint of this event, if this is a
+     * keyboard event.
+     */
+    int code;
+
+} guac_rdp_input_event;
+
+/**
+ * Queue of input events received from the Guacamole client which have not
+ * yet been sent to the RDP server. Only the RDP thread sends data through
+ * FreeRDP, and it does so whenever it is not otherwise busy, as well as
+ * between the stages of long updates. Queueing an event never waits for the
+ * RDP thread unless the queue is full.
+ */
+typedef struct guac_rdp_input_queue {
+
+    /**
+     * The client owning this queue.
+     */
+    guac_client* client;
+
+    /**
+     * Lock which guards the contents of this queue. This lock is only held
+     * while events are added or removed, never while data is sent.
+     */
+    pthread_mutex_t lock;
+
+    /**
+     * Condition signalled when queued events have been removed for sending.
+     */
+    pthread_cond_t space_available;
+
+    /**
+     * Circular buffer of all queued events.
+     */
+    guac_rdp_input_event events[GUAC_RDP_INPUT_QUEUE_SIZE];
+
+    /**
+     * The index of the oldest queued event.
+     */
+    int head;
+
+    /**
+     * The number of queued events.
+     */
+    int length;
+
+    /**
+     * Pipe which is written to when events are queued, such that the RDP
+     * thread can wake from waiting on RDP file descriptors. The read end
+     * is readable only while events are queued.
+     */
+    int wake_fds[2];
+
+} guac_rdp_input_queue;
+
+/**
+ * Allocates a new, empty input queue.
+ *
+ * @param client The client which will own the queue.
+ * @return A new input queue, or NULL if the queue could not be allocated.
+ */
+guac_rdp_input_queue* guac_rdp_input_queue_alloc(guac_client* client);
+
+/**
+ * Frees the given input queue. Any events not yet sent are discarded.
+ *
+ * @param queue The input queue to free.
+ */
+void guac_rdp_input_queue_free(guac_rdp_input_queue* queue);
+
+/**
+ * Returns a file descriptor which is readable whenever events are queued,
+ * for use in select() by the RDP thread.
+ *
+ * @param queue The input queue to wait on.
+ * @return A file descriptor which is readable while events are queued.
+ */
+int guac_rdp_input_queue_fd(guac_rdp_input_queue* queue);
+
+/**
+ * Queues a mouse event having the given flags and coordinates.
+ *
+ * @param queue The input queue to add the event to.
+ * @param flags The RDP pointer flags of the event.
+ * @param x The X coordinate of the mouse pointer.
+ * @param y The Y coordinate of the mouse pointer.
+ */
+void guac_rdp_input_queue_mouse(guac_rdp_input_queue* queue,
+        int flags, int x, int y);
+
+/**
+ * Queues a keyboard event having the given flags and scancode.
+ *
+ * @param queue The input queue to add the event to.
+ * @param flags The RDP keyboard flags of the event.
+ * @param scancode The scancode of the key pressed or released.
+ */
+void guac_rdp_input_queue_keyboard(guac_rdp_input_queue* queue,
+        int flags, int scancode);
+
+/**
+ * Queues a Unicode keyboard event for the given codepoint.
+ *
+ * @param queue The input queue to add the event to.
+ * @param flags The RDP keyboard flags of the event.
+ * @param codepoint The Unicode codepoint of the character typed.
+ */
+void guac_rdp_input_queue_unicode(guac_rdp_input_queue* queue,
+        int flags, int codepoint);
+
+/**
+ * Sends all queued events, in order, using the given FreeRDP input
+ * interface. This function must only be called by the RDP thread.
+ *
+ * @param queue The input queue to send events from.
+ * @param input The FreeRDP input interface to send events with.
+ */
+void guac_rdp_input_queue_flush(guac_rdp_input_queue* queue,
+        rdpInput* input);
+
+#endif
+
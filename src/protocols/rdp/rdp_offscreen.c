@@ -0,0 +1,259 @@
+/*
+ * Copyright (C) 2013 Glyptodon LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "config.h"
+
+#include "client.h"
+#include "debug.h"
+#include "rdp_bitmap.h"
+#include "rdp_cache_policy.h"
+#include "rdp_offscreen.h"
+#include "rdp_shadow.h"
+
+#include <stdlib.h>
+
+#include <cairo/cairo.h>
+#include <freerdp/freerdp.h>
+#include <guacamole/client.h>
+#include <guacamole/protocol.h>
+
+/**
+ * Returns the number of bytes of server-side memory required to store the
+ * given bitmap.
+ */
+static int __guac_rdp_offscreen_bitmap_size(guac_rdp_bitmap* bitmap) {
+    return bitmap->bitmap.width * bitmap->bitmap.height * 4;
+}
+
+/**
+ * Removes the given surface from the list of server-side surfaces, without
+ * otherwise affecting the surface.
+ */
+static void __guac_rdp_offscreen_unlink(guac_rdp_offscreen* offscreen,
+        guac_rdp_bitmap* bitmap) {
+
+    if (bitmap->offscreen_prev != NULL)
+        bitmap->offscreen_prev->offscreen_next = bitmap->offscreen_next;
+    else
+        offscreen->first = bitmap->offscreen_next;
+
+    if (bitmap->offscreen_next != NULL)
+        bitmap->offscreen_next->offscreen_prev = bitmap->offscreen_prev;
+    else
+        offscreen->last = bitmap->offscreen_prev;
+
+    bitmap->offscreen_prev = NULL;
+    bitmap->offscreen_next = NULL;
+
+}
+
+/**
+ * Adds the given surface to the head of the list of server-side surfaces,
+ * marking it as the most-recently used.
+ */
+static void __guac_rdp_offscreen_link(guac_rdp_offscreen* offscreen,
+        guac_rdp_bitmap* bitmap) {
+
+    bitmap->offscreen_prev = NULL;
+    bitmap->offscreen_next = offscreen->first;
+
+    if (offscreen->first != NULL)
+        offscreen->first->offscreen_prev = bitmap;
+    else
+        offscreen->last = bitmap;
+
+    offscreen->first = bitmap;
+
+}
+
+guac_rdp_offscreen* guac_rdp_offscreen_alloc(guac_client* client,
+        int budget) {
+
+    guac_rdp_offscreen* offscreen = calloc(1, sizeof(guac_rdp_offscreen));
+    if (offscreen == NULL)
+        return NULL;
+
+    offscreen->client = client;
+    offscreen->budget = budget;
+
+    return offscreen;
+
+}
+
+void guac_rdp_offscreen_free(guac_rdp_offscreen* offscreen) {
+
+    guac_rdp_offscreen_stats* stats = &(offscreen->stats);
+
+    guac_client_log_info(offscreen->client,
+            "Offscreen surfaces: %i composed server-side, %i moved to "
+            "client, %i rejected, peak usage %i of %i KiB",
+            stats->surfaces, stats->spills, stats->rejected,
+            stats->peak_size / 1024, offscreen->budget / 1024);
+
+    free(offscreen);
+
+}
+
+int guac_rdp_offscreen_add(guac_rdp_offscreen* offscreen,
+        guac_rdp_bitmap* bitmap) {
+
+    int size = __guac_rdp_offscreen_bitmap_size(bitmap);
+    guac_rdp_shadow* shadow;
+
+    /* Never store surfaces which would not fit even alone */
+    if (size > offscreen->budget) {
+        offscreen->stats.rejected++;
+        return 1;
+    }
+
+    /* Move least-recently used surfaces to client until new surface fits */
+    while (offscreen->size + size > offscreen->budget
+            && offscreen->last != NULL)
+        guac_rdp_offscreen_spill(offscreen, offscreen->last);
+
+    shadow = guac_rdp_shadow_alloc(bitmap->bitmap.width,
+            bitmap->bitmap.height);
+
+    if (shadow == NULL) {
+        offscreen->stats.rejected++;
+        return 1;
+    }
+
+    /* Start with bitmap contents, if any */
+    if (bitmap->bitmap.data != NULL)
+        guac_rdp_shadow_draw(shadow, 0, 0,
+                bitmap->bitmap.width, bitmap->bitmap.height,
+                bitmap->bitmap.data, 4*bitmap->bitmap.width);
+
+    bitmap->shadow = shadow;
+
+    /* Track new surface as most-recently used */
+    __guac_rdp_offscreen_link(offscreen, bitmap);
+    offscreen->size += size;
+    offscreen->stats.surfaces++;
+
+    if (offscreen->size > offscreen->stats.peak_size)
+        offscreen->stats.peak_size = offscreen->size;
+
+    return 0;
+
+}
+
+void guac_rdp_offscreen_touch(guac_rdp_offscreen* offscreen,
+        guac_rdp_bitmap* bitmap) {
+
+    if (offscreen->first != bitmap) {
+        __guac_rdp_offscreen_unlink(offscreen, bitmap);
+        __guac_rdp_offscreen_link(offscreen, bitmap);
+    }
+
+}
+
+void guac_rdp_offscreen_spill(guac_rdp_offscreen* offscreen,
+        guac_rdp_bitmap* bitmap) {
+
+    guac_client* client = offscreen->client;
+    rdp_guac_client_data* client_data = (rdp_guac_client_data*) client->data;
+    guac_rdp_shadow* shadow = bitmap->shadow;
+
+    cairo_surface_t* surface;
+
+    /* Nothing to do if not stored server-side */
+    if (shadow == NULL)
+        return;
+
+    GUAC_RDP_DEBUG(2, "Moving %ix%i offscreen surface to client",
+            shadow->width, shadow->height);
+
+    /* Send current contents to new buffer */
+    bitmap->layer = guac_client_alloc_buffer(client);
+
+    surface = cairo_image_surface_create_for_data(shadow->buffer,
+            CAIRO_FORMAT_RGB24, shadow->width, shadow->height,
+            shadow->stride);
+
+    guac_protocol_send_png(client->socket, GUAC_COMP_SRC, bitmap->layer,
+            0, 0, surface);
+
+    cairo_surface_destroy(surface);
+
+    /* Account for buffer as with any other client-side surface */
+    guac_rdp_cache_policy_add(client_data->cache_policy, bitmap);
+
+    /* Continue any drawing to this surface client-side */
+    if (client_data->current_shadow == shadow) {
+        client_data->current_surface = bitmap->layer;
+        client_data->current_shadow = NULL;
+        client_data->paint->offscreen = NULL;
+    }
+
+    guac_rdp_offscreen_remove(offscreen, bitmap);
+    offscreen->stats.spills++;
+
+}
+
+void guac_rdp_offscreen_spill_current(guac_rdp_offscreen* offscreen) {
+
+    rdp_guac_client_data* client_data =
+        (rdp_guac_client_data*) offscreen->client->data;
+
+    guac_rdp_bitmap* current;
+
+    /* Find the surface being drawn to, if composed server-side */
+    for (current = offscreen->first; current != NULL;
+            current = current->offscreen_next) {
+
+        if (current->shadow == client_data->current_shadow) {
+            guac_rdp_offscreen_spill(offscreen, current);
+            return;
+        }
+
+    }
+
+}
+
+void guac_rdp_offscreen_remove(guac_rdp_offscreen* offscreen,
+        guac_rdp_bitmap* bitmap) {
+
+    guac_client* client = offscreen->client;
+    rdp_guac_client_data* client_data = (rdp_guac_client_data*) client->data;
+
+    /* Nothing to do if not stored server-side */
+    if (bitmap->shadow == NULL)
+        return;
+
+    /* Stop drawing to this surface if current */
+    if (client_data->current_shadow == bitmap->shadow) {
+        client_data->current_surface = GUAC_DEFAULT_LAYER;
+        client_data->current_shadow = client_data->shadow;
+        client_data->paint->offscreen = NULL;
+    }
+
+    guac_rdp_shadow_free(bitmap->shadow);
+    bitmap->shadow = NULL;
+
+    __guac_rdp_offscreen_unlink(offscreen, bitmap);
+    offscreen->size -= __guac_rdp_offscreen_bitmap_size(bitmap);
+
+}
+
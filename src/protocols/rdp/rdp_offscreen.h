@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2013 Glyptodon LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef _GUAC_RDP_RDP_OFFSCREEN_H
+#define _GUAC_RDP_RDP_OFFSCREEN_H
+
+#include "config.h"
+
+#include "rdp_bitmap.h"
+
+#include <guacamole/client.h>
+
+/**
+ * The maximum number of bytes of server-side memory which may be used to
+ * store the contents of offscreen surfaces, assuming four bytes per pixel.
+ * Surfaces beyond this budget are moved to client-side buffers.
+ */
+#define GUAC_RDP_OFFSCREEN_BUDGET (32*1024*1024)
+
+/**
+ * Statistics describing the use of server-side offscreen surfaces,
+ * maintained for the sake of tuning.
+ */
+typedef struct guac_rdp_offscreen_stats {
+
+    /**
+     * The number of offscreen surfaces which were composed server-side.
+     */
+    int surfaces;
+
+    /**
+     * The number of offscreen surfaces which were moved to client-side
+     * buffers, either to remain within budget or because drawing required
+     * data known only to the client.
+     */
+    int spills;
+
+    /**
+     * The number of offscreen surfaces which could not be stored
+     * server-side at all.
+     */
+    int rejected;
+
+    /**
+     * The largest number of bytes used by server-side offscreen surfaces at
+     * any one time.
+     */
+    int peak_size;
+
+} guac_rdp_offscreen_stats;
+
+/**
+ * Tracks all offscreen surfaces whose contents are stored server-side within
+ * shadow surfaces, rather than within client-side buffers. Drawing to such
+ * surfaces is composed entirely server-side, and only pixels copied from
+ * them to client-side layers are ever sent.
+ */
+typedef struct guac_rdp_offscreen {
+
+    /**
+     * The client owning all tracked surfaces.
+     */
+    guac_client* client;
+
+    /**
+     * The maximum number of bytes which may be used by server-side
+     * offscreen surfaces.
+     */
+    int budget;
+
+    /**
+     * The number of bytes currently used by server-side offscreen surfaces.
+     */
+    int size;
+
+    /**
+     * The most-recently used server-side offscreen surface, or NULL if there
+     * are none.
+     */
+    guac_rdp_bitmap* first;
+
+    /**
+     * The least-recently used server-side offscreen surface, or NULL if
+     * there are none.
+     */
+    guac_rdp_bitmap* last;
+
+    /**
+     * Statistics describing the use of server-side offscreen surfaces.
+     */
+    guac_rdp_offscreen_stats stats;
+
+} guac_rdp_offscreen;
+
+/**
+ * Allocates a new, empty set of server-side offscreen surfaces.
+ *
+ * @param client
+ *     The client owning all tracked surfaces.
+ *
+ * @param budget
+ *     The maximum number of bytes which may be used by server-side offscreen
+ *     surfaces.
+ *
+ * @return
+ *     A newly-allocated guac_rdp_offscreen, or NULL if allocation fails.
+ */
+guac_rdp_offscreen* guac_rdp_offscreen_alloc(guac_client* client, int budget);
+
+/**
+ * Frees the given set of server-side offscreen surfaces, logging its
+ * statistics. All surfaces should already have been removed.
+ *
+ * @param offscreen
+ *     The guac_rdp_offscreen to free.
+ */
+void guac_rdp_offscreen_free(guac_rdp_offscreen* offscreen);
+
+/**
+ * Stores the contents of the given bitmap server-side, such that it may be
+ * used as an offscreen surface without involving the client. Least-recently
+ * used surfaces are moved to the client as necessary to remain within
+ * budget.
+ *
+ * @param offscreen
+ *     The guac_rdp_offscreen which should track the bitmap.
+ *
+ * @param bitmap
+ *     The bitmap to store server-side, which must not yet have a
+ *     client-side buffer.
+ *
+ * @return
+ *     Zero if the bitmap is now stored server-side, or non-zero if it could
+ *     not be, in which case a client-side buffer must be used.
+ */
+int guac_rdp_offscreen_add(guac_rdp_offscreen* offscreen,
+        guac_rdp_bitmap* bitmap);
+
+/**
+ * Marks the given server-side offscreen surface as the most-recently used.
+ *
+ * @param offscreen
+ *     The guac_rdp_offscreen tracking the bitmap.
+ *
+ * @param bitmap
+ *     The server-side offscreen surface that was used.
+ */
+void guac_rdp_offscreen_touch(guac_rdp_offscreen* offscreen,
+        guac_rdp_bitmap* bitmap);
+
+/**
+ * Moves the contents of the given server-side offscreen surface into a new
+ * client-side buffer, after which all drawing involving the surface is
+ * performed client-side. If the surface is the current drawing surface,
+ * drawing is redirected to the new buffer. This function has no effect if
+ * the bitmap is not stored server-side.
+ *
+ * @param offscreen
+ *     The guac_rdp_offscreen tracking the bitmap.
+ *
+ * @param bitmap
+ *     The server-side offscreen surface to move to the client.
+ */
+void guac_rdp_offscreen_spill(guac_rdp_offscreen* offscreen,
+        guac_rdp_bitmap* bitmap);
+
+/**
+ * Moves the current drawing surface to the client if it is composed
+ * server-side, such that drawing which can only be performed client-side may
+ * proceed. This function has no effect if the current drawing surface is not
+ * composed server-side.
+ *
+ * @param offscreen
+ *     The guac_rdp_offscreen tracking all server-side offscreen surfaces.
+ */
+void guac_rdp_offscreen_spill_current(guac_rdp_offscreen* offscreen);
+
+/**
+ * Discards the server-side contents of the given bitmap. If the surface is
+ * the current drawing surface, drawing is redirected to the default layer.
+ * This function has no effect if the bitmap is not stored server-side.
+ *
+ * @param offscreen
+ *     The guac_rdp_offscreen tracking the bitmap.
+ *
+ * @param bitmap
+ *     The bitmap whose server-side contents should be discarded.
+ */
+void guac_rdp_offscreen_remove(guac_rdp_offscreen* offscreen,
+        guac_rdp_bitmap* bitmap);
+
+#endif
+
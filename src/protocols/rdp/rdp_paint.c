@@ -0,0 +1,513 @@
+/*
+ * Copyright (C) 2013 Glyptodon LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "config.h"
+
+#include "rdp_paint.h"
+#include "rdp_shadow.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cairo/cairo.h>
+#include <guacamole/client.h>
+#include <guacamole/layer.h>
+#include <guacamole/protocol.h>
+#include <guacamole/socket.h>
+
+/* Define cairo_format_stride_for_width() if missing */
+#ifndef HAVE_CAIRO_FORMAT_STRIDE_FOR_WIDTH
+#define cairo_format_stride_for_width(format, width) (width*4)
+#endif
+
+guac_rdp_paint* guac_rdp_paint_alloc(guac_client* client) {
+
+    guac_rdp_paint* paint = malloc(sizeof(guac_rdp_paint));
+    if (paint == NULL)
+        return NULL;
+
+    paint->client = client;
+    paint->shadow = NULL;
+    paint->offscreen = NULL;
+    paint->layer = NULL;
+    paint->count = 0;
+
+    return paint;
+
+}
+
+/**
+ * Frees any data associated with the pending operation at the given index,
+ * removing that operation while preserving the order of all others.
+ */
+static void __guac_rdp_paint_discard(guac_rdp_paint* paint, int index) {
+
+    free(paint->operations[index].data);
+
+    paint->count--;
+    memmove(&(paint->operations[index]), &(paint->operations[index+1]),
+            sizeof(guac_rdp_paint_operation) * (paint->count - index));
+
+}
+
+void guac_rdp_paint_free(guac_rdp_paint* paint) {
+
+    /* Discard all pending operations */
+    while (paint->count > 0)
+        __guac_rdp_paint_discard(paint, paint->count - 1);
+
+    free(paint);
+
+}
+
+/**
+ * Returns whether the rectangle of the given operation lies entirely within
+ * the given rectangle.
+ */
+static int __guac_rdp_paint_contains(int x, int y, int width, int height,
+        guac_rdp_paint_operation* operation) {
+
+    return operation->x >= x
+        && operation->y >= y
+        && operation->x + operation->width  <= x + width
+        && operation->y + operation->height <= y + height;
+
+}
+
+/**
+ * Returns whether the rectangle of the given operation overlaps the given
+ * rectangle.
+ */
+static int __guac_rdp_paint_intersects(int x, int y, int width, int height,
+        guac_rdp_paint_operation* operation) {
+
+    return operation->x < x + width
+        && operation->y < y + height
+        && operation->x + operation->width  > x
+        && operation->y + operation->height > y;
+
+}
+
+/**
+ * Prepares the given paint for a new operation affecting the given rectangle
+ * of the given layer, flushing any operations on other layers and discarding
+ * any pending operations which the new rectangle completely covers. If the
+ * maximum number of pending operations has been reached, all pending
+ * operations are flushed.
+ */
+static void __guac_rdp_paint_prepare(guac_rdp_paint* paint,
+        const guac_layer* layer, int x, int y, int width, int height) {
+
+    int i;
+
+    /* Operations are only deferred for one layer at a time */
+    if (paint->layer != layer) {
+        guac_rdp_paint_flush(paint);
+        paint->layer = layer;
+    }
+
+    /* Discard any operations which will be completely redrawn */
+    for (i = paint->count - 1; i >= 0; i--) {
+        if (__guac_rdp_paint_contains(x, y, width, height,
+                    &(paint->operations[i])))
+            __guac_rdp_paint_discard(paint, i);
+    }
+
+    /* Ensure space exists for new operation */
+    if (paint->count == GUAC_RDP_PAINT_MAX_OPERATIONS) {
+        guac_rdp_paint_flush(paint);
+        paint->layer = layer;
+    }
+
+}
+
+void guac_rdp_paint_rect(guac_rdp_paint* paint, const guac_layer* layer,
+        int x, int y, int width, int height, int color) {
+
+    int i;
+    guac_rdp_paint_operation* operation;
+
+    if (width <= 0 || height <= 0)
+        return;
+
+    /* Fills of server-side offscreen surfaces are never sent */
+    if (layer == NULL) {
+        if (paint->offscreen != NULL)
+            guac_rdp_shadow_fill(paint->offscreen, x, y, width, height,
+                    color);
+        return;
+    }
+
+    /* Mirror fills of default layer within shadow surface */
+    if (paint->shadow != NULL && layer == GUAC_DEFAULT_LAYER)
+        guac_rdp_shadow_fill(paint->shadow, x, y, width, height, color);
+
+    __guac_rdp_paint_prepare(paint, layer, x, y, width, height);
+
+    /* Merge with most recent adjacent rectangle of same color, if possible */
+    for (i = paint->count - 1; i >= 0; i--) {
+
+        operation = &(paint->operations[i]);
+
+        if (operation->type == GUAC_RDP_PAINT_RECT
+                && operation->color == color) {
+
+            /* Rectangles in same row which touch or overlap */
+            if (operation->y == y && operation->height == height
+                    && operation->x <= x + width
+                    && operation->x + operation->width >= x) {
+
+                int right = x + width;
+                if (operation->x + operation->width > right)
+                    right = operation->x + operation->width;
+
+                if (operation->x < x)
+                    x = operation->x;
+
+                operation->x = x;
+                operation->width = right - x;
+                return;
+
+            }
+
+            /* Rectangles in same column which touch or overlap */
+            if (operation->x == x && operation->width == width
+                    && operation->y <= y + height
+                    && operation->y + operation->height >= y) {
+
+                int bottom = y + height;
+                if (operation->y + operation->height > bottom)
+                    bottom = operation->y + operation->height;
+
+                if (operation->y < y)
+                    y = operation->y;
+
+                operation->y = y;
+                operation->height = bottom - y;
+                return;
+
+            }
+
+        }
+
+        /* Merging past an overlapping operation would reorder drawing */
+        if (__guac_rdp_paint_intersects(x, y, width, height, operation))
+            break;
+
+    }
+
+    /* Otherwise, add as new operation */
+    operation = &(paint->operations[paint->count++]);
+    operation->type   = GUAC_RDP_PAINT_RECT;
+    operation->x      = x;
+    operation->y      = y;
+    operation->width  = width;
+    operation->height = height;
+    operation->color  = color;
+    operation->data   = NULL;
+
+}
+
+/**
+ * Adds a deferred image operation without affecting the shadow surface.
+ */
+static void __guac_rdp_paint_add_image(guac_rdp_paint* paint,
+        const guac_layer* layer,
+        int x, int y, int width, int height,
+        const unsigned char* data, int stride) {
+
+    int row;
+    unsigned char* copy;
+    guac_rdp_paint_operation* operation;
+
+    /* Copy image data, packing rows */
+    copy = malloc(width * height * 4);
+    if (copy == NULL)
+        return;
+
+    for (row = 0; row < height; row++)
+        memcpy(copy + row * width * 4, data + row * stride, width * 4);
+
+    __guac_rdp_paint_prepare(paint, layer, x, y, width, height);
+
+    /* Add as new operation */
+    operation = &(paint->operations[paint->count++]);
+    operation->type   = GUAC_RDP_PAINT_IMAGE;
+    operation->x      = x;
+    operation->y      = y;
+    operation->width  = width;
+    operation->height = height;
+    operation->color  = 0;
+    operation->data   = copy;
+
+}
+
+void guac_rdp_paint_image(guac_rdp_paint* paint, const guac_layer* layer,
+        int x, int y, int width, int height,
+        const unsigned char* data, int stride) {
+
+    if (width <= 0 || height <= 0)
+        return;
+
+    /* Images drawn to server-side offscreen surfaces are never sent */
+    if (layer == NULL) {
+        if (paint->offscreen != NULL)
+            guac_rdp_shadow_draw(paint->offscreen, x, y, width, height,
+                    data, stride);
+        return;
+    }
+
+    /* Mirror images drawn to default layer within shadow surface */
+    if (paint->shadow != NULL && layer == GUAC_DEFAULT_LAYER)
+        guac_rdp_shadow_draw(paint->shadow, x, y, width, height,
+                data, stride);
+
+    __guac_rdp_paint_add_image(paint, layer, x, y, width, height,
+            data, stride);
+
+}
+
+void guac_rdp_paint_shadow(guac_rdp_paint* paint,
+        int x, int y, int width, int height) {
+
+    guac_rdp_shadow* shadow = paint->shadow;
+
+    int right  = x + width;
+    int bottom = y + height;
+
+    /* Restrict to bounds of shadow surface */
+    if (x < 0) x = 0;
+    if (y < 0) y = 0;
+    if (right  > shadow->width)  right  = shadow->width;
+    if (bottom > shadow->height) bottom = shadow->height;
+
+    if (right <= x || bottom <= y)
+        return;
+
+    __guac_rdp_paint_add_image(paint, GUAC_DEFAULT_LAYER, x, y,
+            right - x, bottom - y,
+            shadow->buffer + y * shadow->stride + x * 4,
+            shadow->stride);
+
+}
+
+/**
+ * Sends the given operation to the given layer.
+ */
+static void __guac_rdp_paint_send(guac_client* client,
+        const guac_layer* layer, guac_rdp_paint_operation* operation) {
+
+    /* Send rectangles as rect/cfill */
+    if (operation->type == GUAC_RDP_PAINT_RECT) {
+
+        guac_protocol_send_rect(client->socket, layer,
+                operation->x, operation->y,
+                operation->width, operation->height);
+
+        guac_protocol_send_cfill(client->socket,
+                GUAC_COMP_OVER, layer,
+                (operation->color >> 16) & 0xFF,
+                (operation->color >> 8 ) & 0xFF,
+                (operation->color      ) & 0xFF,
+                0xFF);
+
+    }
+
+    /* Send images as PNG */
+    else {
+
+        cairo_surface_t* surface = cairo_image_surface_create_for_data(
+                operation->data, CAIRO_FORMAT_RGB24,
+                operation->width, operation->height, operation->width * 4);
+
+        guac_protocol_send_png(client->socket,
+                GUAC_COMP_OVER, layer,
+                operation->x, operation->y, surface);
+
+        cairo_surface_destroy(surface);
+
+    }
+
+}
+
+/**
+ * Sends the given images to the given layer as a single PNG covering the
+ * given rectangle. Portions of the rectangle not covered by any image are
+ * left transparent, and thus do not affect the layer.
+ */
+static void __guac_rdp_paint_send_combined(guac_client* client,
+        const guac_layer* layer, guac_rdp_paint_operation** images, int count,
+        int x, int y, int width, int height) {
+
+    int i, row, col;
+    int stride;
+    unsigned char* buffer;
+    cairo_surface_t* surface;
+
+    /* Send single images directly */
+    if (count == 1) {
+        __guac_rdp_paint_send(client, layer, images[0]);
+        return;
+    }
+
+    /* Allocate transparent image covering all images */
+    stride = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, width);
+    buffer = calloc(height, stride);
+    if (buffer == NULL) {
+        for (i = 0; i < count; i++)
+            __guac_rdp_paint_send(client, layer, images[i]);
+        return;
+    }
+
+    /* Draw each image, in order, as fully opaque */
+    for (i = 0; i < count; i++) {
+
+        guac_rdp_paint_operation* image = images[i];
+
+        for (row = 0; row < image->height; row++) {
+
+            uint32_t* src = (uint32_t*) (image->data + row * image->width * 4);
+            uint32_t* dst = (uint32_t*) (buffer
+                    + (image->y - y + row) * stride
+                    + (image->x - x) * 4);
+
+            for (col = 0; col < image->width; col++)
+                *(dst++) = *(src++) | 0xFF000000;
+
+        }
+
+    }
+
+    /* Send all images as one PNG */
+    surface = cairo_image_surface_create_for_data(buffer,
+            CAIRO_FORMAT_ARGB32, width, height, stride);
+
+    guac_protocol_send_png(client->socket, GUAC_COMP_OVER, layer, x, y,
+            surface);
+
+    cairo_surface_destroy(surface);
+    free(buffer);
+
+}
+
+void guac_rdp_paint_flush(guac_rdp_paint* paint) {
+
+    int i, j;
+
+    /* Small images awaiting combination into a single PNG */
+    guac_rdp_paint_operation* group[GUAC_RDP_PAINT_MAX_OPERATIONS];
+    int group_count = 0;
+    int group_area = 0;
+    int group_left = 0;
+    int group_top = 0;
+    int group_right = 0;
+    int group_bottom = 0;
+
+    for (i = 0; i < paint->count; i++) {
+
+        guac_rdp_paint_operation* operation = &(paint->operations[i]);
+        int area = operation->width * operation->height;
+
+        /* Attempt to combine small images */
+        if (operation->type == GUAC_RDP_PAINT_IMAGE
+                && area <= GUAC_RDP_PAINT_SMALL_IMAGE_AREA) {
+
+            if (group_count > 0) {
+
+                /* Calculate bounds if image were added to group */
+                int left   = group_left;
+                int top    = group_top;
+                int right  = group_right;
+                int bottom = group_bottom;
+                int combined_area;
+
+                if (operation->x < left) left = operation->x;
+                if (operation->y < top)  top  = operation->y;
+                if (operation->x + operation->width  > right)
+                    right  = operation->x + operation->width;
+                if (operation->y + operation->height > bottom)
+                    bottom = operation->y + operation->height;
+
+                combined_area = (right - left) * (bottom - top);
+
+                /* Add to group only if mostly covered by images */
+                if (combined_area <= GUAC_RDP_PAINT_MAX_COMBINED_AREA
+                        && combined_area <= 2 * (group_area + area)) {
+                    group[group_count++] = operation;
+                    group_area += area;
+                    group_left   = left;
+                    group_top    = top;
+                    group_right  = right;
+                    group_bottom = bottom;
+                    continue;
+                }
+
+                /* Otherwise, send current group */
+                __guac_rdp_paint_send_combined(paint->client, paint->layer,
+                        group, group_count, group_left, group_top,
+                        group_right - group_left, group_bottom - group_top);
+
+            }
+
+            /* Start new group with current image */
+            group[0] = operation;
+            group_count = 1;
+            group_area = area;
+            group_left   = operation->x;
+            group_top    = operation->y;
+            group_right  = operation->x + operation->width;
+            group_bottom = operation->y + operation->height;
+            continue;
+
+        }
+
+        /* Send group first if it must be drawn before this operation */
+        for (j = 0; j < group_count; j++) {
+            if (__guac_rdp_paint_intersects(operation->x, operation->y,
+                        operation->width, operation->height, group[j])) {
+                __guac_rdp_paint_send_combined(paint->client, paint->layer,
+                        group, group_count, group_left, group_top,
+                        group_right - group_left, group_bottom - group_top);
+                group_count = 0;
+                break;
+            }
+        }
+
+        __guac_rdp_paint_send(paint->client, paint->layer, operation);
+
+    }
+
+    /* Send any remaining group */
+    if (group_count > 0)
+        __guac_rdp_paint_send_combined(paint->client, paint->layer,
+                group, group_count, group_left, group_top,
+                group_right - group_left, group_bottom - group_top);
+
+    /* All operations are now sent */
+    while (paint->count > 0)
+        __guac_rdp_paint_discard(paint, paint->count - 1);
+
+    paint->layer = NULL;
+
+}
+
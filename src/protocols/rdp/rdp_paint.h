@@ -0,0 +1,285 @@
+/*
+ * Copyright (C) 2013 Glyptodon LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef _GUAC_RDP_RDP_PAINT_H
+#define _GUAC_RDP_RDP_PAINT_H
+
+#include "config.h"
+
+#include <guacamole/client.h>
+#include <guacamole/layer.h>
+
+#include "rdp_shadow.h"
+
+/**
+ * The maximum number of drawing operations which may be deferred before
+ * pending operations are flushed automatically.
+ */
+#define GUAC_RDP_PAINT_MAX_OPERATIONS 256
+
+/**
+ * The largest area, in pixels, of any image which will be considered for
+ * combination with other images into a single PNG.
+ */
+#define GUAC_RDP_PAINT_SMALL_IMAGE_AREA 4096
+
+/**
+ * The largest area, in pixels, of any PNG produced by combining several small
+ * images.
+ */
+#define GUAC_RDP_PAINT_MAX_COMBINED_AREA 65536
+
+/**
+ * The type of a deferred drawing operation.
+ */
+typedef enum guac_rdp_paint_operation_type {
+
+    /**
+     * Fill a rectangle with an opaque color.
+     */
+    GUAC_RDP_PAINT_RECT,
+
+    /**
+     * Draw opaque image data.
+     */
+    GUAC_RDP_PAINT_IMAGE
+
+} guac_rdp_paint_operation_type;
+
+/**
+ * A single deferred drawing operation. Every deferred operation completely
+ * replaces the contents of its rectangle.
+ */
+typedef struct guac_rdp_paint_operation {
+
+    /**
+     * The type of this operation.
+     */
+    guac_rdp_paint_operation_type type;
+
+    /**
+     * The X coordinate of the upper-left corner of the affected rectangle.
+     */
+    int x;
+
+    /**
+     * The Y coordinate of the upper-left corner of the affected rectangle.
+     */
+    int y;
+
+    /**
+     * The width of the affected rectangle, in pixels.
+     */
+    int width;
+
+    /**
+     * The height of the affected rectangle, in pixels.
+     */
+    int height;
+
+    /**
+     * The color of the rectangle, as 24-bit RGB, if this is a
+     * GUAC_RDP_PAINT_RECT operation.
+     */
+    int color;
+
+    /**
+     * Copy of the image data, in 32-bit RGB with rows packed at four bytes
+     * per pixel, if this is a GUAC_RDP_PAINT_IMAGE operation.
+     */
+    unsigned char* data;
+
+} guac_rdp_paint_operation;
+
+/**
+ * Drawing operations deferred until the end of the current paint, such that
+ * redundant operations can be removed and related operations combined before
+ * anything is sent to the client.
+ */
+typedef struct guac_rdp_paint {
+
+    /**
+     * The client to which all drawing operations will be sent.
+     */
+    guac_client* client;
+
+    /**
+     * The shadow surface which mirrors all operations affecting the default
+     * layer, or NULL if no shadow surface is maintained.
+     */
+    guac_rdp_shadow* shadow;
+
+    /**
+     * The shadow surface of the current server-side offscreen surface, which
+     * receives all operations drawn to a NULL layer, or NULL if the current
+     * surface is not composed server-side.
+     */
+    guac_rdp_shadow* offscreen;
+
+    /**
+     * The layer affected by all pending operations.
+     */
+    const guac_layer* layer;
+
+    /**
+     * All pending operations, in the order they were requested.
+     */
+    guac_rdp_paint_operation operations[GUAC_RDP_PAINT_MAX_OPERATIONS];
+
+    /**
+     * The number of pending operations.
+     */
+    int count;
+
+} guac_rdp_paint;
+
+/**
+ * Allocates a new, empty set of deferred drawing operations.
+ *
+ * @param client
+ *     The client to which all drawing operations will be sent.
+ *
+ * @return
+ *     A newly-allocated guac_rdp_paint, or NULL if allocation fails.
+ */
+guac_rdp_paint* guac_rdp_paint_alloc(guac_client* client);
+
+/**
+ * Frees the given set of deferred drawing operations, discarding any pending
+ * operations.
+ *
+ * @param paint
+ *     The guac_rdp_paint to free.
+ */
+void guac_rdp_paint_free(guac_rdp_paint* paint);
+
+/**
+ * Defers the filling of the given rectangle with the given opaque color.
+ * If the layer is the default layer, the fill is also applied to the shadow
+ * surface immediately. If the layer is NULL, the fill is applied only to the
+ * current server-side offscreen surface. Pending operations which the
+ * rectangle completely covers are discarded, and the rectangle is merged with
+ * any adjacent pending rectangle of the same color where possible.
+ *
+ * @param paint
+ *     The guac_rdp_paint which should receive the operation.
+ *
+ * @param layer
+ *     The layer to draw to, or NULL to draw only to the current server-side
+ *     offscreen surface.
+ *
+ * @param x
+ *     The X coordinate of the upper-left corner of the rectangle.
+ *
+ * @param y
+ *     The Y coordinate of the upper-left corner of the rectangle.
+ *
+ * @param width
+ *     The width of the rectangle, in pixels.
+ *
+ * @param height
+ *     The height of the rectangle, in pixels.
+ *
+ * @param color
+ *     The color of the rectangle, as 24-bit RGB.
+ */
+void guac_rdp_paint_rect(guac_rdp_paint* paint, const guac_layer* layer,
+        int x, int y, int width, int height, int color);
+
+/**
+ * Defers the drawing of the given opaque image data. The image data is copied,
+ * and need not remain valid after this function returns. If the layer is the
+ * default layer, the image is also drawn to the shadow surface immediately.
+ * If the layer is NULL, the image is drawn only to the current server-side
+ * offscreen surface. Pending operations which the image completely covers
+ * are discarded.
+ *
+ * @param paint
+ *     The guac_rdp_paint which should receive the operation.
+ *
+ * @param layer
+ *     The layer to draw to, or NULL to draw only to the current server-side
+ *     offscreen surface.
+ *
+ * @param x
+ *     The X coordinate of the upper-left corner of the destination.
+ *
+ * @param y
+ *     The Y coordinate of the upper-left corner of the destination.
+ *
+ * @param width
+ *     The width of the image, in pixels.
+ *
+ * @param height
+ *     The height of the image, in pixels.
+ *
+ * @param data
+ *     The image data, in 32-bit RGB.
+ *
+ * @param stride
+ *     The number of bytes in each row of image data. This may be negative
+ *     if the rows of the image data are stored bottom-up, in which case data
+ *     must point to the top row.
+ */
+void guac_rdp_paint_image(guac_rdp_paint* paint, const guac_layer* layer,
+        int x, int y, int width, int height,
+        const unsigned char* data, int stride);
+
+/**
+ * Defers the drawing of the contents of the given rectangle of the shadow
+ * surface to the default layer, such as after evaluating a raster operation
+ * against the shadow surface. The contents of the rectangle are copied, and
+ * the shadow surface may be modified freely after this function returns.
+ *
+ * @param paint
+ *     The guac_rdp_paint which should receive the operation, which must have
+ *     an associated shadow surface.
+ *
+ * @param x
+ *     The X coordinate of the upper-left corner of the rectangle.
+ *
+ * @param y
+ *     The Y coordinate of the upper-left corner of the rectangle.
+ *
+ * @param width
+ *     The width of the rectangle, in pixels.
+ *
+ * @param height
+ *     The height of the rectangle, in pixels.
+ */
+void guac_rdp_paint_shadow(guac_rdp_paint* paint,
+        int x, int y, int width, int height);
+
+/**
+ * Sends all pending operations to the client. Small images which lie close
+ * together are combined into a single PNG. This function must be invoked
+ * before any drawing operation which is not deferred, such that the order of
+ * operations is preserved.
+ *
+ * @param paint
+ *     The guac_rdp_paint whose pending operations should be sent.
+ */
+void guac_rdp_paint_flush(guac_rdp_paint* paint);
+
+#endif
+
@@ -23,6 +23,7 @@
 #include "config.h"
 
 #include "client.h"
+#include "guac_pointer_cursor.h"
 #include "rdp_pointer.h"
 
 #include <pthread.h>
@@ -32,17 +33,9 @@
 
 void guac_rdp_pointer_new(rdpContext* context, rdpPointer* pointer) {
 
-    guac_client* client = ((rdp_freerdp_context*) context)->client;
-    guac_socket* socket = client->socket;
-
     /* Allocate data for image */
     unsigned char* data =
-        (unsigned char*) malloc(pointer->width * pointer->height * 4);
-
-    /* Allocate layer */
-    guac_layer* buffer = guac_client_alloc_buffer(client);
-
-    cairo_surface_t* surface;
+        (unsigned char*) calloc(pointer->width * pointer->height, 4);
 
     /* Convert to alpha cursor if mask data present */
     if (pointer->andMaskData && pointer->xorMaskData)
@@ -51,39 +44,28 @@ void guac_rdp_pointer_new(rdpContext* context, rdpPointer* pointer) {
                 pointer->width, pointer->height, pointer->xorBpp,
                 ((rdp_freerdp_context*) context)->clrconv);
 
-    /* Create surface from image data */
-    surface = cairo_image_surface_create_for_data(
-        data, CAIRO_FORMAT_ARGB32,
-        pointer->width, pointer->height, 4*pointer->width);
-
-    /* Send surface to buffer */
-    guac_protocol_send_png(socket, GUAC_COMP_SRC, buffer, 0, 0, surface);
-
-    /* Free surface */
-    cairo_surface_destroy(surface);
-    free(data);
-
-    /* Remember buffer */
-    ((guac_rdp_pointer*) pointer)->layer = buffer;
+    /* Remember image, which is sent only once set and if not yet cached */
+    ((guac_rdp_pointer*) pointer)->image_data = data;
 
 }
 
 void guac_rdp_pointer_set(rdpContext* context, rdpPointer* pointer) {
 
     guac_client* client = ((rdp_freerdp_context*) context)->client;
-    guac_socket* socket = client->socket;
+    rdp_guac_client_data* guac_client_data =
+        (rdp_guac_client_data*) client->data;
 
-    /* Set cursor */
-    guac_protocol_send_cursor(socket, pointer->xPos, pointer->yPos,
-            ((guac_rdp_pointer*) pointer)->layer,
-            0, 0, pointer->width, pointer->height);
+    /* Set cursor, sending image only if not already sent */
+    guac_common_cursor_cache_set(guac_client_data->cursor_cache,
+            pointer->xPos, pointer->yPos,
+            ((guac_rdp_pointer*) pointer)->image_data,
+            pointer->width, pointer->height, 4*pointer->width);
 
 }
 
 void guac_rdp_pointer_free(rdpContext* context, rdpPointer* pointer) {
 
-    guac_client* client = ((rdp_freerdp_context*) context)->client;
-    guac_client_free_buffer(client, ((guac_rdp_pointer*) pointer)->layer);
+    free(((guac_rdp_pointer*) pointer)->image_data);
 
 }
 
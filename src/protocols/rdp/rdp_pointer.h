@@ -38,9 +38,10 @@ typedef struct guac_rdp_pointer {
     rdpPointer pointer;
 
     /**
-     * Guacamole layer containing cached image data.
+     * The ARGB32 image data of this pointer, with rows packed at four bytes
+     * per pixel.
      */
-    guac_layer* layer;
+    unsigned char* image_data;
 
 } guac_rdp_pointer;
 
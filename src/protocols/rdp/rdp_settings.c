@@ -252,5 +252,24 @@ void guac_rdp_push_settings(guac_rdp_settings* guac_settings, freerdp* rdp) {
     rdp_settings->OrderSupport[NEG_ELLIPSE_CB_INDEX] = FALSE;
 #endif
 
+    /* RemoteFX and NSCodec, sent only as fast-path surface commands */
+    if (guac_settings->remotefx_enabled) {
+#ifdef LEGACY_RDPSETTINGS
+        rdp_settings->rfx_codec = TRUE;
+#ifdef HAVE_RDPSETTINGS_FASTPATH
+        rdp_settings->fast_path_output = TRUE;
+#endif
+#else
+        rdp_settings->RemoteFxCodec = TRUE;
+        rdp_settings->SurfaceCommandsEnabled = TRUE;
+#ifdef HAVE_FREERDP_NSCODEC
+        rdp_settings->NSCodec = TRUE;
+#endif
+#ifdef HAVE_RDPSETTINGS_FASTPATH
+        rdp_settings->FastPathOutput = TRUE;
+#endif
+#endif
+    }
+
 }
 
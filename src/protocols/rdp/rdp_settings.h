@@ -128,6 +128,18 @@ typedef struct guac_rdp_settings {
      */
     int audio_enabled;
 
+    /**
+     * The sample rate to which audio should be resampled, in Hz, or zero if
+     * audio should be sent at the rate provided by the server.
+     */
+    int audio_rate;
+
+    /**
+     * The number of channels to which audio should be downmixed, or zero if
+     * audio should be downmixed only as required by the audio encoder.
+     */
+    int audio_channels;
+
     /**
      * Whether printing is enabled.
      */
@@ -138,12 +150,26 @@ typedef struct guac_rdp_settings {
      */
     int drive_enabled;
 
+    /**
+     * Whether RemoteFX (and, where supported, NSCodec) surface bits are
+     * enabled.
+     */
+    int remotefx_enabled;
+
     /**
      * The local system path which will be used to persist the
      * virtual drive.
      */
     char* drive_path;
 
+    /**
+     * Whether small sequential writes to the virtual drive are buffered
+     * before being written. Buffered data which cannot be written is
+     * reported to the RDP server only when the file is next written,
+     * flushed or closed.
+     */
+    int write_behind_enabled;
+
     /**
      * Whether this session is a console session.
      */
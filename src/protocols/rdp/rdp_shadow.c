@@ -0,0 +1,425 @@
+/*
+ * Copyright (C) 2013 Glyptodon LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "config.h"
+
+#include "rdp_shadow.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Clips the given rectangle to the bounds of the given shadow surface,
+ * returning zero if nothing remains. If offsets are provided, they are
+ * updated with the number of pixels removed from the left and top edges.
+ */
+static int __guac_rdp_shadow_clip(guac_rdp_shadow* shadow,
+        int* x, int* y, int* width, int* height,
+        int* offset_x, int* offset_y) {
+
+    int left   = *x;
+    int top    = *y;
+    int right  = left + *width;
+    int bottom = top  + *height;
+
+    if (left < 0) left = 0;
+    if (top  < 0) top  = 0;
+    if (right  > shadow->width)  right  = shadow->width;
+    if (bottom > shadow->height) bottom = shadow->height;
+
+    if (right <= left || bottom <= top)
+        return 0;
+
+    if (offset_x != NULL) *offset_x = left - *x;
+    if (offset_y != NULL) *offset_y = top  - *y;
+
+    *x = left;
+    *y = top;
+    *width  = right  - left;
+    *height = bottom - top;
+
+    return 1;
+
+}
+
+/**
+ * Marks all tiles entirely covered by the given (already clipped) rectangle
+ * as valid, as their contents have been wholly replaced by known data.
+ */
+static void __guac_rdp_shadow_validate(guac_rdp_shadow* shadow,
+        int x, int y, int width, int height) {
+
+    int tile_x, tile_y;
+
+    /* Tiles along the right and bottom edges of the surface are complete
+     * when covered up to that edge */
+    int first_x = (x + GUAC_RDP_SHADOW_TILE_SIZE - 1) / GUAC_RDP_SHADOW_TILE_SIZE;
+    int first_y = (y + GUAC_RDP_SHADOW_TILE_SIZE - 1) / GUAC_RDP_SHADOW_TILE_SIZE;
+    int last_x = (x + width  == shadow->width)  ? shadow->tiles_wide
+               : (x + width)  / GUAC_RDP_SHADOW_TILE_SIZE;
+    int last_y = (y + height == shadow->height) ? shadow->tiles_high
+               : (y + height) / GUAC_RDP_SHADOW_TILE_SIZE;
+
+    for (tile_y = first_y; tile_y < last_y; tile_y++)
+        for (tile_x = first_x; tile_x < last_x; tile_x++)
+            shadow->valid[tile_y * shadow->tiles_wide + tile_x] = 1;
+
+}
+
+guac_rdp_shadow* guac_rdp_shadow_alloc(int width, int height) {
+
+    guac_rdp_shadow* shadow;
+
+    if (width <= 0 || height <= 0)
+        return NULL;
+
+    shadow = malloc(sizeof(guac_rdp_shadow));
+    if (shadow == NULL)
+        return NULL;
+
+    shadow->width  = width;
+    shadow->height = height;
+    shadow->stride = width * 4;
+    shadow->tiles_wide = (width  + GUAC_RDP_SHADOW_TILE_SIZE - 1) / GUAC_RDP_SHADOW_TILE_SIZE;
+    shadow->tiles_high = (height + GUAC_RDP_SHADOW_TILE_SIZE - 1) / GUAC_RDP_SHADOW_TILE_SIZE;
+
+    /* Surface starts black, as does the default layer */
+    shadow->buffer = calloc(height, shadow->stride);
+    shadow->valid = malloc(shadow->tiles_wide * shadow->tiles_high);
+
+    if (shadow->buffer == NULL || shadow->valid == NULL) {
+        free(shadow->buffer);
+        free(shadow->valid);
+        free(shadow);
+        return NULL;
+    }
+
+    memset(shadow->valid, 1, shadow->tiles_wide * shadow->tiles_high);
+    return shadow;
+
+}
+
+void guac_rdp_shadow_free(guac_rdp_shadow* shadow) {
+
+    if (shadow == NULL)
+        return;
+
+    free(shadow->buffer);
+    free(shadow->valid);
+    free(shadow);
+
+}
+
+int guac_rdp_shadow_is_valid(guac_rdp_shadow* shadow,
+        int x, int y, int width, int height) {
+
+    int tile_x, tile_y;
+    int first_x, first_y, last_x, last_y;
+
+    if (!__guac_rdp_shadow_clip(shadow, &x, &y, &width, &height, NULL, NULL))
+        return 1;
+
+    first_x = x / GUAC_RDP_SHADOW_TILE_SIZE;
+    first_y = y / GUAC_RDP_SHADOW_TILE_SIZE;
+    last_x  = (x + width  - 1) / GUAC_RDP_SHADOW_TILE_SIZE;
+    last_y  = (y + height - 1) / GUAC_RDP_SHADOW_TILE_SIZE;
+
+    for (tile_y = first_y; tile_y <= last_y; tile_y++)
+        for (tile_x = first_x; tile_x <= last_x; tile_x++)
+            if (!shadow->valid[tile_y * shadow->tiles_wide + tile_x])
+                return 0;
+
+    return 1;
+
+}
+
+void guac_rdp_shadow_invalidate(guac_rdp_shadow* shadow,
+        int x, int y, int width, int height) {
+
+    int tile_x, tile_y;
+    int first_x, first_y, last_x, last_y;
+
+    if (!__guac_rdp_shadow_clip(shadow, &x, &y, &width, &height, NULL, NULL))
+        return;
+
+    first_x = x / GUAC_RDP_SHADOW_TILE_SIZE;
+    first_y = y / GUAC_RDP_SHADOW_TILE_SIZE;
+    last_x  = (x + width  - 1) / GUAC_RDP_SHADOW_TILE_SIZE;
+    last_y  = (y + height - 1) / GUAC_RDP_SHADOW_TILE_SIZE;
+
+    for (tile_y = first_y; tile_y <= last_y; tile_y++)
+        for (tile_x = first_x; tile_x <= last_x; tile_x++)
+            shadow->valid[tile_y * shadow->tiles_wide + tile_x] = 0;
+
+}
+
+void guac_rdp_shadow_fill(guac_rdp_shadow* shadow,
+        int x, int y, int width, int height, uint32_t color) {
+
+    int row, col;
+
+    if (!__guac_rdp_shadow_clip(shadow, &x, &y, &width, &height, NULL, NULL))
+        return;
+
+    for (row = 0; row < height; row++) {
+        uint32_t* current = (uint32_t*) (shadow->buffer
+                + (y + row) * shadow->stride) + x;
+        for (col = 0; col < width; col++)
+            current[col] = color;
+    }
+
+    __guac_rdp_shadow_validate(shadow, x, y, width, height);
+
+}
+
+void guac_rdp_shadow_draw(guac_rdp_shadow* shadow,
+        int x, int y, int width, int height,
+        const unsigned char* data, int stride) {
+
+    int row;
+    int offset_x, offset_y;
+
+    if (!__guac_rdp_shadow_clip(shadow, &x, &y, &width, &height,
+                &offset_x, &offset_y))
+        return;
+
+    data += offset_y * stride + offset_x * 4;
+
+    for (row = 0; row < height; row++) {
+        memcpy(shadow->buffer + (y + row) * shadow->stride + x * 4,
+                data, width * 4);
+        data += stride;
+    }
+
+    __guac_rdp_shadow_validate(shadow, x, y, width, height);
+
+}
+
+void guac_rdp_shadow_copy(guac_rdp_shadow* shadow,
+        int src_x, int src_y, int width, int height, int x, int y) {
+
+    int row;
+    int offset_x, offset_y;
+    int source_valid;
+
+    /* Clip source, shifting destination accordingly */
+    if (!__guac_rdp_shadow_clip(shadow, &src_x, &src_y, &width, &height,
+                &offset_x, &offset_y))
+        return;
+
+    x += offset_x;
+    y += offset_y;
+
+    /* Clip destination, shifting source accordingly */
+    if (!__guac_rdp_shadow_clip(shadow, &x, &y, &width, &height,
+                &offset_x, &offset_y))
+        return;
+
+    src_x += offset_x;
+    src_y += offset_y;
+
+    source_valid = guac_rdp_shadow_is_valid(shadow,
+            src_x, src_y, width, height);
+
+    /* Copy rows in an order which does not overwrite unread source */
+    if (y > src_y) {
+        for (row = height - 1; row >= 0; row--)
+            memmove(shadow->buffer + (y + row) * shadow->stride + x * 4,
+                    shadow->buffer + (src_y + row) * shadow->stride + src_x * 4,
+                    width * 4);
+    }
+    else {
+        for (row = 0; row < height; row++)
+            memmove(shadow->buffer + (y + row) * shadow->stride + x * 4,
+                    shadow->buffer + (src_y + row) * shadow->stride + src_x * 4,
+                    width * 4);
+    }
+
+    /* Destination is only as valid as its source */
+    if (source_valid)
+        __guac_rdp_shadow_validate(shadow, x, y, width, height);
+    else
+        guac_rdp_shadow_invalidate(shadow, x, y, width, height);
+
+}
+
+void guac_rdp_shadow_glyph(guac_rdp_shadow* shadow,
+        int clip_x, int clip_y, int clip_width, int clip_height,
+        int x, int y, int width, int height,
+        const unsigned char* mask, int stride, uint32_t color) {
+
+    int row, col;
+    int left   = x;
+    int top    = y;
+    int right  = x + width;
+    int bottom = y + height;
+
+    /* Restrict glyph to clipping rectangle */
+    if (left < clip_x) left = clip_x;
+    if (top  < clip_y) top  = clip_y;
+    if (right  > clip_x + clip_width)  right  = clip_x + clip_width;
+    if (bottom > clip_y + clip_height) bottom = clip_y + clip_height;
+
+    /* Restrict glyph to surface */
+    if (left < 0) left = 0;
+    if (top  < 0) top  = 0;
+    if (right  > shadow->width)  right  = shadow->width;
+    if (bottom > shadow->height) bottom = shadow->height;
+
+    for (row = top; row < bottom; row++) {
+
+        const uint32_t* mask_row = (const uint32_t*) (mask
+                + (row - y) * stride);
+
+        uint32_t* current = (uint32_t*) (shadow->buffer
+                + row * shadow->stride);
+
+        for (col = left; col < right; col++) {
+            if (mask_row[col - x] & 0xFF000000)
+                current[col] = color;
+        }
+
+    }
+
+}
+
+int guac_rdp_shadow_rop3_uses_source(int rop3) {
+    /* Compare results where S is set (bits 2, 3, 6, 7) against unset */
+    return ((rop3 >> 2) & 0x33) != (rop3 & 0x33);
+}
+
+int guac_rdp_shadow_rop3_uses_pattern(int rop3) {
+    /* Compare results where P is set (bits 4 through 7) against unset */
+    return ((rop3 >> 4) & 0x0F) != (rop3 & 0x0F);
+}
+
+int guac_rdp_shadow_rop3_uses_dest(int rop3) {
+    /* Compare results where D is set (odd bits) against unset */
+    return ((rop3 >> 1) & 0x55) != (rop3 & 0x55);
+}
+
+/**
+ * Evaluates the given ROP3 opcode for a single row of pixels. Each of the
+ * eight possible combinations of pattern, source, and destination bits is
+ * selected through a mask rather than a branch, such that the loop body is
+ * free of conditionals and may be vectorized by the compiler.
+ */
+static void __guac_rdp_shadow_rop3_row(int rop3, uint32_t* restrict dst,
+        const uint32_t* restrict src, const uint32_t* restrict pat,
+        int width) {
+
+    int i;
+
+    /* Expand each bit of the opcode to a full-width mask */
+    uint32_t m0 = -(uint32_t) ((rop3     ) & 1);
+    uint32_t m1 = -(uint32_t) ((rop3 >> 1) & 1);
+    uint32_t m2 = -(uint32_t) ((rop3 >> 2) & 1);
+    uint32_t m3 = -(uint32_t) ((rop3 >> 3) & 1);
+    uint32_t m4 = -(uint32_t) ((rop3 >> 4) & 1);
+    uint32_t m5 = -(uint32_t) ((rop3 >> 5) & 1);
+    uint32_t m6 = -(uint32_t) ((rop3 >> 6) & 1);
+    uint32_t m7 = -(uint32_t) ((rop3 >> 7) & 1);
+
+    for (i = 0; i < width; i++) {
+
+        uint32_t d = dst[i];
+        uint32_t s = src[i];
+        uint32_t p = pat[i];
+
+        /* The bit index of each minterm is (P << 2) | (S << 1) | D */
+        dst[i] = (m0 & ~p & ~s & ~d)
+               | (m1 & ~p & ~s &  d)
+               | (m2 & ~p &  s & ~d)
+               | (m3 & ~p &  s &  d)
+               | (m4 &  p & ~s & ~d)
+               | (m5 &  p & ~s &  d)
+               | (m6 &  p &  s & ~d)
+               | (m7 &  p &  s &  d);
+
+    }
+
+}
+
+void guac_rdp_shadow_rop3(guac_rdp_shadow* shadow, int rop3,
+        int x, int y, int width, int height,
+        const unsigned char* src, int src_stride,
+        const guac_rdp_shadow_brush* brush) {
+
+    int row, col;
+    int offset_x, offset_y;
+
+    uint32_t* src_row;
+    uint32_t* pat_row;
+
+    if (!__guac_rdp_shadow_clip(shadow, &x, &y, &width, &height,
+                &offset_x, &offset_y))
+        return;
+
+    /* Rows of source and pattern, zeroed if unused */
+    src_row = calloc(width, sizeof(uint32_t));
+    pat_row = calloc(width, sizeof(uint32_t));
+
+    if (src_row == NULL || pat_row == NULL) {
+        free(src_row);
+        free(pat_row);
+        guac_rdp_shadow_invalidate(shadow, x, y, width, height);
+        return;
+    }
+
+    if (src != NULL)
+        src += offset_y * src_stride + offset_x * 4;
+
+    for (row = 0; row < height; row++) {
+
+        uint32_t* current = (uint32_t*) (shadow->buffer
+                + (y + row) * shadow->stride) + x;
+
+        if (src != NULL) {
+            memcpy(src_row, src, width * 4);
+            src += src_stride;
+        }
+
+        /* Expand pattern row relative to brush origin */
+        if (brush != NULL) {
+            const uint32_t* pattern = brush->pattern[
+                (y + row - brush->y) & (GUAC_RDP_SHADOW_BRUSH_SIZE - 1)];
+            for (col = 0; col < width; col++)
+                pat_row[col] = pattern[
+                    (x + col - brush->x) & (GUAC_RDP_SHADOW_BRUSH_SIZE - 1)];
+        }
+
+        __guac_rdp_shadow_rop3_row(rop3, current, src_row, pat_row, width);
+
+    }
+
+    free(src_row);
+    free(pat_row);
+
+    /* Tiles are fully known if the result does not depend on their old
+     * contents */
+    if (!guac_rdp_shadow_rop3_uses_dest(rop3))
+        __guac_rdp_shadow_validate(shadow, x, y, width, height);
+
+}
+
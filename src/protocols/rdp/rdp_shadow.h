@@ -0,0 +1,388 @@
+/*
+ * Copyright (C) 2013 Glyptodon LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef _GUAC_RDP_RDP_SHADOW_H
+#define _GUAC_RDP_RDP_SHADOW_H
+
+#include "config.h"
+
+#include <stdint.h>
+
+/**
+ * The width and height of each region of the shadow surface whose validity
+ * is tracked, in pixels.
+ */
+#define GUAC_RDP_SHADOW_TILE_SIZE 64
+
+/**
+ * The width and height of each brush pattern, in pixels.
+ */
+#define GUAC_RDP_SHADOW_BRUSH_SIZE 8
+
+/**
+ * A brush, expanded to an 8x8 pattern of 32-bit RGB colors.
+ */
+typedef struct guac_rdp_shadow_brush {
+
+    /**
+     * The X coordinate of the brush origin. The first column of the
+     * pattern is drawn at this coordinate, and repeats every 8 pixels.
+     */
+    int x;
+
+    /**
+     * The Y coordinate of the brush origin. The first row of the pattern is
+     * drawn at this coordinate, and repeats every 8 pixels.
+     */
+    int y;
+
+    /**
+     * The color of each pixel of the pattern, by row and then by column.
+     */
+    uint32_t pattern[GUAC_RDP_SHADOW_BRUSH_SIZE][GUAC_RDP_SHADOW_BRUSH_SIZE];
+
+} guac_rdp_shadow_brush;
+
+/**
+ * Server-side copy of the contents of the default layer, allowing raster
+ * operations which depend on existing contents to be evaluated locally. As
+ * some drawing copies data which exists only client-side, the shadow surface
+ * tracks which of its regions are known to match the client.
+ */
+typedef struct guac_rdp_shadow {
+
+    /**
+     * The width of the shadow surface, in pixels.
+     */
+    int width;
+
+    /**
+     * The height of the shadow surface, in pixels.
+     */
+    int height;
+
+    /**
+     * The number of bytes in each row of the shadow surface.
+     */
+    int stride;
+
+    /**
+     * The contents of the shadow surface, in 32-bit RGB.
+     */
+    unsigned char* buffer;
+
+    /**
+     * The number of tiles in each row of tiles.
+     */
+    int tiles_wide;
+
+    /**
+     * The number of rows of tiles.
+     */
+    int tiles_high;
+
+    /**
+     * For each tile, by row and then by column, whether the contents of the
+     * shadow surface within that tile are known to match the client.
+     */
+    unsigned char* valid;
+
+} guac_rdp_shadow;
+
+/**
+ * Allocates a new shadow surface of the given size. The surface is initially
+ * black, matching the initial contents of the default layer, and thus
+ * entirely valid.
+ *
+ * @param width
+ *     The width of the shadow surface, in pixels.
+ *
+ * @param height
+ *     The height of the shadow surface, in pixels.
+ *
+ * @return
+ *     A newly-allocated shadow surface, or NULL if allocation fails.
+ */
+guac_rdp_shadow* guac_rdp_shadow_alloc(int width, int height);
+
+/**
+ * Frees the given shadow surface.
+ *
+ * @param shadow
+ *     The shadow surface to free.
+ */
+void guac_rdp_shadow_free(guac_rdp_shadow* shadow);
+
+/**
+ * Returns whether the contents of the given rectangle of the shadow surface
+ * are known to match the client.
+ *
+ * @param shadow
+ *     The shadow surface to test.
+ *
+ * @param x
+ *     The X coordinate of the upper-left corner of the rectangle.
+ *
+ * @param y
+ *     The Y coordinate of the upper-left corner of the rectangle.
+ *
+ * @param width
+ *     The width of the rectangle, in pixels.
+ *
+ * @param height
+ *     The height of the rectangle, in pixels.
+ *
+ * @return
+ *     Non-zero if the entire rectangle is valid, zero otherwise.
+ */
+int guac_rdp_shadow_is_valid(guac_rdp_shadow* shadow,
+        int x, int y, int width, int height);
+
+/**
+ * Marks the given rectangle of the shadow surface as no longer matching the
+ * client, such as when the client has drawn data not known to the server.
+ *
+ * @param shadow
+ *     The shadow surface to update.
+ *
+ * @param x
+ *     The X coordinate of the upper-left corner of the rectangle.
+ *
+ * @param y
+ *     The Y coordinate of the upper-left corner of the rectangle.
+ *
+ * @param width
+ *     The width of the rectangle, in pixels.
+ *
+ * @param height
+ *     The height of the rectangle, in pixels.
+ */
+void guac_rdp_shadow_invalidate(guac_rdp_shadow* shadow,
+        int x, int y, int width, int height);
+
+/**
+ * Fills the given rectangle of the shadow surface with the given color.
+ *
+ * @param shadow
+ *     The shadow surface to draw to.
+ *
+ * @param x
+ *     The X coordinate of the upper-left corner of the rectangle.
+ *
+ * @param y
+ *     The Y coordinate of the upper-left corner of the rectangle.
+ *
+ * @param width
+ *     The width of the rectangle, in pixels.
+ *
+ * @param height
+ *     The height of the rectangle, in pixels.
+ *
+ * @param color
+ *     The color to fill with, as 24-bit RGB.
+ */
+void guac_rdp_shadow_fill(guac_rdp_shadow* shadow,
+        int x, int y, int width, int height, uint32_t color);
+
+/**
+ * Draws the given 32-bit RGB image data to the shadow surface.
+ *
+ * @param shadow
+ *     The shadow surface to draw to.
+ *
+ * @param x
+ *     The X coordinate of the upper-left corner of the destination.
+ *
+ * @param y
+ *     The Y coordinate of the upper-left corner of the destination.
+ *
+ * @param width
+ *     The width of the image, in pixels.
+ *
+ * @param height
+ *     The height of the image, in pixels.
+ *
+ * @param data
+ *     The image data, pointing to the first pixel of the top row.
+ *
+ * @param stride
+ *     The number of bytes in each row of image data, which may be negative
+ *     for bottom-up image data.
+ */
+void guac_rdp_shadow_draw(guac_rdp_shadow* shadow,
+        int x, int y, int width, int height,
+        const unsigned char* data, int stride);
+
+/**
+ * Copies a rectangle of the shadow surface to another location within the
+ * shadow surface. The source and destination may overlap.
+ *
+ * @param shadow
+ *     The shadow surface to copy within.
+ *
+ * @param src_x
+ *     The X coordinate of the upper-left corner of the source rectangle.
+ *
+ * @param src_y
+ *     The Y coordinate of the upper-left corner of the source rectangle.
+ *
+ * @param width
+ *     The width of the rectangle, in pixels.
+ *
+ * @param height
+ *     The height of the rectangle, in pixels.
+ *
+ * @param x
+ *     The X coordinate of the upper-left corner of the destination.
+ *
+ * @param y
+ *     The Y coordinate of the upper-left corner of the destination.
+ */
+void guac_rdp_shadow_copy(guac_rdp_shadow* shadow,
+        int src_x, int src_y, int width, int height, int x, int y);
+
+/**
+ * Draws the given glyph mask to the shadow surface in the given color,
+ * affecting only the pixels within the given clipping rectangle.
+ *
+ * @param shadow
+ *     The shadow surface to draw to.
+ *
+ * @param clip_x
+ *     The X coordinate of the upper-left corner of the clipping rectangle.
+ *
+ * @param clip_y
+ *     The Y coordinate of the upper-left corner of the clipping rectangle.
+ *
+ * @param clip_width
+ *     The width of the clipping rectangle, in pixels.
+ *
+ * @param clip_height
+ *     The height of the clipping rectangle, in pixels.
+ *
+ * @param x
+ *     The X coordinate of the upper-left corner of the glyph.
+ *
+ * @param y
+ *     The Y coordinate of the upper-left corner of the glyph.
+ *
+ * @param width
+ *     The width of the glyph, in pixels.
+ *
+ * @param height
+ *     The height of the glyph, in pixels.
+ *
+ * @param mask
+ *     The glyph mask, as 32-bit ARGB, where only pixels with non-zero alpha
+ *     are drawn.
+ *
+ * @param stride
+ *     The number of bytes in each row of the glyph mask.
+ *
+ * @param color
+ *     The color of the glyph, as 24-bit RGB.
+ */
+void guac_rdp_shadow_glyph(guac_rdp_shadow* shadow,
+        int clip_x, int clip_y, int clip_width, int clip_height,
+        int x, int y, int width, int height,
+        const unsigned char* mask, int stride, uint32_t color);
+
+/**
+ * Returns whether the given ROP3 opcode depends on the source.
+ *
+ * @param rop3
+ *     The ROP3 opcode to test.
+ *
+ * @return
+ *     Non-zero if the result of the operation depends on the source, zero
+ *     otherwise.
+ */
+int guac_rdp_shadow_rop3_uses_source(int rop3);
+
+/**
+ * Returns whether the given ROP3 opcode depends on the pattern.
+ *
+ * @param rop3
+ *     The ROP3 opcode to test.
+ *
+ * @return
+ *     Non-zero if the result of the operation depends on the pattern, zero
+ *     otherwise.
+ */
+int guac_rdp_shadow_rop3_uses_pattern(int rop3);
+
+/**
+ * Returns whether the given ROP3 opcode depends on the existing contents of
+ * the destination.
+ *
+ * @param rop3
+ *     The ROP3 opcode to test.
+ *
+ * @return
+ *     Non-zero if the result of the operation depends on the destination,
+ *     zero otherwise.
+ */
+int guac_rdp_shadow_rop3_uses_dest(int rop3);
+
+/**
+ * Evaluates the given ROP3 opcode within the given rectangle of the shadow
+ * surface, combining the existing contents of the shadow surface with the
+ * given source image and brush. The source and brush need only be provided
+ * if the opcode depends on them.
+ *
+ * @param shadow
+ *     The shadow surface to draw to.
+ *
+ * @param rop3
+ *     The ROP3 opcode to evaluate.
+ *
+ * @param x
+ *     The X coordinate of the upper-left corner of the rectangle.
+ *
+ * @param y
+ *     The Y coordinate of the upper-left corner of the rectangle.
+ *
+ * @param width
+ *     The width of the rectangle, in pixels.
+ *
+ * @param height
+ *     The height of the rectangle, in pixels.
+ *
+ * @param src
+ *     The source image data, in 32-bit RGB, corresponding to the upper-left
+ *     corner of the rectangle, or NULL if the opcode does not use a source.
+ *
+ * @param src_stride
+ *     The number of bytes in each row of the source image data.
+ *
+ * @param brush
+ *     The brush to use as the pattern, or NULL if the opcode does not use a
+ *     pattern.
+ */
+void guac_rdp_shadow_rop3(guac_rdp_shadow* shadow, int rop3,
+        int x, int y, int width, int height,
+        const unsigned char* src, int src_stride,
+        const guac_rdp_shadow_brush* brush);
+
+#endif
+
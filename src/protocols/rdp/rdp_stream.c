@@ -255,12 +255,16 @@ int guac_rdp_upload_end_handler(guac_client* client, guac_stream* stream) {
         return 0;
     }
 
-    /* Close file */
-    guac_rdp_fs_close(fs, rdp_stream->upload_status.file_id);
+    /* Close file, failing if buffered data could not be written */
+    if (guac_rdp_fs_close(fs, rdp_stream->upload_status.file_id))
+        guac_protocol_send_ack(client->socket, stream, "FAIL (BAD WRITE)",
+                GUAC_PROTOCOL_STATUS_CLIENT_FORBIDDEN);
+
+    /* Otherwise, acknowledge stream end */
+    else
+        guac_protocol_send_ack(client->socket, stream, "OK (STREAM END)",
+                GUAC_PROTOCOL_STATUS_SUCCESS);
 
-    /* Acknowledge stream end */
-    guac_protocol_send_ack(client->socket, stream, "OK (STREAM END)",
-            GUAC_PROTOCOL_STATUS_SUCCESS);
     guac_socket_flush(client->socket);
 
     free(rdp_stream);
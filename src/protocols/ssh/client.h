@@ -44,7 +44,20 @@
 /**
  * The maximum number of bytes to allow within the clipboard.
  */
-#define GUAC_SSH_CLIPBOARD_MAX_LENGTH 262144
+#define GUAC_SSH_CLIPBOARD_MAX_LENGTH 16777216
+
+/**
+ * The maximum duration of a single frame, in milliseconds. Terminal output
+ * received within this time is rendered together, with only the final state
+ * of the display being sent.
+ */
+#define GUAC_SSH_FRAME_DURATION 40
+
+/**
+ * The maximum amount of time to wait for further terminal output before
+ * ending the current frame early, in milliseconds.
+ */
+#define GUAC_SSH_FRAME_TIMEOUT 10
 
 /**
  * SSH-specific client data.
@@ -105,226 +105,569 @@ static bool __guac_terminal_display_selected_contains(guac_terminal_display* dis
 
 }
 
-/* Maps any codepoint onto a number between 0 and 511 inclusive */
-int __guac_terminal_hash_codepoint(int codepoint) {
+/**
+ * Marks the given rectangle of character cells as possibly containing pending
+ * operations, such that the next flush will examine those cells. The
+ * rectangle given must already be within the bounds of the display.
+ */
+static void __guac_terminal_display_mark_dirty(guac_terminal_display* display,
+        int start_row, int start_column, int end_row, int end_column) {
+
+    int row;
+
+    /* Expand range of dirty rows */
+    if (start_row < display->dirty_start_row)
+        display->dirty_start_row = start_row;
+
+    if (end_row > display->dirty_end_row)
+        display->dirty_end_row = end_row;
+
+    /* Expand range of dirty columns within each row */
+    for (row=start_row; row<=end_row; row++) {
+
+        guac_terminal_dirty_row* dirty = &(display->dirty_rows[row]);
 
-    /* If within one byte, just return codepoint */
-    if (codepoint <= 0xFF)
-        return codepoint;
+        if (start_column < dirty->start_column)
+            dirty->start_column = start_column;
 
-    /* Otherwise, map to next 256 values */
-    return (codepoint & 0xFF) + 0x100;
+        if (end_column > dirty->end_column)
+            dirty->end_column = end_column;
+
+    }
 
 }
 
 /**
- * Returns the location of the given character in the glyph cache layer,
- * sending it first if necessary. The location returned is in characters,
- * and thus must be multiplied by the glyph width to obtain the actual
- * location within the glyph cache layer.
+ * Marks all rows of the display as containing no pending operations. This
+ * must only be called once all pending operations have been flushed.
  */
-int __guac_terminal_get_glyph(guac_terminal_display* display, int codepoint) {
+static void __guac_terminal_display_clear_dirty(guac_terminal_display* display) {
 
-    guac_socket* socket = display->client->socket;
-    int location;
+    int row;
+
+    for (row=display->dirty_start_row; row<=display->dirty_end_row; row++) {
+        guac_terminal_dirty_row* dirty = &(display->dirty_rows[row]);
+        dirty->start_column = display->width;
+        dirty->end_column = -1;
+    }
 
-    int bytes;
-    char utf8[4];
+    display->dirty_start_row = display->height;
+    display->dirty_end_row = -1;
 
-    /* Use foreground color */
-    const guac_terminal_color* color =
-        &guac_terminal_palette[display->glyph_foreground];
+}
 
-    /* Use background color */
-    const guac_terminal_color* background =
-        &guac_terminal_palette[display->glyph_background];
+/**
+ * Maps the given codepoint and glyph style onto a bucket within the glyph
+ * hash table.
+ */
+static int __guac_terminal_hash_glyph(int codepoint, int style) {
 
-    cairo_surface_t* surface;
-    cairo_t* cairo;
-   
-    PangoLayout* layout;
+    /* Codepoints within the same block differ only in their low bits */
+    unsigned int hash = (((unsigned int) codepoint << 1) | style)
+                      ^ ((unsigned int) codepoint >> 9);
 
-    /* Get codepoint hash */
-    int hashcode = __guac_terminal_hash_codepoint(codepoint);
+    return hash & (GUAC_TERMINAL_GLYPH_BUCKETS - 1);
+
+}
+
+/**
+ * Returns the X coordinate of the given glyph atlas slot, in pixels.
+ */
+static int __guac_terminal_glyph_x(guac_terminal_display* display,
+        int location) {
+    return (location % GUAC_TERMINAL_GLYPH_ATLAS_COLUMNS) * display->char_width;
+}
+
+/**
+ * Returns the Y coordinate of the given glyph atlas slot, in pixels.
+ */
+static int __guac_terminal_glyph_y(guac_terminal_display* display,
+        int location) {
+    return (location / GUAC_TERMINAL_GLYPH_ATLAS_COLUMNS) * display->char_height;
+}
 
-    /* If something already stored here, either same codepoint or collision */
-    if (display->glyphs[hashcode].location) {
+/**
+ * Marks the given glyph as the most-recently-used glyph, and as in use by the
+ * current glyph batch.
+ */
+static void __guac_terminal_touch_glyph(guac_terminal_display* display,
+        guac_terminal_glyph* glyph) {
+
+    glyph->batch = display->glyph_batch;
+
+    /* Nothing to do if already most-recently-used */
+    if (display->first_used_glyph == glyph)
+        return;
 
-        location = display->glyphs[hashcode].location - 1;
+    /* Remove from current position within list, if present */
+    if (glyph->prev_used != NULL) {
 
-        /* If match, return match. */
-        if (display->glyphs[hashcode].codepoint == codepoint)
-            return location;
+        glyph->prev_used->next_used = glyph->next_used;
 
-        /* Otherwise, reuse location */
+        if (glyph->next_used != NULL)
+            glyph->next_used->prev_used = glyph->prev_used;
+        else
+            display->last_used_glyph = glyph->prev_used;
 
     }
 
-    /* If no collision, allocate new glyph location */
+    /* Insert at head of list */
+    glyph->prev_used = NULL;
+    glyph->next_used = display->first_used_glyph;
+
+    if (display->first_used_glyph != NULL)
+        display->first_used_glyph->prev_used = glyph;
     else
-        location = display->next_glyph++;
-
-    /* Convert to UTF-8 */
-    bytes = guac_terminal_encode_utf8(codepoint, utf8);
-
-    /* Prepare surface */
-    surface = cairo_image_surface_create(
-            CAIRO_FORMAT_ARGB32,
-            display->char_width, display->char_height);
-    cairo = cairo_create(surface);
-
-    /* Get layout */
-    layout = pango_cairo_create_layout(cairo);
-    pango_layout_set_font_description(layout, display->font_desc);
-    pango_layout_set_text(layout, utf8, bytes);
-
-    /* Draw */
-    cairo_set_source_rgba(cairo,
-            color->red   / 255.0,
-            color->green / 255.0,
-            color->blue  / 255.0,
-            1.0 /* alpha */ );
-
-    cairo_move_to(cairo, 0.0, 0.0);
-    pango_cairo_show_layout(cairo, layout);
-
-    /* Free all */
-    g_object_unref(layout);
-    cairo_destroy(cairo);
-
-    /* Clear existing glyph (if any) */
-    guac_protocol_send_rect(socket, display->glyph_stroke,
-            location * display->char_width, 0,
-            display->char_width, display->char_height);
-
-    guac_protocol_send_cfill(socket, GUAC_COMP_ROUT, display->glyph_stroke,
+        display->last_used_glyph = glyph;
+
+    display->first_used_glyph = glyph;
+
+}
+
+/**
+ * Removes the given glyph from the glyph hash table, such that its slot
+ * within the glyph atlas can be reused.
+ */
+static void __guac_terminal_remove_glyph(guac_terminal_display* display,
+        guac_terminal_glyph* glyph) {
+
+    guac_terminal_glyph** current = &(display->glyph_buckets[
+        __guac_terminal_hash_glyph(glyph->codepoint, glyph->style)]);
+
+    /* Find and unlink glyph */
+    while (*current != NULL) {
+
+        if (*current == glyph) {
+            *current = glyph->next_in_bucket;
+            break;
+        }
+
+        current = &((*current)->next_in_bucket);
+
+    }
+
+    glyph->next_in_bucket = NULL;
+
+}
+
+/**
+ * Colors each glyph which pending draws require within the given colored
+ * copy of the glyph atlas, copying the glyph from the atlas and filling its
+ * foreground and background.
+ */
+static void __guac_terminal_display_colorize(guac_terminal_display* display,
+        guac_terminal_glyph_colors* colors) {
+
+    guac_socket* socket = display->client->socket;
+    int i;
+    int count = 0;
+
+    const guac_terminal_color* foreground =
+        &guac_terminal_palette[colors->foreground];
+
+    const guac_terminal_color* background =
+        &guac_terminal_palette[colors->background];
+
+    /* Clear slots of all glyphs being colored */
+    for (i=0; i<display->pending_draw_count; i++) {
+
+        guac_terminal_glyph_draw* draw = &(display->pending_draws[i]);
+        if (!draw->colorize || draw->colors != colors)
+            continue;
+
+        guac_protocol_send_rect(socket, colors->layer,
+                __guac_terminal_glyph_x(display, draw->location),
+                __guac_terminal_glyph_y(display, draw->location),
+                display->char_width, display->char_height);
+
+        count++;
+
+    }
+
+    /* Nothing to do if no glyphs need coloring */
+    if (count == 0)
+        return;
+
+    guac_protocol_send_cfill(socket, GUAC_COMP_ROUT, colors->layer,
             0x00, 0x00, 0x00, 0xFF);
 
-    /* Send glyph */
-    guac_protocol_send_png(socket, GUAC_COMP_OVER, display->glyph_stroke, location * display->char_width, 0, surface);
+    /* Copy each glyph from atlas */
+    for (i=0; i<display->pending_draw_count; i++) {
+
+        guac_terminal_glyph_draw* draw = &(display->pending_draws[i]);
+        int x, y;
+
+        if (!draw->colorize || draw->colors != colors)
+            continue;
+
+        x = __guac_terminal_glyph_x(display, draw->location);
+        y = __guac_terminal_glyph_y(display, draw->location);
+
+        guac_protocol_send_copy(socket, display->glyph_stroke,
+                x, y, display->char_width, display->char_height,
+                GUAC_COMP_OVER, colors->layer, x, y);
+
+    }
+
+    /* Colorize glyph strokes */
+    for (i=0; i<display->pending_draw_count; i++) {
+
+        guac_terminal_glyph_draw* draw = &(display->pending_draws[i]);
+        if (!draw->colorize || draw->colors != colors)
+            continue;
+
+        guac_protocol_send_rect(socket, colors->layer,
+                __guac_terminal_glyph_x(display, draw->location),
+                __guac_terminal_glyph_y(display, draw->location),
+                display->char_width, display->char_height);
+
+    }
+
+    guac_protocol_send_cfill(socket, GUAC_COMP_ATOP, colors->layer,
+            foreground->red,
+            foreground->green,
+            foreground->blue,
+            0xFF);
 
-    /* Update filled glyphs */
-    guac_protocol_send_rect(socket, display->filled_glyphs,
-            location * display->char_width, 0,
-            display->char_width, display->char_height);
+    /* Fill background behind strokes */
+    for (i=0; i<display->pending_draw_count; i++) {
 
-    guac_protocol_send_cfill(socket, GUAC_COMP_OVER, display->filled_glyphs,
+        guac_terminal_glyph_draw* draw = &(display->pending_draws[i]);
+        if (!draw->colorize || draw->colors != colors)
+            continue;
+
+        guac_protocol_send_rect(socket, colors->layer,
+                __guac_terminal_glyph_x(display, draw->location),
+                __guac_terminal_glyph_y(display, draw->location),
+                display->char_width, display->char_height);
+
+    }
+
+    guac_protocol_send_cfill(socket, GUAC_COMP_ROVER, colors->layer,
             background->red,
             background->green,
             background->blue,
             0xFF);
 
-    guac_protocol_send_copy(socket, display->glyph_stroke,
-            location * display->char_width, 0, display->char_width, display->char_height,
-            GUAC_COMP_OVER, display->filled_glyphs, location * display->char_width, 0);
+}
+
+/**
+ * Renders and sends all pending glyphs as a single PNG, copying each into its
+ * slot within the glyph atlas, colors any glyphs missing from the colored
+ * copies of the atlas, and then draws all pending characters. Once this
+ * function returns, a new glyph batch has begun.
+ */
+static void __guac_terminal_display_flush_glyphs(guac_terminal_display* display) {
+
+    guac_socket* socket = display->client->socket;
+    int i;
 
-    display->glyphs[hashcode].location = location+1;
-    display->glyphs[hashcode].codepoint = codepoint;
+    /* Send all newly-rendered glyphs, if any */
+    if (display->pending_glyph_count > 0) {
 
-    cairo_surface_destroy(surface);
+        int count = display->pending_glyph_count;
 
-    /* Return glyph */
-    return location;
+        cairo_surface_t* surface;
+        cairo_t* cairo;
+        PangoLayout* layout;
+
+        /* Prepare surface large enough for all pending glyphs */
+        surface = cairo_image_surface_create(
+                CAIRO_FORMAT_ARGB32,
+                display->char_width * count, display->char_height);
+        cairo = cairo_create(surface);
+
+        /* Get layout */
+        layout = pango_cairo_create_layout(cairo);
+        pango_layout_set_font_description(layout, display->font_desc);
+
+        /* Glyphs are colored later, as they are copied from the atlas */
+        cairo_set_source_rgba(cairo, 1.0, 1.0, 1.0, 1.0);
+
+        /* Draw each glyph side-by-side */
+        for (i=0; i<count; i++) {
+
+            guac_terminal_glyph* glyph = display->pending_glyphs[i];
+            int x = i * display->char_width;
+
+            int bytes;
+            char utf8[4];
+
+            /* Convert to UTF-8 */
+            bytes = guac_terminal_encode_utf8(glyph->codepoint, utf8);
+            pango_layout_set_text(layout, utf8, bytes);
+
+            /* Restrict drawing to the glyph's own cell */
+            cairo_save(cairo);
+            cairo_rectangle(cairo, x, 0,
+                    display->char_width, display->char_height);
+            cairo_clip(cairo);
+
+            /* Draw */
+            cairo_move_to(cairo, x, 0.0);
+            pango_cairo_show_layout(cairo, layout);
+
+            /* Draw underscore along bottom of cell, if requested */
+            if (glyph->style & GUAC_TERMINAL_GLYPH_UNDERSCORE) {
+                cairo_rectangle(cairo, x, display->char_height - 1,
+                        display->char_width, 1);
+                cairo_fill(cairo);
+            }
+
+            cairo_restore(cairo);
+
+        }
+
+        /* Free all */
+        g_object_unref(layout);
+        cairo_destroy(cairo);
+
+        /* Send all glyphs at once */
+        guac_protocol_send_png(socket, GUAC_COMP_SRC, display->glyph_staging,
+                0, 0, surface);
+
+        cairo_surface_destroy(surface);
+
+        /* Clear existing glyphs (if any) */
+        for (i=0; i<count; i++) {
+            int location = display->pending_glyphs[i]->location;
+            guac_protocol_send_rect(socket, display->glyph_stroke,
+                    __guac_terminal_glyph_x(display, location),
+                    __guac_terminal_glyph_y(display, location),
+                    display->char_width, display->char_height);
+        }
+
+        guac_protocol_send_cfill(socket, GUAC_COMP_ROUT, display->glyph_stroke,
+                0x00, 0x00, 0x00, 0xFF);
+
+        /* Move each glyph into its slot */
+        for (i=0; i<count; i++) {
+            int location = display->pending_glyphs[i]->location;
+            guac_protocol_send_copy(socket, display->glyph_staging,
+                    i * display->char_width, 0,
+                    display->char_width, display->char_height,
+                    GUAC_COMP_OVER, display->glyph_stroke,
+                    __guac_terminal_glyph_x(display, location),
+                    __guac_terminal_glyph_y(display, location));
+        }
+
+        display->pending_glyph_count = 0;
+
+    }
+
+    /* Color any glyphs not yet present in their colored copies of the atlas */
+    for (i=0; i<GUAC_TERMINAL_GLYPH_COLOR_LAYERS; i++) {
+        if (display->glyph_colors[i].batch == display->glyph_batch)
+            __guac_terminal_display_colorize(display,
+                    &(display->glyph_colors[i]));
+    }
+
+    /* Draw all pending characters */
+    for (i=0; i<display->pending_draw_count; i++) {
+
+        guac_terminal_glyph_draw* draw = &(display->pending_draws[i]);
+
+        guac_protocol_send_copy(socket,
+            draw->colors->layer,
+            __guac_terminal_glyph_x(display, draw->location),
+            __guac_terminal_glyph_y(display, draw->location),
+            display->char_width, display->char_height,
+            GUAC_COMP_OVER, GUAC_DEFAULT_LAYER,
+            display->char_width * draw->column,
+            display->char_height * draw->row);
+
+    }
+
+    display->pending_draw_count = 0;
+
+    /* Begin new batch */
+    display->glyph_batch++;
 
 }
 
 /**
- * Sets the attributes of the glyph cache layer such that future copies from
- * this layer will display as expected.
+ * Returns the location of the given character in the glyph atlas, allocating
+ * a slot for it first if necessary. Newly-allocated glyphs are not sent
+ * until the current glyph batch is flushed. The location returned is the
+ * index of a slot within the glyph atlas, and must be converted to pixel
+ * coordinates using the glyph width and height.
  */
-int __guac_terminal_set_colors(guac_terminal_display* display,
-        guac_terminal_attributes* attributes) {
+int __guac_terminal_get_glyph(guac_terminal_display* display, int codepoint,
+        int style) {
 
-    guac_socket* socket = display->client->socket;
-    const guac_terminal_color* background_color;
-    int background, foreground;
+    guac_terminal_glyph* glyph;
+
+    /* Get codepoint hash */
+    int hashcode = __guac_terminal_hash_glyph(codepoint, style);
+
+    /* Return existing glyph if already cached */
+    for (glyph = display->glyph_buckets[hashcode]; glyph != NULL;
+            glyph = glyph->next_in_bucket) {
+
+        if (glyph->codepoint == codepoint && glyph->style == style) {
+            __guac_terminal_touch_glyph(display, glyph);
+            return glyph->location;
+        }
 
-    /* Handle reverse video */
-    if (attributes->reverse != attributes->cursor) {
-        background = attributes->foreground;
-        foreground = attributes->background;
     }
+
+    /* Send pending glyphs if the batch is full */
+    if (display->pending_glyph_count == GUAC_TERMINAL_GLYPH_BATCH_SIZE)
+        __guac_terminal_display_flush_glyphs(display);
+
+    /* Use never-used slot, if any remain */
+    if (display->next_glyph < GUAC_TERMINAL_GLYPH_ATLAS_SIZE)
+        glyph = &(display->glyphs[display->next_glyph++]);
+
+    /* Otherwise, reuse slot of least-recently-used glyph */
     else {
-        foreground = attributes->foreground;
-        background = attributes->background;
+
+        glyph = display->last_used_glyph;
+
+        /* Pending draws may still refer to glyphs used in this batch */
+        if (glyph->batch == display->glyph_batch)
+            __guac_terminal_display_flush_glyphs(display);
+
+        __guac_terminal_remove_glyph(display, glyph);
+
     }
 
-    /* Handle bold */
-    if (attributes->bold && foreground <= 7)
-        foreground += 8;
+    /* Store glyph within hash table */
+    glyph->codepoint = codepoint;
+    glyph->style = style;
+    glyph->generation++;
+    glyph->next_in_bucket = display->glyph_buckets[hashcode];
+    display->glyph_buckets[hashcode] = glyph;
 
-    /* Get background color */
-    background_color = &guac_terminal_palette[background];
+    __guac_terminal_touch_glyph(display, glyph);
 
-    /* If foreground different from current, colorize */
-    if (foreground != display->glyph_foreground) {
+    /* Render with next batch */
+    display->pending_glyphs[display->pending_glyph_count++] = glyph;
 
-        /* Get color */
-        const guac_terminal_color* color =
-            &guac_terminal_palette[foreground];
+    /* Return glyph */
+    return glyph->location;
 
-        /* Colorize letter */
-        guac_protocol_send_rect(socket, display->glyph_stroke,
-            0, 0,
-            display->char_width * display->next_glyph, display->char_height);
+}
 
-        guac_protocol_send_cfill(socket, GUAC_COMP_ATOP, display->glyph_stroke,
-            color->red,
-            color->green,
-            color->blue,
-            255);
+/**
+ * Returns the colored copy of the glyph atlas for the given foreground and
+ * background colors, replacing the least-recently-used copy if no copy
+ * exists for those colors.
+ */
+static guac_terminal_glyph_colors* __guac_terminal_get_glyph_colors(
+        guac_terminal_display* display, int foreground, int background) {
+
+    guac_terminal_glyph_colors* colors = NULL;
+    int i;
+
+    /* Find existing copy, noting least-recently-used copy */
+    for (i=0; i<GUAC_TERMINAL_GLYPH_COLOR_LAYERS; i++) {
+
+        guac_terminal_glyph_colors* current = &(display->glyph_colors[i]);
+
+        /* Return match if found */
+        if (current->foreground == foreground
+                && current->background == background) {
+            current->last_used = ++display->color_clock;
+            current->batch = display->glyph_batch;
+            return current;
+        }
+
+        if (colors == NULL || current->last_used < colors->last_used)
+            colors = current;
 
     }
 
-    /* If any color change at all, update filled */
-    if (foreground != display->glyph_foreground
-            || background != display->glyph_background) {
+    /* Pending draws may still refer to copies used in this batch */
+    if (colors->batch == display->glyph_batch)
+        __guac_terminal_display_flush_glyphs(display);
 
-        /* Set background */
-        guac_protocol_send_rect(socket, display->filled_glyphs,
-            0, 0,
-            display->char_width * display->next_glyph, display->char_height);
+    /* Allocate layer on first use */
+    if (colors->layer == NULL)
+        colors->layer = guac_client_alloc_buffer(display->client);
 
-        guac_protocol_send_cfill(socket, GUAC_COMP_OVER, display->filled_glyphs,
-            background_color->red,
-            background_color->green,
-            background_color->blue,
-            255);
+    /* Reuse copy for new colors, with no glyphs yet colored */
+    colors->foreground = foreground;
+    colors->background = background;
+    colors->last_used = ++display->color_clock;
+    colors->batch = display->glyph_batch;
+    memset(colors->generations, 0, sizeof(colors->generations));
 
-        /* Copy stroke */
-        guac_protocol_send_copy(socket, display->glyph_stroke,
+    return colors;
 
-            0, 0,
-            display->char_width * display->next_glyph, display->char_height,
+}
 
-            GUAC_COMP_OVER, display->filled_glyphs,
-            0, 0);
+/**
+ * Selects the colored copy of the glyph atlas matching the given attributes,
+ * such that future characters will display as expected.
+ */
+int __guac_terminal_set_colors(guac_terminal_display* display,
+        guac_terminal_attributes* attributes) {
+
+    guac_terminal_glyph_colors* colors = display->current_colors;
+    int background, foreground;
 
+    /* Handle reverse video */
+    if (attributes->reverse != attributes->cursor) {
+        background = attributes->foreground;
+        foreground = attributes->background;
+    }
+    else {
+        foreground = attributes->foreground;
+        background = attributes->background;
     }
 
-    display->glyph_foreground = foreground;
-    display->glyph_background = background;
+    /* Handle bold */
+    if (attributes->bold && foreground <= 7)
+        foreground += 8;
+
+    /* Look up colored copy only if colors have changed */
+    if (colors == NULL || foreground != colors->foreground
+            || background != colors->background)
+        display->current_colors = __guac_terminal_get_glyph_colors(display,
+                foreground, background);
 
     return 0;
 
 }
 
 /**
- * Sends the given character to the terminal at the given row and column,
- * rendering the charater immediately. This bypasses the guac_terminal_display
- * mechanism and is intended for flushing of updates only.
+ * Sends the given character to the terminal at the given row and column.
+ * The character is drawn once the current glyph batch is flushed. This
+ * bypasses the guac_terminal_display mechanism and is intended for flushing
+ * of updates only.
  */
-int __guac_terminal_set(guac_terminal_display* display, int row, int col, int codepoint) {
+int __guac_terminal_set(guac_terminal_display* display, int row, int col,
+        int codepoint, int style) {
 
-    guac_socket* socket = display->client->socket;
-    int location = __guac_terminal_get_glyph(display, codepoint); 
+    guac_terminal_glyph_colors* colors;
+    guac_terminal_glyph_draw* draw;
+    int location;
+    int generation;
 
-    return guac_protocol_send_copy(socket,
-        display->filled_glyphs,
-        location * display->char_width, 0, display->char_width, display->char_height,
-        GUAC_COMP_OVER, GUAC_DEFAULT_LAYER,
-        display->char_width * col,
-        display->char_height * row);
+    /* Send pending draws if no room for another */
+    if (display->pending_draw_count == GUAC_TERMINAL_MAX_PENDING_DRAWS)
+        __guac_terminal_display_flush_glyphs(display);
+
+    location = __guac_terminal_get_glyph(display, codepoint, style);
+
+    /* Colored copy must remain until the draw is sent */
+    colors = display->current_colors;
+    colors->batch = display->glyph_batch;
+
+    /* Draw once glyph is available */
+    draw = &(display->pending_draws[display->pending_draw_count++]);
+    draw->location = location;
+    draw->colors = colors;
+    draw->row = row;
+    draw->column = col;
+
+    /* Color glyph first if not yet present within the colored copy */
+    generation = display->glyphs[location].generation;
+    draw->colorize = (colors->generations[location] != generation);
+    colors->generations[location] = generation;
+
+    return 0;
 
 }
 
@@ -336,14 +679,48 @@ guac_terminal_display* guac_terminal_display_alloc(guac_client* client,
     PangoFont* font;
     PangoFontMetrics* metrics;
     PangoContext* context;
+    int i;
 
     /* Allocate display */
     guac_terminal_display* display = malloc(sizeof(guac_terminal_display));
     display->client = client;
 
-    memset(display->glyphs, 0, sizeof(display->glyphs));
+    /* Init glyph atlas, initially empty */
+    for (i=0; i<GUAC_TERMINAL_GLYPH_ATLAS_SIZE; i++) {
+        guac_terminal_glyph* glyph = &(display->glyphs[i]);
+        glyph->location = i;
+        glyph->codepoint = -1;
+        glyph->style = 0;
+        glyph->batch = -1;
+        glyph->generation = 0;
+        glyph->next_in_bucket = NULL;
+        glyph->prev_used = NULL;
+        glyph->next_used = NULL;
+    }
+
+    memset(display->glyph_buckets, 0, sizeof(display->glyph_buckets));
+    display->first_used_glyph = NULL;
+    display->last_used_glyph = NULL;
+    display->next_glyph = 0;
+    display->glyph_batch = 0;
+    display->pending_glyph_count = 0;
+    display->pending_draw_count = 0;
+
+    /* No colored copies of the atlas yet exist */
+    for (i=0; i<GUAC_TERMINAL_GLYPH_COLOR_LAYERS; i++) {
+        guac_terminal_glyph_colors* colors = &(display->glyph_colors[i]);
+        colors->foreground = -1;
+        colors->background = -1;
+        colors->layer = NULL;
+        colors->last_used = 0;
+        colors->batch = -1;
+    }
+
+    display->current_colors = NULL;
+    display->color_clock = 0;
+
     display->glyph_stroke = guac_client_alloc_buffer(client);
-    display->filled_glyphs = guac_client_alloc_buffer(client);
+    display->glyph_staging = guac_client_alloc_buffer(client);
 
     display->select_layer = guac_client_alloc_layer(client);
 
@@ -370,8 +747,9 @@ guac_terminal_display* guac_terminal_display_alloc(guac_client* client,
         return NULL;
     }
 
-    display->glyph_foreground = foreground;
-    display->glyph_background = background;
+    /* Use default colors until told otherwise */
+    display->current_colors = __guac_terminal_get_glyph_colors(display,
+            foreground, background);
 
     /* Calculate character dimensions */
     display->char_width =
@@ -384,6 +762,9 @@ guac_terminal_display* guac_terminal_display_alloc(guac_client* client,
     display->width = 0;
     display->height = 0;
     display->operations = NULL;
+    display->dirty_rows = NULL;
+    display->dirty_start_row = 0;
+    display->dirty_end_row = -1;
 
     /* Initially nothing selected */
     display->text_selected =
@@ -397,6 +778,7 @@ void guac_terminal_display_free(guac_terminal_display* display) {
 
     /* Free operations buffers */
     free(display->operations);
+    free(display->dirty_rows);
 
     /* Free display */
     free(display);
@@ -442,6 +824,9 @@ void guac_terminal_display_copy_columns(guac_terminal_display* display, int row,
 
     }
 
+    __guac_terminal_display_mark_dirty(display, row, start_column + offset,
+            row, end_column + offset);
+
     /* If selection visible and committed, clear if update touches selection */
     if (display->text_selected && display->selection_committed &&
         __guac_terminal_display_selected_contains(display, row, start_column, row, end_column))
@@ -492,6 +877,9 @@ void guac_terminal_display_copy_rows(guac_terminal_display* display,
 
     }
 
+    __guac_terminal_display_mark_dirty(display, start_row + offset, 0,
+            end_row + offset, display->width - 1);
+
     /* If selection visible and committed, clear if update touches selection */
     if (display->text_selected && display->selection_committed &&
         __guac_terminal_display_selected_contains(display, start_row, 0, end_row, display->width - 1))
@@ -526,6 +914,9 @@ void guac_terminal_display_set_columns(guac_terminal_display* display, int row,
         current++;
     }
 
+    __guac_terminal_display_mark_dirty(display, row, start_column,
+            row, end_column);
+
     /* If selection visible and committed, clear if update touches selection */
     if (display->text_selected && display->selection_committed &&
         __guac_terminal_display_selected_contains(display, row, start_column, row, end_column))
@@ -551,10 +942,17 @@ void guac_terminal_display_resize(guac_terminal_display* display, int width, int
     if (display->operations != NULL)
         free(display->operations);
 
+    /* Free old dirty row ranges */
+    if (display->dirty_rows != NULL)
+        free(display->dirty_rows);
+
     /* Alloc operations */
     display->operations = malloc(width * height *
             sizeof(guac_terminal_operation));
 
+    /* Alloc dirty row ranges */
+    display->dirty_rows = malloc(height * sizeof(guac_terminal_dirty_row));
+
     /* Init each operation buffer row */
     current = display->operations;
     for (y=0; y<height; y++) {
@@ -582,6 +980,17 @@ void guac_terminal_display_resize(guac_terminal_display* display, int width, int
     display->width = width;
     display->height = height;
 
+    /* Entire display must be examined on next flush */
+    display->dirty_start_row = height;
+    display->dirty_end_row = -1;
+    for (y=0; y<height; y++) {
+        display->dirty_rows[y].start_column = width;
+        display->dirty_rows[y].end_column = -1;
+    }
+
+    if (width > 0 && height > 0)
+        __guac_terminal_display_mark_dirty(display, 0, 0, height - 1, width - 1);
+
     /* Send initial display size */
     guac_protocol_send_size(display->client->socket,
             GUAC_DEFAULT_LAYER,
@@ -601,12 +1010,16 @@ void guac_terminal_display_resize(guac_terminal_display* display, int width, int
 
 void __guac_terminal_display_flush_copy(guac_terminal_display* display) {
 
-    guac_terminal_operation* current = display->operations;
     int row, col;
 
-    /* For each operation */
-    for (row=0; row<display->height; row++) {
-        for (col=0; col<display->width; col++) {
+    /* For each operation within the dirty region */
+    for (row=display->dirty_start_row; row<=display->dirty_end_row; row++) {
+
+        guac_terminal_dirty_row* dirty = &(display->dirty_rows[row]);
+        guac_terminal_operation* current =
+            &(display->operations[row * display->width + dirty->start_column]);
+
+        for (col=dirty->start_column; col<=dirty->end_column; col++) {
 
             /* If operation is a copy operation */
             if (current->type == GUAC_CHAR_COPY) {
@@ -727,12 +1140,16 @@ void __guac_terminal_display_flush_copy(guac_terminal_display* display) {
 
 void __guac_terminal_display_flush_clear(guac_terminal_display* display) {
 
-    guac_terminal_operation* current = display->operations;
     int row, col;
 
-    /* For each operation */
-    for (row=0; row<display->height; row++) {
-        for (col=0; col<display->width; col++) {
+    /* For each operation within the dirty region */
+    for (row=display->dirty_start_row; row<=display->dirty_end_row; row++) {
+
+        guac_terminal_dirty_row* dirty = &(display->dirty_rows[row]);
+        guac_terminal_operation* current =
+            &(display->operations[row * display->width + dirty->start_column]);
+
+        for (col=dirty->start_column; col<=dirty->end_column; col++) {
 
             /* If operation is a cler operation (set to space) */
             if (current->type == GUAC_CHAR_SET &&
@@ -864,23 +1281,33 @@ void __guac_terminal_display_flush_clear(guac_terminal_display* display) {
 
 void __guac_terminal_display_flush_set(guac_terminal_display* display) {
 
-    guac_terminal_operation* current = display->operations;
     int row, col;
 
-    /* For each operation */
-    for (row=0; row<display->height; row++) {
-        for (col=0; col<display->width; col++) {
+    /* For each operation within the dirty region */
+    for (row=display->dirty_start_row; row<=display->dirty_end_row; row++) {
+
+        guac_terminal_dirty_row* dirty = &(display->dirty_rows[row]);
+        guac_terminal_operation* current =
+            &(display->operations[row * display->width + dirty->start_column]);
+
+        for (col=dirty->start_column; col<=dirty->end_column; col++) {
 
             /* Perform given operation */
             if (current->type == GUAC_CHAR_SET) {
 
+                int style = 0;
+
+                /* Determine glyph style */
+                if (current->character.attributes.underscore)
+                    style |= GUAC_TERMINAL_GLYPH_UNDERSCORE;
+
                 /* Set attributes */
                 __guac_terminal_set_colors(display,
                         &(current->character.attributes));
 
                 /* Send character */
                 __guac_terminal_set(display, row, col,
-                        current->character.value);
+                        current->character.value, style);
 
                 /* Mark operation as handled */
                 current->type = GUAC_CHAR_NOP;
@@ -893,6 +1320,9 @@ void __guac_terminal_display_flush_set(guac_terminal_display* display) {
         }
     }
 
+    /* Send any remaining glyphs and characters */
+    __guac_terminal_display_flush_glyphs(display);
+
 }
 
 void guac_terminal_display_flush(guac_terminal_display* display) {
@@ -902,6 +1332,9 @@ void guac_terminal_display_flush(guac_terminal_display* display) {
     __guac_terminal_display_flush_clear(display);
     __guac_terminal_display_flush_set(display);
 
+    /* All operations have now been handled */
+    __guac_terminal_display_clear_dirty(display);
+
 }
 
 void guac_terminal_display_commit_select(guac_terminal_display* display) {
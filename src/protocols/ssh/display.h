@@ -91,21 +91,207 @@ typedef struct guac_terminal_operation {
 } guac_terminal_operation;
 
 /**
- * A cached glyph.
+ * The number of glyphs stored within each row of the glyph atlas.
  */
-typedef struct guac_terminal_glyph {
+#define GUAC_TERMINAL_GLYPH_ATLAS_COLUMNS 64
+
+/**
+ * The number of rows of glyphs within the glyph atlas.
+ */
+#define GUAC_TERMINAL_GLYPH_ATLAS_ROWS 16
+
+/**
+ * The total number of glyphs which can be stored within the glyph atlas at
+ * any one time. Once the atlas is full, the least-recently-used glyph is
+ * replaced.
+ */
+#define GUAC_TERMINAL_GLYPH_ATLAS_SIZE \
+    (GUAC_TERMINAL_GLYPH_ATLAS_COLUMNS * GUAC_TERMINAL_GLYPH_ATLAS_ROWS)
+
+/**
+ * The number of buckets within the hash table used to locate glyphs within
+ * the glyph atlas. This value MUST be a power of two.
+ */
+#define GUAC_TERMINAL_GLYPH_BUCKETS 1024
+
+/**
+ * The maximum number of newly-rendered glyphs which will be sent together
+ * within a single PNG.
+ */
+#define GUAC_TERMINAL_GLYPH_BATCH_SIZE 32
+
+/**
+ * The maximum number of characters which may be drawn from the glyph atlas
+ * before pending glyphs must be sent.
+ */
+#define GUAC_TERMINAL_MAX_PENDING_DRAWS 1024
+
+/**
+ * The maximum number of foreground/background color combinations for which
+ * colored copies of the glyph atlas are kept. Once this many combinations
+ * are in use, the least-recently-used combination is replaced.
+ */
+#define GUAC_TERMINAL_GLYPH_COLOR_LAYERS 16
+
+/**
+ * Glyph style flag which denotes that the glyph is underlined.
+ */
+#define GUAC_TERMINAL_GLYPH_UNDERSCORE 0x1
+
+typedef struct guac_terminal_glyph guac_terminal_glyph;
+
+/**
+ * A cached glyph, occupying a single slot of the glyph atlas.
+ */
+struct guac_terminal_glyph {
 
     /**
-     * The location within the glyph layer that this glyph can be found.
+     * The index of the slot within the glyph atlas occupied by this glyph.
      */
     int location;
 
     /**
-     * The codepoint currently stored at that location.
+     * The codepoint currently stored at that location, or -1 if the slot is
+     * not yet in use.
      */
     int codepoint;
 
-} guac_terminal_glyph;
+    /**
+     * The style of the glyph stored at that location, as a bitwise OR of
+     * GUAC_TERMINAL_GLYPH_* style flags.
+     */
+    int style;
+
+    /**
+     * The batch in which this glyph was last used. A glyph used within the
+     * current, unsent batch cannot be replaced until that batch is sent.
+     */
+    int batch;
+
+    /**
+     * The number of times this slot has been assigned a glyph. Colored
+     * copies of this slot are only valid if they were produced from the
+     * same generation.
+     */
+    int generation;
+
+    /**
+     * The next glyph within the same hash bucket, or NULL if this is the
+     * last glyph in that bucket.
+     */
+    guac_terminal_glyph* next_in_bucket;
+
+    /**
+     * The glyph used immediately before this glyph, or NULL if this glyph is
+     * the most-recently-used glyph.
+     */
+    guac_terminal_glyph* prev_used;
+
+    /**
+     * The glyph used immediately after this glyph, or NULL if this glyph is
+     * the least-recently-used glyph.
+     */
+    guac_terminal_glyph* next_used;
+
+};
+
+/**
+ * A copy of the glyph atlas in which each glyph is colored with a specific
+ * foreground and background color. Slots within this copy are colored on
+ * demand, as glyphs are drawn using these colors.
+ */
+typedef struct guac_terminal_glyph_colors {
+
+    /**
+     * The foreground color of all glyphs within this layer, as a palette
+     * index, or -1 if this layer is not yet in use.
+     */
+    int foreground;
+
+    /**
+     * The background color of all glyphs within this layer, as a palette
+     * index, or -1 if this layer is not yet in use.
+     */
+    int background;
+
+    /**
+     * The layer containing the colored glyphs, laid out identically to the
+     * glyph atlas, or NULL if not yet allocated.
+     */
+    guac_layer* layer;
+
+    /**
+     * The value of the display's color clock when this layer was last used.
+     */
+    int last_used;
+
+    /**
+     * The batch in which this layer was last used. A layer used within the
+     * current, unsent batch cannot be replaced until that batch is sent.
+     */
+    int batch;
+
+    /**
+     * The generation of the glyph within each slot of the glyph atlas at the
+     * time that slot was colored within this layer, or 0 if that slot has
+     * not been colored within this layer.
+     */
+    int generations[GUAC_TERMINAL_GLYPH_ATLAS_SIZE];
+
+} guac_terminal_glyph_colors;
+
+/**
+ * A character which will be drawn from the glyph atlas once all pending
+ * glyphs have been sent.
+ */
+typedef struct guac_terminal_glyph_draw {
+
+    /**
+     * The slot within the glyph atlas containing the glyph to draw.
+     */
+    int location;
+
+    /**
+     * The colored copy of the glyph atlas to draw the glyph from.
+     */
+    guac_terminal_glyph_colors* colors;
+
+    /**
+     * Whether the glyph must first be colored within that copy of the glyph
+     * atlas before being drawn.
+     */
+    bool colorize;
+
+    /**
+     * The row to draw the glyph at.
+     */
+    int row;
+
+    /**
+     * The column to draw the glyph at.
+     */
+    int column;
+
+} guac_terminal_glyph_draw;
+
+/**
+ * The range of columns within a single row of the display which may contain
+ * pending operations. A row with no pending operations has a start_column
+ * greater than its end_column.
+ */
+typedef struct guac_terminal_dirty_row {
+
+    /**
+     * The first column which may contain a pending operation.
+     */
+    int start_column;
+
+    /**
+     * The last column which may contain a pending operation.
+     */
+    int end_column;
+
+} guac_terminal_dirty_row;
 
 /**
  * Set of all pending operations for the currently-visible screen area.
@@ -132,6 +318,23 @@ typedef struct guac_terminal_display {
      */
     int height;
 
+    /**
+     * The range of columns within each row which may contain pending
+     * operations. Operations outside these ranges are always NOPs.
+     */
+    guac_terminal_dirty_row* dirty_rows;
+
+    /**
+     * The first row which may contain pending operations. If no rows contain
+     * pending operations, this will be greater than dirty_end_row.
+     */
+    int dirty_start_row;
+
+    /**
+     * The last row which may contain pending operations.
+     */
+    int dirty_end_row;
+
     /**
      * The description of the font to use for rendering.
      */
@@ -148,24 +351,78 @@ typedef struct guac_terminal_display {
     int char_height;
 
     /**
-     * Index of next glyph to create
+     * The number of glyph atlas slots which have ever been used. Once this
+     * reaches GUAC_TERMINAL_GLYPH_ATLAS_SIZE, new glyphs replace the
+     * least-recently-used glyph.
      */
     int next_glyph;
 
     /**
-     * Index of locations for each glyph in the stroke and fill layers.
+     * All slots of the glyph atlas, indexed by location.
+     */
+    guac_terminal_glyph glyphs[GUAC_TERMINAL_GLYPH_ATLAS_SIZE];
+
+    /**
+     * Hash table of all glyphs within the glyph atlas, keyed by codepoint
+     * and style.
+     */
+    guac_terminal_glyph* glyph_buckets[GUAC_TERMINAL_GLYPH_BUCKETS];
+
+    /**
+     * The most-recently-used glyph, or NULL if no glyphs have been used.
+     */
+    guac_terminal_glyph* first_used_glyph;
+
+    /**
+     * The least-recently-used glyph, or NULL if no glyphs have been used.
+     */
+    guac_terminal_glyph* last_used_glyph;
+
+    /**
+     * The current glyph batch. This value is incremented each time pending
+     * glyphs and draws are sent.
+     */
+    int glyph_batch;
+
+    /**
+     * The glyphs which have been allocated slots within the glyph atlas but
+     * have not yet been rendered and sent.
+     */
+    guac_terminal_glyph* pending_glyphs[GUAC_TERMINAL_GLYPH_BATCH_SIZE];
+
+    /**
+     * The number of glyphs within pending_glyphs.
+     */
+    int pending_glyph_count;
+
+    /**
+     * All characters which will be drawn once pending glyphs have been sent.
+     */
+    guac_terminal_glyph_draw pending_draws[GUAC_TERMINAL_MAX_PENDING_DRAWS];
+
+    /**
+     * The number of draws within pending_draws.
+     */
+    int pending_draw_count;
+
+    /**
+     * Colored copies of the glyph atlas, one for each recently-used
+     * combination of foreground and background color.
      */
-    guac_terminal_glyph glyphs[512];
+    guac_terminal_glyph_colors glyph_colors[GUAC_TERMINAL_GLYPH_COLOR_LAYERS];
 
     /**
-     * Color of glyphs in copy buffer
+     * The colored copy of the glyph atlas which characters will currently
+     * be drawn from.
      */
-    int glyph_foreground;
+    guac_terminal_glyph_colors* current_colors;
 
     /**
-     * Color of glyphs in copy buffer
+     * Counter which is incremented each time a colored copy of the glyph
+     * atlas is selected, used to determine which copy was least recently
+     * used.
      */
-    int glyph_background;
+    int color_clock;
 
     /**
      * Layer above default layer which highlights selected text.
@@ -173,16 +430,20 @@ typedef struct guac_terminal_display {
     guac_layer* select_layer;
 
     /**
-     * A single wide layer holding each glyph, with each glyph only
-     * colored with foreground color (background remains transparent).
+     * The glyph atlas: a layer holding each glyph in a grid of
+     * GUAC_TERMINAL_GLYPH_ATLAS_COLUMNS by GUAC_TERMINAL_GLYPH_ATLAS_ROWS
+     * slots, with each glyph drawn in white (background remains
+     * transparent). Glyphs are colored by copying them into the layers of
+     * glyph_colors.
      */
     guac_layer* glyph_stroke;
 
     /**
-     * A single wide layer holding each glyph, with each glyph properly
-     * colored with foreground and background color (no transparency at all).
+     * A single wide layer which receives newly-rendered glyphs, each batch
+     * of glyphs being sent as a single PNG before being copied into their
+     * slots within the glyph atlas.
      */
-    guac_layer* filled_glyphs;
+    guac_layer* glyph_staging;
 
     /**
      * Whether text is being selected.
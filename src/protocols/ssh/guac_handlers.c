@@ -31,73 +31,57 @@
 #include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/select.h>
 #include <sys/stat.h>
 
 #include <cairo/cairo.h>
 #include <guacamole/socket.h>
 #include <guacamole/protocol.h>
 #include <guacamole/client.h>
+#include <guacamole/timestamp.h>
 #include <libssh2.h>
 #include <pango/pangocairo.h>
 
 int ssh_guac_client_handle_messages(guac_client* client) {
 
     ssh_guac_client_data* client_data = (ssh_guac_client_data*) client->data;
-    char buffer[8192];
+    guac_terminal* term = client_data->term;
 
-    int ret_val;
-    int fd = client_data->term->stdout_pipe_fd[0];
-    struct timeval timeout;
-    fd_set fds;
+    /* Send any clipboard contents the client has not acknowledged in time */
+    guac_common_clipboard_continue(client_data->clipboard);
 
-    /* Build fd_set */
-    FD_ZERO(&fds);
-    FD_SET(fd, &fds);
+    /* Lock terminal access */
+    pthread_mutex_lock(&(term->lock));
 
-    /* Time to wait */
-    timeout.tv_sec =  1;
-    timeout.tv_usec = 0;
+    /* Wait for output to be written to terminal */
+    if (guac_terminal_wait(term, 1000) > 0) {
 
-    /* Wait for data to be available */
-    ret_val = select(fd+1, &fds, NULL, NULL, &timeout);
-    if (ret_val > 0) {
+        guac_timestamp frame_start = guac_timestamp_current();
+        int frame_remaining;
 
-        int bytes_read = 0;
+        /* Continue frame only while further output arrives promptly */
+        do {
 
-        /* Lock terminal access */
-        pthread_mutex_lock(&(client_data->term->lock));
+            /* Stop if time budget for this frame is used up */
+            frame_remaining = frame_start + GUAC_SSH_FRAME_DURATION
+                            - guac_timestamp_current();
+            if (frame_remaining <= 0)
+                break;
 
-        /* Read data, write to terminal */
-        if ((bytes_read = read(fd, buffer, sizeof(buffer))) > 0) {
+            if (frame_remaining > GUAC_SSH_FRAME_TIMEOUT)
+                frame_remaining = GUAC_SSH_FRAME_TIMEOUT;
 
-            if (guac_terminal_write(client_data->term, buffer, bytes_read)) {
-                guac_client_abort(client, GUAC_PROTOCOL_STATUS_SERVER_ERROR, "Error writing data");
-                return 1;
-            }
-
-        }
-
-        /* Notify on error */
-        if (bytes_read < 0) {
-            guac_client_abort(client, GUAC_PROTOCOL_STATUS_SERVER_ERROR, "Error reading data");
-            return 1;
-        }
+        } while (guac_terminal_wait(term, frame_remaining) > 0);
 
         /* Update cursor */
-        guac_terminal_commit_cursor(client_data->term);
+        guac_terminal_commit_cursor(term);
 
         /* Flush terminal display */
-        guac_terminal_display_flush(client_data->term->display);
-
-        /* Unlock terminal access */
-        pthread_mutex_unlock(&(client_data->term->lock));
+        guac_terminal_display_flush(term->display);
 
     }
-    else if (ret_val < 0) {
-        guac_client_abort(client, GUAC_PROTOCOL_STATUS_SERVER_ERROR, "Error waiting for data");
-        return 1;
-    }
+
+    /* Unlock terminal access */
+    pthread_mutex_unlock(&(term->lock));
 
     return 0;
 
@@ -58,12 +58,12 @@ static char* prompt(guac_client* client, const char* title, char* str, int size,
     int pos;
     char in_byte;
 
-    /* Get STDIN and STDOUT */
+    /* Get STDIN and terminal */
     int stdin_fd  = client_data->term->stdin_pipe_fd[0];
-    int stdout_fd = client_data->term->stdout_pipe_fd[1];
+    guac_terminal* term = client_data->term;
 
     /* Print title */
-    guac_terminal_write_all(stdout_fd, title, strlen(title));
+    guac_terminal_write_stdout(term, title, strlen(title));
 
     /* Make room for null terminator */
     size--;
@@ -76,14 +76,14 @@ static char* prompt(guac_client* client, const char* title, char* str, int size,
         if (in_byte == 0x7F) {
 
             if (pos > 0) {
-                guac_terminal_write_all(stdout_fd, "\b \b", 3);
+                guac_terminal_write_stdout(term, "\b \b", 3);
                 pos--;
             }
         }
 
         /* CR (end of input */
         else if (in_byte == 0x0D) {
-            guac_terminal_write_all(stdout_fd, "\r\n", 2);
+            guac_terminal_write_stdout(term, "\r\n", 2);
             break;
         }
 
@@ -94,9 +94,9 @@ static char* prompt(guac_client* client, const char* title, char* str, int size,
 
             /* Print character if echoing */
             if (echo)
-                guac_terminal_write_all(stdout_fd, &in_byte, 1);
+                guac_terminal_write_stdout(term, &in_byte, 1);
             else
-                guac_terminal_write_all(stdout_fd, "*", 1);
+                guac_terminal_write_stdout(term, "*", 1);
 
         }
 
@@ -283,7 +283,6 @@ void* ssh_client_thread(void* data) {
     int bytes_read = -1234;
 
     int socket_fd;
-    int stdout_fd = client_data->term->stdout_pipe_fd[1];
 
     pthread_t input_thread;
 
@@ -335,7 +334,7 @@ void* ssh_client_thread(void* data) {
         prompt(client, "Password: ", client_data->password, sizeof(client_data->password), false);
 
     /* Clear screen */
-    guac_terminal_write_all(stdout_fd, "\x1B[H\x1B[J", 6);
+    guac_terminal_write_stdout(client_data->term, "\x1B[H\x1B[J", 6);
 
     /* Open SSH session */
     client_data->session = __guac_ssh_create_session(client, &socket_fd);
@@ -428,10 +427,9 @@ void* ssh_client_thread(void* data) {
         bytes_read = libssh2_channel_read(client_data->term_channel,
                 buffer, sizeof(buffer));
 
-        /* Attempt to write data received. Exit on failure. */
+        /* Write data received directly to terminal. Exit on failure. */
         if (bytes_read > 0) {
-            int written = guac_terminal_write_all(stdout_fd, buffer, bytes_read);
-            if (written < 0)
+            if (guac_terminal_write_stdout(client_data->term, buffer, bytes_read))
                 break;
 
             total_read += bytes_read;
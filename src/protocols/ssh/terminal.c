@@ -34,6 +34,12 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef HAVE_CLOCK_GETTIME
+#include <time.h>
+#else
+#include <sys/time.h>
+#endif
+
 #include <cairo/cairo.h>
 #include <guacamole/client.h>
 #include <guacamole/error.h>
@@ -119,14 +125,6 @@ guac_terminal* guac_terminal_create(guac_client* client,
     term->term_width   = width  / term->display->char_width;
     term->term_height  = height / term->display->char_height;
 
-    /* Open STDOUT pipe */
-    if (pipe(term->stdout_pipe_fd)) {
-        guac_error = GUAC_STATUS_SEE_ERRNO;
-        guac_error_message = "Unable to open pipe for STDOUT";
-        free(term);
-        return NULL;
-    }
-
     /* Open STDIN pipe */
     if (pipe(term->stdin_pipe_fd)) {
         guac_error = GUAC_STATUS_SEE_ERRNO;
@@ -138,6 +136,10 @@ guac_terminal* guac_terminal_create(guac_client* client,
     /* Init terminal lock */
     pthread_mutex_init(&(term->lock), NULL);
 
+    /* Init output notification, initially without output */
+    pthread_cond_init(&(term->modified_cond), NULL);
+    term->modified = false;
+
     /* Size display */
     guac_terminal_display_resize(term->display,
             term->term_width, term->term_height);
@@ -151,10 +153,6 @@ guac_terminal* guac_terminal_create(guac_client* client,
 
 void guac_terminal_free(guac_terminal* term) {
     
-    /* Close terminal output pipe */
-    close(term->stdout_pipe_fd[1]);
-    close(term->stdout_pipe_fd[0]);
-
     /* Close user input pipe */
     close(term->stdin_pipe_fd[1]);
     close(term->stdin_pipe_fd[0]);
@@ -165,6 +163,9 @@ void guac_terminal_free(guac_terminal* term) {
     /* Free buffer */
     guac_terminal_buffer_free(term->buffer);
 
+    /* Free output notification */
+    pthread_cond_destroy(&(term->modified_cond));
+
 }
 
 int guac_terminal_set(guac_terminal* term, int row, int col, int codepoint) {
@@ -225,6 +226,67 @@ int guac_terminal_write(guac_terminal* term, const char* c, int size) {
 
 }
 
+int guac_terminal_write_stdout(guac_terminal* term, const char* c, int size) {
+
+    int result;
+
+    pthread_mutex_lock(&(term->lock));
+
+    /* Write output, notifying any waiting thread */
+    result = guac_terminal_write(term, c, size);
+    term->modified = true;
+    pthread_cond_signal(&(term->modified_cond));
+
+    pthread_mutex_unlock(&(term->lock));
+
+    return result;
+
+}
+
+int guac_terminal_wait(guac_terminal* term, int msec_timeout) {
+
+    struct timespec deadline;
+    int modified;
+
+#ifdef HAVE_CLOCK_GETTIME
+
+    /* Get current time */
+    clock_gettime(CLOCK_REALTIME, &deadline);
+
+#else
+
+    struct timeval current;
+
+    /* Get current time */
+    gettimeofday(&current, NULL);
+    deadline.tv_sec  = current.tv_sec;
+    deadline.tv_nsec = current.tv_usec * 1000;
+
+#endif
+
+    /* Calculate time that waiting must stop */
+    deadline.tv_sec  +=  msec_timeout / 1000;
+    deadline.tv_nsec += (msec_timeout % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    /* Wait for output, ignoring spurious wakeups */
+    while (!term->modified) {
+        if (pthread_cond_timedwait(&(term->modified_cond), &(term->lock),
+                    &deadline))
+            break;
+    }
+
+    /* Output is now being handled */
+    modified = term->modified;
+    term->modified = false;
+
+    return modified;
+
+}
+
 int guac_terminal_scroll_up(guac_terminal* term,
         int start_row, int end_row, int amount) {
 
@@ -72,13 +72,17 @@ struct guac_terminal {
     pthread_mutex_t lock;
 
     /**
-     * Pipe which should be written to (and read from) to provide output to
-     * this terminal. Another thread should read from this pipe when writing
-     * data to the terminal. It would make sense for the terminal to provide
-     * this thread, but for simplicity, that logic is left to the guac
-     * message handler (to give the message handler something to block with).
+     * Whether output has been written to this terminal since the last call
+     * to guac_terminal_wait(). This flag is protected by the terminal lock.
      */
-    int stdout_pipe_fd[2];
+    bool modified;
+
+    /**
+     * Condition which is signalled whenever output is written to this
+     * terminal via guac_terminal_write_stdout(), allowing the guac message
+     * handler to block until there is something to render.
+     */
+    pthread_cond_t modified_cond;
 
     /**
      * Pipe which will be the source of user input. When a terminal code
@@ -266,6 +270,23 @@ void guac_terminal_free(guac_terminal* term);
  */
 int guac_terminal_write(guac_terminal* term, const char* c, int size);
 
+/**
+ * Writes the given string of characters to the terminal as output from the
+ * program running within it, acquiring the terminal lock and waking any
+ * thread blocked within guac_terminal_wait(). The terminal lock must NOT
+ * already be held by the calling thread.
+ */
+int guac_terminal_write_stdout(guac_terminal* term, const char* c, int size);
+
+/**
+ * Waits up to the given number of milliseconds for output to be written to
+ * the terminal via guac_terminal_write_stdout(). The terminal lock MUST be
+ * held by the calling thread, and is released while waiting. Returns a
+ * positive value if output was written since the last call to this
+ * function, or zero if the timeout elapsed without any output.
+ */
+int guac_terminal_wait(guac_terminal* term, int msec_timeout);
+
 /**
  * Sets the character at the given row and column to the specified value.
  */
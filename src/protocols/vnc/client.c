@@ -64,6 +64,8 @@ const char* GUAC_CLIENT_ARGS[] = {
 #ifdef ENABLE_PULSE
     "enable-audio",
     "audio-servername",
+    "audio-rate",
+    "audio-channels",
 #endif
 
 #ifdef ENABLE_VNC_LISTEN
@@ -94,6 +96,8 @@ enum VNC_ARGS_IDX {
 #ifdef ENABLE_PULSE
     IDX_ENABLE_AUDIO,
     IDX_AUDIO_SERVERNAME,
+    IDX_AUDIO_RATE,
+    IDX_AUDIO_CHANNELS,
 #endif
 
 #ifdef ENABLE_VNC_LISTEN
@@ -321,7 +325,31 @@ int guac_client_init(guac_client* client, int argc, char** argv) {
 
         /* If successful, init audio system */
         if (guac_client_data->audio != NULL) {
-            
+
+            /* Audio sample rate, if resampling is requested */
+            if (argv[IDX_AUDIO_RATE][0] != '\0')
+                guac_client_data->audio->target_rate =
+                    atoi(argv[IDX_AUDIO_RATE]);
+
+            if (guac_client_data->audio->target_rate < 0) {
+                guac_client_data->audio->target_rate = 0;
+                guac_client_log_error(client,
+                        "Invalid audio-rate: \"%s\". Audio will not be "
+                        "resampled.", argv[IDX_AUDIO_RATE]);
+            }
+
+            /* Audio channel count, if downmixing is requested */
+            if (argv[IDX_AUDIO_CHANNELS][0] != '\0')
+                guac_client_data->audio->target_channels =
+                    atoi(argv[IDX_AUDIO_CHANNELS]);
+
+            if (guac_client_data->audio->target_channels < 0) {
+                guac_client_data->audio->target_channels = 0;
+                guac_client_log_error(client,
+                        "Invalid audio-channels: \"%s\". Audio will not be "
+                        "downmixed.", argv[IDX_AUDIO_CHANNELS]);
+            }
+
             guac_client_log_info(client,
                     "Audio will be encoded as %s",
                     guac_client_data->audio->encoder->mimetype);
@@ -345,7 +373,7 @@ int guac_client_init(guac_client* client, int argc, char** argv) {
     /* Set remaining client data */
     guac_client_data->rfb_client = rfb_client;
     guac_client_data->copy_rect_used = 0;
-    guac_client_data->cursor = guac_client_alloc_buffer(client);
+    guac_client_data->cursor_cache = guac_common_cursor_cache_alloc(client);
 
     /* Set handlers */
     client->handle_messages = vnc_guac_client_handle_messages;
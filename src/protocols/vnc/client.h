@@ -26,6 +26,7 @@
 
 #include "config.h"
 #include "guac_clipboard.h"
+#include "guac_pointer_cursor.h"
 
 #include <guacamole/audio.h>
 #include <guacamole/client.h>
@@ -55,7 +56,7 @@
 /**
  * The maximum number of bytes to allow within the clipboard.
  */
-#define GUAC_VNC_CLIPBOARD_MAX_LENGTH 262144
+#define GUAC_VNC_CLIPBOARD_MAX_LENGTH 16777216
 
 extern char* __GUAC_CLIENT;
 
@@ -149,9 +150,9 @@ typedef struct vnc_guac_client_data {
     int remote_cursor;
 
     /**
-     * The layer holding the cursor image.
+     * Cache of all cursor images sent to the client.
      */
-    guac_layer* cursor;
+    guac_common_cursor_cache* cursor_cache;
     
     /**
      * Whether audio is enabled.
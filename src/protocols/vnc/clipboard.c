@@ -26,6 +26,9 @@
 #include "guac_clipboard.h"
 #include "guac_iconv.h"
 
+#include <pthread.h>
+#include <stdlib.h>
+
 int guac_vnc_clipboard_handler(guac_client* client, guac_stream* stream,
         char* mimetype) {
 
@@ -53,20 +56,35 @@ int guac_vnc_clipboard_blob_handler(guac_client* client, guac_stream* stream,
 int guac_vnc_clipboard_end_handler(guac_client* client, guac_stream* stream) {
 
     vnc_guac_client_data* client_data = (vnc_guac_client_data*) client->data;
+    guac_common_clipboard* clipboard = client_data->clipboard;
     rfbClient* rfb_client = client_data->rfb_client;
 
-    char output_data[GUAC_VNC_CLIPBOARD_MAX_LENGTH];
+    int output_size;
+    char* output_data;
+
+    const char* input;
+    char* output;
+
+    /* Clipboard may be replaced by the server while being read */
+    pthread_mutex_lock(&(clipboard->lock));
 
-    const char* input = client_data->clipboard->buffer;
-    char* output = output_data;
+    /* ISO 8859-1 requires no more bytes than UTF-8 */
+    output_size = clipboard->length + 1;
+    output_data = malloc(output_size);
+
+    input = clipboard->buffer;
+    output = output_data;
 
     /* Convert clipboard to ISO 8859-1 */
-    guac_iconv(GUAC_READ_UTF8, &input, client_data->clipboard->length,
-               GUAC_WRITE_ISO8859_1, &output, sizeof(output_data));
+    guac_iconv(GUAC_READ_UTF8, &input, clipboard->length,
+               GUAC_WRITE_ISO8859_1, &output, output_size);
+
+    pthread_mutex_unlock(&(clipboard->lock));
 
     /* Send via VNC */
     SendClientCutText(rfb_client, output_data, output - output_data);
 
+    free(output_data);
     return 0;
 }
 
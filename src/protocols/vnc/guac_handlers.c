@@ -25,6 +25,7 @@
 #include "client.h"
 #include "clipboard.h"
 #include "guac_clipboard.h"
+#include "guac_pointer_cursor.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -41,11 +42,16 @@
 
 int vnc_guac_client_handle_messages(guac_client* client) {
 
-    rfbClient* rfb_client = ((vnc_guac_client_data*) client->data)->rfb_client;
+    vnc_guac_client_data* guac_client_data = (vnc_guac_client_data*) client->data;
+    rfbClient* rfb_client = guac_client_data->rfb_client;
 
     /* Initially wait for messages */
     int wait_result = WaitForMessage(rfb_client, 1000000);
     guac_timestamp frame_start = guac_timestamp_current();
+
+    /* Send any clipboard contents the client has not acknowledged in time */
+    guac_common_clipboard_continue(guac_client_data->clipboard);
+
     while (wait_result > 0) {
 
         guac_timestamp frame_end;
@@ -116,6 +122,9 @@ int vnc_guac_client_free_handler(guac_client* client) {
     /* Free clipboard */
     guac_common_clipboard_free(guac_client_data->clipboard);
 
+    /* Free cursor cache */
+    guac_common_cursor_cache_free(guac_client_data->cursor_cache);
+
     /* Free generic data struct */
     free(client->data);
 
@@ -24,6 +24,7 @@
 
 #include "client.h"
 #include "guac_iconv.h"
+#include "guac_pointer_cursor.h"
 
 #include <stdlib.h>
 #include <syslog.h>
@@ -43,15 +44,12 @@
 void guac_vnc_cursor(rfbClient* client, int x, int y, int w, int h, int bpp) {
 
     guac_client* gc = rfbClientGetClientData(client, __GUAC_CLIENT);
-    guac_socket* socket = gc->socket;
     vnc_guac_client_data* guac_client_data = (vnc_guac_client_data*) gc->data;
-    const guac_layer* cursor_layer = guac_client_data->cursor;
 
     /* Cairo image buffer */
     int stride = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, w);
     unsigned char* buffer = malloc(h*stride);
     unsigned char* buffer_row_current = buffer;
-    cairo_surface_t* surface;
 
     /* VNC image buffer */
     unsigned int fb_stride = bpp * w;
@@ -114,17 +112,10 @@ void guac_vnc_cursor(rfbClient* client, int x, int y, int w, int h, int bpp) {
         }
     }
 
-    /* Send cursor data*/
-    surface = cairo_image_surface_create_for_data(buffer, CAIRO_FORMAT_ARGB32, w, h, stride);
-    
-    guac_protocol_send_png(socket,
-            GUAC_COMP_SRC, cursor_layer, 0, 0, surface);
-    
-    /* Update cursor */
-    guac_protocol_send_cursor(socket, x, y, cursor_layer, 0, 0, w, h);
-    
-    /* Free surface */
-    cairo_surface_destroy(surface);
+    /* Update cursor, sending image only if not already sent */
+    guac_common_cursor_cache_set(guac_client_data->cursor_cache,
+            x, y, buffer, w, h, stride);
+
     free(buffer);
 
     /* libvncclient does not free rcMask as it does rcSource */
@@ -299,20 +290,24 @@ void guac_vnc_cut_text(rfbClient* client, const char* text, int textlen) {
     guac_client* gc = rfbClientGetClientData(client, __GUAC_CLIENT);
     vnc_guac_client_data* client_data = (vnc_guac_client_data*) gc->data;
 
-    char received_data[GUAC_VNC_CLIPBOARD_MAX_LENGTH];
+    /* Each ISO 8859-1 character requires at most two bytes of UTF-8 */
+    int output_size = textlen * 2 + 1;
+    char* received_data = malloc(output_size);
 
     const char* input = text;
     char* output = received_data;
 
     /* Convert clipboard contents */
     guac_iconv(GUAC_READ_ISO8859_1, &input, textlen,
-               GUAC_WRITE_UTF8, &output, sizeof(received_data));
+               GUAC_WRITE_UTF8, &output, output_size);
 
     /* Send converted data */
     guac_common_clipboard_reset(client_data->clipboard, "text/plain");
     guac_common_clipboard_append(client_data->clipboard, received_data, output - received_data);
     guac_common_clipboard_send(client_data->clipboard, gc);
 
+    free(received_data);
+
 }
 
 void guac_vnc_client_log_info(const char* format, ...) {
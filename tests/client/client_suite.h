@@ -30,6 +30,7 @@ int register_client_suite();
 
 void test_layer_pool();
 void test_buffer_pool();
+void test_mouse_coalescing();
 
 #endif
 
@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2013 Glyptodon LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "config.h"
+
+#include "client_suite.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <CUnit/Basic.h>
+#include <guacamole/client.h>
+#include <guacamole/instruction.h>
+#include <guacamole/socket.h>
+
+/**
+ * The maximum number of events recorded by the test handlers.
+ */
+#define TEST_MAX_EVENTS 64
+
+/**
+ * A single event received by the test handlers. Key events are recorded
+ * with a negative mask.
+ */
+typedef struct test_event {
+    int x;
+    int y;
+    int mask;
+} test_event;
+
+static test_event events[TEST_MAX_EVENTS];
+static int event_count;
+
+static int test_mouse_handler(guac_client* client, int x, int y, int mask) {
+
+    if (event_count < TEST_MAX_EVENTS) {
+        events[event_count].x = x;
+        events[event_count].y = y;
+        events[event_count].mask = mask;
+    }
+
+    event_count++;
+    return 0;
+
+}
+
+static int test_key_handler(guac_client* client, int keysym, int pressed) {
+
+    if (event_count < TEST_MAX_EVENTS) {
+        events[event_count].x = keysym;
+        events[event_count].y = pressed;
+        events[event_count].mask = -1;
+    }
+
+    event_count++;
+    return 0;
+
+}
+
+/**
+ * Appends a mouse instruction to the given buffer, returning the number of
+ * characters written.
+ */
+static int test_write_mouse(char* buffer, int x, int y, int mask) {
+
+    char x_str[16], y_str[16], mask_str[16];
+
+    sprintf(x_str,    "%i", x);
+    sprintf(y_str,    "%i", y);
+    sprintf(mask_str, "%i", mask);
+
+    return sprintf(buffer, "5.mouse,%i.%s,%i.%s,%i.%s;",
+            (int) strlen(x_str),    x_str,
+            (int) strlen(y_str),    y_str,
+            (int) strlen(mask_str), mask_str);
+
+}
+
+void test_mouse_coalescing() {
+
+    int fd[2];
+    int i;
+    int instruction_count = 0;
+
+    char input[8192];
+    int length = 0;
+
+    guac_client* client;
+    guac_socket* socket;
+
+    /* Motion before press, drag, key mid-drag, release, then final motion */
+    for (i = 1; i <= 20; i++, instruction_count++)
+        length += test_write_mouse(input + length, i, i, 0);
+
+    length += test_write_mouse(input + length, 20, 20, 1);
+    instruction_count++;
+
+    for (i = 21; i <= 40; i++, instruction_count++)
+        length += test_write_mouse(input + length, i, i, 1);
+
+    length += sprintf(input + length, "3.key,2.65,1.1;");
+    instruction_count++;
+
+    for (i = 41; i <= 50; i++, instruction_count++)
+        length += test_write_mouse(input + length, i, i, 1);
+
+    length += test_write_mouse(input + length, 50, 50, 0);
+    length += test_write_mouse(input + length, 60, 60, 0);
+    instruction_count += 2;
+
+    /* All input is waiting before the first instruction is handled */
+    CU_ASSERT_EQUAL_FATAL(pipe(fd), 0);
+    CU_ASSERT_EQUAL_FATAL(write(fd[1], input, length), length);
+
+    socket = guac_socket_open(fd[0]);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(socket);
+
+    client = guac_client_alloc();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(client);
+
+    client->socket = socket;
+    client->mouse_handler = test_mouse_handler;
+    client->key_handler = test_key_handler;
+
+    event_count = 0;
+
+    /* Handle all instructions */
+    for (i = 0; i < instruction_count; i++) {
+
+        guac_instruction* instruction = guac_instruction_read(socket, 1000000);
+        CU_ASSERT_PTR_NOT_NULL_FATAL(instruction);
+
+        CU_ASSERT_EQUAL(guac_client_handle_instruction(client, instruction), 0);
+        guac_instruction_free(instruction);
+
+    }
+
+    /* Only button changes, motion preceding the key, and final motion */
+    CU_ASSERT_EQUAL_FATAL(event_count, 5);
+
+    CU_ASSERT_EQUAL(events[0].x, 20);
+    CU_ASSERT_EQUAL(events[0].y, 20);
+    CU_ASSERT_EQUAL(events[0].mask, 1);
+
+    CU_ASSERT_EQUAL(events[1].x, 40);
+    CU_ASSERT_EQUAL(events[1].y, 40);
+    CU_ASSERT_EQUAL(events[1].mask, 1);
+
+    CU_ASSERT_EQUAL(events[2].x, 65);
+    CU_ASSERT_EQUAL(events[2].y, 1);
+    CU_ASSERT_EQUAL(events[2].mask, -1);
+
+    CU_ASSERT_EQUAL(events[3].x, 50);
+    CU_ASSERT_EQUAL(events[3].y, 50);
+    CU_ASSERT_EQUAL(events[3].mask, 0);
+
+    CU_ASSERT_EQUAL(events[4].x, 60);
+    CU_ASSERT_EQUAL(events[4].y, 60);
+    CU_ASSERT_EQUAL(events[4].mask, 0);
+
+    guac_client_free(client);
+    guac_socket_free(socket);
+    close(fd[1]);
+
+}
+
@@ -47,7 +47,10 @@ int register_common_suite() {
     /* Add tests */
     if (
         CU_add_test(suite, "guac-iconv", test_guac_iconv)  == NULL
+     || CU_add_test(suite, "guac-iconv-bulk", test_guac_iconv_bulk) == NULL
+     || CU_add_test(suite, "guac-clipboard", test_guac_clipboard) == NULL
      || CU_add_test(suite, "guac-string", test_guac_string) == NULL
+     || CU_add_test(suite, "guac-pointer-cursor", test_guac_pointer_cursor) == NULL
        ) {
         CU_cleanup_registry();
         return CU_get_error();
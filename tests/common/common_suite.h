@@ -49,5 +49,21 @@ void test_guac_string();
  */
 void test_guac_iconv();
 
+/**
+ * Unit test for bulk conversion of ASCII within character conversion
+ * functions.
+ */
+void test_guac_iconv_bulk();
+
+/**
+ * Unit test for clipboard storage.
+ */
+void test_guac_clipboard();
+
+/**
+ * Unit test for the content-addressed cursor image cache.
+ */
+void test_guac_pointer_cursor();
+
 #endif
 
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2013 Glyptodon LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "config.h"
+
+#include "common_suite.h"
+#include "guac_clipboard.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <CUnit/Basic.h>
+
+void test_guac_clipboard() {
+
+    int i;
+    char data[10000];
+    guac_common_clipboard* clipboard;
+
+    for (i = 0; i < (int) sizeof(data); i++)
+        data[i] = 'A' + (i % 26);
+
+    /* Buffer grows to contain data appended beyond its initial size */
+    clipboard = guac_common_clipboard_alloc(sizeof(data) * 4);
+    guac_common_clipboard_reset(clipboard, "text/plain");
+    for (i = 0; i < 3; i++)
+        guac_common_clipboard_append(clipboard, data, sizeof(data));
+
+    CU_ASSERT_STRING_EQUAL("text/plain", clipboard->mimetype);
+    CU_ASSERT_EQUAL(sizeof(data) * 3, clipboard->length);
+    CU_ASSERT(clipboard->available >= clipboard->length);
+    CU_ASSERT(clipboard->available <= clipboard->max_length);
+
+    for (i = 0; i < 3; i++)
+        CU_ASSERT_EQUAL(0, memcmp(clipboard->buffer + sizeof(data) * i,
+                    data, sizeof(data)));
+
+    /* Data beyond the maximum size is discarded */
+    guac_common_clipboard_append(clipboard, data, sizeof(data));
+    guac_common_clipboard_append(clipboard, data, sizeof(data));
+    CU_ASSERT_EQUAL(sizeof(data) * 4, clipboard->length);
+    CU_ASSERT_EQUAL(clipboard->max_length, clipboard->available);
+    CU_ASSERT_EQUAL(0, memcmp(clipboard->buffer + sizeof(data) * 3,
+                data, sizeof(data)));
+
+    /* Reset clears contents */
+    guac_common_clipboard_reset(clipboard, "text/html");
+    CU_ASSERT_STRING_EQUAL("text/html", clipboard->mimetype);
+    CU_ASSERT_EQUAL(0, clipboard->length);
+
+    guac_common_clipboard_append(clipboard, "test", 4);
+    CU_ASSERT_EQUAL(4, clipboard->length);
+    CU_ASSERT_EQUAL(0, memcmp(clipboard->buffer, "test", 4));
+
+    guac_common_clipboard_free(clipboard);
+
+    /* Clipboards smaller than the initial size never grow */
+    clipboard = guac_common_clipboard_alloc(10);
+    guac_common_clipboard_reset(clipboard, "text/plain");
+    guac_common_clipboard_append(clipboard, data, sizeof(data));
+    CU_ASSERT_EQUAL(10, clipboard->length);
+    CU_ASSERT_EQUAL(10, clipboard->available);
+    CU_ASSERT_EQUAL(0, memcmp(clipboard->buffer, data, 10));
+    guac_common_clipboard_free(clipboard);
+
+}
+
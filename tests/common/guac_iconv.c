@@ -26,6 +26,7 @@
 #include "guac_iconv.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include <CUnit/Basic.h>
 
 static void test_conversion(
@@ -53,6 +54,56 @@ static void test_conversion(
 
 }
 
+/**
+ * Reader which reads UTF-8 using GUAC_READ_UTF8(), but which guac_iconv() does
+ * not recognize, thus forcing conversion one character at a time.
+ */
+static int read_utf8_slow(const char** input, int remaining) {
+    return GUAC_READ_UTF8(input, remaining);
+}
+
+/**
+ * Reader which reads UTF-16 using GUAC_READ_UTF16(), but which guac_iconv()
+ * does not recognize, thus forcing conversion one character at a time.
+ */
+static int read_utf16_slow(const char** input, int remaining) {
+    return GUAC_READ_UTF16(input, remaining);
+}
+
+/**
+ * Verifies that converting the given input with the given reader and writer
+ * produces exactly the same result as converting it one character at a time
+ * with the given equivalent, unrecognized reader.
+ */
+static void test_bulk_conversion(
+        guac_iconv_read* reader, guac_iconv_read* slow_reader,
+        guac_iconv_write* writer, const char* input, int in_length,
+        int out_length) {
+
+    char expected[8192];
+    char output[8192];
+
+    const char* expected_input = input;
+    char* expected_output = expected;
+    int expected_result;
+
+    const char* current_input = input;
+    char* current_output = output;
+    int result;
+
+    expected_result = guac_iconv(slow_reader, &expected_input, in_length,
+            writer, &expected_output, out_length);
+
+    result = guac_iconv(reader, &current_input, in_length,
+            writer, &current_output, out_length);
+
+    CU_ASSERT_EQUAL(expected_result, result);
+    CU_ASSERT_EQUAL(expected_input - input, current_input - input);
+    CU_ASSERT_EQUAL(expected_output - expected, current_output - output);
+    CU_ASSERT_EQUAL(0, memcmp(expected, output, current_output - output));
+
+}
+
 void test_guac_iconv() {
 
     /* UTF8 for "papà è bello" */
@@ -129,3 +180,55 @@ void test_guac_iconv() {
 
 }
 
+void test_guac_iconv_bulk() {
+
+    int i;
+    char utf8[2048];
+    char utf16[4096];
+
+    const char* input;
+    char* output;
+
+    /* Long runs of ASCII interrupted by non-ASCII characters */
+    for (i = 0; i < (int) sizeof(utf8) - 2; i++)
+        utf8[i] = 'a' + (i % 26);
+
+    utf8[100] = (char) 0xC3;
+    utf8[101] = (char) 0xA0;
+    utf8[1000] = (char) 0xE2;
+    utf8[1001] = (char) 0x82;
+    utf8[1002] = (char) 0xAC;
+    utf8[sizeof(utf8) - 2] = '\0';
+    utf8[sizeof(utf8) - 1] = 'z';
+
+    input = utf8;
+    output = utf16;
+    CU_ASSERT_EQUAL(1, guac_iconv(GUAC_READ_UTF8, &input, sizeof(utf8),
+                GUAC_WRITE_UTF16, &output, sizeof(utf16)));
+
+    /* Bulk conversion must match conversion one character at a time */
+    for (i = 0; i < 64; i++) {
+
+        /* Vary input and output lengths to test all boundaries */
+        int length = sizeof(utf8) - i*3;
+        test_bulk_conversion(GUAC_READ_UTF8, read_utf8_slow,
+                GUAC_WRITE_UTF16, utf8, length, length*2 - i);
+        test_bulk_conversion(GUAC_READ_UTF8, read_utf8_slow,
+                GUAC_WRITE_UTF8, utf8, length, length - i);
+        test_bulk_conversion(GUAC_READ_UTF8, read_utf8_slow,
+                GUAC_WRITE_CP1252, utf8, length, length - i);
+
+        test_bulk_conversion(GUAC_READ_UTF16, read_utf16_slow,
+                GUAC_WRITE_UTF8, utf16 + i*2, output - utf16 - i*3,
+                sizeof(utf8) - i);
+        test_bulk_conversion(GUAC_READ_UTF16, read_utf16_slow,
+                GUAC_WRITE_UTF16, utf16 + i*2, output - utf16 - i*3,
+                sizeof(utf16) - i);
+        test_bulk_conversion(GUAC_READ_UTF16, read_utf16_slow,
+                GUAC_WRITE_ISO8859_1, utf16, output - utf16 - i,
+                sizeof(utf8) - i*5);
+
+    }
+
+}
+
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2013 Glyptodon LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "config.h"
+
+#include "common_suite.h"
+#include "guac_pointer_cursor.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <CUnit/Basic.h>
+#include <guacamole/client.h>
+#include <guacamole/layer.h>
+#include <guacamole/socket.h>
+
+/**
+ * Fills the given 8x8 ARGB32 image with a single value, padding each row to
+ * the given stride with garbage.
+ */
+static void __fill_cursor(unsigned char* data, int stride, unsigned char value) {
+
+    int y;
+
+    for (y=0; y<8; y++) {
+        memset(data + y*stride, value, 8*4);
+        memset(data + y*stride + 8*4, y, stride - 8*4);
+    }
+
+}
+
+void test_guac_pointer_cursor() {
+
+    guac_client* client;
+    guac_common_cursor_cache* cache;
+
+    const guac_layer* arrow_buffer;
+    const guac_layer* caret_buffer;
+    const guac_layer* buffer;
+
+    unsigned char arrow[8*40];
+    unsigned char caret[8*40];
+    unsigned char padded_arrow[8*48];
+
+    int i;
+
+    __fill_cursor(arrow, 40, 0x11);
+    __fill_cursor(caret, 40, 0x22);
+    __fill_cursor(padded_arrow, 48, 0x11);
+
+    /* Get client, discarding all output */
+    client = guac_client_alloc();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(client);
+    client->socket = guac_socket_open(open("/dev/null", O_WRONLY));
+    CU_ASSERT_PTR_NOT_NULL_FATAL(client->socket);
+
+    cache = guac_common_cursor_cache_alloc(client);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(cache);
+
+    /* Distinct images must use distinct buffers */
+    arrow_buffer = guac_common_cursor_cache_set(cache, 0, 0, arrow, 8, 8, 40);
+    caret_buffer = guac_common_cursor_cache_set(cache, 0, 0, caret, 8, 8, 40);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(arrow_buffer);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(caret_buffer);
+    CU_ASSERT_PTR_NOT_EQUAL(arrow_buffer, caret_buffer);
+
+    /* Identical images must reuse the same buffer, regardless of stride */
+    buffer = guac_common_cursor_cache_set(cache, 0, 0, arrow, 8, 8, 40);
+    CU_ASSERT_PTR_EQUAL(arrow_buffer, buffer);
+
+    buffer = guac_common_cursor_cache_set(cache, 0, 0, padded_arrow, 8, 8, 48);
+    CU_ASSERT_PTR_EQUAL(arrow_buffer, buffer);
+
+    /* Same image with a different hotspot is a different cursor */
+    buffer = guac_common_cursor_cache_set(cache, 4, 4, arrow, 8, 8, 40);
+    CU_ASSERT_PTR_NOT_EQUAL(arrow_buffer, buffer);
+    CU_ASSERT_PTR_NOT_EQUAL(caret_buffer, buffer);
+
+    /* Using the arrow again keeps it cached while other cursors are evicted */
+    for (i=0; i<GUAC_COMMON_CURSOR_CACHE_SIZE * 2; i++) {
+
+        unsigned char other[8*40];
+        __fill_cursor(other, 40, 0x40 + i);
+
+        CU_ASSERT_PTR_EQUAL(arrow_buffer,
+                guac_common_cursor_cache_set(cache, 0, 0, arrow, 8, 8, 40));
+
+        buffer = guac_common_cursor_cache_set(cache, 0, 0, other, 8, 8, 40);
+        CU_ASSERT_PTR_NOT_EQUAL(arrow_buffer, buffer);
+
+    }
+
+    /* Caret has since been evicted, and is sent again to a reused buffer */
+    buffer = guac_common_cursor_cache_set(cache, 0, 0, caret, 8, 8, 40);
+    CU_ASSERT_PTR_NOT_EQUAL(arrow_buffer, buffer);
+
+    /* Clean up */
+    guac_common_cursor_cache_free(cache);
+    guac_socket_free(client->socket);
+    guac_client_free(client);
+
+}
+